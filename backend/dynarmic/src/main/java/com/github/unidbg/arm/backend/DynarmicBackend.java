@@ -10,12 +10,25 @@ import com.github.unidbg.arm.backend.dynarmic.EventMemHookNotifier;
 import org.apache.commons.logging.Log;
 import org.apache.commons.logging.LogFactory;
 
+import java.io.File;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.util.List;
+import java.util.concurrent.CopyOnWriteArrayList;
+
 public abstract class DynarmicBackend extends FastBackend implements Backend, DynarmicCallback {
 
     private static final Log log = LogFactory.getLog(DynarmicBackend.class);
 
     protected final Dynarmic dynarmic;
 
+    /**
+     * Serializes the syscall handler and hooks, which are entered from every vCPU thread.
+     */
+    protected final Object svcLock = new Object();
+
+    private final ThreadLocal<Long> vcpu = new ThreadLocal<>();
+
     protected DynarmicBackend(Emulator<?> emulator, Dynarmic dynarmic) throws BackendException {
         super(emulator);
         this.dynarmic = dynarmic;
@@ -28,7 +41,9 @@ public abstract class DynarmicBackend extends FastBackend implements Backend, Dy
 
     @Override
     public final boolean handleInterpreterFallback(long pc, int num_instructions) {
-        interruptHookNotifier.notifyCallSVC(this, ARMEmulator.EXCP_UDEF, 0);
+        synchronized (svcLock) {
+            interruptHookNotifier.notifyCallSVC(this, ARMEmulator.EXCP_UDEF, 0);
+        }
         return false;
     }
 
@@ -36,28 +51,34 @@ public abstract class DynarmicBackend extends FastBackend implements Backend, Dy
 
     @Override
     public void handleExceptionRaised(long pc, int exception) {
-        if (exception == EXCEPTION_BREAKPOINT) {
-            interruptHookNotifier.notifyCallSVC(this, ARMEmulator.EXCP_BKPT, 0);
-            return;
-        }
-        try {
-            emulator.attach().debug();
-        } catch (Exception e) {
-            e.printStackTrace();
+        synchronized (svcLock) {
+            if (exception == EXCEPTION_BREAKPOINT) {
+                interruptHookNotifier.notifyCallSVC(this, ARMEmulator.EXCP_BKPT, 0);
+                return;
+            }
+            try {
+                emulator.attach().debug();
+            } catch (Exception e) {
+                e.printStackTrace();
+            }
         }
     }
 
     @Override
     public void handleMemoryReadFailed(long vaddr, int size) {
-        if (eventMemHookNotifier != null) {
-            eventMemHookNotifier.handleMemoryReadFailed(this, vaddr, size);
+        synchronized (svcLock) {
+            if (eventMemHookNotifier != null) {
+                eventMemHookNotifier.handleMemoryReadFailed(this, vaddr, size);
+            }
         }
     }
 
     @Override
     public void handleMemoryWriteFailed(long vaddr, int size) {
-        if (eventMemHookNotifier != null) {
-            eventMemHookNotifier.handleMemoryWriteFailed(this, vaddr, size);
+        synchronized (svcLock) {
+            if (eventMemHookNotifier != null) {
+                eventMemHookNotifier.handleMemoryWriteFailed(this, vaddr, size);
+            }
         }
     }
 
@@ -70,16 +91,153 @@ public abstract class DynarmicBackend extends FastBackend implements Backend, Dy
     public final void enableVFP() {
     }
 
-    protected long until;
-
     @Override
-    public final synchronized void emu_start(long begin, long until, long timeout, long count) throws BackendException {
+    public final void emu_start(long begin, long until, long timeout, long count) throws BackendException {
         if (log.isDebugEnabled()) {
             log.debug("emu_start begin=0x" + Long.toHexString(begin) + ", until=0x" + Long.toHexString(until) + ", timeout=" + timeout + ", count=" + count);
         }
-        this.until = until + 4;
         try {
-            dynarmic.emu_start(begin);
+            if (vcpu.get() != null) {
+                dynarmic.emu_start(begin, until + 4); // the vCPU of this thread runs concurrently with the others
+            } else {
+                synchronized (this) {
+                    dynarmic.emu_start(begin, until + 4);
+                }
+            }
+        } catch (DynarmicException e) {
+            throw new BackendException(e);
+        }
+    }
+
+    /**
+     * @return the index of the register in {@link Dynarmic#reg_read_batch(int[], long[])}, -1 if it has none
+     */
+    protected abstract int toBatchIndex(int regId);
+
+    /**
+     * @return <code>null</code> if a register can only be accessed one by one
+     */
+    private int[] toBatchIndices(int[] regIds) {
+        int[] indices = new int[regIds.length];
+        for (int i = 0; i < regIds.length; i++) {
+            indices[i] = toBatchIndex(regIds[i]);
+            if (indices[i] == -1) {
+                return null;
+            }
+        }
+        return indices;
+    }
+
+    @Override
+    public void reg_read_batch(int[] regIds, long[] values) throws BackendException {
+        int[] indices = toBatchIndices(regIds);
+        if (indices == null) {
+            super.reg_read_batch(regIds, values);
+            return;
+        }
+        try {
+            dynarmic.reg_read_batch(indices, values);
+        } catch (DynarmicException e) {
+            throw new BackendException(e);
+        }
+    }
+
+    @Override
+    public void reg_write_batch(int[] regIds, long[] values) throws BackendException {
+        int[] indices = toBatchIndices(regIds);
+        if (indices == null) {
+            super.reg_write_batch(regIds, values);
+            return;
+        }
+        try {
+            dynarmic.reg_write_batch(indices, values);
+        } catch (DynarmicException e) {
+            throw new BackendException(e);
+        }
+    }
+
+    private boolean emuCountSet;
+
+    @Override
+    public void registerEmuCountHook(long emu_count) {
+        if (emuCountSet) {
+            throw new IllegalStateException();
+        }
+        if (emu_count <= 0) {
+            throw new IllegalArgumentException();
+        }
+        try {
+            dynarmic.set_emu_count(emu_count);
+            emuCountSet = true;
+        } catch (DynarmicException e) {
+            throw new BackendException(e);
+        }
+    }
+
+    /**
+     * @see Dynarmic#set_time_source(int, long)
+     */
+    public void setTimeSource(int source, long instructionsPerSecond) {
+        try {
+            dynarmic.set_time_source(source, instructionsPerSecond);
+        } catch (DynarmicException e) {
+            throw new BackendException(e);
+        }
+    }
+
+    /**
+     * @see Dynarmic#checkpoint()
+     */
+    public void checkpoint() {
+        try {
+            dynarmic.checkpoint();
+        } catch (DynarmicException e) {
+            throw new BackendException(e);
+        }
+    }
+
+    /**
+     * @see Dynarmic#restore_checkpoint()
+     */
+    public void restoreCheckpoint() {
+        try {
+            dynarmic.restore_checkpoint();
+        } catch (DynarmicException e) {
+            throw new BackendException(e);
+        }
+    }
+
+    /**
+     * Binds the calling host thread to a jit of its own, so that its emu_start calls run in parallel with the other vCPUs.
+     * Guest memory, the exclusive monitor, the native syscalls and the hooks are shared, see {@link ParallelCallExecutor}.
+     * @return <code>false</code> if all vCPUs of the dynarmic instance are in use.
+     */
+    public boolean attachVCpu() throws BackendException {
+        if (vcpu.get() != null) {
+            return true;
+        }
+        try {
+            long handle = dynarmic.new_vcpu();
+            if (handle == 0) {
+                return false;
+            }
+            dynarmic.bind_vcpu(handle);
+            vcpu.set(handle);
+            return true;
+        } catch (DynarmicException e) {
+            throw new BackendException(e);
+        }
+    }
+
+    public void detachVCpu() throws BackendException {
+        Long handle = vcpu.get();
+        if (handle == null) {
+            return;
+        }
+        vcpu.remove();
+        try {
+            dynarmic.bind_vcpu(0);
+            dynarmic.free_vcpu(handle);
         } catch (DynarmicException e) {
             throw new BackendException(e);
         }
@@ -99,6 +257,20 @@ public abstract class DynarmicBackend extends FastBackend implements Backend, Dy
         IOUtils.close(dynarmic);
     }
 
+    @Override
+    public boolean registerNativeSyscall(int NR, NativeSyscall syscall) throws BackendException {
+        try {
+            if (syscall == null) {
+                dynarmic.unregister_native_syscall(NR);
+            } else {
+                dynarmic.register_native_syscall(NR, syscall.type, syscall.arg0, syscall.arg1);
+            }
+            return true;
+        } catch (DynarmicException e) {
+            throw new BackendException(e);
+        }
+    }
+
     @Override
     public byte[] mem_read(long address, long size) throws BackendException {
         try {
@@ -108,6 +280,51 @@ public abstract class DynarmicBackend extends FastBackend implements Backend, Dy
         }
     }
 
+    @Override
+    public byte[] mem_read_cstring(long address, int max) throws BackendException {
+        try {
+            return dynarmic.mem_read_cstring(address, max);
+        } catch (DynarmicException e) {
+            throw new BackendException(e);
+        }
+    }
+
+    @Override
+    public int mem_read_u32(long address) throws BackendException {
+        try {
+            return dynarmic.mem_read_u32(address);
+        } catch (DynarmicException e) {
+            throw new BackendException(e);
+        }
+    }
+
+    @Override
+    public long mem_read_u64(long address) throws BackendException {
+        try {
+            return dynarmic.mem_read_u64(address);
+        } catch (DynarmicException e) {
+            throw new BackendException(e);
+        }
+    }
+
+    @Override
+    public void mem_write_u32(long address, int value) throws BackendException {
+        try {
+            dynarmic.mem_write_u32(address, value);
+        } catch (DynarmicException e) {
+            throw new BackendException(e);
+        }
+    }
+
+    @Override
+    public void mem_write_u64(long address, long value) throws BackendException {
+        try {
+            dynarmic.mem_write_u64(address, value);
+        } catch (DynarmicException e) {
+            throw new BackendException(e);
+        }
+    }
+
     @Override
     public void mem_write(long address, byte[] bytes) throws BackendException {
         try {
@@ -117,6 +334,42 @@ public abstract class DynarmicBackend extends FastBackend implements Backend, Dy
         }
     }
 
+    @Override
+    public void mem_read(long address, ByteBuffer dst) throws BackendException {
+        if (!dst.isDirect()) {
+            super.mem_read(address, dst);
+            return;
+        }
+        try {
+            dynarmic.mem_read(address, dst);
+        } catch (DynarmicException e) {
+            throw new BackendException(e);
+        }
+    }
+
+    @Override
+    public void mem_write(long address, ByteBuffer src) throws BackendException {
+        if (!src.isDirect()) {
+            super.mem_write(address, src);
+            return;
+        }
+        try {
+            dynarmic.mem_write(address, src);
+        } catch (DynarmicException e) {
+            throw new BackendException(e);
+        }
+    }
+
+    @Override
+    public ByteBuffer mem_view(long address, int size) throws BackendException {
+        try {
+            ByteBuffer buffer = dynarmic.mem_view(address, size);
+            return buffer == null ? null : buffer.order(ByteOrder.LITTLE_ENDIAN);
+        } catch (DynarmicException e) {
+            throw new BackendException(e);
+        }
+    }
+
     @Override
     public void mem_map(long address, long size, int perms) throws BackendException {
         try {
@@ -126,6 +379,28 @@ public abstract class DynarmicBackend extends FastBackend implements Backend, Dy
         }
     }
 
+    @Override
+    public void mem_map_file(long address, long size, int perms, File file, long offset) throws BackendException {
+        try {
+            dynarmic.mem_map_file(address, size, perms, file, offset);
+        } catch (DynarmicException e) {
+            throw new BackendException(e);
+        }
+    }
+
+    @Override
+    public void mem_map_fork(long address, long size, int perms, Backend template) throws BackendException {
+        if (!(template instanceof DynarmicBackend)) {
+            super.mem_map_fork(address, size, perms, template);
+            return;
+        }
+        try {
+            dynarmic.mem_map_fork(((DynarmicBackend) template).dynarmic, address, size, perms);
+        } catch (DynarmicException e) {
+            throw new BackendException(e);
+        }
+    }
+
     @Override
     public void mem_protect(long address, long size, int perms) throws BackendException {
         try {
@@ -144,6 +419,15 @@ public abstract class DynarmicBackend extends FastBackend implements Backend, Dy
         }
     }
 
+    @Override
+    public void removeJitCodeCache(long begin, long end) throws BackendException {
+        try {
+            dynarmic.remove_cache(begin, end);
+        } catch (DynarmicException e) {
+            throw new BackendException(e);
+        }
+    }
+
     private EventMemHookNotifier eventMemHookNotifier;
 
     @Override
@@ -166,28 +450,130 @@ public abstract class DynarmicBackend extends FastBackend implements Backend, Dy
         }
     }
 
+    private static class HookEntry<T> {
+        final T callback;
+        final long begin;
+        final long end;
+        final Object user_data;
+        HookEntry(T callback, long begin, long end, Object user_data) {
+            this.callback = callback;
+            this.begin = begin;
+            this.end = end;
+            this.user_data = user_data;
+        }
+        boolean contains(long address) {
+            return begin > end || (address >= begin && address <= end);
+        }
+    }
+
+    private final List<HookEntry<CodeHook>> codeHooks = new CopyOnWriteArrayList<>();
+    private final List<HookEntry<BlockHook>> blockHooks = new CopyOnWriteArrayList<>();
+    private final List<HookEntry<ReadHook>> readHooks = new CopyOnWriteArrayList<>();
+    private final List<HookEntry<WriteHook>> writeHooks = new CopyOnWriteArrayList<>();
+
+    private <T extends Detachable> void addHook(final int type, final List<HookEntry<T>> hooks, T callback, long begin, long end, Object user_data) {
+        final HookEntry<T> entry = new HookEntry<>(callback, begin, end, user_data);
+        hooks.add(entry);
+        updateHookRanges(type, hooks);
+        callback.onAttach(new UnHook() {
+            @Override
+            public void unhook() {
+                if (hooks.remove(entry)) {
+                    updateHookRanges(type, hooks);
+                }
+            }
+        });
+    }
+
+    private void updateHookRanges(int type, List<? extends HookEntry<?>> hooks) {
+        long[] ranges = new long[hooks.size() * 2];
+        int index = 0;
+        for (HookEntry<?> entry : hooks) {
+            ranges[index++] = entry.begin;
+            ranges[index++] = entry.end;
+        }
+        try {
+            dynarmic.set_hook_ranges(type, ranges);
+        } catch (DynarmicException e) {
+            throw new BackendException(e);
+        }
+    }
+
+    @Override
+    public void handleCodeHook(long address, int size) {
+        synchronized (svcLock) {
+            for (HookEntry<CodeHook> entry : codeHooks) {
+                if (entry.contains(address)) {
+                    entry.callback.hook(this, address, size, entry.user_data);
+                }
+            }
+        }
+    }
+
+    @Override
+    public void handleBlockHook(long address, int size) {
+        synchronized (svcLock) {
+            for (HookEntry<BlockHook> entry : blockHooks) {
+                if (entry.contains(address)) {
+                    entry.callback.hookBlock(this, address, size, entry.user_data);
+                }
+            }
+        }
+    }
+
+    @Override
+    public void handleMemoryRead(long address, int size) {
+        synchronized (svcLock) {
+            for (HookEntry<ReadHook> entry : readHooks) {
+                if (entry.contains(address)) {
+                    entry.callback.hook(this, address, size, entry.user_data);
+                }
+            }
+        }
+    }
+
+    @Override
+    public void handleMemoryWrite(long address, int size, long value) {
+        synchronized (svcLock) {
+            for (HookEntry<WriteHook> entry : writeHooks) {
+                if (entry.contains(address)) {
+                    entry.callback.hook(this, address, size, value, entry.user_data);
+                }
+            }
+        }
+    }
+
+    /**
+     * Code inside [begin, end] is single stepped, the rest still runs at full jit speed.
+     */
     @Override
     public void hook_add_new(CodeHook callback, long begin, long end, Object user_data) {
-        throw new UnsupportedOperationException();
+        addHook(Dynarmic.HOOK_CODE, codeHooks, callback, begin, end, user_data);
     }
 
     @Override
     public void debugger_add(DebugHook callback, long begin, long end, Object user_data) {
     }
 
+    /**
+     * The pages of [begin, end] are taken out of the jit page table, so only their accesses are slowed down.
+     */
     @Override
     public void hook_add_new(ReadHook callback, long begin, long end, Object user_data) {
-        throw new UnsupportedOperationException();
+        addHook(Dynarmic.HOOK_READ, readHooks, callback, begin, end, user_data);
     }
 
     @Override
     public void hook_add_new(WriteHook callback, long begin, long end, Object user_data) {
-        throw new UnsupportedOperationException();
+        addHook(Dynarmic.HOOK_WRITE, writeHooks, callback, begin, end, user_data);
     }
 
+    /**
+     * The block size is not known to the jit and reported as 0.
+     */
     @Override
     public void hook_add_new(BlockHook callback, long begin, long end, Object user_data) {
-        throw new UnsupportedOperationException();
+        addHook(Dynarmic.HOOK_BLOCK, blockHooks, callback, begin, end, user_data);
     }
 
     @Override
@@ -16,13 +16,23 @@ public class DynarmicFactory extends BackendFactory {
         }
     }
 
+    private final int processorCount;
+
     public DynarmicFactory(boolean fallbackUnicorn) {
+        this(fallbackUnicorn, 1);
+    }
+
+    /**
+     * @param processorCount vCPUs available to <code>DynarmicBackend.attachVCpu</code>, the primary jit included
+     */
+    public DynarmicFactory(boolean fallbackUnicorn, int processorCount) {
         super(fallbackUnicorn);
+        this.processorCount = processorCount;
     }
 
     @Override
     protected Backend newBackendInternal(Emulator<?> emulator, boolean is64Bit) {
-        Dynarmic dynarmic = new Dynarmic(is64Bit);
+        Dynarmic dynarmic = new Dynarmic(is64Bit, processorCount);
         return is64Bit ? new DynarmicBackend64(emulator, dynarmic) : new DynarmicBackend32(emulator, dynarmic);
     }
 
@@ -0,0 +1,123 @@
+package com.github.unidbg.arm.backend;
+
+import com.github.unidbg.Emulator;
+import com.github.unidbg.memory.MemoryBlock;
+import com.github.unidbg.pointer.UnidbgPointer;
+import unicorn.Arm64Const;
+
+import java.io.Closeable;
+import java.util.ArrayList;
+import java.util.List;
+import java.util.concurrent.BlockingQueue;
+import java.util.concurrent.Callable;
+import java.util.concurrent.ExecutorService;
+import java.util.concurrent.Executors;
+import java.util.concurrent.Future;
+import java.util.concurrent.LinkedBlockingQueue;
+import java.util.concurrent.ThreadFactory;
+import java.util.concurrent.TimeUnit;
+
+/**
+ * Runs independent guest function calls submitted from java in parallel on the vCPUs of an arm64 {@link DynarmicBackend}:
+ * every worker thread is attached to a vCPU of its own and runs the calls on a guest stack of its own.
+ * <p>
+ * Guest threads are not scheduled here: those created by pthread_create still run one at a time on the emulator thread
+ * through its thread dispatcher. The workers share the TLS of the emulator thread, errno included, so the calls must not
+ * create or join guest threads nor rely on thread locals. Their syscalls and hooks are serialized by the backend.
+ */
+public class ParallelCallExecutor implements Closeable {
+
+    private final Emulator<?> emulator;
+    private final DynarmicBackend backend;
+    private final long tpidr;
+    private final List<MemoryBlock> stacks = new ArrayList<>();
+    private final BlockingQueue<UnidbgPointer> freeStacks = new LinkedBlockingQueue<>();
+    private final ExecutorService executor;
+
+    /**
+     * @param threads at most the processor count of the factory minus one, the primary jit belongs to the emulator thread
+     */
+    public ParallelCallExecutor(Emulator<?> emulator, int threads, int stackSize) {
+        if (!emulator.is64Bit() || !(emulator.getBackend() instanceof DynarmicBackend)) {
+            throw new IllegalArgumentException("arm64 dynarmic backend required");
+        }
+        this.emulator = emulator;
+        this.backend = (DynarmicBackend) emulator.getBackend();
+        this.tpidr = backend.reg_read(Arm64Const.UC_ARM64_REG_TPIDR_EL0).longValue();
+        for (int i = 0; i < threads; i++) {
+            MemoryBlock stack = emulator.getMemory().malloc(stackSize, true);
+            stacks.add(stack);
+            freeStacks.add(stack.getPointer().share(stackSize & ~0xfL, 0));
+        }
+        this.executor = Executors.newFixedThreadPool(threads, new ThreadFactory() {
+            @Override
+            public Thread newThread(final Runnable runnable) {
+                Thread thread = new Thread(new Runnable() {
+                    @Override
+                    public void run() {
+                        try {
+                            runnable.run();
+                        } finally {
+                            backend.detachVCpu();
+                        }
+                    }
+                }, "vcpu");
+                thread.setDaemon(true);
+                return thread;
+            }
+        });
+    }
+
+    /**
+     * @param arguments up to eight integer or pointer arguments
+     * @return the value of x0 when the function returned
+     */
+    public Future<Long> submit(final long address, final long... arguments) {
+        if (arguments.length > 8) {
+            throw new IllegalArgumentException("arguments=" + arguments.length);
+        }
+        return executor.submit(new Callable<Long>() {
+            @Override
+            public Long call() throws Exception {
+                if (!backend.attachVCpu()) {
+                    throw new IllegalStateException("no vCPU left");
+                }
+                UnidbgPointer stack = freeStacks.take();
+                try {
+                    return run(stack, address, arguments);
+                } finally {
+                    freeStacks.add(stack);
+                }
+            }
+        });
+    }
+
+    private long run(UnidbgPointer stack, long address, long[] arguments) {
+        long lr = emulator.getReturnAddress();
+        for (int i = 0; i < arguments.length; i++) {
+            backend.reg_write(Arm64Const.UC_ARM64_REG_X0 + i, arguments[i]);
+        }
+        backend.reg_write(Arm64Const.UC_ARM64_REG_SP, stack.peer);
+        backend.reg_write(Arm64Const.UC_ARM64_REG_LR, lr);
+        backend.reg_write(Arm64Const.UC_ARM64_REG_TPIDR_EL0, tpidr);
+        backend.emu_start(address, lr, 0, 0);
+        return backend.reg_read(Arm64Const.UC_ARM64_REG_X0).longValue();
+    }
+
+    @Override
+    public void close() {
+        executor.shutdown();
+        try {
+            if (!executor.awaitTermination(1, TimeUnit.MINUTES)) {
+                throw new IllegalStateException("vCPU workers still running");
+            }
+        } catch (InterruptedException e) {
+            Thread.currentThread().interrupt();
+            return;
+        }
+        for (MemoryBlock stack : stacks) {
+            stack.free();
+        }
+    }
+
+}
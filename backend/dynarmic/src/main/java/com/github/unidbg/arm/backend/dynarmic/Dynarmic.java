@@ -1,9 +1,12 @@
 package com.github.unidbg.arm.backend.dynarmic;
 
+import com.github.unidbg.thread.ThreadContextSwitchException;
 import org.apache.commons.logging.Log;
 import org.apache.commons.logging.LogFactory;
 
 import java.io.Closeable;
+import java.io.File;
+import java.nio.ByteBuffer;
 
 public class Dynarmic implements Closeable {
 
@@ -11,15 +14,27 @@ public class Dynarmic implements Closeable {
 
     private static native int setDynarmicCallback(long handle, DynarmicCallback callback);
 
-    private static native long nativeInitialize(boolean is64Bit);
+    private static native long nativeInitialize(boolean is64Bit, int processorCount);
     private static native void nativeDestroy(long handle);
 
     private static native int mem_unmap(long handle, long address, long size);
+    private static native int remove_cache(long handle, long begin, long end);
+    private static native void set_jit_pool_size(int size);
     private static native int mem_map(long handle, long address, long size, int perms);
+    private static native int mem_map_file(long handle, long address, long size, int perms, String path, long offset);
+    private static native int mem_map_fork(long handle, long template, long address, long size, int perms);
     private static native int mem_protect(long handle, long address, long size, int perms);
 
     private static native int mem_write(long handle, long address, byte[] bytes);
     private static native byte[] mem_read(long handle, long address, int size);
+    private static native byte[] mem_read_cstring(long handle, long address, int max);
+    private static native int mem_read_u32(long handle, long address);
+    private static native long mem_read_u64(long handle, long address);
+    private static native int mem_write_u32(long handle, long address, int value);
+    private static native int mem_write_u64(long handle, long address, long value);
+    private static native int mem_read_direct(long handle, long address, ByteBuffer buffer, int offset, int size);
+    private static native int mem_write_direct(long handle, long address, ByteBuffer buffer, int offset, int size);
+    private static native ByteBuffer mem_view(long handle, long address, int size);
 
     private static native long reg_read_pc64(long handle);
     private static native int reg_set_sp64(long handle, long value);
@@ -33,22 +48,191 @@ public class Dynarmic implements Closeable {
 
     private static native int reg_write(long handle, int index, long value);
     private static native long reg_read(long handle, int index);
+    private static native int reg_read_batch(long handle, int[] indices, long[] values);
+    private static native int reg_write_batch(long handle, int[] indices, long[] values);
     private static native int reg_read_cpsr(long handle);
     private static native int reg_write_cpsr(long handle, int value);
     private static native int reg_write_c13_c0_3(long handle, int value);
 
-    private static native int emu_start(long handle, long pc);
+    private static native int emu_start(long handle, long pc, long until);
     private static native int emu_stop(long handle);
+    private static native int set_emu_count(long handle, long emu_count);
+    private static native int set_time_source(long handle, int source, long instructions_per_second);
 
     private static native long context_alloc(long handle);
     private static native void context_save(long handle, long context);
     private static native void context_restore(long handle, long context);
     public static native void free(long context);
 
+    private static native int checkpoint(long handle);
+    private static native int restore_checkpoint(long handle);
+
+    private static native int set_hook_ranges(long handle, int type, long[] ranges);
+
+    private static native int register_native_syscall(long handle, int NR, int type, long arg0, long arg1);
+    private static native int unregister_native_syscall(long handle, int NR);
+
+    private static native long new_vcpu(long handle);
+    private static native int bind_vcpu(long handle, long vcpu);
+    private static native int free_vcpu(long handle, long vcpu);
+
+    public static final int HOOK_CODE = 0;
+    public static final int HOOK_BLOCK = 1;
+    public static final int HOOK_READ = 2;
+    public static final int HOOK_WRITE = 3;
+
+    private static final int EMU_COUNT_EXHAUSTED = 2;
+
+    /*
+     * Indices of reg_read_batch and reg_write_batch past the general purpose registers.
+     */
+    public static final int REG64_SP = 31;
+    public static final int REG64_PC = 32;
+    public static final int REG64_NZCV = 33;
+    public static final int REG64_TPIDR_EL0 = 34;
+    public static final int REG64_TPIDRRO_EL0 = 35;
+    public static final int REG32_CPSR = 16;
+    public static final int REG32_C13_C0_3 = 17;
+
+    /**
+     * CNTPCT follows the host monotonic clock, the default.
+     */
+    public static final int TIME_SOURCE_HOST = 0;
+    /**
+     * CNTPCT is derived from the instructions executed, so repeated runs read the same counter values.
+     */
+    public static final int TIME_SOURCE_VIRTUAL = 1;
+
+    /**
+     * Frequency of the generic timer counter, as read from CNTFRQ_EL0.
+     */
+    public static final long CNTFRQ = 19200000;
+
+    /**
+     * Keeps up to <code>size</code> jits of destroyed instances with their compiled code, a new instance of the same kind
+     * takes one over and reuses the blocks of the guest pages it maps with the same content at the same address.
+     * Instances with code or block hooks are never pooled, <code>0</code> (the default) disables the pool.
+     */
+    public static void setJitPoolSize(int size) {
+        set_jit_pool_size(size);
+    }
+
     private final long nativeHandle;
 
     public Dynarmic(boolean is64Bit) {
-        this.nativeHandle = nativeInitialize(is64Bit);
+        this(is64Bit, 1);
+    }
+
+    /**
+     * @param processorCount vCPUs sharing the exclusive monitor
+     */
+    public Dynarmic(boolean is64Bit, int processorCount) {
+        this.nativeHandle = nativeInitialize(is64Bit, processorCount);
+        if (nativeHandle == 0) {
+            throw new DynarmicException("processorCount=" + processorCount);
+        }
+    }
+
+    /**
+     * Saves the cpu state and arms all mapped guest pages whatever their protection, each of them is copied on its first write from now on.
+     */
+    public void checkpoint() {
+        long start = log.isDebugEnabled() ? System.currentTimeMillis() : 0;
+        int ret = checkpoint(nativeHandle);
+        if (log.isDebugEnabled()) {
+            log.debug("checkpoint offset=" + (System.currentTimeMillis() - start) + "ms");
+        }
+        if (ret != 0) {
+            throw new DynarmicException("ret=" + ret);
+        }
+    }
+
+    /**
+     * Copies back the pages written since the {@link #checkpoint()} and restores the cpu state, the compiled code of restored pages is dropped.
+     * Mappings are not rolled back: pages mapped since are left alone and unmapped ones stay unmapped.
+     */
+    public void restore_checkpoint() {
+        if (log.isDebugEnabled()) {
+            log.debug("restore_checkpoint");
+        }
+
+        int ret = restore_checkpoint(nativeHandle);
+        if (ret != 0) {
+            throw new DynarmicException("restore_checkpoint without checkpoint: ret=" + ret);
+        }
+    }
+
+    /**
+     * Only code inside the ranges is single stepped, or has its memory accesses reported.
+     * @param type one of <code>HOOK_*</code>
+     * @param ranges inclusive begin/end pairs, begin &gt; end covers the whole address space
+     */
+    public void set_hook_ranges(int type, long[] ranges) {
+        if (log.isDebugEnabled()) {
+            log.debug("set_hook_ranges type=" + type + ", ranges=" + ranges.length / 2);
+        }
+
+        int ret = set_hook_ranges(nativeHandle, type, ranges);
+        if (ret != 0) {
+            throw new DynarmicException("ret=" + ret);
+        }
+    }
+
+    /**
+     * Answer the syscall NR inside the jit without calling back into java.
+     * @param type one of <code>NativeSyscall.TYPE_*</code>
+     */
+    public void register_native_syscall(int NR, int type, long arg0, long arg1) {
+        if (log.isDebugEnabled()) {
+            log.debug("register_native_syscall NR=" + NR + ", type=" + type + ", arg0=0x" + Long.toHexString(arg0) + ", arg1=0x" + Long.toHexString(arg1));
+        }
+
+        int ret = register_native_syscall(nativeHandle, NR, type, arg0, arg1);
+        if (ret != 0) {
+            throw new DynarmicException("ret=" + ret);
+        }
+    }
+
+    public void unregister_native_syscall(int NR) {
+        if (log.isDebugEnabled()) {
+            log.debug("unregister_native_syscall NR=" + NR);
+        }
+
+        unregister_native_syscall(nativeHandle, NR);
+    }
+
+    /**
+     * Creates a jit sharing the guest memory and exclusive monitor of this instance.
+     * @return 0 if all <code>processorCount</code> vCPUs are in use.
+     */
+    public long new_vcpu() {
+        long vcpu = new_vcpu(nativeHandle);
+        if (log.isDebugEnabled()) {
+            log.debug("new_vcpu vcpu=0x" + Long.toHexString(vcpu));
+        }
+        return vcpu;
+    }
+
+    /**
+     * Registers, emu_start and emu_stop of the calling thread go to the vCPU afterwards.
+     * @param vcpu 0 binds the calling thread back to the primary jit
+     */
+    public void bind_vcpu(long vcpu) {
+        int ret = bind_vcpu(nativeHandle, vcpu);
+        if (ret != 0) {
+            throw new DynarmicException("ret=" + ret);
+        }
+    }
+
+    public void free_vcpu(long vcpu) {
+        if (log.isDebugEnabled()) {
+            log.debug("free_vcpu vcpu=0x" + Long.toHexString(vcpu));
+        }
+
+        int ret = free_vcpu(nativeHandle, vcpu);
+        if (ret != 0) {
+            throw new DynarmicException("ret=" + ret);
+        }
     }
 
     public long context_alloc() {
@@ -74,8 +258,44 @@ public class Dynarmic implements Closeable {
         }
     }
 
-    public void emu_start(long begin) {
-        int ret = emu_start(nativeHandle, begin);
+    /**
+     * @param until the svc return address which stops emulation, it is never answered by a native syscall.
+     */
+    public void emu_start(long begin, long until) {
+        int ret = emu_start(nativeHandle, begin, until);
+        if (ret == EMU_COUNT_EXHAUSTED) {
+            throw new ThreadContextSwitchException();
+        }
+        if (ret != 0) {
+            throw new DynarmicException("ret=" + ret);
+        }
+    }
+
+    /**
+     * Limits every emu_start to about emu_count instructions, the jit checks the budget at block boundaries.
+     * @param emu_count 0 removes the limit
+     */
+    public void set_emu_count(long emu_count) {
+        if (log.isDebugEnabled()) {
+            log.debug("set_emu_count emu_count=" + emu_count);
+        }
+
+        int ret = set_emu_count(nativeHandle, emu_count);
+        if (ret != 0) {
+            throw new DynarmicException("ret=" + ret);
+        }
+    }
+
+    /**
+     * Selects where CNTPCT_EL0 and the CP15 CNTPCT read their time from, the counter runs at {@link #CNTFRQ}.
+     * @param instructions_per_second guest speed assumed by {@link #TIME_SOURCE_VIRTUAL}, which restarts from zero
+     */
+    public void set_time_source(int source, long instructions_per_second) {
+        if (log.isDebugEnabled()) {
+            log.debug("set_time_source source=" + source + ", instructions_per_second=" + instructions_per_second);
+        }
+
+        int ret = set_time_source(nativeHandle, source, instructions_per_second);
         if (ret != 0) {
             throw new DynarmicException("ret=" + ret);
         }
@@ -103,6 +323,17 @@ public class Dynarmic implements Closeable {
         }
     }
 
+    public void remove_cache(long begin, long end) {
+        if (log.isDebugEnabled()) {
+            log.debug("remove_cache begin=0x" + Long.toHexString(begin) + ", end=0x" + Long.toHexString(end));
+        }
+
+        int ret = remove_cache(nativeHandle, begin, end);
+        if (ret != 0) {
+            throw new DynarmicException("ret=" + ret);
+        }
+    }
+
     public void mem_map(long address, long size, int perms) {
         long start = log.isDebugEnabled() ? System.currentTimeMillis() : 0;
         int ret = mem_map(nativeHandle, address, size, perms);
@@ -114,6 +345,32 @@ public class Dynarmic implements Closeable {
         }
     }
 
+    public void mem_map_file(long address, long size, int perms, File file, long offset) {
+        long start = log.isDebugEnabled() ? System.currentTimeMillis() : 0;
+        int ret = mem_map_file(nativeHandle, address, size, perms, file.getAbsolutePath(), offset);
+        if (log.isDebugEnabled()) {
+            log.debug("mem_map_file address=0x" + Long.toHexString(address) + ", size=0x" + Long.toHexString(size) + ", perms=0b" + Integer.toBinaryString(perms) + ", file=" + file + ", offset=0x" + Long.toHexString(offset) + ", cost=" + (System.currentTimeMillis() - start) + "ms");
+        }
+        if (ret != 0) {
+            throw new DynarmicException("ret=" + ret);
+        }
+    }
+
+    /**
+     * Maps the same range of <code>template</code>, which must be mapped there, with its current contents: the host
+     * pages are shared copy-on-write, so the mapping costs no copy and each side only pays for the pages it writes.
+     */
+    public void mem_map_fork(Dynarmic template, long address, long size, int perms) {
+        long start = log.isDebugEnabled() ? System.currentTimeMillis() : 0;
+        int ret = mem_map_fork(nativeHandle, template.nativeHandle, address, size, perms);
+        if (log.isDebugEnabled()) {
+            log.debug("mem_map_fork address=0x" + Long.toHexString(address) + ", size=0x" + Long.toHexString(size) + ", perms=0b" + Integer.toBinaryString(perms) + ", offset=" + (System.currentTimeMillis() - start) + "ms");
+        }
+        if (ret != 0) {
+            throw new DynarmicException("ret=" + ret);
+        }
+    }
+
     public void mem_protect(long address, long size, int perms) {
         long start = log.isDebugEnabled() ? System.currentTimeMillis() : 0;
         int ret = mem_protect(nativeHandle, address, size, perms);
@@ -278,6 +535,29 @@ public class Dynarmic implements Closeable {
         return reg_read(nativeHandle, index);
     }
 
+    /**
+     * @param indices X0-X30 or R0-R15 by number, the others by the REG64_ and REG32_ constants
+     */
+    public void reg_read_batch(int[] indices, long[] values) {
+        if (log.isDebugEnabled()) {
+            log.debug("reg_read_batch count=" + indices.length);
+        }
+        int ret = reg_read_batch(nativeHandle, indices, values);
+        if (ret != 0) {
+            throw new DynarmicException("ret=" + ret);
+        }
+    }
+
+    public void reg_write_batch(int[] indices, long[] values) {
+        if (log.isDebugEnabled()) {
+            log.debug("reg_write_batch count=" + indices.length);
+        }
+        int ret = reg_write_batch(nativeHandle, indices, values);
+        if (ret != 0) {
+            throw new DynarmicException("ret=" + ret);
+        }
+    }
+
     public void mem_write(long address, byte[] bytes) {
         long start = log.isDebugEnabled() ? System.currentTimeMillis() : 0;
         int ret = mem_write(nativeHandle, address, bytes);
@@ -301,6 +581,76 @@ public class Dynarmic implements Closeable {
         return ret;
     }
 
+    /**
+     * Scans the host pages for the terminator, so the string is read with one call.
+     */
+    public byte[] mem_read_cstring(long address, int max) {
+        byte[] ret = mem_read_cstring(nativeHandle, address, max);
+        if (ret == null) {
+            throw new DynarmicException("mem_read_cstring address=0x" + Long.toHexString(address));
+        }
+        return ret;
+    }
+
+    /**
+     * @throws DynarmicException if the address is not mapped
+     */
+    public int mem_read_u32(long address) {
+        return mem_read_u32(nativeHandle, address);
+    }
+
+    /**
+     * @throws DynarmicException if the address is not mapped
+     */
+    public long mem_read_u64(long address) {
+        return mem_read_u64(nativeHandle, address);
+    }
+
+    public void mem_write_u32(long address, int value) {
+        int ret = mem_write_u32(nativeHandle, address, value);
+        if (ret != 0) {
+            throw new DynarmicException("ret=" + ret);
+        }
+    }
+
+    public void mem_write_u64(long address, long value) {
+        int ret = mem_write_u64(nativeHandle, address, value);
+        if (ret != 0) {
+            throw new DynarmicException("ret=" + ret);
+        }
+    }
+
+    /**
+     * Copies between the guest and <code>buffer</code> from its position to its limit, the position is not changed.
+     * @param buffer a direct buffer
+     */
+    public void mem_read(long address, ByteBuffer buffer) {
+        int ret = mem_read_direct(nativeHandle, address, buffer, buffer.position(), buffer.remaining());
+        if (ret != 0) {
+            throw new DynarmicException("ret=" + ret);
+        }
+    }
+
+    public void mem_write(long address, ByteBuffer buffer) {
+        int ret = mem_write_direct(nativeHandle, address, buffer, buffer.position(), buffer.remaining());
+        if (ret != 0) {
+            throw new DynarmicException("ret=" + ret);
+        }
+    }
+
+    /**
+     * Direct buffer over the host memory backing the guest range, valid until the range is unmapped.
+     * After a {@link #checkpoint()} its pages stay read-only to the kernel until they are first written, do not read host I/O into it.
+     * @return <code>null</code> if the range is not inside one mapped region.
+     */
+    public ByteBuffer mem_view(long address, int size) {
+        ByteBuffer buffer = mem_view(nativeHandle, address, size);
+        if (log.isDebugEnabled()) {
+            log.debug("mem_view address=0x" + Long.toHexString(address) + ", size=" + size + ", buffer=" + buffer);
+        }
+        return buffer;
+    }
+
     @Override
     public void close() {
         nativeDestroy(nativeHandle);
@@ -25,11 +25,30 @@ public class DynarmicBackend32 extends DynarmicBackend {
         if (log.isDebugEnabled()) {
             log.debug("callSVC pc=0x" + Long.toHexString(pc) + ", swi=" + swi);
         }
-        if (pc == until) {
-            emu_stop();
-            return;
+        synchronized (svcLock) {
+            interruptHookNotifier.notifyCallSVC(this, ARMEmulator.EXCP_SWI, swi);
+        }
+    }
+
+    @Override
+    protected int toBatchIndex(int regId) {
+        if (regId >= ArmConst.UC_ARM_REG_R0 && regId <= ArmConst.UC_ARM_REG_R12) {
+            return regId - ArmConst.UC_ARM_REG_R0;
+        }
+        switch (regId) {
+            case ArmConst.UC_ARM_REG_SP:
+                return 13;
+            case ArmConst.UC_ARM_REG_LR:
+                return 14;
+            case ArmConst.UC_ARM_REG_PC:
+                return 15;
+            case ArmConst.UC_ARM_REG_CPSR:
+                return Dynarmic.REG32_CPSR;
+            case ArmConst.UC_ARM_REG_C13_C0_3:
+                return Dynarmic.REG32_C13_C0_3;
+            default:
+                return -1;
         }
-        interruptHookNotifier.notifyCallSVC(this, ARMEmulator.EXCP_SWI, swi);
     }
 
     @Override
@@ -25,11 +25,34 @@ public class DynarmicBackend64 extends DynarmicBackend {
         if (log.isDebugEnabled()) {
             log.debug("callSVC pc=0x" + Long.toHexString(pc) + ", swi=" + swi);
         }
-        if (pc == until) {
-            emu_stop();
-            return;
+        synchronized (svcLock) {
+            interruptHookNotifier.notifyCallSVC(this, ARMEmulator.EXCP_SWI, swi);
+        }
+    }
+
+    @Override
+    protected int toBatchIndex(int regId) {
+        if (regId >= Arm64Const.UC_ARM64_REG_X0 && regId <= Arm64Const.UC_ARM64_REG_X28) {
+            return regId - Arm64Const.UC_ARM64_REG_X0;
+        }
+        switch (regId) {
+            case Arm64Const.UC_ARM64_REG_X29:
+                return 29;
+            case Arm64Const.UC_ARM64_REG_LR:
+                return 30;
+            case Arm64Const.UC_ARM64_REG_SP:
+                return Dynarmic.REG64_SP;
+            case Arm64Const.UC_ARM64_REG_PC:
+                return Dynarmic.REG64_PC;
+            case Arm64Const.UC_ARM64_REG_NZCV:
+                return Dynarmic.REG64_NZCV;
+            case Arm64Const.UC_ARM64_REG_TPIDR_EL0:
+                return Dynarmic.REG64_TPIDR_EL0;
+            case Arm64Const.UC_ARM64_REG_TPIDRRO_EL0:
+                return Dynarmic.REG64_TPIDRRO_EL0;
+            default:
+                return -1;
         }
-        interruptHookNotifier.notifyCallSVC(this, ARMEmulator.EXCP_SWI, swi);
     }
 
     @Override
@@ -14,4 +14,9 @@ public interface DynarmicCallback {
     void handleMemoryReadFailed(long vaddr, int size);
     void handleMemoryWriteFailed(long vaddr, int size);
 
+    void handleCodeHook(long address, int size);
+    void handleBlockHook(long address, int size);
+    void handleMemoryRead(long address, int size);
+    void handleMemoryWrite(long address, int size, long value);
+
 }
@@ -74,9 +74,9 @@ CallbackOrAccessTwoWords DynarmicCP15::CompileGetTwoWords(bool two, unsigned opc
         // CNTPCT
         const auto callback = static_cast<u64 (*)(void*, u32, u32)>(
             [](void* arg, u32, u32) -> u64 {
-                return 0x10000000000;
+                return static_cast<DynarmicCP15*>(arg)->cntpct();
             });
-        return Dynarmic::A32::Coprocessor::Callback{callback, nullptr};
+        return Dynarmic::A32::Coprocessor::Callback{callback, static_cast<void*>(this)};
     }
 
     return {};
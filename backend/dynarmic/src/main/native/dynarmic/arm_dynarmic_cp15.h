@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <functional>
 #include <memory>
 #include <optional>
 
@@ -39,4 +40,5 @@ public:
 
     u32 uprw = 0;
     u32 uro = 0;
+    std::function<u64()> cntpct; // physical count read by mrrc p15, 0, <Rt>, <Rt2>, c14
 };
@@ -1,16 +1,27 @@
+#include <algorithm>
 #include <array>
+#include <chrono>
 #include <cstdint>
 #include <cstdio>
 #include <exception>
 #include <iostream>
+#include <unordered_map>
 
+#include <fcntl.h>
 #include <stdlib.h>
 #include <unistd.h>
 
 #if defined(_WIN32) || defined(_WIN64)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
 #include "mman.h"
 #include <errno.h>
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
 #else
+#include <signal.h>
 #include <sys/mman.h>
 #include <sys/errno.h>
 #endif
@@ -24,26 +35,307 @@ static jmethodID handleInterpreterFallback = NULL;
 static jmethodID handleExceptionRaised = NULL;
 static jmethodID handleMemoryReadFailed = NULL;
 static jmethodID handleMemoryWriteFailed = NULL;
+static jmethodID handleCodeHook = NULL;
+static jmethodID handleBlockHook = NULL;
+static jmethodID handleMemoryRead = NULL;
+static jmethodID handleMemoryWrite = NULL;
+
+static memory_map::iterator find_memory_region(memory_map *memory, u64 vaddr) {
+    memory_map::iterator it = memory->upper_bound(vaddr);
+    if(it == memory->begin()) {
+      return memory->end();
+    }
+    --it;
+    if(vaddr < it->first + it->second.size) {
+      return it;
+    }
+    return memory->end();
+}
 
-static char *get_memory_page(khash_t(memory) *memory, u64 vaddr, size_t num_page_table_entries, void **page_table) {
+// the jit page table is tried first, it misses pages of the read/write hook ranges and above PAGE_TABLE_ADDRESS_SPACE_BITS
+static char *get_memory_page(memory_map *memory, u64 vaddr, size_t num_page_table_entries, void **page_table) {
     u64 idx = vaddr >> DYN_PAGE_BITS;
-    if(page_table && idx < num_page_table_entries) {
+    if(page_table && idx < num_page_table_entries && page_table[idx]) {
       return (char *)page_table[idx];
     }
     u64 base = vaddr & ~DYN_PAGE_MASK;
-    khiter_t k = kh_get(memory, memory, base);
-    if(k == kh_end(memory)) {
+    std::lock_guard<std::mutex> guard(memory->lock);
+    memory_map::iterator it = find_memory_region(memory, base);
+    if(it == memory->end()) {
       return NULL;
     }
-    t_memory_page page = kh_value(memory, k);
-    return (char *)page->addr;
+    return &it->second.addr[base - it->first];
 }
 
-static inline void *get_memory(khash_t(memory) *memory, u64 vaddr, size_t num_page_table_entries, void **page_table) {
+static inline void *get_memory(memory_map *memory, u64 vaddr, size_t num_page_table_entries, void **page_table) {
     char *page = get_memory_page(memory, vaddr, num_page_table_entries, page_table);
     return page ? &page[vaddr & DYN_PAGE_MASK] : NULL;
 }
 
+static inline bool in_hook_ranges(hook_ranges &ranges, u64 vaddr) {
+    for(hook_ranges::iterator it = ranges.begin(); it != ranges.end(); ++it) {
+      if(it->first > it->second || (vaddr >= it->first && vaddr <= it->second)) {
+        return true;
+      }
+    }
+    return false;
+}
+
+// code fetched inside the code/block hook ranges is replaced by an undefined instruction,
+// so the jit traps into single stepping there and runs everything else at full speed
+static inline bool is_instrumented(t_hook_table hooks, u64 vaddr) {
+    std::shared_lock<std::shared_mutex> guard(hooks->lock);
+    return in_hook_ranges(hooks->ranges[DYN_HOOK_CODE], vaddr) || in_hook_ranges(hooks->ranges[DYN_HOOK_BLOCK], vaddr);
+}
+
+// the lock is not held by the caller, so a hook may set new ranges from java
+static inline bool is_hooked(t_hook_table hooks, int type, u64 vaddr) {
+    std::shared_lock<std::shared_mutex> guard(hooks->lock);
+    return in_hook_ranges(hooks->ranges[type], vaddr);
+}
+
+// pages of the read/write hook ranges are left out of the page table, so only their accesses reach the MemoryRead/MemoryWrite callbacks
+static bool is_page_watched(t_hook_table hooks, u64 page) {
+    u64 page_end = page + DYN_PAGE_MASK;
+    std::shared_lock<std::shared_mutex> guard(hooks->lock);
+    for(int type = DYN_HOOK_READ; type <= DYN_HOOK_WRITE; type++) {
+      hook_ranges &ranges = hooks->ranges[type];
+      for(hook_ranges::iterator it = ranges.begin(); it != ranges.end(); ++it) {
+        if(it->first > it->second || (it->first <= page_end && it->second >= page)) {
+          return true;
+        }
+      }
+    }
+    return false;
+}
+
+static size_t host_page_size = DYN_PAGE_SIZE; // checkpoints protect whole host pages, set by JNI_OnLoad
+
+static std::mutex checkpoints_lock; // taken before checkpoint->lock
+static std::vector<t_checkpoint> checkpoints; // of all dynarmic instances, searched by the write fault handler
+static bool fault_handler_installed = false;
+
+static inline char *host_page_of(void *addr) {
+    return (char *) ((uintptr_t) addr & ~((uintptr_t) host_page_size - 1));
+}
+
+// checkpoint->lock must be held: copy the armed guest pages backed by the host page, then let it be written again
+static bool save_host_page(t_checkpoint checkpoint, char *host) {
+    char *host_end = host + host_page_size;
+    std::map<char *, u64>::iterator it = checkpoint->armed.lower_bound(host);
+    if(it == checkpoint->armed.end() || it->first >= host_end) {
+      return false;
+    }
+    while(it != checkpoint->armed.end() && it->first < host_end) {
+      char *copy = (char *) malloc(DYN_PAGE_SIZE);
+      if(copy == NULL) {
+        fprintf(stderr, "malloc checkpoint page failed: size=0x%llx\n", DYN_PAGE_SIZE);
+        abort();
+      }
+      memcpy(copy, it->first, DYN_PAGE_SIZE);
+      checkpoint->pages[it->second] = copy;
+      it = checkpoint->armed.erase(it);
+    }
+    if(mprotect(host, host_page_size, PROT_READ | PROT_WRITE) != 0) {
+      fprintf(stderr, "mprotect failed[%s->%s:%d]: addr=%p, errno=%d, msg=%s\n", __FILE__, __func__, __LINE__, host, errno, strerror(errno));
+      abort();
+    }
+    return true;
+}
+
+// checkpoint->lock must be held: host pages of [addr, addr + size) are read-only while they back armed guest pages
+static void protect_armed_pages(t_checkpoint checkpoint, char *addr, u64 size) {
+    for(char *host = host_page_of(addr); host < addr + size; host += host_page_size) {
+      std::map<char *, u64>::iterator it = checkpoint->armed.lower_bound(host);
+      bool armed = it != checkpoint->armed.end() && it->first < host + host_page_size;
+      if(mprotect(host, host_page_size, armed ? PROT_READ : PROT_READ | PROT_WRITE) != 0) {
+        fprintf(stderr, "mprotect failed[%s->%s:%d]: addr=%p, errno=%d, msg=%s\n", __FILE__, __func__, __LINE__, host, errno, strerror(errno));
+        abort();
+      }
+    }
+}
+
+// the first write to an armed page, by the jit or by the host, false for faults which are not ours.
+// The fault is raised by a store to guest memory, which never happens inside the allocator or under these locks
+static bool handle_checkpoint_fault(void *addr) {
+    char *host = host_page_of(addr);
+    std::lock_guard<std::mutex> guard(checkpoints_lock);
+    for(std::vector<t_checkpoint>::iterator it = checkpoints.begin(); it != checkpoints.end(); ++it) {
+      t_checkpoint checkpoint = *it;
+      if(!checkpoint->active.load(std::memory_order_acquire)) {
+        continue;
+      }
+      std::lock_guard<std::mutex> checkpoint_guard(checkpoint->lock);
+      if(save_host_page(checkpoint, host)) {
+        return true;
+      }
+    }
+    return false;
+}
+
+#if defined(_WIN32) || defined(_WIN64)
+static LONG CALLBACK checkpoint_fault_handler(PEXCEPTION_POINTERS info) {
+    PEXCEPTION_RECORD record = info->ExceptionRecord;
+    if(record->ExceptionCode == EXCEPTION_ACCESS_VIOLATION && record->NumberParameters >= 2 && record->ExceptionInformation[0] == 1 &&
+      handle_checkpoint_fault((void *) record->ExceptionInformation[1])) {
+      return EXCEPTION_CONTINUE_EXECUTION;
+    }
+    return EXCEPTION_CONTINUE_SEARCH;
+}
+
+static void install_fault_handler() {
+    if(AddVectoredExceptionHandler(1, checkpoint_fault_handler) == NULL) {
+      fprintf(stderr, "AddVectoredExceptionHandler failed[%s->%s:%d]\n", __FILE__, __func__, __LINE__);
+      abort();
+    }
+}
+#else
+static struct sigaction old_segv_action;
+static struct sigaction old_bus_action; // macOS raises SIGBUS for protected pages
+
+// other faults go on to the handlers installed before, the jvm and dynarmic have theirs
+static void checkpoint_fault_handler(int sig, siginfo_t *info, void *context) {
+    if(handle_checkpoint_fault(info->si_addr)) {
+      return; // the store is retried on the writable page
+    }
+    struct sigaction *old = sig == SIGBUS ? &old_bus_action : &old_segv_action;
+    if(old->sa_flags & SA_SIGINFO) {
+      old->sa_sigaction(sig, info, context);
+    } else if(old->sa_handler == SIG_DFL || old->sa_handler == SIG_IGN) {
+      sigaction(sig, old, NULL); // the fault repeats and is handled as if this handler never was
+    } else {
+      old->sa_handler(sig);
+    }
+}
+
+static void install_fault_handler() {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = checkpoint_fault_handler;
+    action.sa_flags = SA_SIGINFO | SA_ONSTACK | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if(sigaction(SIGSEGV, &action, &old_segv_action) != 0 || sigaction(SIGBUS, &action, &old_bus_action) != 0) {
+      fprintf(stderr, "sigaction failed[%s->%s:%d]: errno=%d, msg=%s\n", __FILE__, __func__, __LINE__, errno, strerror(errno));
+      abort();
+    }
+}
+#endif
+
+static inline std::int64_t host_clock_nanos(bool realtime) {
+    if(realtime) {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    } else {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+static u64 read_cntpct(t_clock clock) {
+    if(clock->source.load(std::memory_order_acquire) == DYN_TIME_SOURCE_VIRTUAL) {
+      u64 instructions = clock->instructions.load(std::memory_order_relaxed);
+      u64 ips = clock->instructions_per_second.load(std::memory_order_relaxed);
+      return instructions / ips * DYN_CNTFRQ + instructions % ips * DYN_CNTFRQ / ips;
+    } else {
+      u64 nanos = host_clock_nanos(false);
+      return nanos / 1000000000ULL * DYN_CNTFRQ + nanos % 1000000000ULL * DYN_CNTFRQ / 1000000000ULL;
+    }
+}
+
+// fill a guest timespec/timeval, false if it is not inside one mapped page
+static bool write_time_pair(memory_map *memory, size_t num_page_table_entries, void **page_table, u64 vaddr, bool is64Bit, std::int64_t first, std::int64_t second) {
+    u64 size = is64Bit ? 16 : 8;
+    if(vaddr == 0 || (vaddr & ~DYN_PAGE_MASK) != ((vaddr + size - 1) & ~DYN_PAGE_MASK)) {
+      return false;
+    }
+    char *dest = (char *) get_memory(memory, vaddr, num_page_table_entries, page_table);
+    if(dest == NULL) {
+      return false;
+    }
+    if(is64Bit) {
+      std::int64_t pair[2] = { first, second };
+      memcpy(dest, pair, sizeof(pair));
+    } else {
+      std::int32_t pair[2] = { (std::int32_t) first, (std::int32_t) second };
+      memcpy(dest, pair, sizeof(pair));
+    }
+    return true;
+}
+
+// false when the syscall has to go through java
+static bool handle_native_syscall(khash_t(syscall) *syscalls, int NR, u64 arg0, u64 arg1, memory_map *memory, size_t num_page_table_entries, void **page_table, bool is64Bit, u64 *ret) {
+    if(kh_size(syscalls) == 0) {
+      return false;
+    }
+    khiter_t k = kh_get(syscall, syscalls, NR);
+    if(k == kh_end(syscalls)) {
+      return false;
+    }
+    t_native_syscall *syscall = &kh_value(syscalls, k);
+    std::int64_t nanos;
+    switch (syscall->type) {
+      case NATIVE_SYSCALL_CONSTANT:
+        *ret = syscall->value;
+        return true;
+      case NATIVE_SYSCALL_CLOCK_GETTIME:
+        switch (is64Bit ? (arg0 & 0x7) : arg0) {
+          case 0: // CLOCK_REALTIME
+            nanos = host_clock_nanos(true) + syscall->realtime_offset;
+            break;
+          case 1: // CLOCK_MONOTONIC
+          case 4: // CLOCK_MONOTONIC_RAW
+          case 6: // CLOCK_MONOTONIC_COARSE
+          case 7: // CLOCK_BOOTTIME
+            nanos = host_clock_nanos(false) + syscall->monotonic_offset;
+            break;
+          default:
+            return false;
+        }
+        if(!write_time_pair(memory, num_page_table_entries, page_table, arg1, is64Bit, nanos / 1000000000LL, nanos % 1000000000LL)) {
+          return false;
+        }
+        *ret = 0;
+        return true;
+      case NATIVE_SYSCALL_GETTIMEOFDAY:
+        if(arg1) {
+          return false; // the timezone is filled by java
+        }
+        nanos = host_clock_nanos(true) + syscall->realtime_offset;
+        if(!write_time_pair(memory, num_page_table_entries, page_table, arg0, is64Bit, nanos / 1000000000LL, (nanos % 1000000000LL) / 1000)) {
+          return false;
+        }
+        *ret = 0;
+        return true;
+      default:
+        return false;
+    }
+}
+
+// compare-and-swap on the host page backing the guest address, so plain stores of other vCPUs are observed
+template<typename T>
+static inline bool compare_and_swap(void *dest, T value, T expected) {
+    return __atomic_compare_exchange_n((T *) dest, &expected, value, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+static inline bool compare_and_swap128(void *dest, u64 lo, u64 hi, u64 expected_lo, u64 expected_hi) {
+#ifdef __GCC_HAVE_SYNC_COMPARE_AND_SWAP_16
+    unsigned __int128 value = ((unsigned __int128) hi << 64) | lo;
+    unsigned __int128 expected = ((unsigned __int128) expected_hi << 64) | expected_lo;
+    return __sync_bool_compare_and_swap((unsigned __int128 *) dest, expected, value);
+#else
+    // no 16-byte host cas: the exclusive monitor lock still orders the exclusive stores
+    u64 *ptr = (u64 *) dest;
+    if(ptr[0] != expected_lo || ptr[1] != expected_hi) {
+      return false;
+    }
+    ptr[0] = lo;
+    ptr[1] = hi;
+    return true;
+#endif
+}
+
+#define A64_TRAP_INSTRUCTION 0x00000000 // udf #0
+#define ARM_TRAP_INSTRUCTION 0xe7f000f0 // udf #0
+#define THUMB_TRAP_INSTRUCTION 0xde00 // udf #0
+
 class DynarmicCallbacks32 final : public Dynarmic::A32::UserCallbacks {
 private:
     ~DynarmicCallbacks32() = default;
@@ -54,7 +346,7 @@ public:
         delete this;
     }
 
-    DynarmicCallbacks32(khash_t(memory) *memory)
+    DynarmicCallbacks32(memory_map *memory)
         : memory{memory}, cp15(std::make_shared<DynarmicCP15>()) {}
 
     bool IsReadOnlyMemory(u32 vaddr) override {
@@ -63,32 +355,48 @@ public:
         return false;
     }
 
+    std::optional<std::uint32_t> MemoryReadCode(u32 vaddr) override {
+        NoteCodePage(vaddr);
+        u32 code = Read32(vaddr);
+        if(!stepping && (cpu->Cpsr() & 0x20)) { // thumb: trap per halfword
+            if(IsInstrumented(vaddr, true)) {
+                code = (code & 0xffff0000) | THUMB_TRAP_INSTRUCTION;
+            }
+            if(IsInstrumented(vaddr + 2, true)) {
+                code = (code & 0xffff) | (THUMB_TRAP_INSTRUCTION << 16);
+            }
+        } else if(!stepping && IsInstrumented(vaddr, false)) {
+            code = ARM_TRAP_INSTRUCTION;
+        }
+        return code;
+    }
+
 #ifndef DYNARMIC_MASTER
     u16 MemoryReadThumbCode(u32 vaddr) override {
-        u16 code = MemoryRead16(vaddr);
+        u16 code = Read16(vaddr);
+        if(!stepping && IsInstrumented(vaddr, true)) {
+            code = THUMB_TRAP_INSTRUCTION;
+        }
 //        printf("MemoryReadThumbCode[%s->%s:%d]: vaddr=0x%x, code=0x%04x\n", __FILE__, __func__, __LINE__, vaddr, code);
         return code;
     }
 #endif
 
-    u8 MemoryRead8(u32 vaddr) override {
+    u8 Read8(u32 vaddr) {
         u8 *dest = (u8 *) get_memory(memory, vaddr, num_page_table_entries, page_table);
         if(dest) {
             return dest[0];
         } else {
             fprintf(stderr, "MemoryRead8[%s->%s:%d]: vaddr=0x%x\n", __FILE__, __func__, __LINE__, vaddr);
-            JNIEnv *env;
-            cachedJVM->AttachCurrentThread((void **)&env, NULL);
             env->CallVoidMethod(callback, handleMemoryReadFailed, vaddr, 1);
-            cachedJVM->DetachCurrentThread();
             abort();
             return 0;
         }
     }
-    u16 MemoryRead16(u32 vaddr) override {
+    u16 Read16(u32 vaddr) {
         if(vaddr & 1) {
-            const u8 a{MemoryRead8(vaddr)};
-            const u8 b{MemoryRead8(vaddr + sizeof(u8))};
+            const u8 a{Read8(vaddr)};
+            const u8 b{Read8(vaddr + sizeof(u8))};
             return (static_cast<u16>(b) << 8) | a;
         }
         u16 *dest = (u16 *) get_memory(memory, vaddr, num_page_table_entries, page_table);
@@ -96,18 +404,15 @@ public:
             return dest[0];
         } else {
             fprintf(stderr, "MemoryRead16[%s->%s:%d]: vaddr=0x%x\n", __FILE__, __func__, __LINE__, vaddr);
-            JNIEnv *env;
-            cachedJVM->AttachCurrentThread((void **)&env, NULL);
             env->CallVoidMethod(callback, handleMemoryReadFailed, vaddr, 2);
-            cachedJVM->DetachCurrentThread();
             abort();
             return 0;
         }
     }
-    u32 MemoryRead32(u32 vaddr) override {
+    u32 Read32(u32 vaddr) {
         if(vaddr & 3) {
-            const u16 a{MemoryRead16(vaddr)};
-            const u16 b{MemoryRead16(vaddr + sizeof(u16))};
+            const u16 a{Read16(vaddr)};
+            const u16 b{Read16(vaddr + sizeof(u16))};
             return (static_cast<u32>(b) << 16) | a;
         }
         u32 *dest = (u32 *) get_memory(memory, vaddr, num_page_table_entries, page_table);
@@ -116,18 +421,15 @@ public:
             return dest[0];
         } else {
             printf("MemoryRead32[%s->%s:%d]: vaddr=0x%x\n", __FILE__, __func__, __LINE__, vaddr);
-            JNIEnv *env;
-            cachedJVM->AttachCurrentThread((void **)&env, NULL);
             env->CallVoidMethod(callback, handleMemoryReadFailed, vaddr, 4);
-            cachedJVM->DetachCurrentThread();
             abort();
             return 0;
         }
     }
-    u64 MemoryRead64(u32 vaddr) override {
+    u64 Read64(u32 vaddr) {
         if(vaddr & 7) {
-            const u32 a{MemoryRead32(vaddr)};
-            const u32 b{MemoryRead32(vaddr + sizeof(u32))};
+            const u32 a{Read32(vaddr)};
+            const u32 b{Read32(vaddr + sizeof(u32))};
             return (static_cast<u64>(b) << 32) | a;
         }
         u64 *dest = (u64 *) get_memory(memory, vaddr, num_page_table_entries, page_table);
@@ -140,23 +442,20 @@ public:
         }
     }
 
-    void MemoryWrite8(u32 vaddr, u8 value) override {
+    void Write8(u32 vaddr, u8 value) {
         u8 *dest = (u8 *) get_memory(memory, vaddr, num_page_table_entries, page_table);
         if(dest) {
             dest[0] = value;
         } else {
             fprintf(stderr, "MemoryWrite8[%s->%s:%d]: vaddr=0x%x\n", __FILE__, __func__, __LINE__, vaddr);
-            JNIEnv *env;
-            cachedJVM->AttachCurrentThread((void **)&env, NULL);
             env->CallVoidMethod(callback, handleMemoryWriteFailed, vaddr, 1);
-            cachedJVM->DetachCurrentThread();
             abort();
         }
     }
-    void MemoryWrite16(u32 vaddr, u16 value) override {
+    void Write16(u32 vaddr, u16 value) {
         if(vaddr & 1) {
-            MemoryWrite8(vaddr, static_cast<u8>(value));
-            MemoryWrite8(vaddr + sizeof(u8), static_cast<u8>(value >> 8));
+            Write8(vaddr, static_cast<u8>(value));
+            Write8(vaddr + sizeof(u8), static_cast<u8>(value >> 8));
             return;
         }
         u16 *dest = (u16 *) get_memory(memory, vaddr, num_page_table_entries, page_table);
@@ -167,10 +466,10 @@ public:
             abort();
         }
     }
-    void MemoryWrite32(u32 vaddr, u32 value) override {
+    void Write32(u32 vaddr, u32 value) {
         if(vaddr & 3) {
-            MemoryWrite16(vaddr, static_cast<u16>(value));
-            MemoryWrite16(vaddr + sizeof(u16), static_cast<u16>(value >> 16));
+            Write16(vaddr, static_cast<u16>(value));
+            Write16(vaddr + sizeof(u16), static_cast<u16>(value >> 16));
             return;
         }
         u32 *dest = (u32 *) get_memory(memory, vaddr, num_page_table_entries, page_table);
@@ -178,17 +477,14 @@ public:
             dest[0] = value;
         } else {
             fprintf(stderr, "MemoryWrite32[%s->%s:%d]: vaddr=0x%x\n", __FILE__, __func__, __LINE__, vaddr);
-            JNIEnv *env;
-            cachedJVM->AttachCurrentThread((void **)&env, NULL);
             env->CallVoidMethod(callback, handleMemoryWriteFailed, vaddr, 4);
-            cachedJVM->DetachCurrentThread();
             abort();
         }
     }
-    void MemoryWrite64(u32 vaddr, u64 value) override {
+    void Write64(u32 vaddr, u64 value) {
         if(vaddr & 7) {
-            MemoryWrite32(vaddr, static_cast<u32>(value));
-            MemoryWrite32(vaddr + sizeof(u32), static_cast<u32>(value >> 32));
+            Write32(vaddr, static_cast<u32>(value));
+            Write32(vaddr + sizeof(u32), static_cast<u32>(value >> 32));
             return;
         }
         u64 *dest = (u64 *) get_memory(memory, vaddr, num_page_table_entries, page_table);
@@ -200,29 +496,76 @@ public:
         }
     }
 
-    bool MemoryWriteExclusive8(u32 vaddr, u8 value, u8 expected) override {
-        MemoryWrite8(vaddr, value);
+    u8 MemoryRead8(u32 vaddr) override {
+        NotifyRead(vaddr, 1);
+        return Read8(vaddr);
+    }
+    u16 MemoryRead16(u32 vaddr) override {
+        NotifyRead(vaddr, 2);
+        return Read16(vaddr);
+    }
+    u32 MemoryRead32(u32 vaddr) override {
+        NotifyRead(vaddr, 4);
+        return Read32(vaddr);
+    }
+    u64 MemoryRead64(u32 vaddr) override {
+        NotifyRead(vaddr, 8);
+        return Read64(vaddr);
+    }
+
+    void MemoryWrite8(u32 vaddr, u8 value) override {
+        NotifyWrite(vaddr, 1, value);
+        Write8(vaddr, value);
+    }
+    void MemoryWrite16(u32 vaddr, u16 value) override {
+        NotifyWrite(vaddr, 2, value);
+        Write16(vaddr, value);
+    }
+    void MemoryWrite32(u32 vaddr, u32 value) override {
+        NotifyWrite(vaddr, 4, value);
+        Write32(vaddr, value);
+    }
+    void MemoryWrite64(u32 vaddr, u64 value) override {
+        NotifyWrite(vaddr, 8, value);
+        Write64(vaddr, value);
+    }
+
+    template<typename T>
+    bool WriteExclusive(u32 vaddr, T value, T expected) {
+        NotifyWrite(vaddr, sizeof(T), value);
+        void *dest = get_memory(memory, vaddr, num_page_table_entries, page_table);
+        if(dest && (vaddr & (sizeof(T) - 1)) == 0) {
+            return compare_and_swap<T>(dest, value, expected);
+        }
+        T current = 0; // unaligned or unmapped
+        for(u32 i = 0; i < sizeof(T); i++) {
+            current |= static_cast<T>(Read8(vaddr + i)) << (8 * i);
+        }
+        if(current != expected) {
+            return false;
+        }
+        for(u32 i = 0; i < sizeof(T); i++) {
+            Write8(vaddr + i, static_cast<u8>(value >> (8 * i)));
+        }
         return true;
     }
+
+    bool MemoryWriteExclusive8(u32 vaddr, u8 value, u8 expected) override {
+        return WriteExclusive<u8>(vaddr, value, expected);
+    }
     bool MemoryWriteExclusive16(u32 vaddr, u16 value, u16 expected) override {
-        MemoryWrite16(vaddr, value);
-        return true;
+        return WriteExclusive<u16>(vaddr, value, expected);
     }
     bool MemoryWriteExclusive32(u32 vaddr, u32 value, u32 expected) override {
-        MemoryWrite32(vaddr, value);
-        return true;
+        return WriteExclusive<u32>(vaddr, value, expected);
     }
     bool MemoryWriteExclusive64(u32 vaddr, u64 value, u64 expected) override {
-        MemoryWrite64(vaddr, value);
-        return true;
+        return WriteExclusive<u64>(vaddr, value, expected);
     }
 
     void InterpreterFallback(u32 pc, std::size_t num_instructions) override {
-        JNIEnv *env;
-        cachedJVM->AttachCurrentThread((void **)&env, NULL);
         env->CallBooleanMethod(callback, handleInterpreterFallback, pc, num_instructions);
         cpu->HaltExecution();
-        cachedJVM->DetachCurrentThread();
         std::optional<std::uint32_t> code = MemoryReadCode(pc);
         if(code) {
             fprintf(stderr, "Unicorn fallback @ 0x%x for %lu instructions (instr = 0x%08X)", pc, num_instructions, *code);
@@ -231,6 +574,12 @@ public:
     }
 
     void ExceptionRaised(u32 pc, Dynarmic::A32::Exception exception) override {
+        if(!stepping && IsInstrumented(pc, cpu->Cpsr() & 0x20)) { // trap instruction of a hooked range
+            cpu->Regs()[15] = pc;
+            step_request = true;
+            cpu->HaltExecution();
+            return;
+        }
         bool isBkpt = exception == Dynarmic::A32::Exception::Breakpoint;
         if(!isBkpt) {
             std::optional<std::uint32_t> code = MemoryReadCode(pc);
@@ -238,36 +587,174 @@ public:
                 printf("ExceptionRaised[%s->%s:%d]: pc=0x%x, exception=%d, code=0x%08X\n", __FILE__, __func__, __LINE__, pc, exception, *code);
             }
         }
-        JNIEnv *env;
-        cachedJVM->AttachCurrentThread((void **)&env, NULL);
         env->CallVoidMethod(callback, handleExceptionRaised, pc, exception);
-        cachedJVM->DetachCurrentThread();
         if(!isBkpt) {
             abort();
         }
     }
 
     void CallSVC(u32 swi) override {
-        JNIEnv *env;
-        cachedJVM->AttachCurrentThread((void **)&env, NULL);
+        if(cpu->Regs()[15] == until) { // per vCPU, so it is checked here instead of in java
+            Stop();
+            return;
+        }
+        u64 ret;
+        if(swi == 0 && handle_native_syscall(syscalls, (int) cpu->Regs()[7], cpu->Regs()[0], cpu->Regs()[1], memory, num_page_table_entries, page_table, false, &ret)) {
+            cpu->Regs()[0] = (u32) ret;
+            return;
+        }
         env->CallVoidMethod(callback, callSVC, cpu->Regs()[15], swi);
         if (env->ExceptionCheck()) {
-            cpu->HaltExecution();
+            Stop();
         }
-        cachedJVM->DetachCurrentThread();
     }
 
     void AddTicks(u64 ticks) override {
+        clock->instructions.fetch_add(ticks, std::memory_order_relaxed);
+        ticks_remaining = ticks < ticks_remaining ? ticks_remaining - ticks : 0;
     }
 
     u64 GetTicksRemaining() override {
-        return 0x10000000000ULL;
+        return ticks_remaining;
+    }
+
+    bool IsInstrumented(u32 vaddr, bool thumb) {
+        // a 32-bit thumb instruction may start one halfword before the range
+        return is_instrumented(hooks, vaddr) || (thumb && is_instrumented(hooks, vaddr + 2));
+    }
+
+    void NotifyRead(u32 vaddr, int size) {
+        if(is_hooked(hooks, DYN_HOOK_READ, vaddr)) {
+            env->CallVoidMethod(callback, handleMemoryRead, (jlong) vaddr, size);
+            if (env->ExceptionCheck()) {
+                Stop();
+            }
+        }
+    }
+
+    void NoteCodePage(u64 vaddr) {
+        u64 page = vaddr & ~DYN_PAGE_MASK;
+        if(page != last_code_page.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> guard(code_lock);
+            code_pages.insert(page);
+            last_code_page.store(page, std::memory_order_relaxed);
+        }
+    }
+
+    // apply the invalidations other threads requested while this jit was theirs to leave alone, see request_flush
+    void FlushPending() {
+        if(!flush_pending.load(std::memory_order_acquire)) {
+            return;
+        }
+        std::lock_guard<std::mutex> guard(code_lock);
+        flush_pending.store(false, std::memory_order_relaxed);
+        if(flush_all) {
+            cpu->ClearCache();
+        } else {
+            for(std::vector<std::pair<u64, u64>>::iterator it = flush_ranges.begin(); it != flush_ranges.end(); ++it) {
+                cpu->InvalidateCacheRange((u32) it->first, it->second - it->first);
+            }
+        }
+        flush_all = false;
+        flush_ranges.clear();
     }
 
-    khash_t(memory) *memory = NULL;
+    void NotifyWrite(u32 vaddr, int size, u64 value) {
+        if(is_hooked(hooks, DYN_HOOK_WRITE, vaddr)) {
+            env->CallVoidMethod(callback, handleMemoryWrite, (jlong) vaddr, size, (jlong) value);
+            if (env->ExceptionCheck()) {
+                Stop();
+            }
+        }
+    }
+
+    void Stop() {
+        stopped = true;
+        if(!stepping) { // Step() returns by itself, a pending halt would end the next Run()
+            cpu->HaltExecution();
+        }
+    }
+
+    // Run() the jit, single stepping through the code/block hook ranges
+    void Run() {
+        stopped = false;
+        stepping = false;
+        u32 next_pc = 0; // fall through of the last stepped instruction, a new block starts anywhere else
+        while(!stopped) {
+            if(ticks_remaining == 0) {
+                break; // the jit checks the budget at block boundaries, stepped code per instruction
+            }
+            FlushPending();
+            if(!stepping) {
+                step_request = false;
+                executing = true;
+                FlushPending(); // after executing is set, so a request either lands here or halts the run
+                cpu->Run();
+                executing = false;
+                if(!step_request) {
+                    if(stopped || ticks_remaining == 0) {
+                        break;
+                    }
+                    continue; // halted by request_flush, the loop flushes and runs on
+                }
+                stepping = true;
+                next_pc = 1;
+                continue;
+            }
+            u32 pc = cpu->Regs()[15];
+            bool thumb = cpu->Cpsr() & 0x20;
+            if(!IsInstrumented(pc, thumb)) {
+                stepping = false;
+                continue;
+            }
+            u32 size = 4;
+            if(thumb && (Read16(pc) & 0xf800) < 0xe800) {
+                size = 2;
+            }
+            if(pc != next_pc && is_hooked(hooks, DYN_HOOK_BLOCK, pc)) {
+                env->CallVoidMethod(callback, handleBlockHook, (jlong) pc, 0);
+                if (env->ExceptionCheck()) {
+                    Stop();
+                }
+            }
+            if(!stopped && is_hooked(hooks, DYN_HOOK_CODE, pc)) {
+                env->CallVoidMethod(callback, handleCodeHook, (jlong) pc, size);
+                if (env->ExceptionCheck()) {
+                    Stop();
+                }
+            }
+            if(stopped) {
+                break;
+            }
+            if(cpu->Regs()[15] != pc) { // redirected by the hook
+                next_pc = 1;
+                continue;
+            }
+            cpu->Step();
+            next_pc = pc + size;
+        }
+    }
+
+    memory_map *memory = NULL;
     size_t num_page_table_entries;
     void **page_table = NULL;
     jobject callback = NULL;
+    JNIEnv *env = NULL; // the thread running emu_start, which is already attached
+    khash_t(syscall) *syscalls = NULL;
+    u64 until = 0; // svc return address which stops emu_start
+    t_hook_table hooks = NULL; // owned by struct dynarmic
+    bool stepping = false; // inside a code/block hook range, compiled code is not instrumented
+    bool step_request = false;
+    bool stopped = false;
+    u64 ticks_remaining = DYN_UNLIMITED_TICKS; // instructions left to the budget of emu_start
+    t_clock clock = NULL; // owned by struct dynarmic
+    std::unordered_set<u64> code_pages; // pages the compiled blocks were fetched from, see pool_jit
+    std::atomic<u64> last_code_page{~0ULL};
+    std::mutex code_lock; // guards code_pages and the requested flushes
+    std::vector<std::pair<u64, u64>> flush_ranges; // [begin, end) to invalidate before the next block runs
+    bool flush_all = false;
+    std::atomic<bool> flush_pending{false};
+    std::atomic<bool> executing{false}; // inside cpu->Run(), a requested flush halts it
     Dynarmic::A32::Jit *cpu;
     std::shared_ptr<DynarmicCP15> cp15;
 };
@@ -281,7 +768,7 @@ public:
         delete this;
     }
 
-    DynarmicCallbacks64(khash_t(memory) *memory)
+    DynarmicCallbacks64(memory_map *memory)
         : memory{memory} {}
 
     bool IsReadOnlyMemory(u64 vaddr) override {
@@ -291,29 +778,30 @@ public:
     }
 
     std::optional<std::uint32_t> MemoryReadCode(u64 vaddr) override {
-        u32 code = MemoryRead32(vaddr);
+        NoteCodePage(vaddr);
+        if(!stepping && is_instrumented(hooks, vaddr)) {
+            return A64_TRAP_INSTRUCTION;
+        }
+        u32 code = Read32(vaddr);
 //        printf("MemoryReadCode[%s->%s:%d]: vaddr=0x%llx, code=0x%08x\n", __FILE__, __func__, __LINE__, vaddr, code);
         return code;
     }
 
-    u8 MemoryRead8(u64 vaddr) override {
+    u8 Read8(u64 vaddr) {
         u8 *dest = (u8 *) get_memory(memory, vaddr, num_page_table_entries, page_table);
         if(dest) {
             return dest[0];
         } else {
             fprintf(stderr, "MemoryRead8[%s->%s:%d]: vaddr=%p\n", __FILE__, __func__, __LINE__, (void*)vaddr);
-            JNIEnv *env;
-            cachedJVM->AttachCurrentThread((void **)&env, NULL);
             env->CallVoidMethod(callback, handleMemoryReadFailed, vaddr, 1);
-            cachedJVM->DetachCurrentThread();
             abort();
             return 0;
         }
     }
-    u16 MemoryRead16(u64 vaddr) override {
+    u16 Read16(u64 vaddr) {
         if(vaddr & 1) {
-            const u8 a{MemoryRead8(vaddr)};
-            const u8 b{MemoryRead8(vaddr + sizeof(u8))};
+            const u8 a{Read8(vaddr)};
+            const u8 b{Read8(vaddr + sizeof(u8))};
             return (static_cast<u16>(b) << 8) | a;
         }
         u16 *dest = (u16 *) get_memory(memory, vaddr, num_page_table_entries, page_table);
@@ -325,10 +813,10 @@ public:
             return 0;
         }
     }
-    u32 MemoryRead32(u64 vaddr) override {
+    u32 Read32(u64 vaddr) {
         if(vaddr & 3) {
-            const u16 a{MemoryRead16(vaddr)};
-            const u16 b{MemoryRead16(vaddr + sizeof(u16))};
+            const u16 a{Read16(vaddr)};
+            const u16 b{Read16(vaddr + sizeof(u16))};
             return (static_cast<u32>(b) << 16) | a;
         }
         u32 *dest = (u32 *) get_memory(memory, vaddr, num_page_table_entries, page_table);
@@ -340,10 +828,10 @@ public:
             return 0;
         }
     }
-    u64 MemoryRead64(u64 vaddr) override {
+    u64 Read64(u64 vaddr) {
         if(vaddr & 7) {
-            const u32 a{MemoryRead32(vaddr)};
-            const u32 b{MemoryRead32(vaddr + sizeof(u32))};
+            const u32 a{Read32(vaddr)};
+            const u32 b{Read32(vaddr + sizeof(u32))};
             return (static_cast<u64>(b) << 32) | a;
         }
         u64 *dest = (u64 *) get_memory(memory, vaddr, num_page_table_entries, page_table);
@@ -355,11 +843,8 @@ public:
             return 0;
         }
     }
-    Dynarmic::A64::Vector MemoryRead128(u64 vaddr) override {
-        return {MemoryRead64(vaddr), MemoryRead64(vaddr + 8)};
-    }
 
-    void MemoryWrite8(u64 vaddr, u8 value) override {
+    void Write8(u64 vaddr, u8 value) {
         u8 *dest = (u8 *) get_memory(memory, vaddr, num_page_table_entries, page_table);
         if(dest) {
             dest[0] = value;
@@ -368,10 +853,10 @@ public:
             abort();
         }
     }
-    void MemoryWrite16(u64 vaddr, u16 value) override {
+    void Write16(u64 vaddr, u16 value) {
         if(vaddr & 1) {
-            MemoryWrite8(vaddr, static_cast<u8>(value));
-            MemoryWrite8(vaddr + sizeof(u8), static_cast<u8>(value >> 8));
+            Write8(vaddr, static_cast<u8>(value));
+            Write8(vaddr + sizeof(u8), static_cast<u8>(value >> 8));
             return;
         }
         u16 *dest = (u16 *) get_memory(memory, vaddr, num_page_table_entries, page_table);
@@ -383,10 +868,10 @@ public:
         }
 
     }
-    void MemoryWrite32(u64 vaddr, u32 value) override {
+    void Write32(u64 vaddr, u32 value) {
         if(vaddr & 3) {
-            MemoryWrite16(vaddr, static_cast<u16>(value));
-            MemoryWrite16(vaddr + sizeof(u16), static_cast<u16>(value >> 16));
+            Write16(vaddr, static_cast<u16>(value));
+            Write16(vaddr + sizeof(u16), static_cast<u16>(value >> 16));
             return;
         }
         u32 *dest = (u32 *) get_memory(memory, vaddr, num_page_table_entries, page_table);
@@ -397,10 +882,10 @@ public:
             abort();
         }
     }
-    void MemoryWrite64(u64 vaddr, u64 value) override {
+    void Write64(u64 vaddr, u64 value) {
         if(vaddr & 7) {
-            MemoryWrite32(vaddr, static_cast<u32>(value));
-            MemoryWrite32(vaddr + sizeof(u32), static_cast<u32>(value >> 32));
+            Write32(vaddr, static_cast<u32>(value));
+            Write32(vaddr + sizeof(u32), static_cast<u32>(value >> 32));
             return;
         }
         u64 *dest = (u64 *) get_memory(memory, vaddr, num_page_table_entries, page_table);
@@ -411,38 +896,97 @@ public:
             abort();
         }
     }
+    u8 MemoryRead8(u64 vaddr) override {
+        NotifyRead(vaddr, 1);
+        return Read8(vaddr);
+    }
+    u16 MemoryRead16(u64 vaddr) override {
+        NotifyRead(vaddr, 2);
+        return Read16(vaddr);
+    }
+    u32 MemoryRead32(u64 vaddr) override {
+        NotifyRead(vaddr, 4);
+        return Read32(vaddr);
+    }
+    u64 MemoryRead64(u64 vaddr) override {
+        NotifyRead(vaddr, 8);
+        return Read64(vaddr);
+    }
+    Dynarmic::A64::Vector MemoryRead128(u64 vaddr) override {
+        NotifyRead(vaddr, 16);
+        return {Read64(vaddr), Read64(vaddr + 8)};
+    }
+
+    void MemoryWrite8(u64 vaddr, u8 value) override {
+        NotifyWrite(vaddr, 1, value);
+        Write8(vaddr, value);
+    }
+    void MemoryWrite16(u64 vaddr, u16 value) override {
+        NotifyWrite(vaddr, 2, value);
+        Write16(vaddr, value);
+    }
+    void MemoryWrite32(u64 vaddr, u32 value) override {
+        NotifyWrite(vaddr, 4, value);
+        Write32(vaddr, value);
+    }
+    void MemoryWrite64(u64 vaddr, u64 value) override {
+        NotifyWrite(vaddr, 8, value);
+        Write64(vaddr, value);
+    }
     void MemoryWrite128(u64 vaddr, Dynarmic::A64::Vector value) override {
-        MemoryWrite64(vaddr, value[0]);
-        MemoryWrite64(vaddr + 8, value[1]);
+        NotifyWrite(vaddr, 16, value[0]);
+        Write64(vaddr, value[0]);
+        Write64(vaddr + 8, value[1]);
     }
 
-    bool MemoryWriteExclusive8(u64 vaddr, std::uint8_t value, std::uint8_t expected) override {
-        MemoryWrite8(vaddr, value);
+    template<typename T>
+    bool WriteExclusive(u64 vaddr, T value, T expected) {
+        NotifyWrite(vaddr, sizeof(T), value);
+        void *dest = get_memory(memory, vaddr, num_page_table_entries, page_table);
+        if(dest && (vaddr & (sizeof(T) - 1)) == 0) {
+            return compare_and_swap<T>(dest, value, expected);
+        }
+        T current = 0; // unaligned or unmapped
+        for(u64 i = 0; i < sizeof(T); i++) {
+            current |= static_cast<T>(Read8(vaddr + i)) << (8 * i);
+        }
+        if(current != expected) {
+            return false;
+        }
+        for(u64 i = 0; i < sizeof(T); i++) {
+            Write8(vaddr + i, static_cast<u8>(value >> (8 * i)));
+        }
         return true;
     }
+
+    bool MemoryWriteExclusive8(u64 vaddr, std::uint8_t value, std::uint8_t expected) override {
+        return WriteExclusive<std::uint8_t>(vaddr, value, expected);
+    }
     bool MemoryWriteExclusive16(u64 vaddr, std::uint16_t value, std::uint16_t expected) override {
-        MemoryWrite16(vaddr, value);
-        return true;
+        return WriteExclusive<std::uint16_t>(vaddr, value, expected);
     }
     bool MemoryWriteExclusive32(u64 vaddr, std::uint32_t value, std::uint32_t expected) override {
-        MemoryWrite32(vaddr, value);
-        return true;
+        return WriteExclusive<std::uint32_t>(vaddr, value, expected);
     }
     bool MemoryWriteExclusive64(u64 vaddr, std::uint64_t value, std::uint64_t expected) override {
-        MemoryWrite64(vaddr, value);
-        return true;
+        return WriteExclusive<std::uint64_t>(vaddr, value, expected);
     }
     bool MemoryWriteExclusive128(u64 vaddr, Dynarmic::A64::Vector value, Dynarmic::A64::Vector expected) override {
-        MemoryWrite128(vaddr, value);
-        return true;
+        if(vaddr & 15) {
+            return WriteExclusive<std::uint64_t>(vaddr, value[0], expected[0]) && WriteExclusive<std::uint64_t>(vaddr + 8, value[1], expected[1]);
+        }
+        NotifyWrite(vaddr, 16, value[0]);
+        void *dest = get_memory(memory, vaddr, num_page_table_entries, page_table);
+        if(dest == NULL) {
+            Write64(vaddr, value[0]); // reports the unmapped access
+            return false;
+        }
+        return compare_and_swap128(dest, value[0], value[1], expected[0], expected[1]);
     }
 
     void InterpreterFallback(u64 pc, std::size_t num_instructions) override {
-        JNIEnv *env;
-        cachedJVM->AttachCurrentThread((void **)&env, NULL);
         env->CallBooleanMethod(callback, handleInterpreterFallback, pc, num_instructions);
         cpu->HaltExecution();
-        cachedJVM->DetachCurrentThread();
         std::optional<std::uint32_t> code = MemoryReadCode(pc);
         if(code) {
             fprintf(stderr, "Unicorn fallback @ 0x%llx for %lu instructions (instr = 0x%08X)", pc, num_instructions, *code);
@@ -451,6 +995,12 @@ public:
     }
 
     void ExceptionRaised(u64 pc, Dynarmic::A64::Exception exception) override {
+        if(!stepping && is_instrumented(hooks, pc)) { // trap instruction of a hooked range
+            cpu->SetPC(pc);
+            step_request = true;
+            cpu->HaltExecution();
+            return;
+        }
         bool isBrk = false;
         switch (exception) {
             case Dynarmic::A64::Exception::Yield:
@@ -471,196 +1021,1053 @@ public:
                 printf("ExceptionRaised[%s->%s:%d]: pc=0x%llx, exception=%d, code=0x%08X\n", __FILE__, __func__, __LINE__, pc, exception, *code);
             }
         }
-        JNIEnv *env;
-        cachedJVM->AttachCurrentThread((void **)&env, NULL);
         env->CallVoidMethod(callback, handleExceptionRaised, pc, exception);
-        cachedJVM->DetachCurrentThread();
         if(!isBrk) {
             abort();
         }
     }
 
     void CallSVC(u32 swi) override {
-        JNIEnv *env;
-        cachedJVM->AttachCurrentThread((void **)&env, NULL);
+        if(cpu->GetPC() == until) { // per vCPU, so it is checked here instead of in java
+            Stop();
+            return;
+        }
+        u64 ret;
+        if(swi == 0 && handle_native_syscall(syscalls, (int) cpu->GetRegister(8), cpu->GetRegister(0), cpu->GetRegister(1), memory, num_page_table_entries, page_table, true, &ret)) {
+            cpu->SetRegister(0, ret);
+            return;
+        }
         env->CallVoidMethod(callback, callSVC, cpu->GetPC(), swi);
         if (env->ExceptionCheck()) {
-            cpu->HaltExecution();
+            Stop();
         }
-        cachedJVM->DetachCurrentThread();
     }
 
     void AddTicks(u64 ticks) override {
+        clock->instructions.fetch_add(ticks, std::memory_order_relaxed);
+        ticks_remaining = ticks < ticks_remaining ? ticks_remaining - ticks : 0;
     }
 
     u64 GetTicksRemaining() override {
-        return 0x10000000000ULL;
+        return ticks_remaining;
     }
 
     u64 GetCNTPCT() override {
-        return 0x10000000000ULL;
+        return read_cntpct(clock);
     }
 
-    u64 tpidrro_el0 = 0;
-    u64 tpidr_el0 = 0;
-    khash_t(memory) *memory = NULL;
-    size_t num_page_table_entries;
-    void **page_table = NULL;
-    jobject callback = NULL;
-    Dynarmic::A64::Jit *cpu;
-};
+    void NotifyRead(u64 vaddr, int size) {
+        if(is_hooked(hooks, DYN_HOOK_READ, vaddr)) {
+            env->CallVoidMethod(callback, handleMemoryRead, vaddr, size);
+            if (env->ExceptionCheck()) {
+                Stop();
+            }
+        }
+    }
 
-typedef struct dynarmic {
-  bool is64Bit;
-  khash_t(memory) *memory;
-  size_t num_page_table_entries;
-  void **page_table;
-  DynarmicCallbacks64 *cb64;
-  Dynarmic::A64::Jit *jit64;
-  DynarmicCallbacks32 *cb32;
-  Dynarmic::A32::Jit *jit32;
-  Dynarmic::ExclusiveMonitor *monitor;
-} *t_dynarmic;
+    void NoteCodePage(u64 vaddr) {
+        u64 page = vaddr & ~DYN_PAGE_MASK;
+        if(page != last_code_page.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> guard(code_lock);
+            code_pages.insert(page);
+            last_code_page.store(page, std::memory_order_relaxed);
+        }
+    }
 
-#ifdef __cplusplus
-extern "C" {
+    // apply the invalidations other threads requested while this jit was theirs to leave alone, see request_flush
+    void FlushPending() {
+        if(!flush_pending.load(std::memory_order_acquire)) {
+            return;
+        }
+        std::lock_guard<std::mutex> guard(code_lock);
+        flush_pending.store(false, std::memory_order_relaxed);
+        if(flush_all) {
+            cpu->ClearCache();
+        } else {
+            for(std::vector<std::pair<u64, u64>>::iterator it = flush_ranges.begin(); it != flush_ranges.end(); ++it) {
+                cpu->InvalidateCacheRange(it->first, it->second - it->first);
+            }
+        }
+        flush_all = false;
+        flush_ranges.clear();
+    }
+
+    void NotifyWrite(u64 vaddr, int size, u64 value) {
+        if(is_hooked(hooks, DYN_HOOK_WRITE, vaddr)) {
+            env->CallVoidMethod(callback, handleMemoryWrite, vaddr, size, value);
+            if (env->ExceptionCheck()) {
+                Stop();
+            }
+        }
+    }
+
+    void Stop() {
+        stopped = true;
+        if(!stepping) { // Step() returns by itself, a pending halt would end the next Run()
+            cpu->HaltExecution();
+        }
+    }
+
+    // Run() the jit, single stepping through the code/block hook ranges
+    void Run() {
+        stopped = false;
+        stepping = false;
+        u64 next_pc = 0; // fall through of the last stepped instruction, a new block starts anywhere else
+        while(!stopped) {
+            if(ticks_remaining == 0) {
+                break; // the jit checks the budget at block boundaries, stepped code per instruction
+            }
+            FlushPending();
+            if(!stepping) {
+                step_request = false;
+                executing = true;
+                FlushPending(); // after executing is set, so a request either lands here or halts the run
+                cpu->Run();
+                executing = false;
+                if(!step_request) {
+                    if(stopped || ticks_remaining == 0) {
+                        break;
+                    }
+                    continue; // halted by request_flush, the loop flushes and runs on
+                }
+                stepping = true;
+                next_pc = 1;
+                continue;
+            }
+            u64 pc = cpu->GetPC();
+            if(!is_instrumented(hooks, pc)) {
+                stepping = false;
+                continue;
+            }
+            if(pc != next_pc && is_hooked(hooks, DYN_HOOK_BLOCK, pc)) {
+                env->CallVoidMethod(callback, handleBlockHook, pc, 0);
+                if (env->ExceptionCheck()) {
+                    Stop();
+                }
+            }
+            if(!stopped && is_hooked(hooks, DYN_HOOK_CODE, pc)) {
+                env->CallVoidMethod(callback, handleCodeHook, pc, 4);
+                if (env->ExceptionCheck()) {
+                    Stop();
+                }
+            }
+            if(stopped) {
+                break;
+            }
+            if(cpu->GetPC() != pc) { // redirected by the hook
+                next_pc = 1;
+                continue;
+            }
+            cpu->Step();
+            next_pc = pc + 4;
+        }
+    }
+
+    u64 tpidrro_el0 = 0;
+    u64 tpidr_el0 = 0;
+    memory_map *memory = NULL;
+    size_t num_page_table_entries;
+    void **page_table = NULL;
+    jobject callback = NULL;
+    JNIEnv *env = NULL; // the thread running emu_start, which is already attached
+    khash_t(syscall) *syscalls = NULL;
+    u64 until = 0; // svc return address which stops emu_start
+    t_hook_table hooks = NULL; // owned by struct dynarmic
+    bool stepping = false; // inside a code/block hook range, compiled code is not instrumented
+    bool step_request = false;
+    bool stopped = false;
+    u64 ticks_remaining = DYN_UNLIMITED_TICKS; // instructions left to the budget of emu_start
+    t_clock clock = NULL; // owned by struct dynarmic
+    std::unordered_set<u64> code_pages; // pages the compiled blocks were fetched from, see pool_jit
+    std::atomic<u64> last_code_page{~0ULL};
+    std::mutex code_lock; // guards code_pages and the requested flushes
+    std::vector<std::pair<u64, u64>> flush_ranges; // [begin, end) to invalidate before the next block runs
+    bool flush_all = false;
+    std::atomic<bool> flush_pending{false};
+    std::atomic<bool> executing{false}; // inside cpu->Run(), a requested flush halts it
+    Dynarmic::A64::Jit *cpu;
+};
+
+typedef struct dynarmic {
+  bool is64Bit;
+  memory_map *memory;
+  size_t num_page_table_entries;
+  void **page_table;
+  DynarmicCallbacks64 *cb64;
+  Dynarmic::A64::Jit *jit64;
+  DynarmicCallbacks32 *cb32;
+  Dynarmic::A32::Jit *jit32;
+  Dynarmic::ExclusiveMonitor *monitor;
+  size_t processor_count; // vCPUs sharing the exclusive monitor
+  t_memory_snapshot snapshot; // NULL once the guest memory changed since the last mem_map_fork from it
+  khash_t(syscall) *syscalls;
+  t_hook_table hooks;
+  std::vector<struct vcpu *> *vcpus; // indexed by processor id, slot 0 is the primary jit above
+  std::mutex *vcpu_lock;
+  u64 emu_count; // instruction budget of every emu_start, 0 for none
+  t_clock clock;
+  t_checkpoint checkpoint;
+  std::unordered_map<u64, char *> *pending_code; // code page -> its content, blocks of a pooled jit not validated yet
+  std::unordered_map<u64, u32> *page_table_leaves; // leaf -> entries in use, guarded by memory_map::lock
+} *t_dynarmic;
+
+// extra jit sharing the page table, memory and exclusive monitor of its dynarmic, driven by one host thread
+typedef struct vcpu {
+  t_dynarmic dynarmic;
+  size_t processor_id;
+  DynarmicCallbacks64 *cb64;
+  Dynarmic::A64::Jit *jit64;
+  DynarmicCallbacks32 *cb32;
+  Dynarmic::A32::Jit *jit32;
+} *t_vcpu;
+
+static thread_local t_vcpu current_vcpu = NULL; // bound by bind_vcpu
+
+static inline t_vcpu bound_vcpu(t_dynarmic dynarmic) {
+  t_vcpu vcpu = current_vcpu;
+  return vcpu && vcpu->dynarmic == dynarmic ? vcpu : NULL;
+}
+
+static inline DynarmicCallbacks64 *current_cb64(t_dynarmic dynarmic) {
+  t_vcpu vcpu = bound_vcpu(dynarmic);
+  return vcpu ? vcpu->cb64 : dynarmic->cb64;
+}
+
+static inline Dynarmic::A64::Jit *current_jit64(t_dynarmic dynarmic) {
+  t_vcpu vcpu = bound_vcpu(dynarmic);
+  return vcpu ? vcpu->jit64 : dynarmic->jit64;
+}
+
+static inline DynarmicCallbacks32 *current_cb32(t_dynarmic dynarmic) {
+  t_vcpu vcpu = bound_vcpu(dynarmic);
+  return vcpu ? vcpu->cb32 : dynarmic->cb32;
+}
+
+static inline Dynarmic::A32::Jit *current_jit32(t_dynarmic dynarmic) {
+  t_vcpu vcpu = bound_vcpu(dynarmic);
+  return vcpu ? vcpu->jit32 : dynarmic->jit32;
+}
+
+// The jit indexes the page table flat, so all of it is reserved. It is reserved read-only: reads of the untouched parts
+// see the zero page and the system neither backs nor commits them, even without overcommit. A leaf, the host page
+// holding a run of entries, is made writable by its first entry and given back once its last entry is cleared
+#if defined(_WIN32) || defined(_WIN64)
+// the mman shim commits what it maps, the table is writable from the start
+static void **reserve_page_table(size_t size) {
+  void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE | MAP_NORESERVE, -1, 0);
+  return addr == MAP_FAILED ? NULL : (void **) addr;
+}
+
+static inline void commit_page_table_leaf(char *leaf) {
+}
+
+static inline void release_page_table_leaf(char *leaf) {
+}
+#else
+static void **reserve_page_table(size_t size) {
+  void *addr = mmap(NULL, size, PROT_READ, MAP_ANONYMOUS | MAP_PRIVATE | MAP_NORESERVE, -1, 0);
+  return addr == MAP_FAILED ? NULL : (void **) addr;
+}
+
+static void commit_page_table_leaf(char *leaf) {
+  if(mprotect(leaf, host_page_size, PROT_READ | PROT_WRITE) != 0) {
+    fprintf(stderr, "mprotect failed[%s->%s:%d]: leaf=%p, errno=%d, msg=%s\n", __FILE__, __func__, __LINE__, leaf, errno, strerror(errno));
+    abort();
+  }
+}
+
+// mapped over by a fresh read-only page, which drops the memory and the commit charge of the leaf at once
+static void release_page_table_leaf(char *leaf) {
+  if(mmap(leaf, host_page_size, PROT_READ, MAP_ANONYMOUS | MAP_PRIVATE | MAP_FIXED | MAP_NORESERVE, -1, 0) == MAP_FAILED) {
+    fprintf(stderr, "mmap failed[%s->%s:%d]: leaf=%p, errno=%d, msg=%s\n", __FILE__, __func__, __LINE__, leaf, errno, strerror(errno));
+    abort();
+  }
+}
 #endif
 
-/*
- * Class:     com_github_unidbg_arm_backend_dynarmic_Dynarmic
- * Method:    setDynarmicCallback
- * Signature: (JLcom/github/unidbg/arm/backend/dynarmic/DynarmicCallback;)I
- */
-JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_setDynarmicCallback
-  (JNIEnv *env, jclass clazz, jlong handle, jobject callback) {
-  t_dynarmic dynarmic = (t_dynarmic) handle;
-  if(dynarmic->is64Bit) {
-    DynarmicCallbacks64 *cb = dynarmic->cb64;
-    if(cb) {
-      cb->callback = env->NewGlobalRef(callback);
+// memory_map::lock must be held
+static void set_page_table_entry(t_dynarmic dynarmic, u64 idx, void *entry) {
+  void **page_table = dynarmic->page_table;
+  if((page_table[idx] == NULL) == (entry == NULL)) {
+    if(entry) {
+      page_table[idx] = entry;
+    }
+    return;
+  }
+  u64 leaf = idx * sizeof(void *) / host_page_size;
+  char *leaf_addr = (char *) page_table + leaf * host_page_size;
+  std::unordered_map<u64, u32> &leaves = *dynarmic->page_table_leaves;
+  if(entry) {
+    if(leaves[leaf]++ == 0) {
+      commit_page_table_leaf(leaf_addr);
+    }
+    page_table[idx] = entry;
+  } else {
+    page_table[idx] = NULL;
+    if(--leaves[leaf] == 0) {
+      leaves.erase(leaf);
+      release_page_table_leaf(leaf_addr);
+    }
+  }
+}
+
+static void set_page_table(t_dynarmic dynarmic, u64 vaddr, u64 size, char *addr) {
+  for(u64 off = 0; off < size; off += DYN_PAGE_SIZE) {
+    u64 idx = (vaddr + off) >> DYN_PAGE_BITS;
+    if(dynarmic->page_table && idx < dynarmic->num_page_table_entries) {
+      set_page_table_entry(dynarmic, idx, addr && !is_page_watched(dynarmic->hooks, vaddr + off) ? &addr[off] : NULL);
+    }
+  }
+}
+
+static bool is_range_free(memory_map *memory, u64 vaddr, u64 vaddr_end) {
+  memory_map::iterator it = memory->lower_bound(vaddr);
+  if(it != memory->end() && it->first < vaddr_end) {
+    return false;
+  }
+  return find_memory_region(memory, vaddr) == memory->end();
+}
+
+static bool is_range_mapped(memory_map *memory, u64 vaddr, u64 vaddr_end) {
+  memory_map::iterator it = find_memory_region(memory, vaddr);
+  while(vaddr < vaddr_end) {
+    if(it == memory->end() || it->first > vaddr) {
+      return false;
+    }
+    vaddr = it->first + it->second.size;
+    ++it;
+  }
+  return true;
+}
+
+// make sure a region boundary exists at vaddr, so that [.., vaddr) and [vaddr, ..) can be updated independently
+static void split_memory_region(memory_map *memory, u64 vaddr) {
+  memory_map::iterator it = find_memory_region(memory, vaddr);
+  if(it == memory->end() || it->first == vaddr) {
+    return;
+  }
+  struct memory_region &region = it->second;
+  u64 off = vaddr - it->first;
+  struct memory_region tail = region;
+  tail.size = region.size - off;
+  tail.addr = &region.addr[off];
+  tail.offset = region.offset + off;
+  region.size = off;
+  memory->insert(std::make_pair(vaddr, tail));
+}
+
+// coalesce neighbours around [vaddr, vaddr_end) which are slices of the same host mapping with the same perms
+static void merge_memory_regions(memory_map *memory, u64 vaddr, u64 vaddr_end) {
+  memory_map::iterator it = find_memory_region(memory, vaddr > 0 ? vaddr - 1 : vaddr);
+  if(it == memory->end()) {
+    it = memory->find(vaddr);
+  }
+  while(it != memory->end() && it->first <= vaddr_end) {
+    memory_map::iterator next = std::next(it);
+    if(next == memory->end()) {
+      break;
+    }
+    struct memory_region &region = it->second;
+    struct memory_region &neighbour = next->second;
+    if(it->first + region.size == next->first && region.block == neighbour.block &&
+       &region.addr[region.size] == neighbour.addr && region.offset + region.size == neighbour.offset &&
+       region.perms == neighbour.perms) {
+      region.size += neighbour.size;
+      memory->erase(next);
     } else {
-      return 1;
+      it = next;
+    }
+  }
+}
+
+static void release_memory_region(struct memory_region &region) {
+  t_memory_block block = region.block;
+#if defined(_WIN32) || defined(_WIN64)
+  // a view can only be unmapped as a whole
+  block->pages -= region.size >> DYN_PAGE_BITS;
+  if(block->pages == 0) {
+    int ret = munmap(block->base, block->size);
+    if(ret != 0) {
+      fprintf(stderr, "munmap failed[%s->%s:%d]: addr=%p, ret=%d\n", __FILE__, __func__, __LINE__, block->base, ret);
+    }
+    free(block);
+  }
+#else
+  int ret = munmap(region.addr, region.size);
+  if(ret != 0) {
+    fprintf(stderr, "munmap failed[%s->%s:%d]: addr=%p, ret=%d\n", __FILE__, __func__, __LINE__, region.addr, ret);
+  }
+  block->pages -= region.size >> DYN_PAGE_BITS;
+  if(block->pages == 0) {
+    free(block);
+  }
+#endif
+}
+
+static void release_memory_snapshot(t_dynarmic dynarmic) {
+  t_memory_snapshot snapshot = __atomic_exchange_n(&dynarmic->snapshot, (t_memory_snapshot) NULL, __ATOMIC_ACQ_REL);
+  if(snapshot == NULL) {
+    return;
+  }
+  close(snapshot->fd); // the clones keep their mappings of it
+  delete snapshot;
+}
+
+#if defined(_WIN32) || defined(_WIN64)
+static t_memory_snapshot take_memory_snapshot(t_dynarmic dynarmic) {
+  return NULL; // no file backed copy-on-write mappings: fork copies the guest memory
+}
+#else
+static int create_memory_fd() {
+#ifdef __linux__
+  return memfd_create("dynarmic", MFD_CLOEXEC);
+#else
+  char path[] = "/tmp/dynarmic.XXXXXX";
+  int fd = mkstemp(path);
+  if(fd != -1) {
+    unlink(path);
+  }
+  return fd;
+#endif
+}
+
+// move the guest memory into a file and remap it MAP_PRIVATE in place, so that clones share the pages copy-on-write
+static t_memory_snapshot take_memory_snapshot(t_dynarmic dynarmic) {
+  memory_map *memory = dynarmic->memory;
+  u64 size = 0;
+  for(memory_map::iterator it = memory->begin(); it != memory->end(); ++it) {
+    size += it->second.size;
+  }
+  if(size == 0) {
+    return NULL;
+  }
+  int fd = create_memory_fd();
+  if(fd == -1) {
+    fprintf(stderr, "create_memory_fd failed[%s->%s:%d]: errno=%d, msg=%s\n", __FILE__, __func__, __LINE__, errno, strerror(errno));
+    return NULL;
+  }
+  if(ftruncate(fd, size) != 0) {
+    fprintf(stderr, "ftruncate failed[%s->%s:%d]: size=0x%llx, errno=%d, msg=%s\n", __FILE__, __func__, __LINE__, (unsigned long long)size, errno, strerror(errno));
+    close(fd);
+    return NULL;
+  }
+  char *view = (char *) mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if(view == MAP_FAILED) {
+    fprintf(stderr, "mmap failed[%s->%s:%d]: size=0x%llx, errno=%d, msg=%s\n", __FILE__, __func__, __LINE__, (unsigned long long)size, errno, strerror(errno));
+    close(fd);
+    return NULL;
+  }
+  u64 offset = 0;
+  for(memory_map::iterator it = memory->begin(); it != memory->end(); ++it) {
+    struct memory_region &region = it->second;
+    memcpy(&view[offset], region.addr, region.size);
+    region.offset = offset;
+    offset += region.size;
+  }
+  munmap(view, size);
+  // mapped read-only first while a checkpoint is active, so no write gets past it before the armed pages are protected again
+  t_checkpoint checkpoint = dynarmic->checkpoint;
+  bool armed = checkpoint->active.load(std::memory_order_acquire);
+  for(memory_map::iterator it = memory->begin(); it != memory->end(); ++it) {
+    struct memory_region &region = it->second;
+    void *addr = mmap(region.addr, region.size, armed ? PROT_READ : PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, region.offset);
+    if(addr == MAP_FAILED) {
+      fprintf(stderr, "mmap failed[%s->%s:%d]: addr=%p, size=0x%llx, errno=%d, msg=%s\n", __FILE__, __func__, __LINE__, region.addr, (unsigned long long)region.size, errno, strerror(errno));
+      abort();
+    }
+    if(armed) {
+      std::lock_guard<std::mutex> guard(checkpoint->lock);
+      protect_armed_pages(checkpoint, region.addr, region.size);
     }
+  }
+  t_memory_snapshot snapshot = new memory_snapshot();
+  snapshot->fd = fd;
+  return snapshot;
+}
+#endif
+
+// [off, off + size) of a template region for a clone, copy-on-write from the snapshot file or copied without one
+static char *map_clone_region(t_memory_snapshot snapshot, struct memory_region &region, u64 off, u64 size) {
+  void *addr;
+  if(snapshot) {
+    addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, snapshot->fd, region.offset + off);
   } else {
-    DynarmicCallbacks32 *cb = dynarmic->cb32;
-    if(cb) {
-      cb->callback = env->NewGlobalRef(callback);
+    addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(addr != MAP_FAILED) {
+      memcpy(addr, &region.addr[off], size);
+    }
+  }
+  return addr == MAP_FAILED ? NULL : (char *) addr;
+}
+
+// primary jit of a destroyed dynarmic, kept with its compiled blocks for the next dynarmic of the same kind:
+// the blocks stay valid for guest code pages with the same content at the same address
+typedef struct jit_engine {
+  bool is64Bit;
+  size_t processor_count;
+  void **page_table; // all entries empty
+  Dynarmic::ExclusiveMonitor *monitor;
+  DynarmicCallbacks64 *cb64;
+  Dynarmic::A64::Jit *jit64;
+  DynarmicCallbacks32 *cb32;
+  Dynarmic::A32::Jit *jit32;
+  std::unordered_map<u64, char *> *code_copies; // code page -> its content when the jit was pooled
+} *t_jit_engine;
+
+static std::mutex jit_pool_lock;
+static std::vector<t_jit_engine> jit_pool;
+static size_t jit_pool_size = 0; // engines kept by destroy_dynarmic, 0 disables the pool
+
+static void release_code_copies(std::unordered_map<u64, char *> *code_copies) {
+  for(std::unordered_map<u64, char *>::iterator it = code_copies->begin(); it != code_copies->end(); ++it) {
+    free(it->second);
+  }
+  delete code_copies;
+}
+
+// the jit bound to the calling thread is flushed right away, dynarmic defers that to the end of a running block by itself.
+// The others may be running on their own threads: the flush is queued and the jit halted, its Run() loop applies the flush.
+// The pages are forgotten at once in both cases, so the next write to them is noticed again.
+template<typename C>
+static void request_flush(C *cb, bool own, bool all, u64 vaddr, u64 vaddr_end) {
+  {
+    std::lock_guard<std::mutex> guard(cb->code_lock);
+    for(std::unordered_set<u64>::iterator it = cb->code_pages.begin(); it != cb->code_pages.end();) {
+      if(all || (*it + DYN_PAGE_SIZE > vaddr && *it < vaddr_end)) {
+        it = cb->code_pages.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    cb->last_code_page = ~0ULL;
+    if(own) {
+      if(all) {
+        cb->cpu->ClearCache();
+      } else {
+        cb->cpu->InvalidateCacheRange(vaddr, vaddr_end - vaddr);
+      }
+      return;
+    }
+    if(all) {
+      cb->flush_all = true;
     } else {
-      return 1;
+      cb->flush_ranges.push_back(std::make_pair(vaddr, vaddr_end));
     }
+    cb->flush_pending = true;
+  }
+  if(cb->executing) {
+    cb->cpu->HaltExecution();
   }
-  return 0;
 }
 
-/*
- * Class:     com_github_unidbg_arm_backend_dynarmic_Dynarmic
- * Method:    nativeInitialize
- * Signature: (Z)J
- */
-JNIEXPORT jlong JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_nativeInitialize
-  (JNIEnv *env, jclass clazz, jboolean is64Bit) {
-  t_dynarmic dynarmic = (t_dynarmic) calloc(1, sizeof(struct dynarmic));
-  if(dynarmic == NULL) {
-    fprintf(stderr, "calloc dynarmic failed: size=%lu\n", sizeof(struct dynarmic));
-    abort();
-    return 0;
+template<typename C>
+static bool has_code_page(C *cb, u64 page) {
+  std::lock_guard<std::mutex> guard(cb->code_lock);
+  return cb->code_pages.count(page) > 0;
+}
+
+// true if a jit of the dynarmic compiled blocks fetched from the page
+static bool is_code_page(t_dynarmic dynarmic, u64 page) {
+  if((dynarmic->cb64 && has_code_page(dynarmic->cb64, page)) || (dynarmic->cb32 && has_code_page(dynarmic->cb32, page))) {
+    return true;
   }
-  dynarmic->is64Bit = is64Bit == JNI_TRUE;
-  dynarmic->memory = kh_init(memory);
-  if(dynarmic->memory == NULL) {
-    fprintf(stderr, "kh_init memory failed\n");
-    abort();
-    return 0;
+  std::lock_guard<std::mutex> guard(*dynarmic->vcpu_lock);
+  for(std::vector<t_vcpu>::iterator it = dynarmic->vcpus->begin(); it != dynarmic->vcpus->end(); ++it) {
+    t_vcpu vcpu = *it;
+    if(vcpu && ((vcpu->cb64 && has_code_page(vcpu->cb64, page)) || (vcpu->cb32 && has_code_page(vcpu->cb32, page)))) {
+      return true;
+    }
   }
-  int ret = kh_resize(memory, dynarmic->memory, 0x1000);
-  if(ret == -1) {
-    fprintf(stderr, "kh_resize memory failed\n");
-    abort();
-    return 0;
+  return false;
+}
+
+// drop the compiled blocks of [vaddr, vaddr_end) from every jit of the dynarmic, all of their blocks if all is set
+static void flush_code(t_dynarmic dynarmic, bool all, u64 vaddr, u64 vaddr_end) {
+  if(dynarmic->cb64) {
+    request_flush(dynarmic->cb64, current_cb64(dynarmic) == dynarmic->cb64, all, vaddr, vaddr_end);
+  }
+  if(dynarmic->cb32) {
+    request_flush(dynarmic->cb32, current_cb32(dynarmic) == dynarmic->cb32, all, vaddr, vaddr_end);
+  }
+  t_vcpu bound = bound_vcpu(dynarmic);
+  std::lock_guard<std::mutex> guard(*dynarmic->vcpu_lock);
+  for(std::vector<t_vcpu>::iterator it = dynarmic->vcpus->begin(); it != dynarmic->vcpus->end(); ++it) {
+    t_vcpu vcpu = *it;
+    if(vcpu && vcpu->cb64) {
+      request_flush(vcpu->cb64, vcpu == bound, all, vaddr, vaddr_end);
+    }
+    if(vcpu && vcpu->cb32) {
+      request_flush(vcpu->cb32, vcpu == bound, all, vaddr, vaddr_end);
+    }
+  }
+}
+
+static inline void invalidate_code(t_dynarmic dynarmic, u64 vaddr, u64 vaddr_end) {
+  flush_code(dynarmic, false, vaddr, vaddr_end);
+}
+
+// the blocks of a pending page are kept when this dynarmic maps the same content there,
+// all other pending pages are dropped: code mapped later, by dlopen during a run for instance, must not reuse them
+static void validate_pooled_code(t_dynarmic dynarmic) {
+  std::unordered_map<u64, char *> *pending = dynarmic->pending_code;
+  for(std::unordered_map<u64, char *>::iterator it = pending->begin(); it != pending->end(); it = pending->erase(it)) {
+    char *addr = get_memory_page(dynarmic->memory, it->first, dynarmic->num_page_table_entries, dynarmic->page_table);
+    if(addr == NULL || memcmp(addr, it->second, DYN_PAGE_SIZE) != 0) {
+      invalidate_code(dynarmic, it->first, it->first + DYN_PAGE_SIZE);
+    }
+    free(it->second);
+  }
+}
+
+static void destroy_engine(t_jit_engine engine) {
+  if(engine->jit64) {
+    engine->jit64->ClearCache();
+    delete engine->jit64;
+    engine->cb64->destroy();
+  }
+  if(engine->jit32) {
+    engine->jit32->ClearCache();
+    delete engine->jit32;
+    engine->cb32->destroy();
+  }
+  munmap(engine->page_table, (engine->is64Bit ? 1ULL << (PAGE_TABLE_ADDRESS_SPACE_BITS - DYN_PAGE_BITS) : Dynarmic::A32::UserConfig::NUM_PAGE_TABLE_ENTRIES) * sizeof(void*));
+  delete engine->monitor;
+  release_code_copies(engine->code_copies);
+  delete engine;
+}
+
+template<typename C>
+static void copy_code_pages(t_dynarmic dynarmic, C *cb, std::unordered_map<u64, char *> *code_copies) {
+  std::lock_guard<std::mutex> guard(cb->code_lock);
+  for(std::unordered_set<u64>::iterator it = cb->code_pages.begin(); it != cb->code_pages.end(); ++it) {
+    char *addr = get_memory_page(dynarmic->memory, *it, dynarmic->num_page_table_entries, dynarmic->page_table);
+    char *copy = addr ? (char *) malloc(DYN_PAGE_SIZE) : NULL;
+    if(copy) { // a page without a copy is not kept
+      memcpy(copy, addr, DYN_PAGE_SIZE);
+      (*code_copies)[*it] = copy;
+    }
+  }
+  cb->last_code_page = ~0ULL;
+}
+
+// called by destroy_dynarmic before the guest memory goes, false if the jit has to be deleted
+static bool pool_jit(t_dynarmic dynarmic) {
+  if(dynarmic->page_table == NULL || !dynarmic->hooks->ranges[DYN_HOOK_CODE].empty() || !dynarmic->hooks->ranges[DYN_HOOK_BLOCK].empty()) {
+    return false; // the compiled blocks hold the trap instructions of the hook ranges
   }
-  dynarmic->monitor = new Dynarmic::ExclusiveMonitor(1);
+  {
+    std::lock_guard<std::mutex> guard(jit_pool_lock);
+    if(jit_pool.size() >= jit_pool_size) {
+      return false;
+    }
+  }
+  validate_pooled_code(dynarmic);
+
+  t_jit_engine engine = new jit_engine();
+  engine->is64Bit = dynarmic->is64Bit;
+  engine->processor_count = dynarmic->processor_count;
+  engine->page_table = dynarmic->page_table;
+  engine->monitor = dynarmic->monitor;
+  engine->code_copies = new std::unordered_map<u64, char *>();
   if(dynarmic->is64Bit) {
-    DynarmicCallbacks64 *callbacks = new DynarmicCallbacks64(dynarmic->memory);
-
-    Dynarmic::A64::UserConfig config;
-    config.callbacks = callbacks;
-    config.tpidrro_el0 = &callbacks->tpidrro_el0;
-    config.tpidr_el0 = &callbacks->tpidr_el0;
-    config.processor_id = 0;
-    config.global_monitor = dynarmic->monitor;
-    config.wall_clock_cntpct = true;
+    engine->cb64 = dynarmic->cb64;
+    engine->jit64 = dynarmic->jit64;
+    copy_code_pages(dynarmic, dynarmic->cb64, engine->code_copies);
+    dynarmic->jit64->Reset(); // cpu state only, the blocks are kept
+  } else {
+    engine->cb32 = dynarmic->cb32;
+    engine->jit32 = dynarmic->jit32;
+    copy_code_pages(dynarmic, dynarmic->cb32, engine->code_copies);
+    dynarmic->jit32->Reset();
+  }
+  memory_map *memory = dynarmic->memory;
+  for(memory_map::iterator it = memory->begin(); it != memory->end(); ++it) {
+    for(u64 off = 0; off < it->second.size; off += DYN_PAGE_SIZE) {
+      u64 idx = (it->first + off) >> DYN_PAGE_BITS;
+      if(idx < dynarmic->num_page_table_entries) {
+        set_page_table_entry(dynarmic, idx, NULL);
+      }
+    }
+  }
+  dynarmic->monitor->Clear();
+
+  std::lock_guard<std::mutex> guard(jit_pool_lock);
+  if(jit_pool.size() >= jit_pool_size) { // lost a race against another destroy
+    destroy_engine(engine);
+  } else {
+    jit_pool.push_back(engine);
+  }
+  return true;
+}
+
+static t_jit_engine take_pooled_jit(bool is64Bit, size_t processor_count) {
+  std::lock_guard<std::mutex> guard(jit_pool_lock);
+  for(std::vector<t_jit_engine>::iterator it = jit_pool.begin(); it != jit_pool.end(); ++it) {
+    t_jit_engine engine = *it;
+    if(engine->is64Bit == is64Bit && engine->processor_count == processor_count) {
+      jit_pool.erase(it);
+      return engine;
+    }
+  }
+  return NULL;
+}
+
+// point the callbacks of a pooled jit at the state of its new dynarmic
+template<typename C>
+static void rebind_callbacks(t_dynarmic dynarmic, C *callbacks) {
+  callbacks->memory = dynarmic->memory;
+  callbacks->syscalls = dynarmic->syscalls;
+  callbacks->hooks = dynarmic->hooks;
+  callbacks->clock = dynarmic->clock;
+  callbacks->callback = NULL;
+  callbacks->env = NULL;
+  callbacks->until = 0;
+  callbacks->stepping = false;
+  callbacks->step_request = false;
+  callbacks->stopped = false;
+  callbacks->ticks_remaining = DYN_UNLIMITED_TICKS;
+}
+
+static void create_cpu64(t_dynarmic dynarmic, size_t processor_id, DynarmicCallbacks64 **cb, Dynarmic::A64::Jit **jit) {
+  DynarmicCallbacks64 *callbacks = new DynarmicCallbacks64(dynarmic->memory);
+  callbacks->syscalls = dynarmic->syscalls;
+  callbacks->hooks = dynarmic->hooks;
+  callbacks->clock = dynarmic->clock;
+
+  Dynarmic::A64::UserConfig config;
+  config.callbacks = callbacks;
+  config.tpidrro_el0 = &callbacks->tpidrro_el0;
+  config.tpidr_el0 = &callbacks->tpidr_el0;
+  config.cntfrq_el0 = DYN_CNTFRQ;
+  config.processor_id = processor_id;
+  config.global_monitor = dynarmic->monitor;
+  config.wall_clock_cntpct = false; // CNTPCT comes from dynarmic->clock
 //    config.page_table_pointer_mask_bits = DYN_PAGE_BITS;
 
 //    config.unsafe_optimizations = true;
 //    config.optimizations |= Dynarmic::OptimizationFlag::Unsafe_UnfuseFMA;
 //    config.optimizations |= Dynarmic::OptimizationFlag::Unsafe_ReducedErrorFP;
 
-    dynarmic->num_page_table_entries = 1ULL << (PAGE_TABLE_ADDRESS_SPACE_BITS - DYN_PAGE_BITS);
-    size_t size = dynarmic->num_page_table_entries * sizeof(void*);
-    dynarmic->page_table = (void **)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
-    if(dynarmic->page_table == MAP_FAILED) {
-      fprintf(stderr, "nativeInitialize mmap failed[%s->%s:%d] size=0x%zx, errno=%d, msg=%s\n", __FILE__, __func__, __LINE__, size, errno, strerror(errno));
-      dynarmic->page_table = NULL;
-    } else {
-      callbacks->num_page_table_entries = dynarmic->num_page_table_entries;
-      callbacks->page_table = dynarmic->page_table;
-
-      // Unpredictable instructions
-      config.define_unpredictable_behaviour = true;
+  if(dynarmic->page_table) {
+    callbacks->num_page_table_entries = dynarmic->num_page_table_entries;
+    callbacks->page_table = dynarmic->page_table;
+
+    // Unpredictable instructions
+    config.define_unpredictable_behaviour = true;
+
+    // Memory
+    config.page_table = dynarmic->page_table;
+    config.page_table_address_space_bits = PAGE_TABLE_ADDRESS_SPACE_BITS;
+    config.silently_mirror_page_table = false;
+    config.absolute_offset_page_table = false;
+    config.detect_misaligned_access_via_page_table = 16 | 32 | 64 | 128;
+    config.only_detect_misalignment_via_page_table_on_page_boundary = true;
+  }
 
-      // Memory
-      config.page_table = dynarmic->page_table;
-      config.page_table_address_space_bits = PAGE_TABLE_ADDRESS_SPACE_BITS;
-      config.silently_mirror_page_table = false;
-      config.absolute_offset_page_table = false;
-      config.detect_misaligned_access_via_page_table = 16 | 32 | 64 | 128;
-      config.only_detect_misalignment_via_page_table_on_page_boundary = true;
-    }
+  *cb = callbacks;
+  *jit = new Dynarmic::A64::Jit(config);
+  callbacks->cpu = *jit;
+}
 
-    dynarmic->cb64 = callbacks;
-    dynarmic->jit64 = new Dynarmic::A64::Jit(config);
-    callbacks->cpu = dynarmic->jit64;
-  } else {
-    DynarmicCallbacks32 *callbacks = new DynarmicCallbacks32(dynarmic->memory);
-
-    Dynarmic::A32::UserConfig config;
-    config.callbacks = callbacks;
-    config.coprocessors[15] = callbacks->cp15;
-    config.processor_id = 0;
-    config.global_monitor = dynarmic->monitor;
-    config.always_little_endian = false;
-    config.wall_clock_cntpct = true;
+static void create_cpu32(t_dynarmic dynarmic, size_t processor_id, DynarmicCallbacks32 **cb, Dynarmic::A32::Jit **jit) {
+  DynarmicCallbacks32 *callbacks = new DynarmicCallbacks32(dynarmic->memory);
+  callbacks->syscalls = dynarmic->syscalls;
+  callbacks->hooks = dynarmic->hooks;
+  callbacks->clock = dynarmic->clock;
+
+  Dynarmic::A32::UserConfig config;
+  config.callbacks = callbacks;
+  t_clock clock = dynarmic->clock;
+  callbacks->cp15->cntpct = [clock]() { return read_cntpct(clock); };
+  config.coprocessors[15] = callbacks->cp15;
+  config.processor_id = processor_id;
+  config.global_monitor = dynarmic->monitor;
+  config.always_little_endian = false;
+  config.wall_clock_cntpct = false; // CNTPCT comes from dynarmic->clock
 //    config.page_table_pointer_mask_bits = DYN_PAGE_BITS;
 
 //    config.unsafe_optimizations = true;
 //    config.optimizations |= Dynarmic::OptimizationFlag::Unsafe_UnfuseFMA;
 //    config.optimizations |= Dynarmic::OptimizationFlag::Unsafe_ReducedErrorFP;
 
-    dynarmic->num_page_table_entries = Dynarmic::A32::UserConfig::NUM_PAGE_TABLE_ENTRIES;
+  if(dynarmic->page_table) {
+    callbacks->num_page_table_entries = dynarmic->num_page_table_entries;
+    callbacks->page_table = dynarmic->page_table;
+
+    // Unpredictable instructions
+    config.define_unpredictable_behaviour = true;
+
+    // Memory
+    config.page_table = reinterpret_cast<std::array<std::uint8_t*, Dynarmic::A32::UserConfig::NUM_PAGE_TABLE_ENTRIES>*>(dynarmic->page_table);
+    config.absolute_offset_page_table = false;
+    config.detect_misaligned_access_via_page_table = 16 | 32 | 64 | 128;
+    config.only_detect_misalignment_via_page_table_on_page_boundary = true;
+  }
+
+  *cb = callbacks;
+  *jit = new Dynarmic::A32::Jit(config);
+  callbacks->cpu = *jit;
+}
+
+static t_dynarmic create_dynarmic(bool is64Bit, size_t processor_count) {
+  t_dynarmic dynarmic = (t_dynarmic) calloc(1, sizeof(struct dynarmic));
+  if(dynarmic == NULL) {
+    fprintf(stderr, "calloc dynarmic failed: size=%lu\n", sizeof(struct dynarmic));
+    abort();
+    return 0;
+  }
+  dynarmic->is64Bit = is64Bit;
+  dynarmic->memory = new memory_map();
+  dynarmic->syscalls = kh_init(syscall);
+  dynarmic->hooks = new hook_table();
+  dynarmic->clock = new dyn_clock();
+  dynarmic->clock->instructions_per_second.store(DYN_CNTFRQ, std::memory_order_relaxed);
+  dynarmic->clock->source.store(DYN_TIME_SOURCE_HOST, std::memory_order_release);
+  dynarmic->processor_count = processor_count;
+  dynarmic->vcpus = new std::vector<t_vcpu>(processor_count, (t_vcpu) NULL);
+  dynarmic->vcpu_lock = new std::mutex();
+  dynarmic->num_page_table_entries = is64Bit ? 1ULL << (PAGE_TABLE_ADDRESS_SPACE_BITS - DYN_PAGE_BITS) : Dynarmic::A32::UserConfig::NUM_PAGE_TABLE_ENTRIES;
+
+  t_jit_engine engine = take_pooled_jit(is64Bit, processor_count);
+  if(engine) {
+    dynarmic->monitor = engine->monitor;
+    dynarmic->page_table = engine->page_table;
+    dynarmic->pending_code = engine->code_copies;
+  } else {
+    dynarmic->monitor = new Dynarmic::ExclusiveMonitor(processor_count);
+    dynarmic->pending_code = new std::unordered_map<u64, char *>();
+
+    // one page table shared by the jits of all vCPUs, see reserve_page_table
     size_t size = dynarmic->num_page_table_entries * sizeof(void*);
-    dynarmic->page_table = (void **)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
-    if(dynarmic->page_table == MAP_FAILED) {
+    dynarmic->page_table = reserve_page_table(size);
+    if(dynarmic->page_table == NULL) {
       fprintf(stderr, "nativeInitialize mmap failed[%s->%s:%d] size=0x%zx, errno=%d, msg=%s\n", __FILE__, __func__, __LINE__, size, errno, strerror(errno));
-      dynarmic->page_table = NULL;
+    }
+  }
+  dynarmic->page_table_leaves = new std::unordered_map<u64, u32>(); // a pooled page table comes back empty
+  dynarmic->checkpoint = new dyn_checkpoint();
+  {
+    std::lock_guard<std::mutex> guard(checkpoints_lock);
+    checkpoints.push_back(dynarmic->checkpoint);
+  }
+
+  if(engine) {
+    if(is64Bit) {
+      dynarmic->cb64 = engine->cb64;
+      dynarmic->jit64 = engine->jit64;
+      rebind_callbacks(dynarmic, dynarmic->cb64);
+      dynarmic->cb64->tpidr_el0 = 0;
+      dynarmic->cb64->tpidrro_el0 = 0;
     } else {
-      callbacks->num_page_table_entries = dynarmic->num_page_table_entries;
-      callbacks->page_table = dynarmic->page_table;
+      dynarmic->cb32 = engine->cb32;
+      dynarmic->jit32 = engine->jit32;
+      rebind_callbacks(dynarmic, dynarmic->cb32);
+      dynarmic->cb32->cp15->uro = 0;
+    }
+    delete engine; // its code copies are the pending_code of the dynarmic now
+  } else if(dynarmic->is64Bit) {
+    create_cpu64(dynarmic, 0, &dynarmic->cb64, &dynarmic->jit64);
+  } else {
+    create_cpu32(dynarmic, 0, &dynarmic->cb32, &dynarmic->jit32);
+  }
+  return dynarmic;
+}
+
+static void destroy_vcpu(t_vcpu vcpu) {
+  if(current_vcpu == vcpu) {
+    current_vcpu = NULL;
+  }
+  if(vcpu->jit64) {
+    vcpu->jit64->ClearCache();
+    delete vcpu->jit64;
+  }
+  if(vcpu->cb64) {
+    vcpu->cb64->destroy(); // the java callback global ref belongs to the primary
+  }
+  if(vcpu->jit32) {
+    vcpu->jit32->ClearCache();
+    delete vcpu->jit32;
+  }
+  if(vcpu->cb32) {
+    vcpu->cb32->destroy();
+  }
+  free(vcpu);
+}
 
-      // Unpredictable instructions
-      config.define_unpredictable_behaviour = true;
+// checkpoint->lock must be held
+static void release_checkpoint_pages(t_checkpoint checkpoint) {
+  for(std::map<u64, char *>::iterator it = checkpoint->pages.begin(); it != checkpoint->pages.end(); ++it) {
+    free(it->second);
+  }
+  checkpoint->pages.clear();
+}
 
-      // Memory
-      config.page_table = reinterpret_cast<std::array<std::uint8_t*, Dynarmic::A32::UserConfig::NUM_PAGE_TABLE_ENTRIES>*>(dynarmic->page_table);
-      config.absolute_offset_page_table = false;
-      config.detect_misaligned_access_via_page_table = 16 | 32 | 64 | 128;
-      config.only_detect_misalignment_via_page_table_on_page_boundary = true;
+static void destroy_dynarmic(JNIEnv *env, t_dynarmic dynarmic) {
+  for(std::vector<t_vcpu>::iterator it = dynarmic->vcpus->begin(); it != dynarmic->vcpus->end(); ++it) {
+    if(*it) {
+      destroy_vcpu(*it);
+      *it = NULL;
+    }
+  }
+  bool pooled = pool_jit(dynarmic);
+  delete dynarmic->vcpus;
+  delete dynarmic->vcpu_lock;
+  release_code_copies(dynarmic->pending_code);
+  delete dynarmic->page_table_leaves;
+  {
+    std::lock_guard<std::mutex> guard(checkpoints_lock); // before its pages are unmapped, their addresses may be reused
+    checkpoints.erase(std::find(checkpoints.begin(), checkpoints.end(), dynarmic->checkpoint));
+  }
+  memory_map *memory = dynarmic->memory;
+  for(memory_map::iterator it = memory->begin(); it != memory->end(); ++it) {
+    release_memory_region(it->second);
+  }
+  delete memory;
+  release_memory_snapshot(dynarmic);
+  kh_destroy(syscall, dynarmic->syscalls);
+  delete dynarmic->hooks;
+  delete dynarmic->clock;
+  release_checkpoint_pages(dynarmic->checkpoint);
+  delete dynarmic->checkpoint;
+  Dynarmic::A64::Jit *jit64 = dynarmic->jit64;
+  if(jit64 && !pooled) {
+    jit64->ClearCache();
+    jit64->Reset();
+    delete jit64;
+  }
+  DynarmicCallbacks64 *cb64 = dynarmic->cb64;
+  if(cb64) {
+    env->DeleteGlobalRef(cb64->callback);
+    cb64->callback = NULL;
+    if(!pooled) {
+      cb64->destroy();
     }
+  }
+  Dynarmic::A32::Jit *jit32 = dynarmic->jit32;
+  if(jit32 && !pooled) {
+    jit32->ClearCache();
+    jit32->Reset();
+    delete jit32;
+  }
+  DynarmicCallbacks32 *cb32 = dynarmic->cb32;
+  if(cb32) {
+    env->DeleteGlobalRef(cb32->callback);
+    cb32->callback = NULL;
+    if(!pooled) {
+      cb32->destroy();
+    }
+  }
+  if(pooled) {
+    free(dynarmic); // the page table and the exclusive monitor went to the pool
+    return;
+  }
+  if(dynarmic->page_table) {
+    int ret = munmap(dynarmic->page_table, dynarmic->num_page_table_entries * sizeof(void*));
+    if(ret != 0) {
+      fprintf(stderr, "munmap failed[%s->%s:%d]: page_table=%p, ret=%d\n", __FILE__, __func__, __LINE__, dynarmic->page_table, ret);
+    }
+  }
+  delete dynarmic->monitor;
+  free(dynarmic);
+}
+
+static void save_context(t_dynarmic dynarmic, void *context) {
+  if(dynarmic->is64Bit) {
+    Dynarmic::A64::Jit *jit = current_jit64(dynarmic);
+    t_context64 ctx = (t_context64) context;
+    ctx->sp = jit->GetSP();
+    ctx->pc = jit->GetPC();
+    ctx->registers = jit->GetRegisters();
+    ctx->vectors = jit->GetVectors();
+    ctx->fpcr = jit->GetFpcr();
+    ctx->fpsr = jit->GetFpsr();
+    ctx->pstate = jit->GetPstate();
+
+    DynarmicCallbacks64 *cb = current_cb64(dynarmic);
+    ctx->tpidr_el0 = cb->tpidr_el0;
+    ctx->tpidrro_el0 = cb->tpidrro_el0;
+  } else {
+    Dynarmic::A32::Jit *jit = current_jit32(dynarmic);
+    t_context32 ctx = (t_context32) context;
+    ctx->regs = jit->Regs();
+    ctx->extRegs = jit->ExtRegs();
+    ctx->cpsr = jit->Cpsr();
+    ctx->fpscr = jit->Fpscr();
+
+    DynarmicCallbacks32 *cb = current_cb32(dynarmic);
+    ctx->uro = cb->cp15.get()->uro;
+  }
+}
+
+static void restore_context(t_dynarmic dynarmic, void *context) {
+  if(dynarmic->is64Bit) {
+    Dynarmic::A64::Jit *jit = current_jit64(dynarmic);
+    t_context64 ctx = (t_context64) context;
+    jit->SetSP(ctx->sp);
+    jit->SetPC(ctx->pc);
+    jit->SetRegisters(ctx->registers);
+    jit->SetVectors(ctx->vectors);
+    jit->SetFpcr(ctx->fpcr);
+    jit->SetFpsr(ctx->fpsr);
+    jit->SetPstate(ctx->pstate);
+
+    DynarmicCallbacks64 *cb = current_cb64(dynarmic);
+    cb->tpidr_el0 = ctx->tpidr_el0;
+    cb->tpidrro_el0 = ctx->tpidrro_el0;
+  } else {
+    Dynarmic::A32::Jit *jit = current_jit32(dynarmic);
+    t_context32 ctx = (t_context32) context;
+    jit->Regs() = ctx->regs;
+    jit->ExtRegs() = ctx->extRegs;
+    jit->SetCpsr(ctx->cpsr);
+    jit->SetFpscr(ctx->fpscr);
+
+    DynarmicCallbacks32 *cb = current_cb32(dynarmic);
+    cb->cp15.get()->uro = ctx->uro;
+  }
+}
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Class:     com_github_unidbg_arm_backend_dynarmic_Dynarmic
+ * Method:    setDynarmicCallback
+ * Signature: (JLcom/github/unidbg/arm/backend/dynarmic/DynarmicCallback;)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_setDynarmicCallback
+  (JNIEnv *env, jclass clazz, jlong handle, jobject callback) {
+  t_dynarmic dynarmic = (t_dynarmic) handle;
+  if(dynarmic->is64Bit) {
+    DynarmicCallbacks64 *cb = dynarmic->cb64;
+    if(cb) {
+      cb->callback = env->NewGlobalRef(callback);
+    } else {
+      return 1;
+    }
+  } else {
+    DynarmicCallbacks32 *cb = dynarmic->cb32;
+    if(cb) {
+      cb->callback = env->NewGlobalRef(callback);
+    } else {
+      return 1;
+    }
+  }
+  return 0;
+}
 
-    dynarmic->cb32 = callbacks;
-    dynarmic->jit32 = new Dynarmic::A32::Jit(config);
-    callbacks->cpu = dynarmic->jit32;
+/*
+ * Class:     com_github_unidbg_arm_backend_dynarmic_Dynarmic
+ * Method:    nativeInitialize
+ * Signature: (ZI)J
+ */
+JNIEXPORT jlong JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_nativeInitialize
+  (JNIEnv *env, jclass clazz, jboolean is64Bit, jint processor_count) {
+  if(processor_count < 1) {
+    return 0;
   }
-  return (jlong) dynarmic;
+  return (jlong) create_dynarmic(is64Bit == JNI_TRUE, processor_count);
 }
 
 /*
@@ -670,49 +2077,24 @@ JNIEXPORT jlong JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_nat
  */
 JNIEXPORT void JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_nativeDestroy
   (JNIEnv *env, jclass clazz, jlong handle) {
-  t_dynarmic dynarmic = (t_dynarmic) handle;
-  khash_t(memory) *memory = dynarmic->memory;
-  for (khiter_t k = kh_begin(memory); k < kh_end(memory); k++) {
-    if(kh_exist(memory, k)) {
-      t_memory_page page = kh_value(memory, k);
-      int ret = munmap(page->addr, DYN_PAGE_SIZE);
-      if(ret != 0) {
-        fprintf(stderr, "munmap failed[%s->%s:%d]: addr=%p, ret=%d\n", __FILE__, __func__, __LINE__, page->addr, ret);
-      }
-      free(page);
-    }
-  }
-  kh_destroy(memory, memory);
-  Dynarmic::A64::Jit *jit64 = dynarmic->jit64;
-  if(jit64) {
-    jit64->ClearCache();
-    jit64->Reset();
-    delete jit64;
-  }
-  DynarmicCallbacks64 *cb64 = dynarmic->cb64;
-  if(cb64) {
-    env->DeleteGlobalRef(cb64->callback);
-    cb64->destroy();
-  }
-  Dynarmic::A32::Jit *jit32 = dynarmic->jit32;
-  if(jit32) {
-    jit32->ClearCache();
-    jit32->Reset();
-    delete jit32;
-  }
-  DynarmicCallbacks32 *cb32 = dynarmic->cb32;
-  if(cb32) {
-    env->DeleteGlobalRef(cb32->callback);
-    cb32->destroy();
+  destroy_dynarmic(env, (t_dynarmic) handle);
+}
+
+// unmapped pages are neither tracked nor restored any more
+// before the region is released, its host pages may be mapped again for other guest pages
+static void forget_checkpoint_pages(t_checkpoint checkpoint, u64 vaddr, struct memory_region &region) {
+  if(!checkpoint->active.load(std::memory_order_acquire)) {
+    return;
   }
-  if(dynarmic->page_table) {
-    int ret = munmap(dynarmic->page_table, dynarmic->num_page_table_entries * sizeof(void*));
-    if(ret != 0) {
-      fprintf(stderr, "munmap failed[%s->%s:%d]: page_table=%p, ret=%d\n", __FILE__, __func__, __LINE__, dynarmic->page_table, ret);
+  std::lock_guard<std::mutex> guard(checkpoint->lock);
+  for(u64 off = 0; off < region.size; off += DYN_PAGE_SIZE) {
+    checkpoint->armed.erase(&region.addr[off]);
+    std::map<u64, char *>::iterator it = checkpoint->pages.find(vaddr + off);
+    if(it != checkpoint->pages.end()) {
+      free(it->second);
+      checkpoint->pages.erase(it);
     }
   }
-  delete dynarmic->monitor;
-  free(dynarmic);
 }
 
 /*
@@ -729,29 +2111,79 @@ JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_mem_
     return 2;
   }
   t_dynarmic dynarmic = (t_dynarmic) handle;
-  khash_t(memory) *memory = dynarmic->memory;
-  int ret;
-  for(u64 vaddr = address; vaddr < address + size; vaddr += DYN_PAGE_SIZE) {
-    u64 idx = vaddr >> DYN_PAGE_BITS;
-    khiter_t k = kh_get(memory, memory, vaddr);
-    if(k == kh_end(memory)) {
-      fprintf(stderr, "mem_unmap failed[%s->%s:%d]: vaddr=%p\n", __FILE__, __func__, __LINE__, (void*)vaddr);
-      return 3;
-    }
-    if(dynarmic->page_table && idx < dynarmic->num_page_table_entries) {
-      dynarmic->page_table[idx] = NULL;
-    }
-    t_memory_page page = kh_value(memory, k);
-    int ret = munmap(page->addr, DYN_PAGE_SIZE);
-    if(ret != 0) {
-      fprintf(stderr, "munmap failed[%s->%s:%d]: addr=%p, ret=%d\n", __FILE__, __func__, __LINE__, page->addr, ret);
-    }
-    free(page);
-    kh_del(memory, memory, k);
+  memory_map *memory = dynarmic->memory;
+  std::lock_guard<std::mutex> guard(memory->lock);
+  u64 vaddr_end = address + size;
+  if(!is_range_mapped(memory, address, vaddr_end)) {
+    fprintf(stderr, "mem_unmap failed[%s->%s:%d]: address=%p, size=0x%llx\n", __FILE__, __func__, __LINE__, (void*)address, (unsigned long long)size);
+    return 3;
+  }
+  split_memory_region(memory, address);
+  split_memory_region(memory, vaddr_end);
+  memory_map::iterator it = memory->find(address);
+  while(it != memory->end() && it->first < vaddr_end) {
+    set_page_table(dynarmic, it->first, it->second.size, NULL);
+    forget_checkpoint_pages(dynarmic->checkpoint, it->first, it->second);
+    release_memory_region(it->second);
+    it = memory->erase(it);
+  }
+  invalidate_code(dynarmic, address, vaddr_end);
+  return 0;
+}
+
+/*
+ * Class:     com_github_unidbg_arm_backend_dynarmic_Dynarmic
+ * Method:    remove_cache
+ * Signature: (JJJ)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_remove_1cache
+  (JNIEnv *env, jclass clazz, jlong handle, jlong begin, jlong end) {
+  if((u64) end <= (u64) begin) {
+    return 1;
   }
+  t_dynarmic dynarmic = (t_dynarmic) handle;
+  invalidate_code(dynarmic, begin, end);
   return 0;
 }
 
+/*
+ * Class:     com_github_unidbg_arm_backend_dynarmic_Dynarmic
+ * Method:    set_jit_pool_size
+ * Signature: (I)V
+ */
+JNIEXPORT void JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_set_1jit_1pool_1size
+  (JNIEnv *env, jclass clazz, jint size) {
+  std::lock_guard<std::mutex> guard(jit_pool_lock);
+  jit_pool_size = size > 0 ? size : 0;
+  while(jit_pool.size() > jit_pool_size) {
+    destroy_engine(jit_pool.back());
+    jit_pool.pop_back();
+  }
+}
+
+// memory->lock must be held
+static void map_memory_block(t_dynarmic dynarmic, jlong address, jlong size, jint perms, char *addr) {
+  t_memory_block block = (t_memory_block) calloc(1, sizeof(struct memory_block));
+  if(block == NULL) {
+    fprintf(stderr, "calloc block failed: size=%lu\n", sizeof(struct memory_block));
+    abort();
+    return;
+  }
+  block->base = addr;
+  block->size = size;
+  block->pages = size >> DYN_PAGE_BITS;
+
+  struct memory_region region;
+  region.size = size;
+  region.addr = block->base;
+  region.perms = perms;
+  region.block = block;
+  region.offset = 0;
+  (*dynarmic->memory)[address] = region;
+  set_page_table(dynarmic, address, size, block->base);
+  release_memory_snapshot(dynarmic);
+}
+
 /*
  * Class:     com_github_unidbg_arm_backend_dynarmic_Dynarmic
  * Method:    mem_map
@@ -766,36 +2198,60 @@ JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_mem_
     return 2;
   }
   t_dynarmic dynarmic = (t_dynarmic) handle;
-  khash_t(memory) *memory = dynarmic->memory;
-  int ret;
-  for(u64 vaddr = address; vaddr < address + size; vaddr += DYN_PAGE_SIZE) {
-    u64 idx = vaddr >> DYN_PAGE_BITS;
-    if(kh_get(memory, memory, vaddr) != kh_end(memory)) {
-      fprintf(stderr, "mem_map failed[%s->%s:%d]: vaddr=%p\n", __FILE__, __func__, __LINE__, (void*)vaddr);
-      return 3;
-    }
+  memory_map *memory = dynarmic->memory;
+  std::lock_guard<std::mutex> guard(memory->lock);
+  if(!is_range_free(memory, address, address + size)) {
+    fprintf(stderr, "mem_map failed[%s->%s:%d]: address=%p, size=0x%llx\n", __FILE__, __func__, __LINE__, (void*)address, (unsigned long long)size);
+    return 3;
+  }
 
-    void *addr = mmap(NULL, DYN_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    if(addr == MAP_FAILED) {
-      fprintf(stderr, "mmap failed[%s->%s:%d]: addr=%p\n", __FILE__, __func__, __LINE__, (void*)addr);
-      return 4;
-    }
-    if(dynarmic->page_table && idx < dynarmic->num_page_table_entries) {
-      dynarmic->page_table[idx] = addr;
-    } else {
-      // 0xffffff80001f0000ULL: 0x10000
-    }
-    khiter_t k = kh_put(memory, memory, vaddr, &ret);
-    t_memory_page page = (t_memory_page) calloc(1, sizeof(struct memory_page));
-    if(page == NULL) {
-      fprintf(stderr, "calloc page failed: size=%lu\n", sizeof(struct memory_page));
-      abort();
-      return 0;
-    }
-    page->addr = addr;
-    page->perms = perms;
-    kh_value(memory, k) = page;
+  void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if(addr == MAP_FAILED) {
+    fprintf(stderr, "mmap failed[%s->%s:%d]: addr=%p, size=0x%llx\n", __FILE__, __func__, __LINE__, (void*)addr, (unsigned long long)size);
+    return 4;
+  }
+  map_memory_block(dynarmic, address, size, perms, (char *) addr);
+  return 0;
+}
+
+/*
+ * Class:     com_github_unidbg_arm_backend_dynarmic_Dynarmic
+ * Method:    mem_map_file
+ * Signature: (JJJILjava/lang/String;J)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_mem_1map_1file
+  (JNIEnv *env, jclass clazz, jlong handle, jlong address, jlong size, jint perms, jstring path, jlong offset) {
+  if(address & DYN_PAGE_MASK) {
+    return 1;
+  }
+  if(size == 0 || (size & DYN_PAGE_MASK)) {
+    return 2;
+  }
+  t_dynarmic dynarmic = (t_dynarmic) handle;
+  memory_map *memory = dynarmic->memory;
+  std::lock_guard<std::mutex> guard(memory->lock);
+  if(!is_range_free(memory, address, address + size)) {
+    fprintf(stderr, "mem_map_file failed[%s->%s:%d]: address=%p, size=0x%llx\n", __FILE__, __func__, __LINE__, (void*)address, (unsigned long long)size);
+    return 3;
+  }
+
+  const char *file = env->GetStringUTFChars(path, NULL);
+  int fd = open(file, O_RDONLY);
+  if(fd == -1) {
+    fprintf(stderr, "open failed[%s->%s:%d]: file=%s, errno=%d, msg=%s\n", __FILE__, __func__, __LINE__, file, errno, strerror(errno));
+    env->ReleaseStringUTFChars(path, file);
+    return 5;
+  }
+  env->ReleaseStringUTFChars(path, file);
+
+  // private file mapping: pages are faulted in from the page cache and copied on the first guest write
+  void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, offset);
+  close(fd);
+  if(addr == MAP_FAILED) {
+    fprintf(stderr, "mmap failed[%s->%s:%d]: size=0x%llx, offset=0x%llx, errno=%d, msg=%s\n", __FILE__, __func__, __LINE__, (unsigned long long)size, (unsigned long long)offset, errno, strerror(errno));
+    return 4;
   }
+  map_memory_block(dynarmic, address, size, perms, (char *) addr);
   return 0;
 }
 
@@ -813,17 +2269,19 @@ JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_mem_
     return 2;
   }
   t_dynarmic dynarmic = (t_dynarmic) handle;
-  khash_t(memory) *memory = dynarmic->memory;
-  int ret;
-  for(u64 vaddr = address; vaddr < address + size; vaddr += DYN_PAGE_SIZE) {
-    khiter_t k = kh_get(memory, memory, vaddr);
-    if(k == kh_end(memory)) {
-      fprintf(stderr, "mem_protect failed[%s->%s:%d]: vaddr=%p\n", __FILE__, __func__, __LINE__, (void*)vaddr);
-      return 3;
-    }
-    t_memory_page page = kh_value(memory, k);
-    page->perms = perms;
+  memory_map *memory = dynarmic->memory;
+  std::lock_guard<std::mutex> guard(memory->lock);
+  u64 vaddr_end = address + size;
+  if(!is_range_mapped(memory, address, vaddr_end)) {
+    fprintf(stderr, "mem_protect failed[%s->%s:%d]: address=%p, size=0x%llx\n", __FILE__, __func__, __LINE__, (void*)address, (unsigned long long)size);
+    return 3;
+  }
+  split_memory_region(memory, address);
+  split_memory_region(memory, vaddr_end);
+  for(memory_map::iterator it = memory->find(address); it != memory->end() && it->first < vaddr_end; ++it) {
+    it->second.perms = perms;
   }
+  merge_memory_regions(memory, address, vaddr_end);
   return 0;
 }
 
@@ -837,7 +2295,8 @@ JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_mem_
   jsize size = env->GetArrayLength(bytes);
   jbyte *data = env->GetByteArrayElements(bytes, NULL);
   t_dynarmic dynarmic = (t_dynarmic) handle;
-  khash_t(memory) *memory = dynarmic->memory;
+  release_memory_snapshot(dynarmic);
+  memory_map *memory = dynarmic->memory;
   char *src = (char *)data;
   u64 vaddr_end = address + size;
   for(u64 vaddr = address & ~DYN_PAGE_MASK; vaddr < vaddr_end; vaddr += DYN_PAGE_SIZE) {
@@ -866,7 +2325,7 @@ JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_mem_
 JNIEXPORT jbyteArray JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_mem_1read
   (JNIEnv *env, jclass clazz, jlong handle, jlong address, jint size) {
   t_dynarmic dynarmic = (t_dynarmic) handle;
-  khash_t(memory) *memory = dynarmic->memory;
+  memory_map *memory = dynarmic->memory;
   jbyteArray bytes = env->NewByteArray(size);
   u64 dest = 0;
   u64 vaddr_end = address + size;
@@ -886,6 +2345,174 @@ JNIEXPORT jbyteArray JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmi
   return bytes;
 }
 
+/*
+ * Class:     com_github_unidbg_arm_backend_dynarmic_Dynarmic
+ * Method:    mem_read_cstring
+ * Signature: (JJI)[B
+ */
+JNIEXPORT jbyteArray JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_mem_1read_1cstring
+  (JNIEnv *env, jclass clazz, jlong handle, jlong address, jint max) {
+  t_dynarmic dynarmic = (t_dynarmic) handle;
+  memory_map *memory = dynarmic->memory;
+  // measure with memchr over the host pages first, consecutive guest pages need not be contiguous on the host
+  u64 length = 0;
+  while(length < (u64) max) {
+    u64 vaddr = address + length;
+    char *addr = get_memory_page(memory, vaddr, dynarmic->num_page_table_entries, dynarmic->page_table);
+    if(addr == NULL) {
+      fprintf(stderr, "mem_read_cstring failed[%s->%s:%d]: vaddr=%p\n", __FILE__, __func__, __LINE__, (void*)vaddr);
+      return NULL;
+    }
+    u64 start = vaddr & DYN_PAGE_MASK;
+    u64 len = std::min<u64>(DYN_PAGE_SIZE - start, (u64) max - length);
+    char *nul = (char *) memchr(&addr[start], 0, len);
+    if(nul) {
+      length += nul - &addr[start];
+      break;
+    }
+    length += len;
+  }
+  jbyteArray bytes = env->NewByteArray((jsize) length);
+  for(u64 dest = 0; dest < length;) {
+    u64 vaddr = address + dest;
+    char *addr = get_memory_page(memory, vaddr, dynarmic->num_page_table_entries, dynarmic->page_table);
+    u64 start = vaddr & DYN_PAGE_MASK;
+    u64 len = std::min<u64>(DYN_PAGE_SIZE - start, length - dest);
+    env->SetByteArrayRegion(bytes, dest, len, (jbyte *)&addr[start]);
+    dest += len;
+  }
+  return bytes;
+}
+
+// copies size bytes between the guest and a host buffer without going through a java array
+static int copy_memory(t_dynarmic dynarmic, u64 address, char *buf, u64 size, bool write) {
+  memory_map *memory = dynarmic->memory;
+  u64 vaddr_end = address + size;
+  for(u64 vaddr = address & ~DYN_PAGE_MASK; vaddr < vaddr_end; vaddr += DYN_PAGE_SIZE) {
+    u64 start = vaddr < address ? address - vaddr : 0;
+    u64 end = vaddr + DYN_PAGE_SIZE <= vaddr_end ? DYN_PAGE_SIZE : (vaddr_end - vaddr);
+    u64 len = end - start;
+    char *addr = get_memory_page(memory, vaddr, dynarmic->num_page_table_entries, dynarmic->page_table);
+    if(addr == NULL) {
+      fprintf(stderr, "%s failed[%s->%s:%d]: vaddr=%p\n", write ? "mem_write" : "mem_read", __FILE__, __func__, __LINE__, (void*)vaddr);
+      return 1;
+    }
+    if(write) {
+      memcpy(&addr[start], buf, len);
+    } else {
+      memcpy(buf, &addr[start], len);
+    }
+    buf += len;
+  }
+  return 0;
+}
+
+static void throw_unmapped(JNIEnv *env, u64 address) {
+  char msg[64];
+  snprintf(msg, sizeof(msg), "unmapped address=0x%llx", (unsigned long long) address);
+  env->ThrowNew(env->FindClass("com/github/unidbg/arm/backend/dynarmic/DynarmicException"), msg);
+}
+
+/*
+ * Class:     com_github_unidbg_arm_backend_dynarmic_Dynarmic
+ * Method:    mem_read_u32
+ * Signature: (JJ)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_mem_1read_1u32
+  (JNIEnv *env, jclass clazz, jlong handle, jlong address) {
+  u32 value = 0;
+  if(copy_memory((t_dynarmic) handle, address, (char *) &value, sizeof(value), false)) {
+    throw_unmapped(env, address);
+  }
+  return (jint) value;
+}
+
+/*
+ * Class:     com_github_unidbg_arm_backend_dynarmic_Dynarmic
+ * Method:    mem_read_u64
+ * Signature: (JJ)J
+ */
+JNIEXPORT jlong JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_mem_1read_1u64
+  (JNIEnv *env, jclass clazz, jlong handle, jlong address) {
+  u64 value = 0;
+  if(copy_memory((t_dynarmic) handle, address, (char *) &value, sizeof(value), false)) {
+    throw_unmapped(env, address);
+  }
+  return (jlong) value;
+}
+
+/*
+ * Class:     com_github_unidbg_arm_backend_dynarmic_Dynarmic
+ * Method:    mem_write_u32
+ * Signature: (JJI)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_mem_1write_1u32
+  (JNIEnv *env, jclass clazz, jlong handle, jlong address, jint value) {
+  t_dynarmic dynarmic = (t_dynarmic) handle;
+  release_memory_snapshot(dynarmic);
+  return copy_memory(dynarmic, address, (char *) &value, sizeof(value), true);
+}
+
+/*
+ * Class:     com_github_unidbg_arm_backend_dynarmic_Dynarmic
+ * Method:    mem_write_u64
+ * Signature: (JJJ)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_mem_1write_1u64
+  (JNIEnv *env, jclass clazz, jlong handle, jlong address, jlong value) {
+  t_dynarmic dynarmic = (t_dynarmic) handle;
+  release_memory_snapshot(dynarmic);
+  return copy_memory(dynarmic, address, (char *) &value, sizeof(value), true);
+}
+
+/*
+ * Class:     com_github_unidbg_arm_backend_dynarmic_Dynarmic
+ * Method:    mem_read_direct
+ * Signature: (JJLjava/nio/ByteBuffer;II)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_mem_1read_1direct
+  (JNIEnv *env, jclass clazz, jlong handle, jlong address, jobject buffer, jint offset, jint size) {
+  char *buf = (char *) env->GetDirectBufferAddress(buffer);
+  if(buf == NULL) {
+    return 2;
+  }
+  return copy_memory((t_dynarmic) handle, address, &buf[offset], size, false);
+}
+
+/*
+ * Class:     com_github_unidbg_arm_backend_dynarmic_Dynarmic
+ * Method:    mem_write_direct
+ * Signature: (JJLjava/nio/ByteBuffer;II)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_mem_1write_1direct
+  (JNIEnv *env, jclass clazz, jlong handle, jlong address, jobject buffer, jint offset, jint size) {
+  char *buf = (char *) env->GetDirectBufferAddress(buffer);
+  if(buf == NULL) {
+    return 2;
+  }
+  t_dynarmic dynarmic = (t_dynarmic) handle;
+  release_memory_snapshot(dynarmic);
+  return copy_memory(dynarmic, address, &buf[offset], size, true);
+}
+
+/*
+ * Class:     com_github_unidbg_arm_backend_dynarmic_Dynarmic
+ * Method:    mem_view
+ * Signature: (JJI)Ljava/nio/ByteBuffer;
+ */
+JNIEXPORT jobject JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_mem_1view
+  (JNIEnv *env, jclass clazz, jlong handle, jlong address, jint size) {
+  t_dynarmic dynarmic = (t_dynarmic) handle;
+  memory_map *memory = dynarmic->memory;
+  std::lock_guard<std::mutex> guard(memory->lock);
+  memory_map::iterator it = find_memory_region(memory, address);
+  if(size <= 0 || it == memory->end() || address + size > it->first + it->second.size) {
+    return NULL; // regions are contiguous on the host, a range spanning two of them may not be
+  }
+  release_memory_snapshot(dynarmic); // the view is writable, a write through it saves an armed page like any other
+  return env->NewDirectByteBuffer(&it->second.addr[address - it->first], size);
+}
+
 /*
  * Class:     com_github_unidbg_arm_backend_dynarmic_Dynarmic
  * Method:    reg_read_pc64
@@ -895,7 +2522,7 @@ JNIEXPORT jlong JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_reg
   (JNIEnv *env, jclass clazz, jlong handle) {
   t_dynarmic dynarmic = (t_dynarmic) handle;
   if(dynarmic->is64Bit) {
-    Dynarmic::A64::Jit *jit = dynarmic->jit64;
+    Dynarmic::A64::Jit *jit = current_jit64(dynarmic);
     if(jit) {
       return jit->GetPC();
     } else {
@@ -917,7 +2544,7 @@ JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_reg_
   (JNIEnv *env, jclass clazz, jlong handle, jlong value) {
   t_dynarmic dynarmic = (t_dynarmic) handle;
   if(dynarmic->is64Bit) {
-    Dynarmic::A64::Jit *jit = dynarmic->jit64;
+    Dynarmic::A64::Jit *jit = current_jit64(dynarmic);
     if(jit) {
       jit->SetSP(value);
     } else {
@@ -938,7 +2565,7 @@ JNIEXPORT jlong JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_reg
   (JNIEnv *env, jclass clazz, jlong handle) {
   t_dynarmic dynarmic = (t_dynarmic) handle;
   if(dynarmic->is64Bit) {
-    Dynarmic::A64::Jit *jit = dynarmic->jit64;
+    Dynarmic::A64::Jit *jit = current_jit64(dynarmic);
     if(jit) {
       return jit->GetSP();
     } else {
@@ -960,7 +2587,7 @@ JNIEXPORT jlong JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_reg
   (JNIEnv *env, jclass clazz, jlong handle) {
   t_dynarmic dynarmic = (t_dynarmic) handle;
   if(dynarmic->is64Bit) {
-    Dynarmic::A64::Jit *jit = dynarmic->jit64;
+    Dynarmic::A64::Jit *jit = current_jit64(dynarmic);
     if(jit) {
       return jit->GetPstate();
     } else {
@@ -982,7 +2609,7 @@ JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_reg_
   (JNIEnv *env, jclass clazz, jlong handle, jlong value) {
   t_dynarmic dynarmic = (t_dynarmic) handle;
   if(dynarmic->is64Bit) {
-    Dynarmic::A64::Jit *jit = dynarmic->jit64;
+    Dynarmic::A64::Jit *jit = current_jit64(dynarmic);
     if(jit) {
       jit->SetPstate(value);
     } else {
@@ -1003,7 +2630,7 @@ JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_reg_
   (JNIEnv *env, jclass clazz, jlong handle, jlong value) {
   t_dynarmic dynarmic = (t_dynarmic) handle;
   if(dynarmic->is64Bit) {
-    DynarmicCallbacks64 *cb = dynarmic->cb64;
+    DynarmicCallbacks64 *cb = current_cb64(dynarmic);
     if(cb) {
       cb->tpidr_el0 = value;
     } else {
@@ -1024,7 +2651,7 @@ JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_reg_
   (JNIEnv *env, jclass clazz, jlong handle, jint index, jbyteArray vector) {
   t_dynarmic dynarmic = (t_dynarmic) handle;
   if(dynarmic->is64Bit) {
-    Dynarmic::A64::Jit *jit = dynarmic->jit64;
+    Dynarmic::A64::Jit *jit = current_jit64(dynarmic);
     if(jit) {
       jbyte *bytes = env->GetByteArrayElements(vector, NULL);
       u64 array[2];
@@ -1049,7 +2676,7 @@ JNIEXPORT jbyteArray JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmi
   (JNIEnv *env, jclass clazz, jlong handle, jint index) {
   t_dynarmic dynarmic = (t_dynarmic) handle;
   if(dynarmic->is64Bit) {
-    Dynarmic::A64::Jit *jit = dynarmic->jit64;
+    Dynarmic::A64::Jit *jit = current_jit64(dynarmic);
     if(jit) {
       Dynarmic::Vector array = jit->GetVector(index);
       jbyteArray bytes = env->NewByteArray(16);
@@ -1072,69 +2699,215 @@ JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_reg_
   (JNIEnv *env, jclass clazz, jlong handle, jlong value) {
   t_dynarmic dynarmic = (t_dynarmic) handle;
   if(dynarmic->is64Bit) {
-    DynarmicCallbacks64 *cb = dynarmic->cb64;
+    DynarmicCallbacks64 *cb = current_cb64(dynarmic);
     if(cb) {
       cb->tpidrro_el0 = value;
     } else {
       return 1;
     }
   } else {
-    return -1;
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * Class:     com_github_unidbg_arm_backend_dynarmic_Dynarmic
+ * Method:    reg_write
+ * Signature: (JIJ)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_reg_1write
+  (JNIEnv *env, jclass clazz, jlong handle, jint index, jlong value) {
+  t_dynarmic dynarmic = (t_dynarmic) handle;
+  if(dynarmic->is64Bit) {
+    Dynarmic::A64::Jit *jit = current_jit64(dynarmic);
+    if(jit) {
+      jit->SetRegister(index, value);
+    } else {
+      return 1;
+    }
+  } else {
+    Dynarmic::A32::Jit *jit = current_jit32(dynarmic);
+    if(jit) {
+      jit->Regs()[index] = (u32) value;
+    } else {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/*
+ * Class:     com_github_unidbg_arm_backend_dynarmic_Dynarmic
+ * Method:    reg_read
+ * Signature: (JI)J
+ */
+JNIEXPORT jlong JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_reg_1read
+  (JNIEnv *env, jclass clazz, jlong handle, jint index) {
+  t_dynarmic dynarmic = (t_dynarmic) handle;
+  if(dynarmic->is64Bit) {
+    Dynarmic::A64::Jit *jit = current_jit64(dynarmic);
+    if(jit) {
+      return jit->GetRegister(index);
+    } else {
+      abort();
+      return -1;
+    }
+  } else {
+    Dynarmic::A32::Jit *jit = current_jit32(dynarmic);
+    if(jit) {
+      return jit->Regs()[index];
+    } else {
+      abort();
+      return -1;
+    }
+  }
+}
+
+static bool read_register(t_dynarmic dynarmic, int index, u64 *value) {
+  if(dynarmic->is64Bit) {
+    DynarmicCallbacks64 *cb = current_cb64(dynarmic);
+    Dynarmic::A64::Jit *jit = current_jit64(dynarmic);
+    if(index >= 0 && index <= 30) {
+      *value = jit->GetRegister(index);
+      return true;
+    }
+    switch(index) {
+      case DYN_REG64_SP:
+        *value = jit->GetSP();
+        return true;
+      case DYN_REG64_PC:
+        *value = jit->GetPC();
+        return true;
+      case DYN_REG64_NZCV:
+        *value = jit->GetPstate();
+        return true;
+      case DYN_REG64_TPIDR_EL0:
+        *value = cb->tpidr_el0;
+        return true;
+      case DYN_REG64_TPIDRRO_EL0:
+        *value = cb->tpidrro_el0;
+        return true;
+    }
+  } else {
+    DynarmicCallbacks32 *cb = current_cb32(dynarmic);
+    Dynarmic::A32::Jit *jit = current_jit32(dynarmic);
+    if(index >= 0 && index <= 15) {
+      *value = jit->Regs()[index];
+      return true;
+    }
+    switch(index) {
+      case DYN_REG32_CPSR:
+        *value = jit->Cpsr();
+        return true;
+      case DYN_REG32_C13_C0_3:
+        *value = cb->cp15.get()->uro;
+        return true;
+    }
+  }
+  return false;
+}
+
+static bool write_register(t_dynarmic dynarmic, int index, u64 value) {
+  if(dynarmic->is64Bit) {
+    DynarmicCallbacks64 *cb = current_cb64(dynarmic);
+    Dynarmic::A64::Jit *jit = current_jit64(dynarmic);
+    if(index >= 0 && index <= 30) {
+      jit->SetRegister(index, value);
+      return true;
+    }
+    switch(index) {
+      case DYN_REG64_SP:
+        jit->SetSP(value);
+        return true;
+      case DYN_REG64_PC:
+        jit->SetPC(value);
+        return true;
+      case DYN_REG64_NZCV:
+        jit->SetPstate(value);
+        return true;
+      case DYN_REG64_TPIDR_EL0:
+        cb->tpidr_el0 = value;
+        return true;
+      case DYN_REG64_TPIDRRO_EL0:
+        cb->tpidrro_el0 = value;
+        return true;
+    }
+  } else {
+    DynarmicCallbacks32 *cb = current_cb32(dynarmic);
+    Dynarmic::A32::Jit *jit = current_jit32(dynarmic);
+    if(index >= 0 && index <= 15) {
+      jit->Regs()[index] = (u32) value;
+      return true;
+    }
+    switch(index) {
+      case DYN_REG32_CPSR:
+        jit->SetCpsr((u32) value);
+        return true;
+      case DYN_REG32_C13_C0_3:
+        cb->cp15.get()->uro = (u32) value;
+        return true;
+    }
   }
-  return 0;
+  return false;
 }
 
+#define REG_BATCH_SIZE 32 // registers copied from and to java per round
+
 /*
  * Class:     com_github_unidbg_arm_backend_dynarmic_Dynarmic
- * Method:    reg_write
- * Signature: (JIJ)I
+ * Method:    reg_read_batch
+ * Signature: (J[I[J)I
  */
-JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_reg_1write
-  (JNIEnv *env, jclass clazz, jlong handle, jint index, jlong value) {
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_reg_1read_1batch
+  (JNIEnv *env, jclass clazz, jlong handle, jintArray indices, jlongArray values) {
   t_dynarmic dynarmic = (t_dynarmic) handle;
-  if(dynarmic->is64Bit) {
-    Dynarmic::A64::Jit *jit = dynarmic->jit64;
-    if(jit) {
-      jit->SetRegister(index, value);
-    } else {
-      return 1;
-    }
-  } else {
-    Dynarmic::A32::Jit *jit = dynarmic->jit32;
-    if(jit) {
-      jit->Regs()[index] = (u32) value;
-    } else {
-      return 1;
+  if(dynarmic->is64Bit ? current_jit64(dynarmic) == NULL : current_jit32(dynarmic) == NULL) {
+    return 1;
+  }
+  jint ids[REG_BATCH_SIZE];
+  jlong vals[REG_BATCH_SIZE];
+  jsize count = env->GetArrayLength(indices);
+  for(jsize off = 0; off < count; off += REG_BATCH_SIZE) {
+    jsize n = std::min(count - off, (jsize) REG_BATCH_SIZE);
+    env->GetIntArrayRegion(indices, off, n, ids);
+    for(jsize i = 0; i < n; i++) {
+      u64 value = 0;
+      if(!read_register(dynarmic, ids[i], &value)) {
+        return -1;
+      }
+      vals[i] = (jlong) value;
     }
+    env->SetLongArrayRegion(values, off, n, vals);
   }
   return 0;
 }
 
 /*
  * Class:     com_github_unidbg_arm_backend_dynarmic_Dynarmic
- * Method:    reg_read
- * Signature: (JI)J
+ * Method:    reg_write_batch
+ * Signature: (J[I[J)I
  */
-JNIEXPORT jlong JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_reg_1read
-  (JNIEnv *env, jclass clazz, jlong handle, jint index) {
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_reg_1write_1batch
+  (JNIEnv *env, jclass clazz, jlong handle, jintArray indices, jlongArray values) {
   t_dynarmic dynarmic = (t_dynarmic) handle;
-  if(dynarmic->is64Bit) {
-    Dynarmic::A64::Jit *jit = dynarmic->jit64;
-    if(jit) {
-      return jit->GetRegister(index);
-    } else {
-      abort();
-      return -1;
-    }
-  } else {
-    Dynarmic::A32::Jit *jit = dynarmic->jit32;
-    if(jit) {
-      return jit->Regs()[index];
-    } else {
-      abort();
-      return -1;
+  if(dynarmic->is64Bit ? current_jit64(dynarmic) == NULL : current_jit32(dynarmic) == NULL) {
+    return 1;
+  }
+  jint ids[REG_BATCH_SIZE];
+  jlong vals[REG_BATCH_SIZE];
+  jsize count = env->GetArrayLength(indices);
+  for(jsize off = 0; off < count; off += REG_BATCH_SIZE) {
+    jsize n = std::min(count - off, (jsize) REG_BATCH_SIZE);
+    env->GetIntArrayRegion(indices, off, n, ids);
+    env->GetLongArrayRegion(values, off, n, vals);
+    for(jsize i = 0; i < n; i++) {
+      if(!write_register(dynarmic, ids[i], (u64) vals[i])) {
+        return -1;
+      }
     }
   }
+  return 0;
 }
 
 /*
@@ -1149,7 +2922,7 @@ JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_reg_
     abort();
     return 1;
   } else {
-    Dynarmic::A32::Jit *jit = dynarmic->jit32;
+    Dynarmic::A32::Jit *jit = current_jit32(dynarmic);
     if(jit) {
       return jit->Cpsr();
     } else {
@@ -1171,7 +2944,7 @@ JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_reg_
     abort();
     return 1;
   } else {
-    Dynarmic::A32::Jit *jit = dynarmic->jit32;
+    Dynarmic::A32::Jit *jit = current_jit32(dynarmic);
     if(jit) {
       jit->SetCpsr(value);
       return 0;
@@ -1194,7 +2967,7 @@ JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_reg_
     abort();
     return 1;
   } else {
-    DynarmicCallbacks32 *cb32 = dynarmic->cb32;
+    DynarmicCallbacks32 *cb32 = current_cb32(dynarmic);
     if(cb32) {
       cb32->cp15.get()->uro = value;
       return 0;
@@ -1208,22 +2981,42 @@ JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_reg_
 /*
  * Class:     com_github_unidbg_arm_backend_dynarmic_Dynarmic
  * Method:    emu_start
- * Signature: (JJ)I
+ * Signature: (JJJ)I
  */
 JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_emu_1start
-  (JNIEnv *env, jclass clazz, jlong handle, jlong pc) {
+  (JNIEnv *env, jclass clazz, jlong handle, jlong pc, jlong until) {
   t_dynarmic dynarmic = (t_dynarmic) handle;
+  release_memory_snapshot(dynarmic);
+  if(!dynarmic->pending_code->empty()) {
+    validate_pooled_code(dynarmic);
+  }
+  bool exhausted = false;
   if(dynarmic->is64Bit) {
-    Dynarmic::A64::Jit *jit = dynarmic->jit64;
+    Dynarmic::A64::Jit *jit = current_jit64(dynarmic);
     if(jit) {
       Dynarmic::A64::Jit *cpu = jit;
+      DynarmicCallbacks64 *cb = current_cb64(dynarmic);
+      JNIEnv *prev = cb->env; // emu_start may nest from a callback
+      u64 prev_until = cb->until;
+      bool prev_stepping = cb->stepping;
+      bool prev_stopped = cb->stopped;
+      u64 prev_ticks = cb->ticks_remaining;
+      cb->env = env;
+      cb->until = until;
+      cb->ticks_remaining = dynarmic->emu_count ? dynarmic->emu_count : DYN_UNLIMITED_TICKS;
       cpu->SetPC(pc);
-      cpu->Run();
+      cb->Run();
+      exhausted = dynarmic->emu_count && !cb->stopped && cb->ticks_remaining == 0;
+      cb->env = prev;
+      cb->until = prev_until;
+      cb->stepping = prev_stepping;
+      cb->stopped = prev_stopped;
+      cb->ticks_remaining = prev_ticks;
     } else {
       return 1;
     }
   } else {
-    Dynarmic::A32::Jit *jit = dynarmic->jit32;
+    Dynarmic::A32::Jit *jit = current_jit32(dynarmic);
     if(jit) {
       Dynarmic::A32::Jit *cpu = jit;
       bool thumb = pc & 1;
@@ -1233,12 +3026,27 @@ JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_emu_
         cpu->SetCpsr(0x000001d0); // Arm user mode
       }
       cpu->Regs()[15] = (u32) (pc & ~1);
-      cpu->Run();
+      DynarmicCallbacks32 *cb = current_cb32(dynarmic);
+      JNIEnv *prev = cb->env; // emu_start may nest from a callback
+      u64 prev_until = cb->until;
+      bool prev_stepping = cb->stepping;
+      bool prev_stopped = cb->stopped;
+      u64 prev_ticks = cb->ticks_remaining;
+      cb->env = env;
+      cb->until = until;
+      cb->ticks_remaining = dynarmic->emu_count ? dynarmic->emu_count : DYN_UNLIMITED_TICKS;
+      cb->Run();
+      exhausted = dynarmic->emu_count && !cb->stopped && cb->ticks_remaining == 0;
+      cb->env = prev;
+      cb->until = prev_until;
+      cb->stepping = prev_stepping;
+      cb->stopped = prev_stopped;
+      cb->ticks_remaining = prev_ticks;
     } else {
       return 1;
     }
   }
-  return 0;
+  return exhausted ? DYN_EMU_COUNT_EXHAUSTED : 0;
 }
 
 /*
@@ -1250,18 +3058,16 @@ JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_emu_
   (JNIEnv *env, jclass clazz, jlong handle) {
   t_dynarmic dynarmic = (t_dynarmic) handle;
   if(dynarmic->is64Bit) {
-    Dynarmic::A64::Jit *jit = dynarmic->jit64;
+    Dynarmic::A64::Jit *jit = current_jit64(dynarmic);
     if(jit) {
-      Dynarmic::A64::Jit *cpu = jit;
-      cpu->HaltExecution();
+      current_cb64(dynarmic)->Stop();
     } else {
       return 1;
     }
   } else {
-    Dynarmic::A32::Jit *jit = dynarmic->jit32;
+    Dynarmic::A32::Jit *jit = current_jit32(dynarmic);
     if(jit) {
-      Dynarmic::A32::Jit *cpu = jit;
-      cpu->HaltExecution();
+      current_cb32(dynarmic)->Stop();
     } else {
       return 1;
     }
@@ -1269,6 +3075,37 @@ JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_emu_
   return 0;
 }
 
+/*
+ * Class:     com_github_unidbg_arm_backend_dynarmic_Dynarmic
+ * Method:    set_emu_count
+ * Signature: (JJ)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_set_1emu_1count
+  (JNIEnv *env, jclass clazz, jlong handle, jlong emu_count) {
+  t_dynarmic dynarmic = (t_dynarmic) handle;
+  dynarmic->emu_count = emu_count;
+  return 0;
+}
+
+/*
+ * Class:     com_github_unidbg_arm_backend_dynarmic_Dynarmic
+ * Method:    set_time_source
+ * Signature: (JIJ)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_set_1time_1source
+  (JNIEnv *env, jclass clazz, jlong handle, jint source, jlong instructions_per_second) {
+  t_dynarmic dynarmic = (t_dynarmic) handle;
+  if((source != DYN_TIME_SOURCE_HOST && source != DYN_TIME_SOURCE_VIRTUAL) || instructions_per_second <= 0) {
+    return -1;
+  }
+  t_clock clock = dynarmic->clock;
+  // a vCPU reading the clock meanwhile may pair the old count with the new speed, never with a zero one
+  clock->instructions_per_second.store(instructions_per_second, std::memory_order_relaxed);
+  clock->instructions.store(0, std::memory_order_relaxed); // a virtual clock starts from zero every time it is set
+  clock->source.store(source, std::memory_order_release);
+  return 0;
+}
+
 /*
  * Class:     com_github_unidbg_arm_backend_dynarmic_Dynarmic
  * Method:    context_alloc
@@ -1293,32 +3130,7 @@ JNIEXPORT jlong JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_con
  */
 JNIEXPORT void JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_context_1restore
   (JNIEnv *env, jclass clazz, jlong handle, jlong context) {
-  t_dynarmic dynarmic = (t_dynarmic) handle;
-  if(dynarmic->is64Bit) {
-    Dynarmic::A64::Jit *jit = dynarmic->jit64;
-    t_context64 ctx = (t_context64) context;
-    jit->SetSP(ctx->sp);
-    jit->SetPC(ctx->pc);
-    jit->SetRegisters(ctx->registers);
-    jit->SetVectors(ctx->vectors);
-    jit->SetFpcr(ctx->fpcr);
-    jit->SetFpsr(ctx->fpsr);
-    jit->SetPstate(ctx->pstate);
-
-    DynarmicCallbacks64 *cb = dynarmic->cb64;
-    cb->tpidr_el0 = ctx->tpidr_el0;
-    cb->tpidrro_el0 = ctx->tpidrro_el0;
-  } else {
-    Dynarmic::A32::Jit *jit = dynarmic->jit32;
-    t_context32 ctx = (t_context32) context;
-    jit->Regs() = ctx->regs;
-    jit->ExtRegs() = ctx->extRegs;
-    jit->SetCpsr(ctx->cpsr);
-    jit->SetFpscr(ctx->fpscr);
-
-    DynarmicCallbacks32 *cb = dynarmic->cb32;
-    cb->cp15.get()->uro = ctx->uro;
-  }
+  restore_context((t_dynarmic) handle, (void *) context);
 }
 
 /*
@@ -1328,32 +3140,7 @@ JNIEXPORT void JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_cont
  */
 JNIEXPORT void JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_context_1save
   (JNIEnv *env, jclass clazz, jlong handle, jlong context) {
-  t_dynarmic dynarmic = (t_dynarmic) handle;
-  if(dynarmic->is64Bit) {
-    Dynarmic::A64::Jit *jit = dynarmic->jit64;
-    t_context64 ctx = (t_context64) context;
-    ctx->sp = jit->GetSP();
-    ctx->pc = jit->GetPC();
-    ctx->registers = jit->GetRegisters();
-    ctx->vectors = jit->GetVectors();
-    ctx->fpcr = jit->GetFpcr();
-    ctx->fpsr = jit->GetFpsr();
-    ctx->pstate = jit->GetPstate();
-
-    DynarmicCallbacks64 *cb = dynarmic->cb64;
-    ctx->tpidr_el0 = cb->tpidr_el0;
-    ctx->tpidrro_el0 = cb->tpidrro_el0;
-  } else {
-    Dynarmic::A32::Jit *jit = dynarmic->jit32;
-    t_context32 ctx = (t_context32) context;
-    ctx->regs = jit->Regs();
-    ctx->extRegs = jit->ExtRegs();
-    ctx->cpsr = jit->Cpsr();
-    ctx->fpscr = jit->Fpscr();
-
-    DynarmicCallbacks32 *cb = dynarmic->cb32;
-    ctx->uro = cb->cp15.get()->uro;
-  }
+  save_context((t_dynarmic) handle, (void *) context);
 }
 
 /*
@@ -1367,6 +3154,303 @@ JNIEXPORT void JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_free
   free(ctx);
 }
 
+/*
+ * Class:     com_github_unidbg_arm_backend_dynarmic_Dynarmic
+ * Method:    checkpoint
+ * Signature: (J)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_checkpoint
+  (JNIEnv *env, jclass clazz, jlong handle) {
+  t_dynarmic dynarmic = (t_dynarmic) handle;
+  memory_map *memory = dynarmic->memory;
+  std::lock_guard<std::mutex> guard(memory->lock);
+  t_checkpoint checkpoint = dynarmic->checkpoint;
+  {
+    std::lock_guard<std::mutex> guard(checkpoints_lock);
+    if(!fault_handler_installed) {
+      install_fault_handler();
+      fault_handler_installed = true;
+    }
+  }
+  std::lock_guard<std::mutex> checkpoint_guard(checkpoint->lock);
+  release_checkpoint_pages(checkpoint);
+  checkpoint->armed.clear();
+  // read-only pages too: host writes, a later mem_protect and guest stores, which dynarmic does not check, all change them
+  for(memory_map::iterator it = memory->begin(); it != memory->end(); ++it) {
+    for(u64 off = 0; off < it->second.size; off += DYN_PAGE_SIZE) {
+      checkpoint->armed[&it->second.addr[off]] = it->first + off;
+    }
+  }
+  if(dynarmic->is64Bit) {
+    save_context(dynarmic, &checkpoint->ctx64);
+  } else {
+    save_context(dynarmic, &checkpoint->ctx32);
+  }
+  checkpoint->active.store(true, std::memory_order_release);
+  for(memory_map::iterator it = memory->begin(); it != memory->end(); ++it) {
+    protect_armed_pages(checkpoint, it->second.addr, it->second.size);
+  }
+  return 0;
+}
+
+/*
+ * Class:     com_github_unidbg_arm_backend_dynarmic_Dynarmic
+ * Method:    restore_checkpoint
+ * Signature: (J)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_restore_1checkpoint
+  (JNIEnv *env, jclass clazz, jlong handle) {
+  t_dynarmic dynarmic = (t_dynarmic) handle;
+  memory_map *memory = dynarmic->memory;
+  std::lock_guard<std::mutex> guard(memory->lock);
+  t_checkpoint checkpoint = dynarmic->checkpoint;
+  if(!checkpoint->active.load(std::memory_order_acquire)) {
+    return 1;
+  }
+  release_memory_snapshot(dynarmic);
+  std::vector<u64> restored;
+  {
+    std::lock_guard<std::mutex> checkpoint_guard(checkpoint->lock);
+    for(std::map<u64, char *>::iterator it = checkpoint->pages.begin(); it != checkpoint->pages.end(); ++it) {
+      u64 page = it->first;
+      memory_map::iterator region = find_memory_region(memory, page);
+      if(region != memory->end()) {
+        char *addr = &region->second.addr[page - region->first];
+        memcpy(addr, it->second, DYN_PAGE_SIZE); // written since, so its host page is writable
+        checkpoint->armed[addr] = page;
+        restored.push_back(page);
+      }
+      free(it->second);
+    }
+    checkpoint->pages.clear();
+    for(std::vector<u64>::iterator it = restored.begin(); it != restored.end(); ++it) {
+      memory_map::iterator region = find_memory_region(memory, *it);
+      protect_armed_pages(checkpoint, &region->second.addr[*it - region->first], DYN_PAGE_SIZE);
+    }
+  }
+  // blocks compiled from the written content must not run the restored one
+  for(std::vector<u64>::iterator it = restored.begin(); it != restored.end(); ++it) {
+    if(is_code_page(dynarmic, *it)) {
+      invalidate_code(dynarmic, *it, *it + DYN_PAGE_SIZE);
+    }
+  }
+  dynarmic->monitor->Clear();
+  if(dynarmic->is64Bit) {
+    restore_context(dynarmic, &checkpoint->ctx64);
+  } else {
+    restore_context(dynarmic, &checkpoint->ctx32);
+  }
+  return 0;
+}
+
+/*
+ * Class:     com_github_unidbg_arm_backend_dynarmic_Dynarmic
+ * Method:    mem_map_fork
+ * Signature: (JJJJI)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_mem_1map_1fork
+  (JNIEnv *env, jclass clazz, jlong handle, jlong template_handle, jlong address, jlong size, jint perms) {
+  if(address & DYN_PAGE_MASK) {
+    return 1;
+  }
+  if(size == 0 || (size & DYN_PAGE_MASK)) {
+    return 2;
+  }
+  t_dynarmic dynarmic = (t_dynarmic) handle;
+  t_dynarmic source = (t_dynarmic) template_handle;
+  if(source == dynarmic || source->is64Bit != dynarmic->is64Bit) {
+    return 6;
+  }
+  u64 vaddr_end = address + size;
+  memory_map *source_memory = source->memory;
+  std::lock_guard<std::mutex> source_guard(source_memory->lock);
+  if(!is_range_mapped(source_memory, address, vaddr_end)) {
+    fprintf(stderr, "mem_map_fork failed[%s->%s:%d]: template address=%p, size=0x%llx\n", __FILE__, __func__, __LINE__, (void*)address, (unsigned long long)size);
+    return 3;
+  }
+  memory_map *memory = dynarmic->memory;
+  std::lock_guard<std::mutex> guard(memory->lock);
+  if(!is_range_free(memory, address, vaddr_end)) {
+    fprintf(stderr, "mem_map_fork failed[%s->%s:%d]: address=%p, size=0x%llx\n", __FILE__, __func__, __LINE__, (void*)address, (unsigned long long)size);
+    return 3;
+  }
+  if(source->snapshot == NULL) {
+    source->snapshot = take_memory_snapshot(source); // kept by the template until its memory changes, for the next clone
+  }
+  // one block per template region: the clone maps slices of the snapshot file, not one contiguous range
+  for(memory_map::iterator it = find_memory_region(source_memory, address); it != source_memory->end() && it->first < vaddr_end; ++it) {
+    u64 begin = std::max<u64>(it->first, address);
+    u64 end = std::min<u64>(it->first + it->second.size, vaddr_end);
+    char *addr = map_clone_region(source->snapshot, it->second, begin - it->first, end - begin);
+    if(addr == NULL) {
+      fprintf(stderr, "mem_map_fork failed[%s->%s:%d]: vaddr=%p, size=0x%llx, errno=%d, msg=%s\n", __FILE__, __func__, __LINE__, (void*)begin, (unsigned long long)(end - begin), errno, strerror(errno));
+      return 4;
+    }
+    map_memory_block(dynarmic, begin, end - begin, perms, addr);
+  }
+  return 0;
+}
+
+/*
+ * Class:     com_github_unidbg_arm_backend_dynarmic_Dynarmic
+ * Method:    set_hook_ranges
+ * Signature: (JI[J)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_set_1hook_1ranges
+  (JNIEnv *env, jclass clazz, jlong handle, jint type, jlongArray ranges) {
+  if(type < 0 || type >= DYN_HOOK_TYPES) {
+    return 1;
+  }
+  t_dynarmic dynarmic = (t_dynarmic) handle;
+  hook_ranges hooks;
+  jsize size = env->GetArrayLength(ranges);
+  jlong *elements = env->GetLongArrayElements(ranges, NULL);
+  for(jsize i = 0; i + 1 < size; i += 2) {
+    hooks.push_back(std::make_pair((u64) elements[i], (u64) elements[i + 1]));
+  }
+  env->ReleaseLongArrayElements(ranges, elements, JNI_ABORT);
+  {
+    std::unique_lock<std::shared_mutex> guard(dynarmic->hooks->lock);
+    dynarmic->hooks->ranges[type].swap(hooks);
+  }
+  if(type == DYN_HOOK_CODE || type == DYN_HOOK_BLOCK) {
+    flush_code(dynarmic, true, 0, 0); // recompile with the new trap instructions
+  } else {
+    memory_map *memory = dynarmic->memory;
+    std::lock_guard<std::mutex> guard(memory->lock);
+    for(memory_map::iterator it = memory->begin(); it != memory->end(); ++it) {
+      set_page_table(dynarmic, it->first, it->second.size, it->second.addr);
+    }
+  }
+  return 0;
+}
+
+/*
+ * Class:     com_github_unidbg_arm_backend_dynarmic_Dynarmic
+ * Method:    register_native_syscall
+ * Signature: (JIIJJ)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_register_1native_1syscall
+  (JNIEnv *env, jclass clazz, jlong handle, jint NR, jint type, jlong arg0, jlong arg1) {
+  t_dynarmic dynarmic = (t_dynarmic) handle;
+  struct native_syscall syscall;
+  syscall.type = type;
+  syscall.value = 0;
+  syscall.realtime_offset = 0;
+  syscall.monotonic_offset = 0;
+  switch (type) {
+    case NATIVE_SYSCALL_CONSTANT:
+      syscall.value = arg0;
+      break;
+    case NATIVE_SYSCALL_CLOCK_GETTIME:
+    case NATIVE_SYSCALL_GETTIMEOFDAY:
+      // arg0 and arg1 are the emulated realtime and monotonic clocks right now
+      syscall.realtime_offset = arg0 - host_clock_nanos(true);
+      syscall.monotonic_offset = arg1 - host_clock_nanos(false);
+      break;
+    default:
+      return 1;
+  }
+  int ret;
+  khiter_t k = kh_put(syscall, dynarmic->syscalls, NR, &ret);
+  kh_value(dynarmic->syscalls, k) = syscall;
+  return 0;
+}
+
+/*
+ * Class:     com_github_unidbg_arm_backend_dynarmic_Dynarmic
+ * Method:    unregister_native_syscall
+ * Signature: (JI)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_unregister_1native_1syscall
+  (JNIEnv *env, jclass clazz, jlong handle, jint NR) {
+  t_dynarmic dynarmic = (t_dynarmic) handle;
+  khiter_t k = kh_get(syscall, dynarmic->syscalls, NR);
+  if(k == kh_end(dynarmic->syscalls)) {
+    return 1;
+  }
+  kh_del(syscall, dynarmic->syscalls, k);
+  return 0;
+}
+
+// vcpu_lock must be held, a handle is not dereferenced before it is found: it may have been freed already
+static bool has_vcpu(t_dynarmic dynarmic, t_vcpu vcpu) {
+  std::vector<t_vcpu> &vcpus = *dynarmic->vcpus;
+  return std::find(vcpus.begin(), vcpus.end(), vcpu) != vcpus.end();
+}
+
+/*
+ * Class:     com_github_unidbg_arm_backend_dynarmic_Dynarmic
+ * Method:    new_vcpu
+ * Signature: (J)J
+ */
+JNIEXPORT jlong JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_new_1vcpu
+  (JNIEnv *env, jclass clazz, jlong handle) {
+  t_dynarmic dynarmic = (t_dynarmic) handle;
+  std::lock_guard<std::mutex> guard(*dynarmic->vcpu_lock);
+  std::vector<t_vcpu> &vcpus = *dynarmic->vcpus;
+  for(size_t processor_id = 1; processor_id < vcpus.size(); processor_id++) {
+    if(vcpus[processor_id]) {
+      continue;
+    }
+    t_vcpu vcpu = (t_vcpu) calloc(1, sizeof(struct vcpu));
+    if(vcpu == NULL) {
+      fprintf(stderr, "calloc vcpu failed: size=%lu\n", sizeof(struct vcpu));
+      abort();
+      return 0;
+    }
+    vcpu->dynarmic = dynarmic;
+    vcpu->processor_id = processor_id;
+    if(dynarmic->is64Bit) {
+      create_cpu64(dynarmic, processor_id, &vcpu->cb64, &vcpu->jit64);
+      vcpu->cb64->callback = dynarmic->cb64->callback;
+    } else {
+      create_cpu32(dynarmic, processor_id, &vcpu->cb32, &vcpu->jit32);
+      vcpu->cb32->callback = dynarmic->cb32->callback;
+    }
+    vcpus[processor_id] = vcpu;
+    return (jlong) vcpu;
+  }
+  return 0; // all processor ids in use
+}
+
+/*
+ * Class:     com_github_unidbg_arm_backend_dynarmic_Dynarmic
+ * Method:    bind_vcpu
+ * Signature: (JJ)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_bind_1vcpu
+  (JNIEnv *env, jclass clazz, jlong handle, jlong vcpu_handle) {
+  t_dynarmic dynarmic = (t_dynarmic) handle;
+  t_vcpu vcpu = (t_vcpu) vcpu_handle;
+  if(vcpu) {
+    std::lock_guard<std::mutex> guard(*dynarmic->vcpu_lock);
+    if(!has_vcpu(dynarmic, vcpu)) {
+      return 1;
+    }
+  }
+  current_vcpu = vcpu;
+  return 0;
+}
+
+/*
+ * Class:     com_github_unidbg_arm_backend_dynarmic_Dynarmic
+ * Method:    free_vcpu
+ * Signature: (JJ)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_dynarmic_Dynarmic_free_1vcpu
+  (JNIEnv *env, jclass clazz, jlong handle, jlong vcpu_handle) {
+  t_dynarmic dynarmic = (t_dynarmic) handle;
+  t_vcpu vcpu = (t_vcpu) vcpu_handle;
+  std::lock_guard<std::mutex> guard(*dynarmic->vcpu_lock);
+  if(vcpu == NULL || !has_vcpu(dynarmic, vcpu)) {
+    return 1;
+  }
+  (*dynarmic->vcpus)[vcpu->processor_id] = NULL;
+  destroy_vcpu(vcpu);
+  return 0;
+}
+
 JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM *vm, void *reserved) {
   JNIEnv *env;
   if (JNI_OK != vm->GetEnv((void **)&env, JNI_VERSION_1_6)) {
@@ -1381,7 +3465,17 @@ JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM *vm, void *reserved) {
   handleExceptionRaised = env->GetMethodID(cDynarmicCallback, "handleExceptionRaised", "(JI)V");
   handleMemoryReadFailed = env->GetMethodID(cDynarmicCallback, "handleMemoryReadFailed", "(JI)V");
   handleMemoryWriteFailed = env->GetMethodID(cDynarmicCallback, "handleMemoryWriteFailed", "(JI)V");
+  handleCodeHook = env->GetMethodID(cDynarmicCallback, "handleCodeHook", "(JI)V");
+  handleBlockHook = env->GetMethodID(cDynarmicCallback, "handleBlockHook", "(JI)V");
+  handleMemoryRead = env->GetMethodID(cDynarmicCallback, "handleMemoryRead", "(JI)V");
+  handleMemoryWrite = env->GetMethodID(cDynarmicCallback, "handleMemoryWrite", "(JIJ)V");
   cachedJVM = vm;
+#if !defined(_WIN32) && !defined(_WIN64)
+  long page_size = sysconf(_SC_PAGESIZE);
+  if(page_size > (long) DYN_PAGE_SIZE) {
+    host_page_size = (size_t) page_size; // 16k on apple silicon and some arm64 linux kernels
+  }
+#endif
 
   return JNI_VERSION_1_6;
 }
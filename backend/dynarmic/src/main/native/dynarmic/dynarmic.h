@@ -1,3 +1,9 @@
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #ifdef DYNARMIC_MASTER
@@ -22,18 +28,89 @@
 #include "khash.h"
 #include "com_github_unidbg_arm_backend_dynarmic_Dynarmic.h"
 
-#define PAGE_TABLE_ADDRESS_SPACE_BITS 36
+#define PAGE_TABLE_ADDRESS_SPACE_BITS 36 // guest pages above it are resolved through the locked memory_map
 #define DYN_PAGE_BITS 12 // 4k
 #define DYN_PAGE_SIZE (1ULL << DYN_PAGE_BITS)
 #define DYN_PAGE_MASK (DYN_PAGE_SIZE-1)
 #define UC_PROT_WRITE 2
 
-typedef struct memory_page {
-  void *addr;
+// one host mapping per guest mem_map call
+typedef struct memory_block {
+  char *base;
+  size_t size;
+  size_t pages; // pages still referenced by a region
+} *t_memory_block;
+
+// contiguous guest range backed by a slice of one memory_block
+typedef struct memory_region {
+  std::uint64_t size;
+  char *addr;
   int perms;
-} *t_memory_page;
+  t_memory_block block;
+  std::uint64_t offset; // offset in the memory_snapshot file
+} t_memory_region;
+
+// file holding the guest memory of a forked template, mapped MAP_PRIVATE by the template and its clones
+typedef struct memory_snapshot {
+  int fd;
+} *t_memory_snapshot;
+
+// key is guest start address, the lock guards the map against vCPU threads resolving pages outside the page table
+struct memory_map : std::map<std::uint64_t, struct memory_region> {
+  std::mutex lock;
+};
+
+#define DYN_HOOK_CODE 0
+#define DYN_HOOK_BLOCK 1
+#define DYN_HOOK_READ 2
+#define DYN_HOOK_WRITE 3
+#define DYN_HOOK_TYPES 4
+
+#define DYN_UNLIMITED_TICKS 0x10000000000ULL // budget of emu_start without an emu count
+#define DYN_EMU_COUNT_EXHAUSTED 2 // emu_start return value
+
+// indices of reg_read_batch/reg_write_batch past the general purpose registers
+#define DYN_REG64_SP 31
+#define DYN_REG64_PC 32
+#define DYN_REG64_NZCV 33
+#define DYN_REG64_TPIDR_EL0 34
+#define DYN_REG64_TPIDRRO_EL0 35
+#define DYN_REG32_CPSR 16
+#define DYN_REG32_C13_C0_3 17
+
+#define DYN_TIME_SOURCE_HOST 0 // host monotonic time scaled to DYN_CNTFRQ
+#define DYN_TIME_SOURCE_VIRTUAL 1 // executed instructions, reproducible across runs
+#define DYN_CNTFRQ 19200000ULL // generic timer frequency reported to the guest
 
-KHASH_MAP_INIT_INT64(memory, t_memory_page)
+// source of the CNTPCT counter, shared by all vCPUs of a dynarmic: set_time_source changes it while they read it
+typedef struct dyn_clock {
+  std::atomic<int> source; // stored after instructions_per_second
+  std::atomic<std::uint64_t> instructions_per_second; // guest speed assumed by DYN_TIME_SOURCE_VIRTUAL
+  std::atomic<std::uint64_t> instructions; // retired by all vCPUs since the clock was set
+} *t_clock;
+
+// inclusive [begin, end] ranges of the hooks registered in java, begin > end covers the whole address space
+typedef std::vector<std::pair<std::uint64_t, std::uint64_t>> hook_ranges;
+
+// set_hook_ranges replaces the ranges while the vCPUs read them
+typedef struct hook_table {
+  std::shared_mutex lock;
+  hook_ranges ranges[DYN_HOOK_TYPES];
+} *t_hook_table;
+
+#define NATIVE_SYSCALL_CONSTANT 0
+#define NATIVE_SYSCALL_CLOCK_GETTIME 1
+#define NATIVE_SYSCALL_GETTIMEOFDAY 2
+
+// syscall answered inside CallSVC without calling back into java
+typedef struct native_syscall {
+  int type;
+  std::int64_t value; // result of NATIVE_SYSCALL_CONSTANT
+  std::int64_t realtime_offset; // nanoseconds added to the host realtime clock
+  std::int64_t monotonic_offset; // nanoseconds added to the host steady clock
+} t_native_syscall;
+
+KHASH_MAP_INIT_INT(syscall, t_native_syscall)
 
 using Vector = std::array<std::uint64_t, 2>;
 typedef struct context64 {
@@ -55,3 +132,15 @@ typedef struct context32 {
   std::uint32_t fpscr;
   std::uint32_t uro;
 } *t_context32;
+
+// guest pages saved by their first write after a checkpoint: the host pages backing the guest memory are made read-only,
+// the fault of the first write to one copies the guest pages it holds and makes it writable again. Reads and code fetches
+// of armed pages keep going through the jit page table
+typedef struct dyn_checkpoint {
+  std::atomic<bool> active;
+  std::mutex lock; // taken after memory_map::lock, never held while guest memory is written
+  std::map<char *, std::uint64_t> armed; // host addresses of the guest pages not written since the checkpoint -> guest page
+  std::map<std::uint64_t, char *> pages; // content at the checkpoint of the guest pages written since
+  struct context64 ctx64;
+  struct context32 ctx32;
+} *t_checkpoint;
@@ -1,7 +1,7 @@
 JAVA_INC="$JAVA_HOME"/include
 JAVA_PLATFORM_INC="$(dirname "$(find "$JAVA_INC" -name jni_md.h)")"
 
-c++ -m64 -o libdynarmic.so -shared -fPIC -std=c++17 -O2 \
+c++ -m64 -mcx16 -o libdynarmic.so -shared -fPIC -std=c++17 -O2 \
   -I ~/git/dynarmic/include -I ~/git/dynarmic/externals/fmt/include dynarmic.cpp arm_dynarmic_cp15.cpp \
   -I "$JAVA_INC" -I "$JAVA_PLATFORM_INC" \
   ~/git/dynarmic/build/src/libdynarmic.a \
@@ -3,7 +3,7 @@
 JAVA_INC="$JAVA_HOME"/include
 JAVA_PLATFORM_INC="$(dirname "$(find "$JAVA_INC" -name jni_md.h)")"
 
-g++ -m64 -o dynarmic.dll -shared -fPIC -std=c++17 -O2 -static \
+g++ -m64 -mcx16 -o dynarmic.dll -shared -fPIC -std=c++17 -O2 -static \
   -I ~/git/dynarmic/include -I ~/git/dynarmic/externals/fmt/include \
   dynarmic.cpp arm_dynarmic_cp15.cpp mman.c \
   -I "$JAVA_INC" -I "$JAVA_PLATFORM_INC" \
@@ -1,12 +1,135 @@
 package com.github.unidbg.arm.backend;
 
+import com.github.unidbg.arm.backend.dynarmic.Dynarmic;
+import com.github.unidbg.arm.backend.dynarmic.DynarmicCallback;
 import junit.framework.TestCase;
 
+import java.io.IOException;
+
 public class Arm64Test extends TestCase {
 
+    static {
+        try {
+            org.scijava.nativelib.NativeLoader.loadLibrary("dynarmic");
+        } catch (IOException ignored) {
+        }
+    }
+
+    private static final long STUB = 0x10000;
+    private static final long CODE = 0x20000;
+    private static final long DATA = 0x30000;
+    private static final int PAGE_SIZE = 0x1000;
+    private static final int PROT_READ = 1;
+    private static final int PROT_WRITE = 2;
+    private static final int PROT_ALL = 7;
+
+    private static final int MOV_X0_1 = 0xd2800020;
+    private static final int MOV_X0_2 = 0xd2800040;
+    private static final int STR_W1_X2 = 0xb9000041;
+    private static final int SVC_0 = 0xd4000001;
+
     public void testSys() {
         int code = 0xD50B7522;
         System.out.println("0x" + Integer.toHexString(code >>> 19));
     }
 
+    public void testPooledJitRunsCodeMappedLater() {
+        Dynarmic.setJitPoolSize(1);
+        try {
+            try (Dynarmic dynarmic = new Dynarmic(true)) {
+                dynarmic.setDynarmicCallback(new TestCallback());
+                mapCode(dynarmic, CODE, MOV_X0_1);
+                assertEquals(1, run(dynarmic, CODE));
+            }
+
+            try (Dynarmic dynarmic = new Dynarmic(true)) {
+                dynarmic.setDynarmicCallback(new TestCallback());
+                // the first emu_start does not see CODE mapped, the pooled blocks of it must not survive
+                mapCode(dynarmic, STUB, MOV_X0_2);
+                assertEquals(2, run(dynarmic, STUB));
+                mapCode(dynarmic, CODE, MOV_X0_2);
+                assertEquals(2, run(dynarmic, CODE));
+            }
+        } finally {
+            Dynarmic.setJitPoolSize(0);
+        }
+    }
+
+    public void testRestoreCheckpoint() {
+        try (Dynarmic dynarmic = new Dynarmic(true)) {
+            dynarmic.setDynarmicCallback(new TestCallback());
+            mapCode(dynarmic, CODE, MOV_X0_1);
+            mapCode(dynarmic, STUB, STR_W1_X2);
+            dynarmic.mem_map(DATA, PAGE_SIZE, PROT_READ);
+            dynarmic.mem_map(DATA + PAGE_SIZE, PAGE_SIZE, PROT_READ);
+            dynarmic.mem_write_u32(DATA, 1);
+            assertEquals(1, run(dynarmic, CODE));
+            dynarmic.checkpoint();
+
+            dynarmic.mem_write_u32(DATA, 2); // host write to a read-only page
+            dynarmic.reg_write64(1, 3);
+            dynarmic.reg_write64(2, DATA + 4);
+            run(dynarmic, STUB); // guest store to a read-only page
+            dynarmic.mem_protect(DATA + PAGE_SIZE, PAGE_SIZE, PROT_READ | PROT_WRITE);
+            dynarmic.mem_write_u32(DATA + PAGE_SIZE, 4);
+            dynarmic.mem_write_u32(CODE, MOV_X0_2);
+            dynarmic.remove_cache(CODE, CODE + 8);
+            assertEquals(2, run(dynarmic, CODE));
+            assertEquals(3, dynarmic.mem_read_u32(DATA + 4));
+
+            dynarmic.restore_checkpoint();
+            assertEquals(1, dynarmic.mem_read_u32(DATA));
+            assertEquals(0, dynarmic.mem_read_u32(DATA + 4));
+            assertEquals(0, dynarmic.mem_read_u32(DATA + PAGE_SIZE));
+            assertEquals(1, run(dynarmic, CODE));
+        }
+    }
+
+    private static void mapCode(Dynarmic dynarmic, long address, int instruction) {
+        dynarmic.mem_map(address, PAGE_SIZE, PROT_ALL);
+        dynarmic.mem_write_u32(address, instruction);
+        dynarmic.mem_write_u32(address + 4, SVC_0);
+    }
+
+    private static long run(Dynarmic dynarmic, long address) {
+        dynarmic.reg_write64(0, 0);
+        dynarmic.emu_start(address, address + 8); // the pc of an svc is the next instruction
+        return dynarmic.reg_read64(0);
+    }
+
+    private static class TestCallback implements DynarmicCallback {
+        @Override
+        public void callSVC(long pc, int swi) {
+            throw new IllegalStateException("pc=0x" + Long.toHexString(pc) + ", swi=" + swi);
+        }
+        @Override
+        public boolean handleInterpreterFallback(long pc, int num_instructions) {
+            return false;
+        }
+        @Override
+        public void handleExceptionRaised(long pc, int exception) {
+            throw new IllegalStateException("pc=0x" + Long.toHexString(pc) + ", exception=" + exception);
+        }
+        @Override
+        public void handleMemoryReadFailed(long vaddr, int size) {
+            throw new IllegalStateException("read vaddr=0x" + Long.toHexString(vaddr));
+        }
+        @Override
+        public void handleMemoryWriteFailed(long vaddr, int size) {
+            throw new IllegalStateException("write vaddr=0x" + Long.toHexString(vaddr));
+        }
+        @Override
+        public void handleCodeHook(long address, int size) {
+        }
+        @Override
+        public void handleBlockHook(long address, int size) {
+        }
+        @Override
+        public void handleMemoryRead(long address, int size) {
+        }
+        @Override
+        public void handleMemoryWrite(long address, int size, long value) {
+        }
+    }
+
 }
@@ -23,7 +23,7 @@ public abstract class KvmBackend extends FastBackend implements Backend, KvmCall
 
     private int slotIndex;
     private final UserMemoryRegion[] slots;
-    protected final Map<Long, UserMemoryRegion> memoryRegionMap; // key is guest_phys_addr
+    protected final TreeMap<Long, UserMemoryRegion> memoryRegionMap; // key is guest_phys_addr
 
     protected KvmBackend(Emulator<?> emulator, Kvm kvm) throws BackendException {
         super(emulator);
@@ -44,6 +44,40 @@ public abstract class KvmBackend extends FastBackend implements Backend, KvmCall
         }
     }
 
+    /**
+     * Back regions of 2M and more with transparent huge pages, aligned so that the guest can map them with block entries.
+     */
+    public void setHugePages(boolean enable) {
+        try {
+            kvm.set_huge_pages(enable);
+        } catch (KvmException e) {
+            throw new BackendException(e);
+        }
+    }
+
+    /**
+     * Saves guest memory and registers, and enables dirty page logging on every slot.
+     */
+    public void checkpoint() {
+        try {
+            kvm.checkpoint();
+        } catch (KvmException e) {
+            throw new BackendException(e);
+        }
+    }
+
+    /**
+     * Copies back only the pages written since {@link #checkpoint()} and restores the registers.
+     * Fails when memory was mapped or unmapped after the checkpoint, the emulator side of such changes can not be rolled back here.
+     */
+    public void restoreCheckpoint() {
+        try {
+            kvm.restore_checkpoint();
+        } catch (KvmException e) {
+            throw new BackendException(e);
+        }
+    }
+
     private int allocateSlot() {
         for (int i = slotIndex; i < slots.length; i++) {
             if (slots[i] == null) {
@@ -64,6 +98,21 @@ public abstract class KvmBackend extends FastBackend implements Backend, KvmCall
 
 //        System.out.println("mem_map address=0x" + Long.toHexString(address) + ", size=0x" + Long.toHexString(size));
 
+        Map.Entry<Long, UserMemoryRegion> entry = memoryRegionMap.lowerEntry(address);
+        UserMemoryRegion previous = entry == null ? null : entry.getValue();
+        if (previous != null && previous.guest_phys_addr + previous.memory_size == address) { // grow the adjacent slot instead of taking a new one
+            long userspace_addr = kvm.extend_user_memory_region(previous.slot, size);
+            if (userspace_addr != 0L) {
+                if (log.isDebugEnabled()) {
+                    log.debug("mem_map extend slot=" + previous.slot + ", address=0x" + Long.toHexString(address) + ", size=0x" + Long.toHexString(size) + ", userspace_addr=0x" + Long.toHexString(userspace_addr));
+                }
+                UserMemoryRegion region = new UserMemoryRegion(previous.slot, previous.guest_phys_addr, previous.memory_size + size, userspace_addr);
+                memoryRegionMap.put(region.guest_phys_addr, region);
+                slots[region.slot] = region;
+                return;
+            }
+        }
+
         int slot = allocateSlot();
         long userspace_addr = kvm.set_user_memory_region(slot, address, size, 0L);
         if (log.isDebugEnabled()) {
@@ -189,6 +238,51 @@ public abstract class KvmBackend extends FastBackend implements Backend, KvmCall
         }
     }
 
+    @Override
+    public final byte[] mem_read_cstring(long address, int max) throws BackendException {
+        try {
+            return kvm.mem_read_cstring(address, max);
+        } catch (KvmException e) {
+            throw new BackendException(e);
+        }
+    }
+
+    @Override
+    public final int mem_read_u32(long address) throws BackendException {
+        try {
+            return kvm.mem_read_u32(address);
+        } catch (KvmException e) {
+            throw new BackendException(e);
+        }
+    }
+
+    @Override
+    public final long mem_read_u64(long address) throws BackendException {
+        try {
+            return kvm.mem_read_u64(address);
+        } catch (KvmException e) {
+            throw new BackendException(e);
+        }
+    }
+
+    @Override
+    public final void mem_write_u32(long address, int value) throws BackendException {
+        try {
+            kvm.mem_write_u32(address, value);
+        } catch (KvmException e) {
+            throw new BackendException(e);
+        }
+    }
+
+    @Override
+    public final void mem_write_u64(long address, long value) throws BackendException {
+        try {
+            kvm.mem_write_u64(address, value);
+        } catch (KvmException e) {
+            throw new BackendException(e);
+        }
+    }
+
     protected final void callSVC(long pc, int swi) {
         if (log.isDebugEnabled()) {
             log.debug("callSVC pc=0x" + Long.toHexString(pc) + ", until=0x" + Long.toHexString(until) + ", swi=" + swi);
@@ -18,6 +18,10 @@ public class Kvm implements Closeable {
 
     private static native long set_user_memory_region(long handle, int slot, long guest_phys_addr, long memory_size, long userspace_addr);
     private static native int remove_user_memory_region(long handle, int slot, long guest_phys_addr, long memory_size, long userspace_addr, long vaddr_off);
+    private static native long extend_user_memory_region(long handle, int slot, long extra_size);
+    private static native int set_huge_pages(long handle, boolean enable);
+    private static native int checkpoint(long handle);
+    private static native int restore_checkpoint(long handle);
 
     private static native long reg_read_cpacr_el1(long handle);
     private static native int reg_set_cpacr_el1(long handle, long value);
@@ -34,9 +38,16 @@ public class Kvm implements Closeable {
 
     private static native int mem_write(long handle, long address, byte[] bytes);
     private static native byte[] mem_read(long handle, long address, int size);
+    private static native byte[] mem_read_cstring(long handle, long address, int max);
+    private static native int mem_read_u32(long handle, long address);
+    private static native long mem_read_u64(long handle, long address);
+    private static native int mem_write_u32(long handle, long address, int value);
+    private static native int mem_write_u64(long handle, long address, long value);
 
     private static native int reg_write(long handle, int index, long value);
     private static native long reg_read(long handle, int index);
+    private static native int reg_read_batch(long handle, int[] indices, long[] values);
+    private static native int reg_write_batch(long handle, int[] indices, long[] values);
 
     private static native int emu_start(long handle, long pc);
     private static native int emu_stop(long handle);
@@ -80,6 +91,47 @@ public class Kvm implements Closeable {
         }
     }
 
+    /**
+     * Grows the slot in place by <code>extra_size</code> bytes mapped directly behind it.
+     * @return the unchanged userspace_addr of the slot, or 0 when the host memory behind the slot is taken
+     */
+    public long extend_user_memory_region(int slot, long extra_size) {
+        return extend_user_memory_region(nativeHandle, slot, extra_size);
+    }
+
+    public void set_huge_pages(boolean enable) {
+        if (log.isDebugEnabled()) {
+            log.debug("set_huge_pages enable=" + enable);
+        }
+
+        int ret = set_huge_pages(nativeHandle, enable);
+        if (ret != 0) {
+            throw new KvmException("ret=" + ret);
+        }
+    }
+
+    public void checkpoint() {
+        if (log.isDebugEnabled()) {
+            log.debug("checkpoint");
+        }
+
+        int ret = checkpoint(nativeHandle);
+        if (ret != 0) {
+            throw new KvmException("checkpoint failed: ret=" + ret);
+        }
+    }
+
+    public void restore_checkpoint() {
+        if (log.isDebugEnabled()) {
+            log.debug("restore_checkpoint");
+        }
+
+        int ret = restore_checkpoint(nativeHandle);
+        if (ret != 0) {
+            throw new KvmException("restore_checkpoint failed: ret=" + ret);
+        }
+    }
+
     public long reg_read_cpacr_el1() {
         long cpacr = reg_read_cpacr_el1(nativeHandle);
         if (log.isDebugEnabled()) {
@@ -175,6 +227,45 @@ public class Kvm implements Closeable {
         return ret;
     }
 
+    /**
+     * Scans the host pages for the terminator, so the string is read with one call.
+     */
+    public byte[] mem_read_cstring(long address, int max) {
+        byte[] ret = mem_read_cstring(nativeHandle, address, max);
+        if (ret == null) {
+            throw new KvmException("mem_read_cstring address=0x" + Long.toHexString(address));
+        }
+        return ret;
+    }
+
+    /**
+     * @throws KvmException if the address is not mapped
+     */
+    public int mem_read_u32(long address) {
+        return mem_read_u32(nativeHandle, address);
+    }
+
+    /**
+     * @throws KvmException if the address is not mapped
+     */
+    public long mem_read_u64(long address) {
+        return mem_read_u64(nativeHandle, address);
+    }
+
+    public void mem_write_u32(long address, int value) {
+        int ret = mem_write_u32(nativeHandle, address, value);
+        if (ret != 0) {
+            throw new KvmException("ret=" + ret);
+        }
+    }
+
+    public void mem_write_u64(long address, long value) {
+        int ret = mem_write_u64(nativeHandle, address, value);
+        if (ret != 0) {
+            throw new KvmException("ret=" + ret);
+        }
+    }
+
     public void reg_set_tpidr_el0(long value) {
         if (log.isDebugEnabled()) {
             log.debug("reg_set_tpidr_el0 value=0x" + Long.toHexString(value));
@@ -228,6 +319,39 @@ public class Kvm implements Closeable {
         return reg_read(nativeHandle, index);
     }
 
+    /*
+     * Indices of reg_read_batch and reg_write_batch past X0-X30.
+     */
+    public static final int REG64_SP = 31;
+    public static final int REG64_PC = 32;
+    public static final int REG64_NZCV = 33;
+    public static final int REG64_TPIDR_EL0 = 34;
+    public static final int REG64_TPIDRRO_EL0 = 35;
+
+    /**
+     * Accesses all registers with one JNI call, each is still one KVM_GET_ONE_REG: arm64 has no KVM_GET_REGS.
+     * @param indices X0-X30 by number, the others by the REG64_ constants
+     */
+    public void reg_read_batch(int[] indices, long[] values) {
+        if (log.isDebugEnabled()) {
+            log.debug("reg_read_batch count=" + indices.length);
+        }
+        int ret = reg_read_batch(nativeHandle, indices, values);
+        if (ret != 0) {
+            throw new KvmException("ret=" + ret);
+        }
+    }
+
+    public void reg_write_batch(int[] indices, long[] values) {
+        if (log.isDebugEnabled()) {
+            log.debug("reg_write_batch count=" + indices.length);
+        }
+        int ret = reg_write_batch(nativeHandle, indices, values);
+        if (ret != 0) {
+            throw new KvmException("ret=" + ret);
+        }
+    }
+
     public void emu_start(long begin) {
         int ret = emu_start(nativeHandle, begin);
         if (ret != 0) {
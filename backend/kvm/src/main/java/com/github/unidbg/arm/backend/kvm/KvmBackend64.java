@@ -184,6 +184,72 @@ public class KvmBackend64 extends KvmBackend {
         reg_write(Arm64Const.UC_ARM64_REG_CPACR_EL1, value);
     }
 
+    private static int toBatchIndex(int regId) {
+        if (regId >= Arm64Const.UC_ARM64_REG_X0 && regId <= Arm64Const.UC_ARM64_REG_X28) {
+            return regId - Arm64Const.UC_ARM64_REG_X0;
+        }
+        switch (regId) {
+            case Arm64Const.UC_ARM64_REG_FP:
+                return 29;
+            case Arm64Const.UC_ARM64_REG_LR:
+                return 30;
+            case Arm64Const.UC_ARM64_REG_SP:
+                return Kvm.REG64_SP;
+            case Arm64Const.UC_ARM64_REG_PC:
+                return Kvm.REG64_PC;
+            case Arm64Const.UC_ARM64_REG_NZCV:
+                return Kvm.REG64_NZCV;
+            case Arm64Const.UC_ARM64_REG_TPIDR_EL0:
+                return Kvm.REG64_TPIDR_EL0;
+            case Arm64Const.UC_ARM64_REG_TPIDRRO_EL0:
+                return Kvm.REG64_TPIDRRO_EL0;
+            default:
+                return -1;
+        }
+    }
+
+    /**
+     * @return <code>null</code> if a register can only be accessed one by one
+     */
+    private static int[] toBatchIndices(int[] regIds) {
+        int[] indices = new int[regIds.length];
+        for (int i = 0; i < regIds.length; i++) {
+            indices[i] = toBatchIndex(regIds[i]);
+            if (indices[i] == -1) {
+                return null;
+            }
+        }
+        return indices;
+    }
+
+    @Override
+    public void reg_read_batch(int[] regIds, long[] values) throws BackendException {
+        int[] indices = toBatchIndices(regIds);
+        if (indices == null) {
+            super.reg_read_batch(regIds, values);
+            return;
+        }
+        try {
+            kvm.reg_read_batch(indices, values);
+        } catch (KvmException e) {
+            throw new BackendException(e);
+        }
+    }
+
+    @Override
+    public void reg_write_batch(int[] regIds, long[] values) throws BackendException {
+        int[] indices = toBatchIndices(regIds);
+        if (indices == null) {
+            super.reg_write_batch(regIds, values);
+            return;
+        }
+        try {
+            kvm.reg_write_batch(indices, values);
+        } catch (KvmException e) {
+            throw new BackendException(e);
+        }
+    }
+
     @Override
     public Number reg_read(int regId) throws BackendException {
         try {
@@ -63,6 +63,38 @@ JNIEXPORT jlong JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_set_1user_1me
 JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_remove_1user_1memory_1region
   (JNIEnv *, jclass, jlong, jint, jlong, jlong, jlong, jlong);
 
+/*
+ * Class:     com_github_unidbg_arm_backend_kvm_Kvm
+ * Method:    extend_user_memory_region
+ * Signature: (JIJ)J
+ */
+JNIEXPORT jlong JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_extend_1user_1memory_1region
+  (JNIEnv *, jclass, jlong, jint, jlong);
+
+/*
+ * Class:     com_github_unidbg_arm_backend_kvm_Kvm
+ * Method:    set_huge_pages
+ * Signature: (JZ)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_set_1huge_1pages
+  (JNIEnv *, jclass, jlong, jboolean);
+
+/*
+ * Class:     com_github_unidbg_arm_backend_kvm_Kvm
+ * Method:    checkpoint
+ * Signature: (J)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_checkpoint
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     com_github_unidbg_arm_backend_kvm_Kvm
+ * Method:    restore_checkpoint
+ * Signature: (J)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_restore_1checkpoint
+  (JNIEnv *, jclass, jlong);
+
 /*
  * Class:     com_github_unidbg_arm_backend_kvm_Kvm
  * Method:    reg_read_cpacr_el1
@@ -167,6 +199,46 @@ JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_mem_1write
 JNIEXPORT jbyteArray JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_mem_1read
   (JNIEnv *, jclass, jlong, jlong, jint);
 
+/*
+ * Class:     com_github_unidbg_arm_backend_kvm_Kvm
+ * Method:    mem_read_cstring
+ * Signature: (JJI)[B
+ */
+JNIEXPORT jbyteArray JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_mem_1read_1cstring
+  (JNIEnv *, jclass, jlong, jlong, jint);
+
+/*
+ * Class:     com_github_unidbg_arm_backend_kvm_Kvm
+ * Method:    mem_read_u32
+ * Signature: (JJ)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_mem_1read_1u32
+  (JNIEnv *, jclass, jlong, jlong);
+
+/*
+ * Class:     com_github_unidbg_arm_backend_kvm_Kvm
+ * Method:    mem_read_u64
+ * Signature: (JJ)J
+ */
+JNIEXPORT jlong JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_mem_1read_1u64
+  (JNIEnv *, jclass, jlong, jlong);
+
+/*
+ * Class:     com_github_unidbg_arm_backend_kvm_Kvm
+ * Method:    mem_write_u32
+ * Signature: (JJI)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_mem_1write_1u32
+  (JNIEnv *, jclass, jlong, jlong, jint);
+
+/*
+ * Class:     com_github_unidbg_arm_backend_kvm_Kvm
+ * Method:    mem_write_u64
+ * Signature: (JJJ)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_mem_1write_1u64
+  (JNIEnv *, jclass, jlong, jlong, jlong);
+
 /*
  * Class:     com_github_unidbg_arm_backend_kvm_Kvm
  * Method:    reg_write
@@ -183,6 +255,22 @@ JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_reg_1write
 JNIEXPORT jlong JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_reg_1read
   (JNIEnv *, jclass, jlong, jint);
 
+/*
+ * Class:     com_github_unidbg_arm_backend_kvm_Kvm
+ * Method:    reg_read_batch
+ * Signature: (J[I[J)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_reg_1read_1batch
+  (JNIEnv *, jclass, jlong, jintArray, jlongArray);
+
+/*
+ * Class:     com_github_unidbg_arm_backend_kvm_Kvm
+ * Method:    reg_write_batch
+ * Signature: (J[I[J)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_reg_1write_1batch
+  (JNIEnv *, jclass, jlong, jintArray, jlongArray);
+
 /*
  * Class:     com_github_unidbg_arm_backend_kvm_Kvm
  * Method:    emu_start
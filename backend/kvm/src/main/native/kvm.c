@@ -6,16 +6,50 @@
 #include <sys/ioctl.h>
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include "kvm.h"
 
+// x0-x30, sp, pc, pstate, sp_el1, elr_el1 and spsr_el1 are consecutive u64 of struct kvm_regs, their ids advance by 2
+#define REG_CACHE_CORE_SLOTS 37
+
+// system registers read on every exception exit or written by every thread switch
+static const uint64_t cached_sys_regs[] = {
+  HV_SYS_REG_ESR_EL1,
+  HV_SYS_REG_FAR_EL1,
+  HV_SYS_REG_TPIDR_EL0,
+  HV_SYS_REG_TPIDRRO_EL0,
+};
+
+#define REG_CACHE_SLOTS (REG_CACHE_CORE_SLOTS + sizeof(cached_sys_regs) / sizeof(cached_sys_regs[0]))
+
 typedef struct kvm_cpu {
   int fd;
   struct kvm_run *run;
   uint32_t offset;
+  uint64_t regs[REG_CACHE_SLOTS]; // user space copy of the registers accessed since the last exit
+  uint64_t regs_valid; // bit per slot of regs
+  uint64_t regs_dirty; // written since the last exit, flushed before KVM_RUN
 } *t_kvm_cpu;
 
+static int reg_cache_slot(uint64_t reg) {
+  if(reg >= HV_REG_X0 && reg <= HV_SYS_REG_SPSR_EL1 && ((reg - HV_REG_X0) & 1) == 0) {
+    return (int) ((reg - HV_REG_X0) >> 1);
+  }
+  for(size_t i = 0; i < sizeof(cached_sys_regs) / sizeof(cached_sys_regs[0]); i++) {
+    if(cached_sys_regs[i] == reg) {
+      return REG_CACHE_CORE_SLOTS + i;
+    }
+  }
+  return -1;
+}
+
+static uint64_t reg_cache_id(int slot) {
+  return slot < REG_CACHE_CORE_SLOTS ? HV_REG_X0 + 2 * (uint64_t) slot : cached_sys_regs[slot - REG_CACHE_CORE_SLOTS];
+}
+
 static int check_one_reg(uint64_t reg, int ret) {
   if(ret == 0) {
     return 0;
@@ -37,48 +71,77 @@ static int check_one_reg(uint64_t reg, int ret) {
   return ret;
 }
 
-hv_return_t hv_vcpu_get_reg(hv_vcpu_t vcpu, hv_reg_t reg, uint64_t *value) {
+// KVM has no bulk register access on arm64, so every register costs one ioctl:
+// reads are kept until the next exit and writes are deferred to flush_reg_cache
+static hv_return_t get_one_reg(t_kvm_cpu cpu, uint64_t reg, uint64_t *value) {
+    int slot = reg_cache_slot(reg);
+    if (slot >= 0 && (cpu->regs_valid & (1ULL << slot))) {
+        *value = cpu->regs[slot];
+        return HV_SUCCESS;
+    }
     struct kvm_one_reg reg_req = {
         .id = reg,
         .addr = (uint64_t)value,
     };
-    if (check_one_reg(reg, ioctl(vcpu->fd, KVM_GET_ONE_REG, &reg_req)) < 0) {
+    if (check_one_reg(reg, ioctl(cpu->fd, KVM_GET_ONE_REG, &reg_req)) < 0) {
         return -1;
     }
+    if (slot >= 0) {
+        cpu->regs[slot] = *value;
+        cpu->regs_valid |= 1ULL << slot;
+    }
     return HV_SUCCESS;
 }
 
-hv_return_t hv_vcpu_set_reg(hv_vcpu_t vcpu, hv_reg_t reg, uint64_t value) {
+static hv_return_t set_one_reg(t_kvm_cpu cpu, uint64_t reg, uint64_t value) {
+    int slot = reg_cache_slot(reg);
+    if (slot >= 0) {
+        cpu->regs[slot] = value;
+        cpu->regs_valid |= 1ULL << slot;
+        cpu->regs_dirty |= 1ULL << slot;
+        return HV_SUCCESS;
+    }
     struct kvm_one_reg reg_req = {
         .id = reg,
         .addr = (uint64_t)&value,
     };
-    if (check_one_reg(reg, ioctl(vcpu->fd, KVM_SET_ONE_REG, &reg_req)) < 0) {
+    if (check_one_reg(reg, ioctl(cpu->fd, KVM_SET_ONE_REG, &reg_req)) < 0) {
         return -1;
     }
     return HV_SUCCESS;
 }
 
-hv_return_t hv_vcpu_get_sys_reg(hv_vcpu_t vcpu, hv_sys_reg_t reg, uint64_t *value) {
-    struct kvm_one_reg reg_req = {
-        .id = reg,
-        .addr = (uint64_t)value,
-    };
-    if (check_one_reg(reg, ioctl(vcpu->fd, KVM_GET_ONE_REG, &reg_req)) < 0) {
-        return -1;
+static int flush_reg_cache(t_kvm_cpu cpu) {
+    for (int slot = 0; cpu->regs_dirty; slot++) {
+        if (cpu->regs_dirty & (1ULL << slot)) {
+            uint64_t reg = reg_cache_id(slot);
+            struct kvm_one_reg reg_req = {
+                .id = reg,
+                .addr = (uint64_t)&cpu->regs[slot],
+            };
+            if (check_one_reg(reg, ioctl(cpu->fd, KVM_SET_ONE_REG, &reg_req)) < 0) {
+                return -1;
+            }
+            cpu->regs_dirty &= ~(1ULL << slot);
+        }
     }
-    return HV_SUCCESS;
+    return 0;
+}
+
+hv_return_t hv_vcpu_get_reg(hv_vcpu_t vcpu, hv_reg_t reg, uint64_t *value) {
+    return get_one_reg(vcpu, reg, value);
+}
+
+hv_return_t hv_vcpu_set_reg(hv_vcpu_t vcpu, hv_reg_t reg, uint64_t value) {
+    return set_one_reg(vcpu, reg, value);
+}
+
+hv_return_t hv_vcpu_get_sys_reg(hv_vcpu_t vcpu, hv_sys_reg_t reg, uint64_t *value) {
+    return get_one_reg(vcpu, reg, value);
 }
 
 hv_return_t hv_vcpu_set_sys_reg(hv_vcpu_t vcpu, hv_sys_reg_t reg, uint64_t value) {
-    struct kvm_one_reg reg_req = {
-        .id = reg,
-        .addr = (uint64_t)&value,
-    };
-    if (check_one_reg(reg, ioctl(vcpu->fd, KVM_SET_ONE_REG, &reg_req)) < 0) {
-        return -1;
-    }
-    return HV_SUCCESS;
+    return set_one_reg(vcpu, reg, value);
 }
 
 hv_return_t hv_vcpu_get_simd_fp_reg(hv_vcpu_t vcpu, hv_simd_fp_reg_t reg, hv_simd_fp_uchar16_t *value) {
@@ -130,11 +193,29 @@ JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_getPageSize
   return (jint) sz;
 }
 
+// guest memory and registers saved by checkpoint, KVM_MEM_LOG_DIRTY_PAGES tells restore_checkpoint which pages to copy back
+typedef struct kvm_checkpoint {
+  int slot_count; // slots above are unused
+  struct kvm_slot *slots; // layout at the checkpoint
+  char **memory; // copy of every slot
+  uint64_t *dirty_log; // KVM_GET_DIRTY_LOG bitmap, sized for the largest slot
+  uint64_t *host_dirty; // guest pages written by mem_write, KVM only logs the writes of the guest
+  size_t host_dirty_count;
+  size_t host_dirty_capacity;
+  bool layout_changed; // a slot was registered, removed or resized after the checkpoint
+  uint64_t regs[REG_CACHE_SLOTS];
+  uint64_t fpcr;
+  uint64_t fpsr;
+  hv_simd_fp_uchar16_t vregs[32];
+} *t_kvm_checkpoint;
+
 typedef struct kvm {
   bool is64Bit;
-  khash_t(memory) *memory;
-  size_t num_page_table_entries;
-  void **page_table;
+  t_kvm_slot slots; // gMaxSlots registered regions, indexed by slot
+  t_kvm_checkpoint checkpoint;
+  bool huge_pages;
+  int *slot_order; // indices of the registered slots sorted by guest_phys_addr, see find_slot
+  int slot_order_count;
   t_kvm_cpu cpu;
   jobject callback;
   bool stop_request;
@@ -142,23 +223,57 @@ typedef struct kvm {
 
 static jmethodID handleException = NULL;
 
-static char *get_memory_page(khash_t(memory) *memory, uint64_t vaddr, size_t num_page_table_entries, void **page_table) {
-    uint64_t idx = vaddr >> PAGE_BITS;
-    if(page_table && idx < num_page_table_entries) {
-      return (char *)page_table[idx];
+// position in slot_order of the first slot ending above vaddr
+static int lower_slot(t_kvm kvm, uint64_t vaddr) {
+    int lo = 0, hi = kvm->slot_order_count;
+    while(lo < hi) {
+      int mid = (lo + hi) / 2;
+      t_kvm_slot slot = &kvm->slots[kvm->slot_order[mid]];
+      if(slot->guest_phys_addr + slot->memory_size <= vaddr) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
     }
-    uint64_t base = vaddr & ~KVM_PAGE_MASK;
-    khiter_t k = kh_get(memory, memory, base);
-    if(k == kh_end(memory)) {
+    return lo;
+}
+
+// mem_map grows the adjacent slot instead of taking a new one, so a binary search over the few slots
+// resolves a guest address without any per-page bookkeeping
+static t_kvm_slot find_slot(t_kvm kvm, uint64_t vaddr) {
+    int pos = lower_slot(kvm, vaddr);
+    if(pos == kvm->slot_order_count) {
       return NULL;
     }
-    t_memory_page page = kh_value(memory, k);
-    return (char *)page->addr;
+    t_kvm_slot slot = &kvm->slots[kvm->slot_order[pos]];
+    return vaddr >= slot->guest_phys_addr ? slot : NULL;
 }
 
-static inline void *get_memory(khash_t(memory) *memory, uint64_t vaddr, size_t num_page_table_entries, void **page_table) {
-    char *page = get_memory_page(memory, vaddr, num_page_table_entries, page_table);
-    return page ? &page[vaddr & KVM_PAGE_MASK] : NULL;
+static bool is_range_free(t_kvm kvm, uint64_t vaddr, uint64_t vaddr_end) {
+    int pos = lower_slot(kvm, vaddr);
+    return pos == kvm->slot_order_count || kvm->slots[kvm->slot_order[pos]].guest_phys_addr >= vaddr_end;
+}
+
+// the host page is computed from the base of the slot holding the guest page
+static char *get_memory_page(t_kvm kvm, uint64_t vaddr) {
+    t_kvm_slot slot = find_slot(kvm, vaddr);
+    return slot ? &slot->userspace_addr[(vaddr & ~KVM_PAGE_MASK) - slot->guest_phys_addr] : NULL;
+}
+
+// registers the range of a slot with find_slot, a memory_size of 0 removes it
+static void set_slot(t_kvm kvm, int index, uint64_t guest_phys_addr, uint64_t memory_size, char *userspace_addr) {
+    if(kvm->slots[index].memory_size > 0) {
+      int pos = lower_slot(kvm, kvm->slots[index].guest_phys_addr);
+      memmove(&kvm->slot_order[pos], &kvm->slot_order[pos + 1], (kvm->slot_order_count - pos - 1) * sizeof(int));
+      kvm->slot_order_count--;
+    }
+    kvm->slots[index] = (struct kvm_slot) { guest_phys_addr, memory_size, userspace_addr };
+    if(memory_size > 0) {
+      int pos = lower_slot(kvm, guest_phys_addr);
+      memmove(&kvm->slot_order[pos + 1], &kvm->slot_order[pos], (kvm->slot_order_count - pos) * sizeof(int));
+      kvm->slot_order[pos] = index;
+      kvm->slot_order_count++;
+    }
 }
 
 static t_kvm_cpu create_kvm_cpu(t_kvm kvm) {
@@ -283,6 +398,19 @@ JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_setKvmCallback
   return 0;
 }
 
+static void free_checkpoint(t_kvm_checkpoint checkpoint) {
+  for(int i = 0; i < checkpoint->slot_count; i++) {
+    if(checkpoint->memory[i]) {
+      munmap(checkpoint->memory[i], checkpoint->slots[i].memory_size);
+    }
+  }
+  free(checkpoint->slots);
+  free(checkpoint->memory);
+  free(checkpoint->dirty_log);
+  free(checkpoint->host_dirty);
+  free(checkpoint);
+}
+
 /*
  * Class:     com_github_unidbg_arm_backend_kvm_Kvm
  * Method:    nativeInitialize
@@ -297,23 +425,15 @@ JNIEXPORT jlong JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_nativeInitial
     return 0;
   }
   kvm->is64Bit = is64Bit == JNI_TRUE;
-  kvm->memory = kh_init(memory);
-  if(kvm->memory == NULL) {
-    fprintf(stderr, "kh_init memory failed\n");
+  kvm->slots = (t_kvm_slot) calloc(gMaxSlots, sizeof(struct kvm_slot));
+  if(kvm->slots == NULL) {
+    fprintf(stderr, "calloc slots failed: size=%lu\n", gMaxSlots * sizeof(struct kvm_slot));
     abort();
     return 0;
   }
-  int ret = kh_resize(memory, kvm->memory, 0x1000);
-  if(ret == -1) {
-    fprintf(stderr, "kh_resize memory failed\n");
-    abort();
-    return 0;
-  }
-  kvm->num_page_table_entries = 1ULL << (PAGE_TABLE_ADDRESS_SPACE_BITS - PAGE_BITS);
-  size_t size = kvm->num_page_table_entries * sizeof(void*);
-  kvm->page_table = (void **)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
-  if(kvm->page_table == MAP_FAILED) {
-    fprintf(stderr, "createVM mmap failed[%s->%s:%d] size=0x%zx, errno=%d, msg=%s\n", __FILE__, __func__, __LINE__, size, errno, strerror(errno));
+  kvm->slot_order = (int *) calloc(gMaxSlots, sizeof(int));
+  if(kvm->slot_order == NULL) {
+    fprintf(stderr, "calloc slot_order failed: size=%lu\n", gMaxSlots * sizeof(int));
     abort();
     return 0;
   }
@@ -333,28 +453,23 @@ JNIEXPORT void JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_nativeDestroy
   close(kvm->cpu->fd);
   free(kvm->cpu);
 
-  khash_t(memory) *memory = kvm->memory;
-  khiter_t k = kh_begin(memory);
-  for (; k < kh_end(memory); k++) {
-    if(kh_exist(memory, k)) {
-      t_memory_page page = kh_value(memory, k);
-      int ret = munmap(page->addr, KVM_PAGE_SIZE);
+  for(int i = 0; i < gMaxSlots; i++) {
+    t_kvm_slot slot = &kvm->slots[i];
+    if(slot->memory_size > 0) {
+      int ret = munmap(slot->userspace_addr, slot->memory_size);
       if(ret != 0) {
-        fprintf(stderr, "munmap failed[%s->%s:%d]: addr=%p, ret=%d\n", __FILE__, __func__, __LINE__, page->addr, ret);
+        fprintf(stderr, "munmap failed[%s->%s:%d]: addr=%p, ret=%d\n", __FILE__, __func__, __LINE__, slot->userspace_addr, ret);
       }
-      free(page);
     }
   }
-  kh_destroy(memory, memory);
+  free(kvm->slots);
+  if(kvm->checkpoint) {
+    free_checkpoint(kvm->checkpoint);
+  }
   if(kvm->callback) {
     (*env)->DeleteGlobalRef(env, kvm->callback);
   }
-  if(kvm->page_table) {
-    int ret = munmap(kvm->page_table, kvm->num_page_table_entries * sizeof(void*));
-    if(ret != 0) {
-      fprintf(stderr, "munmap failed[%s->%s:%d]: page_table=%p, ret=%d\n", __FILE__, __func__, __LINE__, kvm->page_table, ret);
-    }
-  }
+  free(kvm->slot_order);
   free(kvm);
 }
 
@@ -367,7 +482,11 @@ JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_remove_1user_1
   (JNIEnv *env, jclass clazz, jlong handle, jint slot, jlong guest_phys_addr, jlong memory_size, jlong userspace_addr, jlong vaddr_off) {
 
   t_kvm kvm = (t_kvm) handle;
-  khash_t(memory) *memory = kvm->memory;
+  t_kvm_slot current = &kvm->slots[slot];
+  if(current->guest_phys_addr != guest_phys_addr || vaddr_off + memory_size > current->memory_size) {
+    fprintf(stderr, "mem_unmap failed[%s->%s:%d]: slot=%d, guest_phys_addr=0x%llx, vaddr_off=0x%llx\n", __FILE__, __func__, __LINE__, slot, guest_phys_addr, vaddr_off);
+    return 3;
+  }
 
   if(memory_size > 0) {
     char *start_addr = (char *) (userspace_addr + vaddr_off);
@@ -391,24 +510,37 @@ JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_remove_1user_1
     fprintf(stderr, "set_user_memory_region failed userspace_addr=0x%llx, guest_phys_addr=0x%lx\n", userspace_addr, guest_phys_addr);
     return 2;
   }
+  set_slot(kvm, slot, 0, 0, NULL); // the java side registers what is left of the slot again
+  if(kvm->checkpoint) {
+    kvm->checkpoint->layout_changed = true;
+  }
+  return 0;
+}
 
-  uint64_t vaddr = guest_phys_addr + vaddr_off;
-  for(; vaddr < guest_phys_addr + vaddr_off + memory_size; vaddr += KVM_PAGE_SIZE) {
-    uint64_t idx = vaddr >> PAGE_BITS;
-    khiter_t k = kh_get(memory, memory, vaddr);
-    if(k == kh_end(memory)) {
-      fprintf(stderr, "mem_unmap failed[%s->%s:%d]: vaddr=%p\n", __FILE__, __func__, __LINE__, (void*)vaddr);
-      return 3;
-    }
-    if(kvm->page_table && idx < kvm->num_page_table_entries) {
-      kvm->page_table[idx] = NULL;
-    }
-    t_memory_page page = kh_value(memory, k);
-    free(page);
-    kh_del(memory, memory, k);
+// regions of at least one huge page are placed at the same offset into a huge page on the host as in the guest and
+// advised for transparent huge pages, so that both the host and the stage-2 tables can map them with 2M blocks.
+// MAP_HUGETLB is not used: mem_unmap punches single 4K pages out of a slot, which hugetlbfs mappings cannot do
+static char *alloc_guest_memory(t_kvm kvm, uint64_t guest_phys_addr, uint64_t memory_size) {
+  if(!kvm->huge_pages || memory_size < HUGE_PAGE_SIZE) {
+    void *addr = mmap(NULL, memory_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return addr == MAP_FAILED ? NULL : (char *) addr;
   }
 
-  return 0;
+  size_t reserve_size = memory_size + HUGE_PAGE_SIZE;
+  char *reserve = (char *) mmap(NULL, reserve_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if(reserve == MAP_FAILED) {
+    return NULL;
+  }
+  uint64_t off = (guest_phys_addr - (uint64_t) reserve) & HUGE_PAGE_MASK;
+  char *start_addr = &reserve[off];
+  if(off > 0) {
+    munmap(reserve, off);
+  }
+  munmap(&start_addr[memory_size], reserve_size - off - memory_size);
+  if(madvise(start_addr, memory_size, MADV_HUGEPAGE) != 0) {
+    fprintf(stderr, "madvise MADV_HUGEPAGE failed[%s->%s:%d]: errno=%d, msg=%s\n", __FILE__, __func__, __LINE__, errno, strerror(errno));
+  }
+  return start_addr;
 }
 
 /*
@@ -419,13 +551,16 @@ JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_remove_1user_1
 JNIEXPORT jlong JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_set_1user_1memory_1region
   (JNIEnv *env, jclass clazz, jlong handle, jint slot, jlong guest_phys_addr, jlong memory_size, jlong userspace_addr) {
   t_kvm kvm = (t_kvm) handle;
-  khash_t(memory) *memory = kvm->memory;
+  if(!is_range_free(kvm, guest_phys_addr, guest_phys_addr + memory_size)) {
+    fprintf(stderr, "set_user_memory_region failed[%s->%s:%d]: guest_phys_addr=0x%llx, memory_size=0x%llx\n", __FILE__, __func__, __LINE__, guest_phys_addr, memory_size);
+    return 0L;
+  }
 
   char *start_addr = (char *) userspace_addr;
   if(start_addr == NULL) {
-    start_addr = (char *) mmap(NULL, memory_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    if(start_addr == MAP_FAILED) {
-      fprintf(stderr, "mmap failed[%s->%s:%d]: start_addr=%p\n", __FILE__, __func__, __LINE__, start_addr);
+    start_addr = alloc_guest_memory(kvm, guest_phys_addr, memory_size);
+    if(start_addr == NULL) {
+      fprintf(stderr, "mmap failed[%s->%s:%d]: memory_size=0x%llx, errno=%d, msg=%s\n", __FILE__, __func__, __LINE__, memory_size, errno, strerror(errno));
       abort();
       return 0L;
     }
@@ -450,40 +585,285 @@ JNIEXPORT jlong JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_set_1user_1me
     abort();
     return 0L;
   }
+  set_slot(kvm, slot, guest_phys_addr, memory_size, start_addr);
+  if(kvm->checkpoint) {
+    kvm->checkpoint->layout_changed = true;
+  }
 //  printf("set_user_memory_region slot=0x%x, guest_phys_addr=0x%llx, memory_size=0x%llx, userspace_addr=%p\n", slot, guest_phys_addr, memory_size, start_addr);
 
-  if(userspace_addr > 0) {
-    return userspace_addr;
+  return (jlong) start_addr;
+}
+
+/*
+ * Class:     com_github_unidbg_arm_backend_kvm_Kvm
+ * Method:    extend_user_memory_region
+ * Signature: (JIJ)J
+ */
+JNIEXPORT jlong JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_extend_1user_1memory_1region
+  (JNIEnv *env, jclass clazz, jlong handle, jint slot, jlong extra_size) {
+  t_kvm kvm = (t_kvm) handle;
+  t_kvm_slot current = &kvm->slots[slot];
+  if(current->memory_size == 0) {
+    return 0L;
   }
 
-  int ret;
-  uint64_t vaddr = guest_phys_addr;
-  for(; vaddr < guest_phys_addr + memory_size; vaddr += KVM_PAGE_SIZE) {
-    uint64_t idx = vaddr >> PAGE_BITS;
-    if(kh_get(memory, memory, vaddr) != kh_end(memory)) {
-      fprintf(stderr, "set_user_memory_region failed[%s->%s:%d]: vaddr=%p\n", __FILE__, __func__, __LINE__, (void*)vaddr);
-      return 0L;
-    }
+  uint64_t guest_phys_addr = current->guest_phys_addr + current->memory_size;
+  if(guest_phys_addr <= MMIO_TRAP_ADDRESS && guest_phys_addr + extra_size > MMIO_TRAP_ADDRESS) {
+    return 0L;
+  }
+  if(!is_range_free(kvm, guest_phys_addr, guest_phys_addr + extra_size)) {
+    return 0L;
+  }
 
-    void *addr = &start_addr[vaddr - guest_phys_addr];
-//    printf("set_user_memory_region vaddr=0x%llx addr=%p\n", vaddr, addr);
-    if(kvm->page_table && idx < kvm->num_page_table_entries) {
-      kvm->page_table[idx] = addr;
-    } else {
-      fprintf(stderr, "guest_phys_addr warning[%s->%s:%d]: addr=%p, page_table=%p, idx=%llu, num_page_table_entries=%zu\n", __FILE__, __func__, __LINE__, (void*)addr, kvm->page_table, idx, kvm->num_page_table_entries);
+  // the host memory must continue the slot, kernels before 4.17 treat MAP_FIXED_NOREPLACE as a plain hint
+  char *end_addr = &current->userspace_addr[current->memory_size];
+  void *addr = mmap(end_addr, extra_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+  if(addr == MAP_FAILED) {
+    return 0L;
+  }
+  if(addr != end_addr) {
+    munmap(addr, extra_size);
+    return 0L;
+  }
+
+  // a registered slot can not be resized: delete it and register the combined range
+  struct kvm_userspace_memory_region region = {
+    .slot = slot,
+    .flags = 0,
+    .guest_phys_addr = current->guest_phys_addr,
+    .memory_size = 0,
+    .userspace_addr = (uint64_t)current->userspace_addr,
+  };
+  if (ioctl(gKvmFd, KVM_SET_USER_MEMORY_REGION, &region) == -1) {
+    fprintf(stderr, "extend_user_memory_region failed[%s->%s:%d]: slot=%d, errno=%d, msg=%s\n", __FILE__, __func__, __LINE__, slot, errno, strerror(errno));
+    munmap(addr, extra_size);
+    return 0L;
+  }
+  region.memory_size = current->memory_size + extra_size;
+  if (ioctl(gKvmFd, KVM_SET_USER_MEMORY_REGION, &region) == -1) {
+    fprintf(stderr, "extend_user_memory_region failed[%s->%s:%d]: slot=%d, errno=%d, msg=%s\n", __FILE__, __func__, __LINE__, slot, errno, strerror(errno));
+    abort();
+    return 0L;
+  }
+  current->memory_size += extra_size; // the range behind the slot was free, slot_order stays sorted
+  if(kvm->checkpoint) {
+    kvm->checkpoint->layout_changed = true;
+  }
+  if(kvm->huge_pages && current->memory_size >= HUGE_PAGE_SIZE) {
+    madvise(current->userspace_addr, current->memory_size, MADV_HUGEPAGE);
+  }
+  return (jlong) current->userspace_addr;
+}
+
+/*
+ * Class:     com_github_unidbg_arm_backend_kvm_Kvm
+ * Method:    set_huge_pages
+ * Signature: (JZ)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_set_1huge_1pages
+  (JNIEnv *env, jclass clazz, jlong handle, jboolean enable) {
+  t_kvm kvm = (t_kvm) handle;
+  kvm->huge_pages = enable == JNI_TRUE;
+  return 0;
+}
+
+static int set_dirty_logging(int index, t_kvm_slot slot, bool enable) {
+  struct kvm_userspace_memory_region region = {
+    .slot = index,
+    .flags = enable ? KVM_MEM_LOG_DIRTY_PAGES : 0,
+    .guest_phys_addr = slot->guest_phys_addr,
+    .memory_size = slot->memory_size,
+    .userspace_addr = (uint64_t)slot->userspace_addr,
+  };
+  return ioctl(gKvmFd, KVM_SET_USER_MEMORY_REGION, &region);
+}
+
+// switches dirty logging off again on the slots of a checkpoint that failed half way
+static void disable_dirty_logging(t_kvm kvm, int slot_count) {
+  for(int i = 0; i < slot_count; i++) {
+    t_kvm_slot slot = &kvm->slots[i];
+    if(slot->memory_size > 0 && set_dirty_logging(i, slot, false) == -1) {
+      fprintf(stderr, "disable dirty logging failed[%s->%s:%d]: slot=%d, errno=%d, msg=%s\n", __FILE__, __func__, __LINE__, i, errno, strerror(errno));
     }
-    khiter_t k = kh_put(memory, memory, vaddr, &ret);
-    t_memory_page page = (t_memory_page) calloc(1, sizeof(struct memory_page));
-    if(page == NULL) {
-      fprintf(stderr, "calloc page failed: size=%lu\n", sizeof(struct memory_page));
+  }
+}
+
+// returns the pages of the slot written by the guest since the last call and write protects them again
+static int get_dirty_log(int index, uint64_t *bitmap) {
+  struct kvm_dirty_log log = {
+    .slot = index,
+    .dirty_bitmap = bitmap,
+  };
+  return ioctl(gKvmFd, KVM_GET_DIRTY_LOG, &log);
+}
+
+static void note_host_write(t_kvm_checkpoint checkpoint, uint64_t vaddr) {
+  if(checkpoint->host_dirty_count > 0 && checkpoint->host_dirty[checkpoint->host_dirty_count - 1] == vaddr) {
+    return;
+  }
+  if(checkpoint->host_dirty_count == checkpoint->host_dirty_capacity) {
+    size_t capacity = checkpoint->host_dirty_capacity ? checkpoint->host_dirty_capacity * 2 : 64;
+    uint64_t *host_dirty = (uint64_t *) realloc(checkpoint->host_dirty, capacity * sizeof(uint64_t));
+    if(host_dirty == NULL) {
+      fprintf(stderr, "realloc host_dirty failed: size=%lu\n", capacity * sizeof(uint64_t));
       abort();
-      return 0L;
+      return;
     }
-    page->addr = addr;
-    kh_value(memory, k) = page;
+    checkpoint->host_dirty = host_dirty;
+    checkpoint->host_dirty_capacity = capacity;
   }
+  checkpoint->host_dirty[checkpoint->host_dirty_count++] = vaddr;
+}
 
-  return (jlong) start_addr;
+static void restore_host_page(t_kvm_checkpoint checkpoint, uint64_t vaddr) {
+  for(int i = 0; i < checkpoint->slot_count; i++) {
+    t_kvm_slot slot = &checkpoint->slots[i];
+    if(vaddr >= slot->guest_phys_addr && vaddr < slot->guest_phys_addr + slot->memory_size) {
+      uint64_t off = vaddr - slot->guest_phys_addr;
+      memcpy(&slot->userspace_addr[off], &checkpoint->memory[i][off], KVM_PAGE_SIZE);
+      return;
+    }
+  }
+}
+
+/*
+ * Class:     com_github_unidbg_arm_backend_kvm_Kvm
+ * Method:    checkpoint
+ * Signature: (J)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_checkpoint
+  (JNIEnv *env, jclass clazz, jlong handle) {
+  t_kvm kvm = (t_kvm) handle;
+  t_kvm_cpu cpu = kvm->cpu;
+  if(kvm->checkpoint) {
+    free_checkpoint(kvm->checkpoint);
+    kvm->checkpoint = NULL;
+  }
+
+  t_kvm_checkpoint checkpoint = (t_kvm_checkpoint) calloc(1, sizeof(struct kvm_checkpoint));
+  if(checkpoint == NULL) {
+    fprintf(stderr, "calloc checkpoint failed: size=%lu\n", sizeof(struct kvm_checkpoint));
+    abort();
+    return 1;
+  }
+  for(int i = 0; i < gMaxSlots; i++) {
+    if(kvm->slots[i].memory_size > 0) {
+      checkpoint->slot_count = i + 1;
+    }
+  }
+  checkpoint->slots = (struct kvm_slot *) calloc(checkpoint->slot_count + 1, sizeof(struct kvm_slot));
+  checkpoint->memory = (char **) calloc(checkpoint->slot_count + 1, sizeof(char *));
+  if(checkpoint->slots == NULL || checkpoint->memory == NULL) {
+    fprintf(stderr, "calloc checkpoint slots failed: slot_count=%d\n", checkpoint->slot_count);
+    abort();
+    return 1;
+  }
+
+  uint64_t max_pages = 0;
+  for(int i = 0; i < checkpoint->slot_count; i++) {
+    t_kvm_slot slot = &kvm->slots[i];
+    if(slot->memory_size == 0) {
+      continue;
+    }
+    if(set_dirty_logging(i, slot, true) == -1) {
+      fprintf(stderr, "checkpoint failed[%s->%s:%d]: slot=%d, errno=%d, msg=%s\n", __FILE__, __func__, __LINE__, i, errno, strerror(errno));
+      disable_dirty_logging(kvm, checkpoint->slot_count);
+      free_checkpoint(checkpoint);
+      return 2;
+    }
+    char *copy = (char *) mmap(NULL, slot->memory_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(copy == MAP_FAILED) {
+      fprintf(stderr, "checkpoint mmap failed[%s->%s:%d]: memory_size=0x%llx\n", __FILE__, __func__, __LINE__, (unsigned long long) slot->memory_size);
+      disable_dirty_logging(kvm, checkpoint->slot_count);
+      free_checkpoint(checkpoint);
+      return 3;
+    }
+    memcpy(copy, slot->userspace_addr, slot->memory_size);
+    checkpoint->slots[i] = *slot;
+    checkpoint->memory[i] = copy;
+    if((slot->memory_size >> PAGE_BITS) > max_pages) {
+      max_pages = slot->memory_size >> PAGE_BITS;
+    }
+  }
+
+  checkpoint->dirty_log = (uint64_t *) calloc((max_pages + 63) / 64 + 1, sizeof(uint64_t));
+  if(checkpoint->dirty_log == NULL) {
+    fprintf(stderr, "calloc dirty_log failed: max_pages=0x%llx\n", (unsigned long long) max_pages);
+    abort();
+    return 1;
+  }
+  for(int i = 0; i < checkpoint->slot_count; i++) { // slots that already logged keep their old bits, start from a clean log
+    if(checkpoint->memory[i] && get_dirty_log(i, checkpoint->dirty_log) == -1) {
+      fprintf(stderr, "checkpoint failed[%s->%s:%d]: slot=%d, errno=%d, msg=%s\n", __FILE__, __func__, __LINE__, i, errno, strerror(errno));
+      disable_dirty_logging(kvm, checkpoint->slot_count);
+      free_checkpoint(checkpoint);
+      return 2;
+    }
+  }
+
+  for(int i = 0; i < REG_CACHE_SLOTS; i++) {
+    HYP_ASSERT_SUCCESS(get_one_reg(cpu, reg_cache_id(i), &checkpoint->regs[i]));
+  }
+  HYP_ASSERT_SUCCESS(hv_vcpu_get_reg(cpu, HV_REG_FPCR, &checkpoint->fpcr));
+  HYP_ASSERT_SUCCESS(hv_vcpu_get_reg(cpu, HV_REG_FPSR, &checkpoint->fpsr));
+  for(int i = 0; i < 32; i++) {
+    HYP_ASSERT_SUCCESS(hv_vcpu_get_simd_fp_reg(cpu, HV_SIMD_FP_REG_Q0 + i * (HV_SIMD_FP_REG_Q1 - HV_SIMD_FP_REG_Q0), &checkpoint->vregs[i]));
+  }
+
+  kvm->checkpoint = checkpoint;
+  return 0;
+}
+
+/*
+ * Class:     com_github_unidbg_arm_backend_kvm_Kvm
+ * Method:    restore_checkpoint
+ * Signature: (J)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_restore_1checkpoint
+  (JNIEnv *env, jclass clazz, jlong handle) {
+  t_kvm kvm = (t_kvm) handle;
+  t_kvm_cpu cpu = kvm->cpu;
+  t_kvm_checkpoint checkpoint = kvm->checkpoint;
+  if(checkpoint == NULL) {
+    return 1;
+  }
+  if(checkpoint->layout_changed) {
+    return 2;
+  }
+
+  for(int i = 0; i < checkpoint->slot_count; i++) {
+    t_kvm_slot slot = &checkpoint->slots[i];
+    if(slot->memory_size == 0) {
+      continue;
+    }
+    if(get_dirty_log(i, checkpoint->dirty_log) == -1) {
+      fprintf(stderr, "restore_checkpoint failed[%s->%s:%d]: slot=%d, errno=%d, msg=%s\n", __FILE__, __func__, __LINE__, i, errno, strerror(errno));
+      return 3;
+    }
+    uint64_t words = ((slot->memory_size >> PAGE_BITS) + 63) / 64;
+    for(uint64_t w = 0; w < words; w++) {
+      uint64_t bits = checkpoint->dirty_log[w];
+      while(bits) {
+        uint64_t off = ((w << 6) + __builtin_ctzll(bits)) << PAGE_BITS;
+        memcpy(&slot->userspace_addr[off], &checkpoint->memory[i][off], KVM_PAGE_SIZE);
+        bits &= bits - 1;
+      }
+    }
+  }
+  for(size_t i = 0; i < checkpoint->host_dirty_count; i++) {
+    restore_host_page(checkpoint, checkpoint->host_dirty[i]);
+  }
+  checkpoint->host_dirty_count = 0;
+
+  for(int i = 0; i < REG_CACHE_SLOTS; i++) {
+    HYP_ASSERT_SUCCESS(set_one_reg(cpu, reg_cache_id(i), checkpoint->regs[i]));
+  }
+  HYP_ASSERT_SUCCESS(hv_vcpu_set_reg(cpu, HV_REG_FPCR, checkpoint->fpcr));
+  HYP_ASSERT_SUCCESS(hv_vcpu_set_reg(cpu, HV_REG_FPSR, checkpoint->fpsr));
+  for(int i = 0; i < 32; i++) {
+    HYP_ASSERT_SUCCESS(hv_vcpu_set_simd_fp_reg(cpu, HV_SIMD_FP_REG_Q0 + i * (HV_SIMD_FP_REG_Q1 - HV_SIMD_FP_REG_Q0), checkpoint->vregs[i]));
+  }
+  return 0;
 }
 
 /*
@@ -643,7 +1023,6 @@ JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_mem_1write
   jsize size = (*env)->GetArrayLength(env, bytes);
   jbyte *data = (*env)->GetByteArrayElements(env, bytes, NULL);
   t_kvm kvm = (t_kvm) handle;
-  khash_t(memory) *memory = kvm->memory;
   char *src = (char *)data;
   uint64_t vaddr_end = address + size;
   uint64_t vaddr = address & ~KVM_PAGE_MASK;
@@ -651,11 +1030,14 @@ JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_mem_1write
     uint64_t start = vaddr < address ? address - vaddr : 0;
     uint64_t end = vaddr + KVM_PAGE_SIZE <= vaddr_end ? KVM_PAGE_SIZE : (vaddr_end - vaddr);
     uint64_t len = end - start;
-    char *addr = get_memory_page(memory, vaddr, kvm->num_page_table_entries, kvm->page_table);
+    char *addr = get_memory_page(kvm, vaddr);
     if(addr == NULL) {
       fprintf(stderr, "mem_write failed[%s->%s:%d]: vaddr=%p\n", __FILE__, __func__, __LINE__, (void*)vaddr);
       return 1;
     }
+    if(kvm->checkpoint) {
+      note_host_write(kvm->checkpoint, vaddr);
+    }
     char *dest = &addr[start];
 //    printf("mem_write address=%p, vaddr=%p, start=%ld, len=%ld, addr=%p, dest=%p\n", (void*)address, (void*)vaddr, start, len, addr, dest);
     memcpy(dest, src, len);
@@ -673,7 +1055,6 @@ JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_mem_1write
 JNIEXPORT jbyteArray JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_mem_1read
   (JNIEnv *env, jclass clazz, jlong handle, jlong address, jint size) {
   t_kvm kvm = (t_kvm) handle;
-  khash_t(memory) *memory = kvm->memory;
   jbyteArray bytes = (*env)->NewByteArray(env, size);
   uint64_t dest = 0;
   uint64_t vaddr_end = address + size;
@@ -682,7 +1063,7 @@ JNIEXPORT jbyteArray JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_mem_1rea
     uint64_t start = vaddr < address ? address - vaddr : 0;
     uint64_t end = vaddr + KVM_PAGE_SIZE <= vaddr_end ? KVM_PAGE_SIZE : (vaddr_end - vaddr);
     uint64_t len = end - start;
-    char *addr = get_memory_page(memory, vaddr, kvm->num_page_table_entries, kvm->page_table);
+    char *addr = get_memory_page(kvm, vaddr);
     if(addr == NULL) {
       fprintf(stderr, "mem_read failed[%s->%s:%d]: vaddr=%p\n", __FILE__, __func__, __LINE__, (void*)vaddr);
       return NULL;
@@ -694,6 +1075,130 @@ JNIEXPORT jbyteArray JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_mem_1rea
   return bytes;
 }
 
+// copies size bytes between the guest and a host buffer without going through a java array
+static int copy_memory(t_kvm kvm, uint64_t address, char *buf, uint64_t size, bool write) {
+  uint64_t vaddr_end = address + size;
+  for(uint64_t vaddr = address & ~KVM_PAGE_MASK; vaddr < vaddr_end; vaddr += KVM_PAGE_SIZE) {
+    uint64_t start = vaddr < address ? address - vaddr : 0;
+    uint64_t end = vaddr + KVM_PAGE_SIZE <= vaddr_end ? KVM_PAGE_SIZE : (vaddr_end - vaddr);
+    uint64_t len = end - start;
+    char *addr = get_memory_page(kvm, vaddr);
+    if(addr == NULL) {
+      fprintf(stderr, "%s failed[%s->%s:%d]: vaddr=%p\n", write ? "mem_write" : "mem_read", __FILE__, __func__, __LINE__, (void*)vaddr);
+      return 1;
+    }
+    if(write) {
+      if(kvm->checkpoint) {
+        note_host_write(kvm->checkpoint, vaddr);
+      }
+      memcpy(&addr[start], buf, len);
+    } else {
+      memcpy(buf, &addr[start], len);
+    }
+    buf += len;
+  }
+  return 0;
+}
+
+static void throw_unmapped(JNIEnv *env, uint64_t address) {
+  char msg[64];
+  snprintf(msg, sizeof(msg), "unmapped address=0x%llx", (unsigned long long) address);
+  (*env)->ThrowNew(env, (*env)->FindClass(env, "com/github/unidbg/arm/backend/kvm/KvmException"), msg);
+}
+
+/*
+ * Class:     com_github_unidbg_arm_backend_kvm_Kvm
+ * Method:    mem_read_u32
+ * Signature: (JJ)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_mem_1read_1u32
+  (JNIEnv *env, jclass clazz, jlong handle, jlong address) {
+  uint32_t value = 0;
+  if(copy_memory((t_kvm) handle, address, (char *) &value, sizeof(value), false)) {
+    throw_unmapped(env, address);
+  }
+  return (jint) value;
+}
+
+/*
+ * Class:     com_github_unidbg_arm_backend_kvm_Kvm
+ * Method:    mem_read_u64
+ * Signature: (JJ)J
+ */
+JNIEXPORT jlong JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_mem_1read_1u64
+  (JNIEnv *env, jclass clazz, jlong handle, jlong address) {
+  uint64_t value = 0;
+  if(copy_memory((t_kvm) handle, address, (char *) &value, sizeof(value), false)) {
+    throw_unmapped(env, address);
+  }
+  return (jlong) value;
+}
+
+/*
+ * Class:     com_github_unidbg_arm_backend_kvm_Kvm
+ * Method:    mem_write_u32
+ * Signature: (JJI)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_mem_1write_1u32
+  (JNIEnv *env, jclass clazz, jlong handle, jlong address, jint value) {
+  return copy_memory((t_kvm) handle, address, (char *) &value, sizeof(value), true);
+}
+
+/*
+ * Class:     com_github_unidbg_arm_backend_kvm_Kvm
+ * Method:    mem_write_u64
+ * Signature: (JJJ)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_mem_1write_1u64
+  (JNIEnv *env, jclass clazz, jlong handle, jlong address, jlong value) {
+  return copy_memory((t_kvm) handle, address, (char *) &value, sizeof(value), true);
+}
+
+/*
+ * Class:     com_github_unidbg_arm_backend_kvm_Kvm
+ * Method:    mem_read_cstring
+ * Signature: (JJI)[B
+ */
+JNIEXPORT jbyteArray JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_mem_1read_1cstring
+  (JNIEnv *env, jclass clazz, jlong handle, jlong address, jint max) {
+  t_kvm kvm = (t_kvm) handle;
+  // measure with memchr over the host pages first, consecutive guest pages need not be contiguous on the host
+  uint64_t length = 0;
+  while(length < (uint64_t) max) {
+    uint64_t vaddr = address + length;
+    char *addr = get_memory_page(kvm, vaddr & ~KVM_PAGE_MASK);
+    if(addr == NULL) {
+      fprintf(stderr, "mem_read_cstring failed[%s->%s:%d]: vaddr=%p\n", __FILE__, __func__, __LINE__, (void*)vaddr);
+      return NULL;
+    }
+    uint64_t start = vaddr & KVM_PAGE_MASK;
+    uint64_t len = KVM_PAGE_SIZE - start;
+    if(len > (uint64_t) max - length) {
+      len = (uint64_t) max - length;
+    }
+    char *nul = (char *) memchr(&addr[start], 0, len);
+    if(nul) {
+      length += nul - &addr[start];
+      break;
+    }
+    length += len;
+  }
+  jbyteArray bytes = (*env)->NewByteArray(env, (jsize) length);
+  uint64_t dest = 0;
+  while(dest < length) {
+    uint64_t vaddr = address + dest;
+    char *addr = get_memory_page(kvm, vaddr & ~KVM_PAGE_MASK);
+    uint64_t start = vaddr & KVM_PAGE_MASK;
+    uint64_t len = KVM_PAGE_SIZE - start;
+    if(len > length - dest) {
+      len = length - dest;
+    }
+    (*env)->SetByteArrayRegion(env, bytes, dest, len, (jbyte *)&addr[start]);
+    dest += len;
+  }
+  return bytes;
+}
+
 static hv_reg_t gprs[] = {
   HV_REG_X0,
   HV_REG_X1,
@@ -757,6 +1262,89 @@ JNIEXPORT jlong JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_reg_1read
   return value;
 }
 
+// KVM_GET_ONE_REG id of a reg_read_batch/reg_write_batch index, 0 if there is none
+static uint64_t batch_reg(jint index) {
+  if(index >= 0 && index <= 30) {
+    return gprs[index];
+  }
+  switch(index) {
+    case KVM_REG64_SP:
+      return HV_SYS_REG_SP_EL0;
+    case KVM_REG64_PC:
+      return HV_SYS_REG_ELR_EL1;
+    case KVM_REG64_NZCV:
+      return HV_SYS_REG_SPSR_EL1;
+    case KVM_REG64_TPIDR_EL0:
+      return HV_SYS_REG_TPIDR_EL0;
+    case KVM_REG64_TPIDRRO_EL0:
+      return HV_SYS_REG_TPIDRRO_EL0;
+    default:
+      return 0;
+  }
+}
+
+#define REG_BATCH_SIZE 32 // registers copied from and to java per round
+
+/*
+ * Class:     com_github_unidbg_arm_backend_kvm_Kvm
+ * Method:    reg_read_batch
+ * Signature: (J[I[J)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_reg_1read_1batch
+  (JNIEnv *env, jclass clazz, jlong handle, jintArray indices, jlongArray values) {
+  t_kvm kvm = (t_kvm) handle;
+  t_kvm_cpu cpu = kvm->cpu;
+  jint ids[REG_BATCH_SIZE];
+  jlong vals[REG_BATCH_SIZE];
+  jsize count = (*env)->GetArrayLength(env, indices);
+  for(jsize off = 0; off < count; off += REG_BATCH_SIZE) {
+    jsize n = count - off < REG_BATCH_SIZE ? count - off : REG_BATCH_SIZE;
+    (*env)->GetIntArrayRegion(env, indices, off, n, ids);
+    for(jsize i = 0; i < n; i++) {
+      uint64_t reg = batch_reg(ids[i]);
+      uint64_t value = 0;
+      if(reg == 0) {
+        return -1;
+      }
+      if(hv_vcpu_get_reg(cpu, (hv_reg_t) reg, &value) != HV_SUCCESS) {
+        return 1;
+      }
+      vals[i] = (jlong) value;
+    }
+    (*env)->SetLongArrayRegion(env, values, off, n, vals);
+  }
+  return 0;
+}
+
+/*
+ * Class:     com_github_unidbg_arm_backend_kvm_Kvm
+ * Method:    reg_write_batch
+ * Signature: (J[I[J)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_kvm_Kvm_reg_1write_1batch
+  (JNIEnv *env, jclass clazz, jlong handle, jintArray indices, jlongArray values) {
+  t_kvm kvm = (t_kvm) handle;
+  t_kvm_cpu cpu = kvm->cpu;
+  jint ids[REG_BATCH_SIZE];
+  jlong vals[REG_BATCH_SIZE];
+  jsize count = (*env)->GetArrayLength(env, indices);
+  for(jsize off = 0; off < count; off += REG_BATCH_SIZE) {
+    jsize n = count - off < REG_BATCH_SIZE ? count - off : REG_BATCH_SIZE;
+    (*env)->GetIntArrayRegion(env, indices, off, n, ids);
+    (*env)->GetLongArrayRegion(env, values, off, n, vals);
+    for(jsize i = 0; i < n; i++) {
+      uint64_t reg = batch_reg(ids[i]);
+      if(reg == 0) {
+        return -1;
+      }
+      if(hv_vcpu_set_reg(cpu, (hv_reg_t) reg, (uint64_t) vals[i]) != HV_SUCCESS) {
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
 static int cpu_loop(JNIEnv *env, t_kvm kvm, t_kvm_cpu cpu) {
   kvm->stop_request = false;
   cpu->offset = 0;
@@ -766,7 +1354,13 @@ static int cpu_loop(JNIEnv *env, t_kvm kvm, t_kvm_cpu cpu) {
   uint64_t sp = 0;
   uint64_t cpsr = 0;
   while(true) {
-    if (ioctl(cpu->fd, KVM_RUN, NULL) == -1) {
+    if (flush_reg_cache(cpu) != 0) {
+      fprintf(stderr, "flush registers failed: dirty=0x%llx\n", (unsigned long long) cpu->regs_dirty);
+      return -1;
+    }
+    int ret = ioctl(cpu->fd, KVM_RUN, NULL);
+    cpu->regs_valid = 0; // the guest changed them
+    if (ret == -1) {
       hv_vcpu_get_reg(cpu, HV_REG_CPSR, &cpsr);
       hv_vcpu_get_reg(cpu, HV_REG_PC, &pc);
       fprintf(stderr, "KVM_RUN failed: reason=%d, cpsr=0x%llx, pc=0x%llx\n", cpu->run->exit_reason, cpsr, pc);
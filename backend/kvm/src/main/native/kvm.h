@@ -4,23 +4,26 @@
 
 #include <linux/kvm.h>
 
-#include "khash.h"
 #include "com_github_unidbg_arm_backend_kvm_Kvm.h"
 
 #define REG_VBAR_EL1 0xf0000000LL
 #define MMIO_TRAP_ADDRESS 0x76543210LL
 
-#define PAGE_TABLE_ADDRESS_SPACE_BITS 36
 #define PAGE_BITS 12 // 4k
 #define KVM_PAGE_SIZE (1UL << PAGE_BITS)
 #define KVM_PAGE_MASK (KVM_PAGE_SIZE-1)
+#define HUGE_PAGE_SIZE (1UL << 21) // 2M, one stage-2 block entry
+#define HUGE_PAGE_MASK (HUGE_PAGE_SIZE-1)
 
-typedef struct memory_page {
-  void *addr;
-  int perms;
-} *t_memory_page;
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
 
-KHASH_MAP_INIT_INT64(memory, t_memory_page)
+typedef struct kvm_slot {
+  uint64_t guest_phys_addr;
+  uint64_t memory_size;
+  char *userspace_addr;
+} *t_kvm_slot;
 
 #define ARM64_CORE_REG(x)	(KVM_REG_ARM64 | KVM_REG_SIZE_U64 | \
 				 KVM_REG_ARM_CORE | KVM_REG_ARM_CORE_REG(x))
@@ -126,6 +129,13 @@ typedef enum {
     HV_SIMD_FP_REG_Q31 = ARM64_FP_REG(fp_regs.vregs[31]),
 } hv_simd_fp_reg_t;
 
+// indices of reg_read_batch/reg_write_batch past X0-X30
+#define KVM_REG64_SP 31
+#define KVM_REG64_PC 32
+#define KVM_REG64_NZCV 33
+#define KVM_REG64_TPIDR_EL0 34
+#define KVM_REG64_TPIDRRO_EL0 35
+
 #define HV_SUCCESS 0
 typedef int hv_return_t;
 typedef struct kvm_cpu *hv_vcpu_t;
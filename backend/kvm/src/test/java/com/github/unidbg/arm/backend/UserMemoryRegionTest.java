@@ -25,16 +25,38 @@ public class UserMemoryRegionTest extends TestCase {
     }
 
     private long set_user_memory_region(int slot, long guest_phys_addr, long memory_size, long old_addr) {
+        layoutChanged = true;
         System.out.println("set_user_memory_region slot=" + slot + ", guest_phys_addr=0x" + Long.toHexString(guest_phys_addr) +
                 ", memory_size=0x" + Long.toHexString(memory_size) + ", old_addr=0x" + Long.toHexString(old_addr));
         return guest_phys_addr;
     }
 
     private void remove_user_memory_region(int slot, long guest_phys_addr, long memory_size, long userspace_addr, long vaddr_off) {
+        layoutChanged = true;
         System.out.println("remove_user_memory_region slot=" + slot + ", guest_phys_addr=0x" + Long.toHexString(guest_phys_addr) +
                 ", memory_size=0x" + Long.toHexString(memory_size) + ", userspace_addr=0x" + Long.toHexString(userspace_addr) + ", vaddr_off=0x" + Long.toHexString(vaddr_off));
     }
 
+    private Map<Long, UserMemoryRegion> checkpointRegions;
+    private boolean layoutChanged; // a slot was registered, removed or resized after the checkpoint
+
+    private int checkpoint() {
+        checkpointRegions = new TreeMap<>(memoryRegionMap);
+        layoutChanged = false;
+        return 0;
+    }
+
+    private int restore_checkpoint() {
+        if (checkpointRegions == null) {
+            return 1;
+        }
+        if (layoutChanged) {
+            return 2;
+        }
+        assertEquals(checkpointRegions, memoryRegionMap);
+        return 0;
+    }
+
     private UserMemoryRegionTest kvm;
 
     @Override
@@ -132,6 +154,48 @@ public class UserMemoryRegionTest extends TestCase {
         assertEquals(1, slotIndex);
     }
 
+    public void testCheckpointRestore() {
+        try {
+            restoreCheckpoint();
+            fail();
+        } catch (BackendException ignored) { // no checkpoint yet
+        }
+
+        checkpoint();
+        restoreCheckpoint();
+        restoreCheckpoint(); // the checkpoint stays valid after a restore
+
+        mem_unmap(0x5000, 0x1000); // splits a slot
+        try {
+            restoreCheckpoint();
+            fail();
+        } catch (BackendException ignored) { // the layout changed
+        }
+
+        checkpoint();
+        restoreCheckpoint();
+        mem_map(0x5000, 0x1000);
+        try {
+            restoreCheckpoint();
+            fail();
+        } catch (BackendException ignored) {
+        }
+    }
+
+    private void checkpoint() {
+        int ret = kvm.checkpoint();
+        if (ret != 0) {
+            throw new BackendException("checkpoint failed: ret=" + ret);
+        }
+    }
+
+    private void restoreCheckpoint() {
+        int ret = kvm.restore_checkpoint();
+        if (ret != 0) {
+            throw new BackendException("restore_checkpoint failed: ret=" + ret);
+        }
+    }
+
     private void mem_map(long address, long size) {
         if ((address & (pageSize - 1)) != 0) {
             throw new IllegalArgumentException("mem_map address=0x" + Long.toHexString(address));
@@ -12,6 +12,7 @@ import unicorn.ArmConst;
 import unicorn.UnicornConst;
 import unicorn.UnicornException;
 
+import java.nio.ByteBuffer;
 import java.util.Map;
 
 class Unicorn2Backend extends AbstractBackend implements Backend {
@@ -112,6 +113,24 @@ class Unicorn2Backend extends AbstractBackend implements Backend {
         }
     }
 
+    @Override
+    public void reg_read_batch(int[] regIds, long[] values) throws BackendException {
+        try {
+            unicorn.reg_read_batch(regIds, values);
+        } catch (UnicornException e) {
+            throw new BackendException(e);
+        }
+    }
+
+    @Override
+    public void reg_write_batch(int[] regIds, long[] values) throws BackendException {
+        try {
+            unicorn.reg_write_batch(regIds, values);
+        } catch (UnicornException e) {
+            throw new BackendException(e);
+        }
+    }
+
     @Override
     public byte[] mem_read(long address, long size) throws BackendException {
         try {
@@ -121,6 +140,51 @@ class Unicorn2Backend extends AbstractBackend implements Backend {
         }
     }
 
+    @Override
+    public byte[] mem_read_cstring(long address, int max) throws BackendException {
+        try {
+            return unicorn.mem_read_cstring(address, max);
+        } catch (UnicornException e) {
+            throw new BackendException("mem_read_cstring address=0x" + Long.toHexString(address), e);
+        }
+    }
+
+    @Override
+    public int mem_read_u32(long address) throws BackendException {
+        try {
+            return unicorn.mem_read_u32(address);
+        } catch (UnicornException e) {
+            throw new BackendException("mem_read_u32 address=0x" + Long.toHexString(address), e);
+        }
+    }
+
+    @Override
+    public long mem_read_u64(long address) throws BackendException {
+        try {
+            return unicorn.mem_read_u64(address);
+        } catch (UnicornException e) {
+            throw new BackendException("mem_read_u64 address=0x" + Long.toHexString(address), e);
+        }
+    }
+
+    @Override
+    public void mem_write_u32(long address, int value) throws BackendException {
+        try {
+            unicorn.mem_write_u32(address, value);
+        } catch (UnicornException e) {
+            throw new BackendException("mem_write_u32 address=0x" + Long.toHexString(address), e);
+        }
+    }
+
+    @Override
+    public void mem_write_u64(long address, long value) throws BackendException {
+        try {
+            unicorn.mem_write_u64(address, value);
+        } catch (UnicornException e) {
+            throw new BackendException("mem_write_u64 address=0x" + Long.toHexString(address), e);
+        }
+    }
+
     @Override
     public void mem_write(long address, byte[] bytes) throws BackendException {
         try {
@@ -130,6 +194,32 @@ class Unicorn2Backend extends AbstractBackend implements Backend {
         }
     }
 
+    @Override
+    public void mem_read(long address, ByteBuffer dst) throws BackendException {
+        if (!dst.isDirect()) {
+            super.mem_read(address, dst);
+            return;
+        }
+        try {
+            unicorn.mem_read(address, dst);
+        } catch (UnicornException e) {
+            throw new BackendException("mem_read address=0x" + Long.toHexString(address) + ", size=" + dst.remaining(), e);
+        }
+    }
+
+    @Override
+    public void mem_write(long address, ByteBuffer src) throws BackendException {
+        if (!src.isDirect()) {
+            super.mem_write(address, src);
+            return;
+        }
+        try {
+            unicorn.mem_write(address, src);
+        } catch (UnicornException e) {
+            throw new BackendException("mem_write address=0x" + Long.toHexString(address), e);
+        }
+    }
+
     @Override
     public void mem_map(long address, long size, int perms) throws BackendException {
         try {
@@ -383,6 +473,26 @@ class Unicorn2Backend extends AbstractBackend implements Backend {
         }
     }
 
+    @Override
+    public void trace_add(final TraceBufferHook callback, long begin, long end, int types, int capacity, Object user_data) throws BackendException {
+        try {
+            final Unicorn.UnHook unHook = unicorn.trace_add(new com.github.unidbg.arm.backend.unicorn.TraceBufferHook() {
+                @Override
+                public void onTrace(Unicorn u, ByteBuffer records, int count, Object user) {
+                    callback.onTrace(Unicorn2Backend.this, records, count, user);
+                }
+            }, begin, end, types, capacity, user_data);
+            callback.onAttach(new UnHook() {
+                @Override
+                public void unhook() {
+                    unHook.unhook();
+                }
+            });
+        } catch (UnicornException e) {
+            throw new BackendException(e);
+        }
+    }
+
     @Override
     public final synchronized void emu_start(long begin, long until, long timeout, long count) throws BackendException {
         try {
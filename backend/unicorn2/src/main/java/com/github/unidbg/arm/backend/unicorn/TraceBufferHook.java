@@ -0,0 +1,33 @@
+/*
+
+Java bindings for the Unicorn Emulator Engine
+
+Copyright(c) 2015 Chris Eagle
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 2 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+package com.github.unidbg.arm.backend.unicorn;
+
+import java.nio.ByteBuffer;
+
+public interface TraceBufferHook extends Hook {
+
+   /**
+    * @param records <code>count</code> fixed size records in native byte order, only valid during the call
+    */
+   void onTrace(Unicorn u, ByteBuffer records, int count, Object user);
+
+}
@@ -4,6 +4,8 @@ import com.github.unidbg.thread.ThreadContextSwitchException;
 import unicorn.UnicornConst;
 import unicorn.UnicornException;
 
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
 import java.util.ArrayList;
 import java.util.HashMap;
 import java.util.Hashtable;
@@ -116,6 +118,14 @@ public class Unicorn {
             EventMemHook hook = (EventMemHook) function;
             return hook.hook(Unicorn.this, address, size, value, data);
         }
+
+        /**
+         * for trace_add
+         */
+        void onTrace(ByteBuffer records, int count) {
+            TraceBufferHook hook = (TraceBufferHook) function;
+            hook.onTrace(Unicorn.this, records.order(ByteOrder.nativeOrder()), count, data);
+        }
     }
 
     /**
@@ -188,6 +198,30 @@ public class Unicorn {
 
     private static native void reg_write(long handle, int regid, long value) throws UnicornException;
 
+    /**
+     * Read several registers with one call.
+     *
+     * @param regids  Register IDs that are to be retrieved.
+     * @param values  Receives the values of @regids, 32-bit registers are zero-extended.
+     */
+    public void reg_read_batch(int[] regids, long[] values) throws UnicornException {
+        reg_read_batch(nativeHandle, regids, values);
+    }
+
+    private static native void reg_read_batch(long handle, int[] regids, long[] values) throws UnicornException;
+
+    /**
+     * Write several registers with one call.
+     *
+     * @param regids  Register IDs that are to be modified.
+     * @param values  New values of @regids.
+     */
+    public void reg_write_batch(int[] regids, long[] values) throws UnicornException {
+        reg_write_batch(nativeHandle, regids, values);
+    }
+
+    private static native void reg_write_batch(long handle, int[] regids, long[] values) throws UnicornException;
+
     public UnHook registerEmuCountHook(long emu_count) {
         NewHook hook = new NewHook(new CodeHook() {
             @Override
@@ -213,6 +247,41 @@ public class Unicorn {
 
     private static native byte[] mem_read(long handle, long address, long size) throws UnicornException;
 
+    /**
+     * Read a NUL terminated string, without its terminator.
+     *
+     * @param  max  At most that many bytes are read when there is no terminator.
+     */
+    public byte[] mem_read_cstring(long address, int max) throws UnicornException {
+        return mem_read_cstring(nativeHandle, address, max);
+    }
+
+    private static native byte[] mem_read_cstring(long handle, long address, int max) throws UnicornException;
+
+    /**
+     * Little-endian primitive accessors, they do not allocate.
+     */
+    public int mem_read_u32(long address) throws UnicornException {
+        return mem_read_u32(nativeHandle, address);
+    }
+
+    public long mem_read_u64(long address) throws UnicornException {
+        return mem_read_u64(nativeHandle, address);
+    }
+
+    public void mem_write_u32(long address, int value) throws UnicornException {
+        mem_write_u32(nativeHandle, address, value);
+    }
+
+    public void mem_write_u64(long address, long value) throws UnicornException {
+        mem_write_u64(nativeHandle, address, value);
+    }
+
+    private static native int mem_read_u32(long handle, long address) throws UnicornException;
+    private static native long mem_read_u64(long handle, long address) throws UnicornException;
+    private static native void mem_write_u32(long handle, long address, int value) throws UnicornException;
+    private static native void mem_write_u64(long handle, long address, long value) throws UnicornException;
+
     /**
      * Write to memory.
      *
@@ -225,6 +294,24 @@ public class Unicorn {
 
     private static native void mem_write(long handle, long address, byte[] bytes) throws UnicornException;
 
+    /**
+     * Read memory contents into a direct buffer, from its position to its limit.
+     */
+    public void mem_read(long address, ByteBuffer buffer) throws UnicornException {
+        mem_read_direct(nativeHandle, address, buffer, buffer.position(), buffer.remaining());
+    }
+
+    private static native void mem_read_direct(long handle, long address, ByteBuffer buffer, int offset, int size) throws UnicornException;
+
+    /**
+     * Write the contents of a direct buffer, from its position to its limit.
+     */
+    public void mem_write(long address, ByteBuffer buffer) throws UnicornException {
+        mem_write_direct(nativeHandle, address, buffer, buffer.position(), buffer.remaining());
+    }
+
+    private static native void mem_write_direct(long handle, long address, ByteBuffer buffer, int offset, int size) throws UnicornException;
+
     /**
      * Map a range of memory.
      *
@@ -431,6 +518,20 @@ public class Unicorn {
         return new UnHook(handle);
     }
 
+    /**
+     * Appends a fixed size record per traced instruction and memory access to a native buffer of <code>capacity</code> records,
+     * which is handed to <code>callback</code> when it fills and when emulation stops. Only one trace can be active.
+     *
+     * @param types combination of TRACE_CODE(1), TRACE_READ(2) and TRACE_WRITE(4)
+     */
+    public UnHook trace_add(TraceBufferHook callback, long begin, long end, int types, int capacity, Object user_data) throws UnicornException {
+        NewHook hook = new NewHook(callback, user_data);
+        long handle = trace_add(nativeHandle, begin, end, types, capacity, hook);
+        return new UnHook(handle);
+    }
+
+    private static native long trace_add(long handle, long begin, long end, int types, int capacity, NewHook hook) throws UnicornException;
+
     private final List<UnHook> newHookList = new ArrayList<>();
     private final long nativeHandle;
 
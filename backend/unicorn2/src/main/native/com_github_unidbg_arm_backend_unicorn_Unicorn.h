@@ -63,6 +63,22 @@ JNIEXPORT jlong JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_reg_1
 JNIEXPORT void JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_reg_1write__JIJ
   (JNIEnv *, jclass, jlong, jint, jlong);
 
+/*
+ * Class:     com_github_unidbg_arm_backend_unicorn_Unicorn
+ * Method:    reg_read_batch
+ * Signature: (J[I[J)V
+ */
+JNIEXPORT void JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_reg_1read_1batch
+  (JNIEnv *, jclass, jlong, jintArray, jlongArray);
+
+/*
+ * Class:     com_github_unidbg_arm_backend_unicorn_Unicorn
+ * Method:    reg_write_batch
+ * Signature: (J[I[J)V
+ */
+JNIEXPORT void JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_reg_1write_1batch
+  (JNIEnv *, jclass, jlong, jintArray, jlongArray);
+
 /*
  * Class:     com_github_unidbg_arm_backend_unicorn_Unicorn
  * Method:    register_emu_count_hook
@@ -79,6 +95,62 @@ JNIEXPORT jlong JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_regis
 JNIEXPORT jbyteArray JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_mem_1read
   (JNIEnv *, jclass, jlong, jlong, jlong);
 
+/*
+ * Class:     com_github_unidbg_arm_backend_unicorn_Unicorn
+ * Method:    mem_read_cstring
+ * Signature: (JJI)[B
+ */
+JNIEXPORT jbyteArray JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_mem_1read_1cstring
+  (JNIEnv *, jclass, jlong, jlong, jint);
+
+/*
+ * Class:     com_github_unidbg_arm_backend_unicorn_Unicorn
+ * Method:    mem_read_u32
+ * Signature: (JJ)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_mem_1read_1u32
+  (JNIEnv *, jclass, jlong, jlong);
+
+/*
+ * Class:     com_github_unidbg_arm_backend_unicorn_Unicorn
+ * Method:    mem_read_u64
+ * Signature: (JJ)J
+ */
+JNIEXPORT jlong JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_mem_1read_1u64
+  (JNIEnv *, jclass, jlong, jlong);
+
+/*
+ * Class:     com_github_unidbg_arm_backend_unicorn_Unicorn
+ * Method:    mem_write_u32
+ * Signature: (JJI)V
+ */
+JNIEXPORT void JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_mem_1write_1u32
+  (JNIEnv *, jclass, jlong, jlong, jint);
+
+/*
+ * Class:     com_github_unidbg_arm_backend_unicorn_Unicorn
+ * Method:    mem_write_u64
+ * Signature: (JJJ)V
+ */
+JNIEXPORT void JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_mem_1write_1u64
+  (JNIEnv *, jclass, jlong, jlong, jlong);
+
+/*
+ * Class:     com_github_unidbg_arm_backend_unicorn_Unicorn
+ * Method:    mem_read_direct
+ * Signature: (JJLjava/nio/ByteBuffer;II)V
+ */
+JNIEXPORT void JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_mem_1read_1direct
+  (JNIEnv *, jclass, jlong, jlong, jobject, jint, jint);
+
+/*
+ * Class:     com_github_unidbg_arm_backend_unicorn_Unicorn
+ * Method:    mem_write_direct
+ * Signature: (JJLjava/nio/ByteBuffer;II)V
+ */
+JNIEXPORT void JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_mem_1write_1direct
+  (JNIEnv *, jclass, jlong, jlong, jobject, jint, jint);
+
 /*
  * Class:     com_github_unidbg_arm_backend_unicorn_Unicorn
  * Method:    mem_write
@@ -159,6 +231,14 @@ JNIEXPORT jlong JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_regis
 JNIEXPORT jlong JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_registerHook__JILcom_github_unidbg_arm_backend_unicorn_Unicorn_NewHook_2
   (JNIEnv *, jclass, jlong, jint, jobject);
 
+/*
+ * Class:     com_github_unidbg_arm_backend_unicorn_Unicorn
+ * Method:    trace_add
+ * Signature: (JJJIILcom/github/unidbg/arm/backend/unicorn/Unicorn/NewHook;)J
+ */
+JNIEXPORT jlong JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_trace_1add
+  (JNIEnv *, jclass, jlong, jlong, jlong, jint, jint, jobject);
+
 /*
  * Class:     com_github_unidbg_arm_backend_unicorn_Unicorn
  * Method:    registerDebugger
@@ -9,6 +9,7 @@ static jmethodID onRead = 0;
 static jmethodID onWrite = 0;
 static jmethodID onInterrupt = 0;
 static jmethodID onMemEvent = 0;
+static jmethodID onTrace = 0;
 
 static void throwException(JNIEnv *env, uc_err err) {
    if (err != UC_ERR_OK) {
@@ -42,6 +43,103 @@ static inline bool hitBreakPoint(uint64_t bps[], int n, uint64_t address) {
     return false;
 }
 
+static void cb_debugger(uc_engine *eng, uint64_t address, uint32_t size, void *user_data) {
+    struct new_hook *nh = (struct new_hook *) user_data;
+    JNIEnv *env = nh->unicorn->env;
+    int n;
+
+    if(nh->unicorn->skip_hook) {
+        nh->unicorn->skip_hook = false;
+        return;
+    }
+
+    if((nh->unicorn->singleStep > 0 && --nh->unicorn->singleStep == 0) || ((n = kh_size(nh->unicorn->bps_map)) > 0 && (n > SEARCH_BPS_COUNT ? (kh_get(64, nh->unicorn->bps_map, address) != kh_end(nh->unicorn->bps_map)) : hitBreakPoint(nh->unicorn->bps, n, address)))) {
+        (*env)->CallVoidMethod(env, nh->hook, onBreak, (jlong)address, (int)size);
+    } else if(nh->unicorn->fastDebug != JNI_TRUE) {
+        (*env)->CallVoidMethod(env, nh->hook, onCode, (jlong)address, (int)size);
+    }
+}
+
+static void cb_breakpoint(uc_engine *eng, uint64_t address, uint32_t size, void *user_data) {
+    struct new_hook *nh = (struct new_hook *) user_data;
+    t_unicorn unicorn = nh->unicorn;
+    if(nh->hh) {
+        return; // cb_debugger checks the breakpoints itself
+    }
+
+    JNIEnv *env = unicorn->env;
+    unicorn->breaking = true;
+    (*env)->CallVoidMethod(env, nh->hook, onBreak, (jlong)address, (int)size);
+    unicorn->breaking = false;
+}
+
+// a hook bounded to the breakpoint, so only its block is translated with a callback
+static uc_hook add_breakpoint_hook(t_unicorn unicorn, uint64_t address) {
+    uc_hook hh = 0;
+    if(unicorn->debugger) {
+        uc_err err = uc_hook_add(unicorn->uc, &hh, UC_HOOK_CODE, cb_breakpoint, unicorn->debugger, address, address);
+        if(err != UC_ERR_OK) {
+            fprintf(stderr, "add breakpoint hook failed[%s->%s:%d]: address=0x%llx, err=%d\n", __FILE__, __func__, __LINE__, (unsigned long long)address, err);
+            return 0;
+        }
+        uc_ctl_remove_cache(unicorn->uc, address, address + 4);
+    }
+    return hh;
+}
+
+static void remove_breakpoint_hook(t_unicorn unicorn, uint64_t address, uc_hook hh) {
+    if(hh) {
+        uc_hook_del(unicorn->uc, hh);
+        uc_ctl_remove_cache(unicorn->uc, address, address + 4);
+    }
+}
+
+static uint64_t read_pc(t_unicorn unicorn) {
+    if(unicorn->arch == UC_ARCH_ARM64) {
+        uint64_t pc = 0;
+        uc_reg_read(unicorn->uc, UC_ARM64_REG_PC, &pc);
+        return pc;
+    } else {
+        uint32_t pc = 0;
+        uint32_t cpsr = 0;
+        uc_reg_read(unicorn->uc, UC_ARM_REG_PC, &pc);
+        uc_reg_read(unicorn->uc, UC_ARM_REG_CPSR, &cpsr);
+        return pc | ((cpsr >> 5) & 1); // thumb
+    }
+}
+
+/*
+ * The per instruction hook costs a callback on every instruction, so it is only installed while single stepping
+ * or when onCode is wanted. Blocks translated before it was added have no call to it: when it is added during
+ * emulation, emulation stops and emu_start resumes from pc after flushing the translation cache.
+ */
+static void update_debug_hook(t_unicorn unicorn) {
+    struct new_hook *nh = unicorn->debugger;
+    if(nh == NULL) {
+        return;
+    }
+    bool need = unicorn->singleStep > 0 || unicorn->fastDebug != JNI_TRUE;
+    if(need && !nh->hh) {
+        uc_err err = uc_hook_add(unicorn->uc, &nh->hh, UC_HOOK_CODE, cb_debugger, nh, unicorn->debug_begin, unicorn->debug_end);
+        if(err != UC_ERR_OK) {
+            fprintf(stderr, "add debug hook failed[%s->%s:%d]: err=%d\n", __FILE__, __func__, __LINE__, err);
+            nh->hh = 0;
+            return;
+        }
+        if(unicorn->env) {
+            unicorn->restart = true;
+            unicorn->skip_hook = unicorn->breaking;
+            uc_emu_stop(unicorn->uc);
+        } else {
+            uc_ctl_flush_tb(unicorn->uc);
+        }
+    } else if(!need && nh->hh && !unicorn->env) {
+        uc_hook_del(unicorn->uc, nh->hh);
+        nh->hh = 0;
+        uc_ctl_flush_tb(unicorn->uc);
+    }
+}
+
 /*
  * Class:     com_github_unidbg_arm_backend_unicorn_Unicorn
  * Method:    nativeInitialize
@@ -70,6 +168,7 @@ JNIEXPORT jlong JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_nativ
     memset(unicorn, 0, sizeof(struct unicorn));
     unicorn->bps_map = kh_init(64);
     unicorn->uc = eng;
+    unicorn->arch = (uc_arch) arch;
     unicorn->singleStep = 0;
     unicorn->fastDebug = JNI_TRUE;
     return (jlong) unicorn;
@@ -126,45 +225,97 @@ JNIEXPORT void JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_reg_1w
   }
 }
 
+#define REG_BATCH_SIZE 32 // registers passed to unicorn per call
+
+/*
+ * Class:     com_github_unidbg_arm_backend_unicorn_Unicorn
+ * Method:    reg_read_batch
+ * Signature: (J[I[J)V
+ */
+JNIEXPORT void JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_reg_1read_1batch
+  (JNIEnv *env, jclass cls, jlong handle, jintArray regids, jlongArray values) {
+  t_unicorn unicorn = (t_unicorn) handle;
+  uc_engine *eng = unicorn->uc;
+
+  int ids[REG_BATCH_SIZE];
+  jlong vals[REG_BATCH_SIZE];
+  void *ptrs[REG_BATCH_SIZE];
+  jsize count = (*env)->GetArrayLength(env, regids);
+  for(jsize off = 0; off < count; off += REG_BATCH_SIZE) {
+    int n = count - off < REG_BATCH_SIZE ? count - off : REG_BATCH_SIZE;
+    (*env)->GetIntArrayRegion(env, regids, off, n, (jint *) ids);
+    for(int i = 0; i < n; i++) {
+      vals[i] = 0; // 32-bit registers only fill the low half
+      ptrs[i] = &vals[i];
+    }
+    uc_err err = uc_reg_read_batch(eng, ids, ptrs, n);
+    if (err != UC_ERR_OK) {
+      throwException(env, err);
+      return;
+    }
+    (*env)->SetLongArrayRegion(env, values, off, n, vals);
+  }
+}
+
+/*
+ * Class:     com_github_unidbg_arm_backend_unicorn_Unicorn
+ * Method:    reg_write_batch
+ * Signature: (J[I[J)V
+ */
+JNIEXPORT void JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_reg_1write_1batch
+  (JNIEnv *env, jclass cls, jlong handle, jintArray regids, jlongArray values) {
+  t_unicorn unicorn = (t_unicorn) handle;
+  uc_engine *eng = unicorn->uc;
+
+  int ids[REG_BATCH_SIZE];
+  jlong vals[REG_BATCH_SIZE];
+  void *ptrs[REG_BATCH_SIZE];
+  jsize count = (*env)->GetArrayLength(env, regids);
+  for(jsize off = 0; off < count; off += REG_BATCH_SIZE) {
+    int n = count - off < REG_BATCH_SIZE ? count - off : REG_BATCH_SIZE;
+    (*env)->GetIntArrayRegion(env, regids, off, n, (jint *) ids);
+    (*env)->GetLongArrayRegion(env, values, off, n, vals);
+    for(int i = 0; i < n; i++) {
+      ptrs[i] = &vals[i];
+    }
+    uc_err err = uc_reg_write_batch(eng, ids, (void *const *) ptrs, n);
+    if (err != UC_ERR_OK) {
+      throwException(env, err);
+      return;
+    }
+  }
+}
+
 static void cb_hookintr_new(uc_engine *eng, uint32_t intno, void *user_data) {
    struct new_hook *nh = (struct new_hook *) user_data;
-   JNIEnv *env;
-   (*cachedJVM)->AttachCurrentThread(cachedJVM, (void **)&env, NULL);
+   JNIEnv *env = nh->unicorn->env;
    (*env)->CallVoidMethod(env, nh->hook, onInterrupt, (int)intno);
-   (*cachedJVM)->DetachCurrentThread(cachedJVM);
 }
 
 static bool cb_eventmem_new(uc_engine *eng, uc_mem_type type,
                         uint64_t address, int size, int64_t value, void *user_data) {
    struct new_hook *nh = (struct new_hook *) user_data;
-   JNIEnv *env;
-   (*cachedJVM)->AttachCurrentThread(cachedJVM, (void **)&env, NULL);
+   JNIEnv *env = nh->unicorn->env;
    jboolean res = (*env)->CallBooleanMethod(env, nh->hook, onMemEvent, (int)type, (jlong)address, (int)size, (jlong)value);
-   (*cachedJVM)->DetachCurrentThread(cachedJVM);
    return res;
 }
 
 static void cb_hookcode_new(uc_engine *eng, uint64_t address, uint32_t size, void *user_data) {
    struct new_hook *nh = (struct new_hook *) user_data;
-   JNIEnv *env;
-   (*cachedJVM)->AttachCurrentThread(cachedJVM, (void **)&env, NULL);
+   JNIEnv *env = nh->unicorn->env;
    (*env)->CallVoidMethod(env, nh->hook, onCode, (jlong)address, (int)size);
-   (*cachedJVM)->DetachCurrentThread(cachedJVM);
 }
 
 static void cb_hookblock_new(uc_engine *eng, uint64_t address, uint32_t size, void *user_data) {
    struct new_hook *nh = (struct new_hook *) user_data;
-   JNIEnv *env;
-   (*cachedJVM)->AttachCurrentThread(cachedJVM, (void **)&env, NULL);
+   JNIEnv *env = nh->unicorn->env;
    (*env)->CallVoidMethod(env, nh->hook, onBlock, (jlong)address, (int)size);
-   (*cachedJVM)->DetachCurrentThread(cachedJVM);
 }
 
 static void cb_hookmem_new(uc_engine *eng, uc_mem_type type,
         uint64_t address, int size, int64_t value, void *user_data) {
    struct new_hook *nh = (struct new_hook *) user_data;
-   JNIEnv *env;
-   (*cachedJVM)->AttachCurrentThread(cachedJVM, (void **)&env, NULL);
+   JNIEnv *env = nh->unicorn->env;
    switch (type) {
       case UC_MEM_READ:
          (*env)->CallVoidMethod(env, nh->hook, onRead, (jlong)address, (int)size);
@@ -175,7 +326,70 @@ static void cb_hookmem_new(uc_engine *eng, uc_mem_type type,
       default:
          break;
    }
-   (*cachedJVM)->DetachCurrentThread(cachedJVM);
+}
+
+/*
+ * Hands the buffered records to java and returns false when an exception is pending afterwards, the one thrown
+ * by the hook or an earlier one. No java method may be called while an exception is pending, the records are dropped then.
+ */
+static bool flush_trace(JNIEnv *env, struct new_hook *nh) {
+   struct trace *trace = nh->trace;
+   jint count = trace->count;
+   trace->count = 0;
+   if ((*env)->ExceptionCheck(env)) {
+      return false;
+   }
+   if (count > 0) {
+      (*env)->CallVoidMethod(env, nh->hook, onTrace, trace->buffer, count);
+   }
+   return !(*env)->ExceptionCheck(env);
+}
+
+static inline struct trace_record *next_trace_record(struct new_hook *nh) {
+   struct trace *trace = nh->trace;
+   if (trace->count == trace->capacity && !flush_trace(nh->unicorn->env, nh)) {
+      uc_emu_stop(nh->unicorn->uc); // emu_start returns with the exception pending
+   }
+   return &trace->records[trace->count++];
+}
+
+static void cb_trace_code(uc_engine *eng, uint64_t address, uint32_t size, void *user_data) {
+   struct trace_record *record = next_trace_record((struct new_hook *) user_data);
+   record->address = address;
+   record->value = 0;
+   record->size = size;
+   record->type = TRACE_CODE;
+}
+
+static void cb_trace_mem(uc_engine *eng, uc_mem_type type,
+        uint64_t address, int size, int64_t value, void *user_data) {
+   struct trace_record *record = next_trace_record((struct new_hook *) user_data);
+   record->address = address;
+   record->size = size;
+   if (type == UC_MEM_WRITE) {
+      record->value = value;
+      record->type = TRACE_WRITE;
+   } else {
+      uint64_t data = 0; // the hook runs before the load, so memory still holds the value read
+      if (size <= sizeof(data)) {
+         uc_mem_read(eng, address, &data, size);
+      }
+      record->value = data;
+      record->type = TRACE_READ;
+   }
+}
+
+static void destroy_trace(JNIEnv *env, struct new_hook *nh) {
+   struct trace *trace = nh->trace;
+   flush_trace(env, nh); // an exception of the hook stays pending, the trace is released regardless
+   if (trace->mem_hook) {
+      uc_hook_del(nh->unicorn->uc, trace->mem_hook);
+   }
+   (*env)->DeleteGlobalRef(env, trace->buffer);
+   free(trace->records);
+   free(trace);
+   nh->trace = NULL;
+   nh->unicorn->trace = NULL;
 }
 
 /*
@@ -210,7 +424,7 @@ JNIEXPORT jlong JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_regis
     uint64_t begin = (uint64_t) arg1;
     uint64_t end = (uint64_t) arg2;
 
-    struct new_hook *nh = malloc(sizeof(struct new_hook));
+    struct new_hook *nh = calloc(1, sizeof(struct new_hook));
     nh->hook = (*env)->NewGlobalRef(env, hook);
     nh->unicorn = unicorn;
 
@@ -240,19 +454,25 @@ JNIEXPORT jlong JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_regis
     return (jlong)nh;
 }
 
+/*
+ * Counts whole blocks before they run, in 4 byte instruction units, or 2 byte units for Thumb code so that a
+ * Thumb block never counts fewer than its instructions, and no per instruction callback is translated in.
+ * The block that crosses the budget still runs: emulation stops at the next block boundary.
+ */
 static void hook_count_cb(struct uc_struct *uc, uint64_t address, uint32_t size, void *user_data) {
     struct new_hook *nh = (struct new_hook *) user_data;
 
-    // count this instruction. ah ah ah.
-    nh->unicorn->emu_counter++;
-
-    if (nh->unicorn->emu_counter > nh->unicorn->emu_count) {
+    if (nh->unicorn->emu_counter < nh->unicorn->emu_count) {
+        size_t mode = UC_MODE_ARM;
+        if (nh->unicorn->arch == UC_ARCH_ARM) {
+            uc_query(uc, UC_QUERY_MODE, &mode); // the mode follows interworking branches
+        }
+        nh->unicorn->emu_counter += (mode & UC_MODE_THUMB) ? (size + 1) / 2 : (size + 3) / 4;
+    } else {
         uc_emu_stop(uc);
 
-        JNIEnv *env;
-        (*cachedJVM)->AttachCurrentThread(cachedJVM, (void **)&env, NULL);
+        JNIEnv *env = nh->unicorn->env;
         (*env)->CallVoidMethod(env, nh->hook, onCode, (jlong)address, (int)size);
-        (*cachedJVM)->DetachCurrentThread(cachedJVM);
     }
 }
 
@@ -267,11 +487,11 @@ JNIEXPORT jlong JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_regis
   unicorn->emu_count = emu_count;
 
   if (emu_count > 0 && unicorn->count_hook == 0) {
-    struct new_hook *nh = malloc(sizeof(struct new_hook));
+    struct new_hook *nh = calloc(1, sizeof(struct new_hook));
     nh->hook = (*env)->NewGlobalRef(env, hook);
     nh->unicorn = unicorn;
 
-    uc_err err = uc_hook_add(unicorn->uc, &unicorn->count_hook, UC_HOOK_CODE, hook_count_cb, nh, 1, 0);
+    uc_err err = uc_hook_add(unicorn->uc, &unicorn->count_hook, UC_HOOK_BLOCK, hook_count_cb, nh, 1, 0);
     if (err != UC_ERR_OK) {
       (*env)->DeleteGlobalRef(env, nh->hook);
       free(nh);
@@ -299,7 +519,7 @@ JNIEXPORT jlong JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_regis
   uc_hook hh = 0;
   uc_err err = UC_ERR_OK;
 
-  struct new_hook *nh = malloc(sizeof(struct new_hook));
+  struct new_hook *nh = calloc(1, sizeof(struct new_hook));
   nh->hook = (*env)->NewGlobalRef(env, hook);
   nh->unicorn = unicorn;
 
@@ -328,6 +548,60 @@ JNIEXPORT jlong JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_regis
   return (jlong)nh;
 }
 
+/*
+ * Class:     com_github_unidbg_arm_backend_unicorn_Unicorn
+ * Method:    trace_add
+ * Signature: (JJJIILcom/github/unidbg/arm/backend/unicorn/Unicorn/NewHook;)J
+ */
+JNIEXPORT jlong JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_trace_1add
+  (JNIEnv *env, jclass cls, jlong handle, jlong begin, jlong end, jint types, jint capacity, jobject hook) {
+  t_unicorn unicorn = (t_unicorn) handle;
+  uc_engine *eng = unicorn->uc;
+  if (unicorn->trace || capacity <= 0 || (types & (TRACE_CODE | TRACE_READ | TRACE_WRITE)) == 0) {
+    throwException(env, UC_ERR_ARG);
+    return 0;
+  }
+
+  struct trace *trace = calloc(1, sizeof(struct trace));
+  trace->records = malloc(capacity * sizeof(struct trace_record));
+  if (trace->records == NULL) {
+    fprintf(stderr, "malloc trace records failed: capacity=%d\n", capacity);
+    free(trace);
+    throwException(env, UC_ERR_NOMEM);
+    return 0;
+  }
+  trace->capacity = capacity;
+  jobject buffer = (*env)->NewDirectByteBuffer(env, trace->records, (jlong) capacity * sizeof(struct trace_record));
+  trace->buffer = (*env)->NewGlobalRef(env, buffer);
+  (*env)->DeleteLocalRef(env, buffer);
+
+  struct new_hook *nh = calloc(1, sizeof(struct new_hook));
+  nh->hook = (*env)->NewGlobalRef(env, hook);
+  nh->unicorn = unicorn;
+  nh->trace = trace;
+  unicorn->trace = nh;
+
+  uc_err err = UC_ERR_OK;
+  if (types & TRACE_CODE) {
+    err = uc_hook_add(eng, &nh->hh, UC_HOOK_CODE, cb_trace_code, nh, begin, end);
+  }
+  if (err == UC_ERR_OK && (types & (TRACE_READ | TRACE_WRITE))) {
+    int type = ((types & TRACE_READ) ? UC_HOOK_MEM_READ : 0) | ((types & TRACE_WRITE) ? UC_HOOK_MEM_WRITE : 0);
+    err = uc_hook_add(eng, &trace->mem_hook, type, cb_trace_mem, nh, begin, end);
+  }
+  if (err != UC_ERR_OK) {
+    destroy_trace(env, nh);
+    if (nh->hh) {
+      uc_hook_del(eng, nh->hh);
+    }
+    (*env)->DeleteGlobalRef(env, nh->hook);
+    free(nh);
+    throwException(env, err);
+    return 0;
+  }
+  return (jlong)nh;
+}
+
 /*
  * Class:     com_github_unidbg_arm_backend_unicorn_Unicorn
  * Method:    mem_write
@@ -369,6 +643,144 @@ JNIEXPORT jbyteArray JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_
    return bytes;
 }
 
+/*
+ * Class:     com_github_unidbg_arm_backend_unicorn_Unicorn
+ * Method:    mem_read_u32
+ * Signature: (JJ)I
+ */
+JNIEXPORT jint JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_mem_1read_1u32
+  (JNIEnv *env, jclass cls, jlong handle, jlong address) {
+  t_unicorn unicorn = (t_unicorn) handle;
+  uint32_t value = 0;
+  throwException(env, uc_mem_read(unicorn->uc, (uint64_t)address, &value, sizeof(value)));
+  return (jint) value;
+}
+
+/*
+ * Class:     com_github_unidbg_arm_backend_unicorn_Unicorn
+ * Method:    mem_read_u64
+ * Signature: (JJ)J
+ */
+JNIEXPORT jlong JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_mem_1read_1u64
+  (JNIEnv *env, jclass cls, jlong handle, jlong address) {
+  t_unicorn unicorn = (t_unicorn) handle;
+  uint64_t value = 0;
+  throwException(env, uc_mem_read(unicorn->uc, (uint64_t)address, &value, sizeof(value)));
+  return (jlong) value;
+}
+
+/*
+ * Class:     com_github_unidbg_arm_backend_unicorn_Unicorn
+ * Method:    mem_write_u32
+ * Signature: (JJI)V
+ */
+JNIEXPORT void JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_mem_1write_1u32
+  (JNIEnv *env, jclass cls, jlong handle, jlong address, jint value) {
+  t_unicorn unicorn = (t_unicorn) handle;
+  throwException(env, uc_mem_write(unicorn->uc, (uint64_t)address, &value, sizeof(value)));
+}
+
+/*
+ * Class:     com_github_unidbg_arm_backend_unicorn_Unicorn
+ * Method:    mem_write_u64
+ * Signature: (JJJ)V
+ */
+JNIEXPORT void JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_mem_1write_1u64
+  (JNIEnv *env, jclass cls, jlong handle, jlong address, jlong value) {
+  t_unicorn unicorn = (t_unicorn) handle;
+  throwException(env, uc_mem_write(unicorn->uc, (uint64_t)address, &value, sizeof(value)));
+}
+
+#define CSTRING_CHUNK 0x400 // smallest guest page size, so a chunk never straddles two mappings
+
+/*
+ * Class:     com_github_unidbg_arm_backend_unicorn_Unicorn
+ * Method:    mem_read_cstring
+ * Signature: (JJI)[B
+ */
+JNIEXPORT jbyteArray JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_mem_1read_1cstring
+  (JNIEnv *env, jclass cls, jlong handle, jlong address, jint max) {
+  t_unicorn unicorn = (t_unicorn) handle;
+  uc_engine *eng = unicorn->uc;
+
+  size_t capacity = CSTRING_CHUNK;
+  char *buf = (char *) malloc(capacity);
+  if(buf == NULL) {
+    fprintf(stderr, "malloc failed[%s->%s:%d]: size=0x%zx\n", __FILE__, __func__, __LINE__, capacity);
+    throwException(env, UC_ERR_NOMEM);
+    return NULL;
+  }
+  size_t length = 0;
+  while(length < (size_t) max) {
+    uint64_t vaddr = (uint64_t) address + length;
+    size_t len = CSTRING_CHUNK - (size_t) (vaddr & (CSTRING_CHUNK - 1));
+    if(len > (size_t) max - length) {
+      len = (size_t) max - length;
+    }
+    if(length + len > capacity) {
+      char *grown = (char *) realloc(buf, capacity * 2);
+      if(grown == NULL) {
+        fprintf(stderr, "realloc failed[%s->%s:%d]: size=0x%zx\n", __FILE__, __func__, __LINE__, capacity * 2);
+        free(buf);
+        throwException(env, UC_ERR_NOMEM);
+        return NULL;
+      }
+      buf = grown;
+      capacity *= 2;
+    }
+    uc_err err = uc_mem_read(eng, vaddr, &buf[length], len);
+    if(err != UC_ERR_OK) {
+      free(buf);
+      throwException(env, err);
+      return NULL;
+    }
+    char *nul = (char *) memchr(&buf[length], 0, len);
+    if(nul) {
+      length = nul - buf;
+      break;
+    }
+    length += len;
+  }
+  jbyteArray bytes = (*env)->NewByteArray(env, (jsize) length);
+  (*env)->SetByteArrayRegion(env, bytes, 0, (jsize) length, (jbyte *) buf);
+  free(buf);
+  return bytes;
+}
+
+/*
+ * Class:     com_github_unidbg_arm_backend_unicorn_Unicorn
+ * Method:    mem_read_direct
+ * Signature: (JJLjava/nio/ByteBuffer;II)V
+ */
+JNIEXPORT void JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_mem_1read_1direct
+  (JNIEnv *env, jclass cls, jlong handle, jlong address, jobject buffer, jint offset, jint size) {
+  t_unicorn unicorn = (t_unicorn) handle;
+  uc_engine *eng = unicorn->uc;
+
+   char *array = (char *) (*env)->GetDirectBufferAddress(env, buffer);
+   uc_err err = array == NULL ? UC_ERR_ARG : uc_mem_read(eng, (uint64_t)address, &array[offset], (size_t)size);
+   if (err != UC_ERR_OK) {
+      throwException(env, err);
+   }
+}
+
+/*
+ * Class:     com_github_unidbg_arm_backend_unicorn_Unicorn
+ * Method:    mem_write_direct
+ * Signature: (JJLjava/nio/ByteBuffer;II)V
+ */
+JNIEXPORT void JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_mem_1write_1direct
+  (JNIEnv *env, jclass cls, jlong handle, jlong address, jobject buffer, jint offset, jint size) {
+  t_unicorn unicorn = (t_unicorn) handle;
+  uc_engine *eng = unicorn->uc;
+
+   char *array = (char *) (*env)->GetDirectBufferAddress(env, buffer);
+   uc_err err = array == NULL ? UC_ERR_ARG : uc_mem_write(eng, (uint64_t)address, &array[offset], (size_t)size);
+   if (err != UC_ERR_OK) {
+      throwException(env, err);
+   }
+}
+
 /*
  * Class:     com_github_unidbg_arm_backend_unicorn_Unicorn
  * Method:    emu_start
@@ -379,8 +791,27 @@ JNIEXPORT void JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_emu_1s
   t_unicorn unicorn = (t_unicorn) handle;
   uc_engine *eng = unicorn->uc;
   unicorn->emu_counter = 0;
-
-   uc_err err = uc_emu_start(eng, (uint64_t)begin, (uint64_t)until, (uint64_t)timeout, (size_t)count);
+  JNIEnv *prev = unicorn->env; // emu_start may nest from a hook
+  if(prev == NULL) {
+    update_debug_hook(unicorn);
+  }
+  unicorn->env = env;
+
+   uint64_t pc = (uint64_t)begin;
+   uc_err err;
+   while (true) {
+      unicorn->restart = false;
+      err = uc_emu_start(eng, pc, (uint64_t)until, (uint64_t)timeout, (size_t)count);
+      if (err != UC_ERR_OK || !unicorn->restart) {
+         break;
+      }
+      uc_ctl_flush_tb(eng);
+      pc = read_pc(unicorn);
+   }
+   unicorn->env = prev;
+   if (unicorn->trace && !flush_trace(env, unicorn->trace)) {
+      return; // the exception thrown by the hook
+   }
    if (err != UC_ERR_OK) {
       throwException(env, err);
    }
@@ -395,6 +826,7 @@ JNIEXPORT void JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_emu_1s
   (JNIEnv *env, jclass cls, jlong handle) {
   t_unicorn unicorn = (t_unicorn) handle;
   uc_engine *eng = unicorn->uc;
+  unicorn->restart = false;
 
    uc_err err = uc_emu_stop(eng);
    if (err != UC_ERR_OK) {
@@ -462,6 +894,19 @@ JNIEXPORT void JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_hook_1
   t_unicorn unicorn = nh->unicorn;
   uc_engine *eng = unicorn->uc;
 
+   if (nh->trace) {
+      destroy_trace(env, nh);
+   }
+   if (nh == unicorn->debugger) {
+      khiter_t k;
+      for (k = kh_begin(unicorn->bps_map); k < kh_end(unicorn->bps_map); k++) {
+         if (kh_exist(unicorn->bps_map, k)) {
+            remove_breakpoint_hook(unicorn, kh_key(unicorn->bps_map, k), kh_value(unicorn->bps_map, k));
+            kh_value(unicorn->bps_map, k) = 0;
+         }
+      }
+      unicorn->debugger = NULL;
+   }
    (*env)->DeleteGlobalRef(env, nh->hook);
    uc_err err = uc_hook_del(eng, nh->hh);
    free(nh);
@@ -571,22 +1016,6 @@ JNIEXPORT void JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_reg_1w
    (*env)->ReleaseByteArrayElements(env, value, array, JNI_ABORT);
 }
 
-static void cb_debugger(uc_engine *eng, uint64_t address, uint32_t size, void *user_data) {
-    struct new_hook *nh = (struct new_hook *) user_data;
-    JNIEnv *env;
-    int n;
-
-    if((nh->unicorn->singleStep > 0 && --nh->unicorn->singleStep == 0) || ((n = kh_size(nh->unicorn->bps_map)) > 0 && (n > SEARCH_BPS_COUNT ? (kh_get(64, nh->unicorn->bps_map, address) != kh_end(nh->unicorn->bps_map)) : hitBreakPoint(nh->unicorn->bps, n, address)))) {
-        (*cachedJVM)->AttachCurrentThread(cachedJVM, (void **)&env, NULL);
-        (*env)->CallVoidMethod(env, nh->hook, onBreak, (jlong)address, (int)size);
-        (*cachedJVM)->DetachCurrentThread(cachedJVM);
-    } else if(nh->unicorn->fastDebug != JNI_TRUE) {
-        (*cachedJVM)->AttachCurrentThread(cachedJVM, (void **)&env, NULL);
-        (*env)->CallVoidMethod(env, nh->hook, onCode, (jlong)address, (int)size);
-        (*cachedJVM)->DetachCurrentThread(cachedJVM);
-    }
-}
-
 /*
  * Class:     com_github_unidbg_arm_backend_unicorn_Unicorn
  * Method:    registerDebugger
@@ -595,26 +1024,25 @@ static void cb_debugger(uc_engine *eng, uint64_t address, uint32_t size, void *u
 JNIEXPORT jlong JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_registerDebugger
   (JNIEnv *env, jclass cls, jlong handle, jlong arg1, jlong arg2, jobject hook) {
   t_unicorn unicorn = (t_unicorn) handle;
-  uc_engine *eng = unicorn->uc;
-
-    uc_hook hh = 0;
-    uint64_t begin = (uint64_t) arg1;
-    uint64_t end = (uint64_t) arg2;
+  if(unicorn->debugger) {
+    throwException(env, UC_ERR_ARG);
+    return 0;
+  }
 
-    struct new_hook *nh = malloc(sizeof(struct new_hook));
+    struct new_hook *nh = calloc(1, sizeof(struct new_hook));
     nh->hook = (*env)->NewGlobalRef(env, hook);
     nh->unicorn = unicorn;
+    unicorn->debugger = nh;
+    unicorn->debug_begin = (uint64_t) arg1;
+    unicorn->debug_end = (uint64_t) arg2;
 
-    uc_err err = uc_hook_add((uc_engine*)eng, &hh, UC_HOOK_CODE, cb_debugger, nh, begin, end);
-    if (err != UC_ERR_OK) {
-      (*env)->DeleteGlobalRef(env, nh->hook);
-      free(nh);
-      throwException(env, err);
-      return 0;
-    } else {
-      nh->hh = hh;
+    khiter_t k;
+    for (k = kh_begin(unicorn->bps_map); k < kh_end(unicorn->bps_map); k++) {
+      if(kh_exist(unicorn->bps_map, k)) {
+        kh_value(unicorn->bps_map, k) = add_breakpoint_hook(unicorn, kh_key(unicorn->bps_map, k));
+      }
     }
-
+    update_debug_hook(unicorn);
     return (jlong)nh;
 }
 
@@ -627,6 +1055,7 @@ JNIEXPORT void JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_setFas
   (JNIEnv *env, jclass cls, jlong handle, jboolean fastDebug) {
   t_unicorn unicorn = (t_unicorn) handle;
   unicorn->fastDebug = fastDebug;
+  update_debug_hook(unicorn);
 }
 
 /*
@@ -638,6 +1067,7 @@ JNIEXPORT void JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_setSin
   (JNIEnv *env, jclass cls, jlong handle, jint singleStep) {
   t_unicorn unicorn = (t_unicorn) handle;
   unicorn->singleStep = singleStep;
+  update_debug_hook(unicorn);
 }
 
 /*
@@ -650,7 +1080,9 @@ JNIEXPORT void JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_addBre
   t_unicorn unicorn = (t_unicorn) handle;
     int ret;
     khiter_t k = kh_put(64, unicorn->bps_map, address, &ret);
-    kh_value(unicorn->bps_map, k) = 1;
+    if(ret != 0) {
+      kh_value(unicorn->bps_map, k) = add_breakpoint_hook(unicorn, address);
+    }
     update_bps(unicorn);
 }
 
@@ -663,7 +1095,10 @@ JNIEXPORT void JNICALL Java_com_github_unidbg_arm_backend_unicorn_Unicorn_remove
   (JNIEnv *env, jclass cls, jlong handle, jlong address) {
   t_unicorn unicorn = (t_unicorn) handle;
     khiter_t k = kh_get(64, unicorn->bps_map, address);
-    kh_del(64, unicorn->bps_map, k);
+    if(k != kh_end(unicorn->bps_map)) {
+      remove_breakpoint_hook(unicorn, address, kh_value(unicorn->bps_map, k));
+      kh_del(64, unicorn->bps_map, k);
+    }
     update_bps(unicorn);
 }
 
@@ -693,6 +1128,7 @@ JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM *jvm, void *reserved) {
     onWrite = (*env)->GetMethodID(env, newHookClass, "onWrite", "(JIJ)V");
     onInterrupt = (*env)->GetMethodID(env, newHookClass, "onInterrupt", "(I)V");
     onMemEvent = (*env)->GetMethodID(env, newHookClass, "onMemEvent", "(IJIJ)Z");
+    onTrace = (*env)->GetMethodID(env, newHookClass, "onTrace", "(Ljava/nio/ByteBuffer;I)V");
 
     int len = sizeof(s_methods) / sizeof(s_methods[0]);
     if ((*env)->RegisterNatives(env, clz, s_methods, len)) {
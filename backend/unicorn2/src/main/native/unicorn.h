@@ -4,23 +4,53 @@
 
 #define SEARCH_BPS_COUNT 8
 
-KHASH_MAP_INIT_INT64(64, char)
+KHASH_MAP_INIT_INT64(64, uc_hook) // breakpoint address -> its code hook, 0 without a debugger
+
+// record types and the trace_add types mask, see TraceBufferHook
+#define TRACE_CODE 1
+#define TRACE_READ 2
+#define TRACE_WRITE 4
+
+struct trace_record {
+  uint64_t address; // pc for code records, accessed address otherwise
+  uint64_t value;
+  uint32_t size;
+  uint32_t type;
+};
+
+struct trace {
+  struct trace_record *records;
+  jint capacity;
+  jint count;
+  jobject buffer; // direct ByteBuffer over records, handed to java when full and when emulation stops
+  uc_hook mem_hook;
+};
 
 typedef struct unicorn {
   khash_t(64) *bps_map;
   uint64_t bps[SEARCH_BPS_COUNT];
   uc_engine *uc;
+  uc_arch arch;
   jint singleStep;
   jboolean fastDebug;
+  struct new_hook *debugger; // its hh is the per instruction hook, only installed to single step or without fastDebug
+  uint64_t debug_begin;
+  uint64_t debug_end;
+  bool breaking; // inside the onBreak upcall of a breakpoint hook
+  bool restart; // emu_start resumes from pc once the per instruction hook is translated in
+  bool skip_hook; // the instruction emulation resumes at has already been reported
   uc_hook count_hook;
   uint64_t emu_count;
   uint64_t emu_counter;
+  JNIEnv *env; // the thread running emu_start, which is already attached
+  struct new_hook *trace;
 } *t_unicorn;
 
 struct new_hook {
     uc_hook hh;
     jobject hook;
     t_unicorn unicorn;
+    struct trace *trace;
 };
 
 void armeb_uc_init() {
@@ -11,6 +11,7 @@ import com.github.unidbg.arm.ArmSvc;
 import com.github.unidbg.arm.ThumbSvc;
 import com.github.unidbg.arm.backend.Backend;
 import com.github.unidbg.arm.backend.BackendException;
+import com.github.unidbg.arm.backend.NativeSyscall;
 import com.github.unidbg.arm.context.Arm32RegisterContext;
 import com.github.unidbg.arm.context.RegisterContext;
 import com.github.unidbg.file.FileIO;
@@ -1713,6 +1714,15 @@ public class ARM32SyscallHandler extends AndroidSyscallHandler {
 
     private final long nanoTime = System.nanoTime();
 
+    @Override
+    public boolean registerNativeSyscalls(Emulator<?> emulator) {
+        Backend backend = emulator.getBackend();
+        return backend.registerNativeSyscall(20, NativeSyscall.constant(emulator.getPid())) && // getpid
+                backend.registerNativeSyscall(220, NativeSyscall.constant(0)) && // madvise
+                backend.registerNativeSyscall(263, NativeSyscall.clock_gettime(System.currentTimeMillis() * 1000000L, System.nanoTime() - nanoTime)) &&
+                backend.registerNativeSyscall(78, NativeSyscall.gettimeofday(currentTimeMillis() * 1000000L));
+    }
+
     protected int clock_gettime(Backend backend, Emulator<?> emulator) {
         int clk_id = backend.reg_read(ArmConst.UC_ARM_REG_R0).intValue();
         Pointer tp = UnidbgPointer.register(emulator, ArmConst.UC_ARM_REG_R1);
@@ -10,7 +10,9 @@ import com.github.unidbg.arm.ARMEmulator;
 import com.github.unidbg.arm.Arm64Svc;
 import com.github.unidbg.arm.backend.Backend;
 import com.github.unidbg.arm.backend.BackendException;
+import com.github.unidbg.arm.backend.NativeSyscall;
 import com.github.unidbg.arm.context.Arm64RegisterContext;
+import com.github.unidbg.arm.context.BackendArm64RegisterContext;
 import com.github.unidbg.arm.context.RegisterContext;
 import com.github.unidbg.file.FileIO;
 import com.github.unidbg.file.FileResult;
@@ -58,6 +60,21 @@ public class ARM64SyscallHandler extends AndroidSyscallHandler {
 
     private static final Logger log = LoggerFactory.getLogger(ARM64SyscallHandler.class);
 
+    /**
+     * Registers every svc needs, read with one backend call: the arguments, stack and return address served by the
+     * register context, then pc, syscall number, callback marker and callback svc number.
+     */
+    private static final int[] SVC_REGS = BackendArm64RegisterContext.syscallRegs(
+            Arm64Const.UC_ARM64_REG_PC,
+            Arm64Const.UC_ARM64_REG_X8,
+            Arm64Const.UC_ARM64_REG_X16,
+            Arm64Const.UC_ARM64_REG_X12);
+
+    private static final int SVC_PC = BackendArm64RegisterContext.SYSCALL_REG_COUNT;
+    private static final int SVC_NR = SVC_PC + 1;
+    private static final int SVC_MARKER = SVC_PC + 2;
+    private static final int SVC_NUMBER = SVC_PC + 3;
+
     private final SvcMemory svcMemory;
 
     public ARM64SyscallHandler(SvcMemory svcMemory) {
@@ -70,7 +87,24 @@ public class ARM64SyscallHandler extends AndroidSyscallHandler {
     @Override
     public void hook(Backend backend, int intno, int swi, Object user) {
         Emulator<AndroidFileIO> emulator = (Emulator<AndroidFileIO>) user;
-        UnidbgPointer pc = UnidbgPointer.register(emulator, Arm64Const.UC_ARM64_REG_PC);
+        RegisterContext registerContext = emulator.getContext();
+        if (!(registerContext instanceof BackendArm64RegisterContext)) { // no cache to fill, the handlers read every register from the backend
+            long[] regs = new long[SVC_REGS.length];
+            backend.reg_read_batch(SVC_REGS, regs);
+            hook(backend, intno, swi, emulator, regs);
+            return;
+        }
+        BackendArm64RegisterContext context = (BackendArm64RegisterContext) registerContext;
+        long[] regs = context.enterSyscall(SVC_REGS);
+        try {
+            hook(backend, intno, swi, emulator, regs);
+        } finally {
+            context.leaveSyscall();
+        }
+    }
+
+    private void hook(Backend backend, int intno, int swi, Emulator<AndroidFileIO> emulator, long[] regs) {
+        UnidbgPointer pc = UnidbgPointer.pointer(emulator, regs[SVC_PC]);
 
         if (intno == ARMEmulator.EXCP_BKPT) { // brk
             createBreaker(emulator).brk(pc, pc == null ? swi : (pc.getInt(0) >> 5) & 0xffff);
@@ -85,12 +119,12 @@ public class ARM64SyscallHandler extends AndroidSyscallHandler {
             throw new BackendException("intno=" + intno);
         }
 
-        int NR = backend.reg_read(Arm64Const.UC_ARM64_REG_X8).intValue();
+        int NR = (int) regs[SVC_NR];
         String syscall = null;
         Throwable exception = null;
         try {
-            if (swi == 0 && NR == 0 && backend.reg_read(Arm64Const.UC_ARM64_REG_X16).intValue() == Svc.POST_CALLBACK_SYSCALL_NUMBER) { // postCallback
-                int number = backend.reg_read(Arm64Const.UC_ARM64_REG_X12).intValue();
+            if (swi == 0 && NR == 0 && (int) regs[SVC_MARKER] == Svc.POST_CALLBACK_SYSCALL_NUMBER) { // postCallback
+                int number = (int) regs[SVC_NUMBER];
                 Svc svc = svcMemory.getSvc(number);
                 if (svc != null) {
                     svc.handlePostCallback(emulator);
@@ -99,8 +133,8 @@ public class ARM64SyscallHandler extends AndroidSyscallHandler {
                 backend.emu_stop();
                 throw new IllegalStateException("svc number: " + swi);
             }
-            if (swi == 0 && NR == 0 && backend.reg_read(Arm64Const.UC_ARM64_REG_X16).intValue() == Svc.PRE_CALLBACK_SYSCALL_NUMBER) { // preCallback
-                int number = backend.reg_read(Arm64Const.UC_ARM64_REG_X12).intValue();
+            if (swi == 0 && NR == 0 && (int) regs[SVC_MARKER] == Svc.PRE_CALLBACK_SYSCALL_NUMBER) { // preCallback
+                int number = (int) regs[SVC_NUMBER];
                 Svc svc = svcMemory.getSvc(number);
                 if (svc != null) {
                     svc.handlePreCallback(emulator);
@@ -1219,6 +1253,15 @@ public class ARM64SyscallHandler extends AndroidSyscallHandler {
 
     private final long nanoTime = System.nanoTime();
 
+    @Override
+    public boolean registerNativeSyscalls(Emulator<?> emulator) {
+        Backend backend = emulator.getBackend();
+        return backend.registerNativeSyscall(172, NativeSyscall.constant(emulator.getPid())) && // getpid
+                backend.registerNativeSyscall(233, NativeSyscall.constant(0)) && // madvise
+                backend.registerNativeSyscall(113, NativeSyscall.clock_gettime(currentTimeMillis() * 1000000L, System.nanoTime() - nanoTime)) &&
+                backend.registerNativeSyscall(169, NativeSyscall.gettimeofday(currentTimeMillis() * 1000000L));
+    }
+
     protected int clock_gettime(Emulator<?> emulator) {
         RegisterContext context = emulator.getContext();
         int clk_id = context.getIntArg(0) & 0x7;
@@ -17,7 +17,6 @@ import com.github.unidbg.memory.MemRegion;
 import com.github.unidbg.memory.Memory;
 import com.github.unidbg.memory.MemoryAllocBlock;
 import com.github.unidbg.memory.MemoryBlock;
-import com.github.unidbg.memory.MemoryBlockImpl;
 import com.github.unidbg.memory.MemoryMap;
 import com.github.unidbg.pointer.UnidbgPointer;
 import com.github.unidbg.spi.AbstractLoader;
@@ -49,6 +48,8 @@ import unicorn.ArmConst;
 import unicorn.Unicorn;
 import unicorn.UnicornConst;
 
+import java.io.DataInput;
+import java.io.DataOutput;
 import java.io.File;
 import java.io.IOException;
 import java.util.ArrayList;
@@ -714,7 +715,7 @@ public class AndroidElfLoader extends AbstractLoader<AndroidFileIO> implements M
     @Override
     public MemoryBlock malloc(int length, boolean runtime) {
         if (runtime) {
-            return MemoryBlockImpl.alloc(this, length);
+            return runtimeArena.alloc(length);
         } else {
             return MemoryAllocBlock.malloc(emulator, malloc, free, length);
         }
@@ -751,6 +752,41 @@ public class AndroidElfLoader extends AbstractLoader<AndroidFileIO> implements M
         return (int) this.brk;
     }
 
+    @Override
+    protected Module restoreModule(LibraryFile libraryFile) throws IOException {
+        LinuxModule module = loadInternal(libraryFile);
+        resolveSymbols(false);
+        module.initFunctionList.clear();
+        return module;
+    }
+
+    /**
+     * The brk heap is not in the memory map, its contents are serialized inline.
+     */
+    @Override
+    public void serialize(DataOutput out) throws IOException {
+        super.serialize(out);
+        out.writeLong(brk);
+        if (brk > HEAP_BASE) {
+            out.write(backend.mem_read(HEAP_BASE, brk - HEAP_BASE));
+        }
+    }
+
+    @Override
+    public void deserialize(DataInput in) throws IOException {
+        super.deserialize(in);
+        if (brk > HEAP_BASE) {
+            backend.mem_unmap(HEAP_BASE, brk - HEAP_BASE);
+        }
+        brk = in.readLong();
+        if (brk > HEAP_BASE) {
+            byte[] heap = new byte[(int) (brk - HEAP_BASE)];
+            in.readFully(heap);
+            backend.mem_map(HEAP_BASE, heap.length, UnicornConst.UC_PROT_READ | UnicornConst.UC_PROT_WRITE);
+            backend.mem_write(HEAP_BASE, heap);
+        }
+    }
+
     private static final int MAP_FAILED = -1;
     public static final int MAP_FIXED = 0x10;
     public static final int MAP_ANONYMOUS = 0x20;
@@ -814,12 +850,8 @@ public class AndroidElfLoader extends AbstractLoader<AndroidFileIO> implements M
                 if ((start & (emulator.getPageAlign() - 1)) != 0) {
                     return MAP_FAILED;
                 }
-                long end = start + length;
-                for (Map.Entry<Long, MemoryMap> entry : memoryMap.entrySet()) {
-                    MemoryMap map = entry.getValue();
-                    if (Math.max(start, entry.getKey()) <= Math.min(map.base + map.size, end)) {
-                        return MAP_FAILED;
-                    }
+                if (memoryMap.overlaps(start, start + length)) {
+                    return MAP_FAILED;
                 }
                 if (log.isDebugEnabled()) {
                     log.debug("mmap2 start=0x" + Long.toHexString(start) + ", mmapBaseAddress=0x" + Long.toHexString(mmapBaseAddress) + ", flags=0x" + Integer.toHexString(flags) + ", length=0x" + Integer.toHexString(length));
@@ -61,6 +61,14 @@ public abstract class BaseVM implements VM, DvmClassFactory {
         this.verboseFieldOperation = verboseFieldOperation;
     }
 
+    JniMirror jniMirror;
+
+    final void mirror(int hash, DvmObject<?> object) {
+        if (jniMirror != null) {
+            jniMirror.mirror(hash, object);
+        }
+    }
+
     @Override
     public void throwException(DvmObject<?> throwable) {
         this.throwable = throwable;
@@ -164,6 +172,9 @@ public abstract class BaseVM implements VM, DvmClassFactory {
         } else {
             localObjectMap.put(hash, new ObjRef(object, weak));
         }
+        if (jniMirror != null) {
+            jniMirror.touch(hash, object);
+        }
         return hash;
     }
 
@@ -185,16 +196,35 @@ public abstract class BaseVM implements VM, DvmClassFactory {
         return addObject(object, true, false);
     }
 
-    @SuppressWarnings("unchecked")
-    @Override
-    public final <T extends DvmObject<?>> T getObject(int hash) {
-        ObjRef ref;
+    private ObjRef findObjRef(int hash) {
         if (localObjectMap.containsKey(hash)) {
-            ref = localObjectMap.get(hash);
+            return localObjectMap.get(hash);
         } else if(globalObjectMap.containsKey(hash)) {
-            ref = globalObjectMap.get(hash);
+            return globalObjectMap.get(hash);
         } else {
-            ref = weakGlobalObjectMap.get(hash);
+            return weakGlobalObjectMap.get(hash);
+        }
+    }
+
+    @SuppressWarnings("unchecked")
+    @Override
+    public final <T extends DvmObject<?>> T getObject(int hash) {
+        ObjRef ref = findObjRef(hash);
+        if (ref != null && jniMirror != null) {
+            jniMirror.touch(hash, ref.obj);
+        }
+        return ref == null ? null : (T) ref.obj;
+    }
+
+    /**
+     * For the handlers which {@link #mirror(int, DvmObject)} the object they serve: the mirror stays valid,
+     * only what the stubs wrote is copied back.
+     */
+    @SuppressWarnings("unchecked")
+    final <T extends DvmObject<?>> T getMirrorObject(int hash) {
+        ObjRef ref = findObjRef(hash);
+        if (ref != null && jniMirror != null) {
+            jniMirror.sync(hash, ref.obj);
         }
         return ref == null ? null : (T) ref.obj;
     }
@@ -205,6 +235,9 @@ public abstract class BaseVM implements VM, DvmClassFactory {
     }
 
     final void deleteLocalRefs() {
+        if (jniMirror != null) {
+            jniMirror.reset();
+        }
         for (ObjRef ref : localObjectMap.values()) {
             ref.obj.onDeleteRef();
         }
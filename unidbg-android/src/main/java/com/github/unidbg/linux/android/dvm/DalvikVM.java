@@ -3842,6 +3842,13 @@ public class DalvikVM extends BaseVM implements VM {
         return _JNIEnv;
     }
 
+    @Override
+    public void setJniMirror(boolean jniMirror) {
+        if (jniMirror) {
+            throw new UnsupportedOperationException("JNI mirror is arm64 only");
+        }
+    }
+
     byte[] loadLibraryData(Apk apk, String soName) {
         byte[] soData = apk.getFileData("lib/armeabi-v7a/" + soName);
         if (soData != null) {
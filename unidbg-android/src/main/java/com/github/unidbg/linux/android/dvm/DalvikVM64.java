@@ -2584,7 +2584,7 @@ public class DalvikVM64 extends BaseVM implements VM {
             public long handle(Emulator<?> emulator) {
                 RegisterContext context = emulator.getContext();
                 UnidbgPointer object = context.getPointerArg(1);
-                DvmObject<?> string = getObject(object.toIntPeer());
+                DvmObject<?> string = getMirrorObject(object.toIntPeer());
                 if (log.isDebugEnabled()) {
                     log.debug("GetStringUTFLength string=" + string + ", lr=" + context.getLRPointer());
                 }
@@ -2593,6 +2593,7 @@ public class DalvikVM64 extends BaseVM implements VM {
                     System.out.printf("JNIEnv->GetStringUTFLength(%s) was called from %s%n", string, context.getLRPointer());
                 }
                 byte[] data = value.getBytes(StandardCharsets.UTF_8);
+                mirror(object.toIntPeer(), string);
                 return data.length;
             }
         });
@@ -2645,13 +2646,14 @@ public class DalvikVM64 extends BaseVM implements VM {
             public long handle(Emulator<?> emulator) {
                 RegisterContext context = emulator.getContext();
                 UnidbgPointer pointer = context.getPointerArg(1);
-                Array<?> array = Objects.requireNonNull((Array<?>) getObject(pointer.toIntPeer()));
+                Array<?> array = Objects.requireNonNull((Array<?>) getMirrorObject(pointer.toIntPeer()));
                 if (log.isDebugEnabled()) {
                     log.debug("GetArrayLength array=" + array);
                 }
                 if (verbose || verboseFieldOperation) {
                     System.out.printf("JNIEnv->GetArrayLength(%s => %s) was called from %s%n", array, array.length(), context.getLRPointer());
                 }
+                mirror(pointer.toIntPeer(), (DvmObject<?>) array);
                 return array.length();
             }
         });
@@ -2955,11 +2957,12 @@ public class DalvikVM64 extends BaseVM implements VM {
             public long handle(Emulator<?> emulator) {
                 RegisterContext context = emulator.getContext();
                 UnidbgPointer object = context.getPointerArg(1);
-                DvmObject<?> string = getObject(object.toIntPeer());
+                DvmObject<?> string = getMirrorObject(object.toIntPeer());
                 if (log.isDebugEnabled()) {
                     log.debug("GetStringLength string=" + string + ", lr=" + context.getLRPointer());
                 }
                 String value = (String) Objects.requireNonNull(string).getValue();
+                mirror(object.toIntPeer(), string);
                 return value.length();
             }
         });
@@ -3155,7 +3158,7 @@ public class DalvikVM64 extends BaseVM implements VM {
                 int start = context.getIntArg(2);
                 int length = context.getIntArg(3);
                 Pointer buf = context.getPointerArg(4);
-                ByteArray array = getObject(object.toIntPeer());
+                ByteArray array = getMirrorObject(object.toIntPeer());
                 if (verbose || verboseFieldOperation) {
                     System.out.printf("JNIEnv->GetByteArrayRegion(%s, %d, %d, %s) was called from %s%n", array, start, length, buf, context.getLRPointer());
                 }
@@ -3164,6 +3167,7 @@ public class DalvikVM64 extends BaseVM implements VM {
                     Inspector.inspect(data, "GetByteArrayRegion array=" + array + ", start=" + start + ", length=" + length + ", buf=" + buf);
                 }
                 buf.write(0, data, 0, data.length);
+                mirror(object.toIntPeer(), array);
                 return 0;
             }
         });
@@ -3183,7 +3187,7 @@ public class DalvikVM64 extends BaseVM implements VM {
                 int start = context.getIntArg(2);
                 int length = context.getIntArg(3);
                 Pointer buf = context.getPointerArg(4);
-                ShortArray array = getObject(object.toIntPeer());
+                ShortArray array = getMirrorObject(object.toIntPeer());
                 if (verbose || verboseFieldOperation) {
                     System.out.printf("JNIEnv->GetShortArrayRegion(%s, %d, %d, %s) was called from %s%n", array, start, length, buf, context.getLRPointer());
                 }
@@ -3192,6 +3196,7 @@ public class DalvikVM64 extends BaseVM implements VM {
                     log.debug("GetShortArrayRegion array=" + array + ", start=" + start + ", length=" + length + ", buf=" + buf);
                 }
                 buf.write(0, data, 0, data.length);
+                mirror(object.toIntPeer(), array);
                 return 0;
             }
         });
@@ -3199,7 +3204,22 @@ public class DalvikVM64 extends BaseVM implements VM {
         Pointer _GetIntArrayRegion = svcMemory.registerSvc(new Arm64Svc() {
             @Override
             public long handle(Emulator<?> emulator) {
-                throw new UnsupportedOperationException();
+                RegisterContext context = emulator.getContext();
+                UnidbgPointer object = context.getPointerArg(1);
+                int start = context.getIntArg(2);
+                int length = context.getIntArg(3);
+                Pointer buf = context.getPointerArg(4);
+                IntArray array = getMirrorObject(object.toIntPeer());
+                if (verbose || verboseFieldOperation) {
+                    System.out.printf("JNIEnv->GetIntArrayRegion(%s, %d, %d, %s) was called from %s%n", array, start, length, buf, context.getLRPointer());
+                }
+                int[] data = Arrays.copyOfRange(Objects.requireNonNull(array).value, start, start + length);
+                if (log.isDebugEnabled()) {
+                    log.debug("GetIntArrayRegion array=" + array + ", start=" + start + ", length=" + length + ", buf=" + buf);
+                }
+                buf.write(0, data, 0, data.length);
+                mirror(object.toIntPeer(), array);
+                return 0;
             }
         });
 
@@ -3213,7 +3233,22 @@ public class DalvikVM64 extends BaseVM implements VM {
         Pointer _GetFloatArrayRegion = svcMemory.registerSvc(new Arm64Svc() {
             @Override
             public long handle(Emulator<?> emulator) {
-                throw new UnsupportedOperationException();
+                RegisterContext context = emulator.getContext();
+                UnidbgPointer object = context.getPointerArg(1);
+                int start = context.getIntArg(2);
+                int length = context.getIntArg(3);
+                Pointer buf = context.getPointerArg(4);
+                FloatArray array = getMirrorObject(object.toIntPeer());
+                if (verbose || verboseFieldOperation) {
+                    System.out.printf("JNIEnv->GetFloatArrayRegion(%s, %d, %d, %s) was called from %s%n", array, start, length, buf, context.getLRPointer());
+                }
+                float[] data = Arrays.copyOfRange(Objects.requireNonNull(array).value, start, start + length);
+                if (log.isDebugEnabled()) {
+                    log.debug("GetFloatArrayRegion array=" + array + ", start=" + start + ", length=" + length + ", buf=" + buf);
+                }
+                buf.write(0, data, 0, data.length);
+                mirror(object.toIntPeer(), array);
+                return 0;
             }
         });
 
@@ -3225,7 +3260,7 @@ public class DalvikVM64 extends BaseVM implements VM {
                 int start = context.getIntArg(2);
                 int length = context.getIntArg(3);
                 Pointer buf = context.getPointerArg(4);
-                DoubleArray array = getObject(object.toIntPeer());
+                DoubleArray array = getMirrorObject(object.toIntPeer());
                 if (verbose || verboseFieldOperation) {
                     System.out.printf("JNIEnv->GetDoubleArrayRegion(%s, %d, %d, %s) was called from %s%n", array, start, length, buf, context.getLRPointer());
                 }
@@ -3234,6 +3269,7 @@ public class DalvikVM64 extends BaseVM implements VM {
                     log.debug("GetDoubleArrayRegion array=" + array + ", start=" + start + ", length=" + length + ", buf=" + buf);
                 }
                 buf.write(0, data, 0, data.length);
+                mirror(object.toIntPeer(), array);
                 return 0;
             }
         });
@@ -3253,7 +3289,7 @@ public class DalvikVM64 extends BaseVM implements VM {
                 int start = context.getIntArg(2);
                 int length = context.getIntArg(3);
                 Pointer buf = context.getPointerArg(4);
-                ByteArray array = getObject(object.toIntPeer());
+                ByteArray array = getMirrorObject(object.toIntPeer());
                 if (verbose || verboseFieldOperation) {
                     System.out.printf("JNIEnv->SetByteArrayRegion(%s, %d, %d, %s) was called from %s%n", array, start, length, buf, context.getLRPointer());
                 }
@@ -3266,6 +3302,7 @@ public class DalvikVM64 extends BaseVM implements VM {
                     }
                 }
                 Objects.requireNonNull(array).setData(start, data);
+                mirror(object.toIntPeer(), array);
                 return 0;
             }
         });
@@ -3280,7 +3317,22 @@ public class DalvikVM64 extends BaseVM implements VM {
         Pointer _SetShortArrayRegion = svcMemory.registerSvc(new Arm64Svc() {
             @Override
             public long handle(Emulator<?> emulator) {
-                throw new UnsupportedOperationException();
+                RegisterContext context = emulator.getContext();
+                UnidbgPointer object = context.getPointerArg(1);
+                int start = context.getIntArg(2);
+                int length = context.getIntArg(3);
+                Pointer buf = context.getPointerArg(4);
+                ShortArray array = getMirrorObject(object.toIntPeer());
+                if (verbose || verboseFieldOperation) {
+                    System.out.printf("JNIEnv->SetShortArrayRegion(%s, %d, %d, %s) was called from %s%n", array, start, length, buf, context.getLRPointer());
+                }
+                short[] data = buf.getShortArray(0, length);
+                if (log.isDebugEnabled()) {
+                    log.debug("SetShortArrayRegion array=" + array + ", start=" + start + ", length=" + length + ", buf=" + buf);
+                }
+                Objects.requireNonNull(array).setData(start, data);
+                mirror(object.toIntPeer(), array);
+                return 0;
             }
         });
 
@@ -3292,7 +3344,7 @@ public class DalvikVM64 extends BaseVM implements VM {
                 int start = context.getIntArg(2);
                 int length = context.getIntArg(3);
                 Pointer buf = context.getPointerArg(4);
-                IntArray array = getObject(object.toIntPeer());
+                IntArray array = getMirrorObject(object.toIntPeer());
                 if (verbose || verboseFieldOperation) {
                     System.out.printf("JNIEnv->SetIntArrayRegion(%s, %d, %d, %s) was called from %s%n", array, start, length, buf, context.getLRPointer());
                 }
@@ -3301,6 +3353,7 @@ public class DalvikVM64 extends BaseVM implements VM {
                     log.debug("SetIntArrayRegion array=" + array + ", start=" + start + ", length=" + length + ", buf=" + buf);
                 }
                 Objects.requireNonNull(array).setData(start, data);
+                mirror(object.toIntPeer(), array);
                 return 0;
             }
         });
@@ -3320,7 +3373,7 @@ public class DalvikVM64 extends BaseVM implements VM {
                 int start = context.getIntArg(2);
                 int length = context.getIntArg(3);
                 Pointer buf = context.getPointerArg(4);
-                FloatArray array = getObject(object.toIntPeer());
+                FloatArray array = getMirrorObject(object.toIntPeer());
                 if (verbose || verboseFieldOperation) {
                     System.out.printf("JNIEnv->SetFloatArrayRegion(%s, %d, %d, %s) was called from %s%n", array, start, length, buf, context.getLRPointer());
                 }
@@ -3329,6 +3382,7 @@ public class DalvikVM64 extends BaseVM implements VM {
                     log.debug("SetIntArrayRegion array=" + array + ", start=" + start + ", length=" + length + ", buf=" + buf);
                 }
                 Objects.requireNonNull(array).setData(start, data);
+                mirror(object.toIntPeer(), array);
                 return 0;
             }
         });
@@ -3341,7 +3395,7 @@ public class DalvikVM64 extends BaseVM implements VM {
                 int start = context.getIntArg(2);
                 int length = context.getIntArg(3);
                 Pointer buf = context.getPointerArg(4);
-                DoubleArray array = getObject(object.toIntPeer());
+                DoubleArray array = getMirrorObject(object.toIntPeer());
                 if (verbose || verboseFieldOperation) {
                     System.out.printf("JNIEnv->SetDoubleArrayRegion(%s, %d, %d, %s) was called from %s%n", array, start, length, buf, context.getLRPointer());
                 }
@@ -3350,6 +3404,7 @@ public class DalvikVM64 extends BaseVM implements VM {
                     log.debug("SetDoubleArrayRegion array=" + array + ", start=" + start + ", length=" + length + ", buf=" + buf);
                 }
                 Objects.requireNonNull(array).setData(start, data);
+                mirror(object.toIntPeer(), array);
                 return 0;
             }
         });
@@ -3938,6 +3993,25 @@ public class DalvikVM64 extends BaseVM implements VM {
         return _JNIEnv;
     }
 
+    private JniMirror mirrorStubs;
+
+    @Override
+    public void setJniMirror(boolean jniMirror) {
+        if (jniMirror == (this.jniMirror != null)) {
+            return;
+        }
+        if (jniMirror) {
+            if (mirrorStubs == null) {
+                mirrorStubs = new JniMirror(getEmulator(), _JNIEnv.getPointer(0));
+            }
+            mirrorStubs.install();
+            this.jniMirror = mirrorStubs;
+        } else {
+            this.jniMirror.uninstall();
+            this.jniMirror = null;
+        }
+    }
+
     byte[] loadLibraryData(Apk apk, String soName) {
         byte[] soData = apk.getFileData("lib/arm64-v8a/" + soName);
         if (soData != null) {
@@ -0,0 +1,507 @@
+package com.github.unidbg.linux.android.dvm;
+
+import com.github.unidbg.Emulator;
+import com.github.unidbg.linux.android.dvm.array.ByteArray;
+import com.github.unidbg.linux.android.dvm.array.DoubleArray;
+import com.github.unidbg.linux.android.dvm.array.FloatArray;
+import com.github.unidbg.linux.android.dvm.array.IntArray;
+import com.github.unidbg.linux.android.dvm.array.ShortArray;
+import com.github.unidbg.memory.Memory;
+import com.github.unidbg.memory.MemoryBlock;
+import com.github.unidbg.memory.SvcMemory;
+import com.github.unidbg.pointer.UnidbgPointer;
+
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.charset.StandardCharsets;
+import java.util.ArrayList;
+import java.util.HashMap;
+import java.util.List;
+import java.util.Map;
+
+/**
+ * Mirrors the primitive arrays and strings seen by native code in a guest hash table keyed by handle, and replaces
+ * GetArrayLength, GetStringLength, GetStringUTFLength and the byte, short, int, float and double
+ * Get/Set&lt;Type&gt;ArrayRegion entries of the arm64 JNIEnv with stubs that serve mirrored objects without trapping.
+ * A miss falls through to the original handler, which mirrors the object for the next call.
+ * Stub writes are copied back when the VM resolves the handle again and at the end of every JNI call.
+ */
+class JniMirror {
+
+    private static final int ENTRY_SIZE = 32;
+    private static final int OFFSET_HANDLE = 0;
+    private static final int OFFSET_LENGTH = 4;
+    private static final int OFFSET_DATA = 8;
+    private static final int OFFSET_SHIFT = 16;
+    private static final int OFFSET_FLAGS = 20;
+    private static final int OFFSET_UTF_LENGTH = 24;
+    private static final int OFFSET_TYPE = 28;
+
+    private static final int FLAG_VALID = 1;
+    private static final int FLAG_DIRTY = 2;
+
+    private static final int TYPE_BYTE = 1;
+    private static final int TYPE_SHORT = 3;
+    private static final int TYPE_INT = 4;
+    private static final int TYPE_FLOAT = 6;
+    private static final int TYPE_DOUBLE = 7;
+    private static final int TYPE_STRING = 8;
+
+    private static final int INITIAL_CAPACITY = 64;
+
+    private static class Entry {
+        final int slot;
+        DvmObject<?> object;
+        MemoryBlock block;
+        int size; // of the block
+        int type;
+        Entry(int slot) {
+            this.slot = slot;
+        }
+    }
+
+    private final Memory memory;
+    private final UnidbgPointer impl;
+    private final int[] offsets = {
+            0x558, 0x520, 0x540, // GetArrayLength, GetStringLength, GetStringUTFLength
+            0x640, 0x650, 0x658, 0x668, 0x670, // Get<Type>ArrayRegion
+            0x680, 0x690, 0x698, 0x6a8, 0x6b0, // Set<Type>ArrayRegion
+    };
+    private final UnidbgPointer[] originals = new UnidbgPointer[offsets.length];
+    private final UnidbgPointer[] stubs = new UnidbgPointer[offsets.length];
+
+    private final MemoryBlock header; // u32 mask, u64 entries at +8
+    private MemoryBlock table;
+    private int capacity;
+    private final Map<Integer, Entry> entries = new HashMap<>();
+
+    JniMirror(Emulator<?> emulator, UnidbgPointer impl) {
+        this.memory = emulator.getMemory();
+        this.impl = impl;
+        this.header = memory.malloc(16, true);
+        allocateTable(INITIAL_CAPACITY);
+
+        SvcMemory svcMemory = emulator.getSvcMemory();
+        long address = header.getPointer().peer;
+        for (int i = 0; i < offsets.length; i++) {
+            originals[i] = impl.getPointer(offsets[i]);
+            Assembler asm;
+            if (i == 0) {
+                asm = assembleGetLength(address, false, OFFSET_LENGTH);
+            } else if (i == 1) {
+                asm = assembleGetLength(address, true, OFFSET_LENGTH);
+            } else if (i == 2) {
+                asm = assembleGetLength(address, true, OFFSET_UTF_LENGTH);
+            } else {
+                int[] types = {TYPE_BYTE, TYPE_SHORT, TYPE_INT, TYPE_FLOAT, TYPE_DOUBLE};
+                asm = assembleRegion(address, types[(i - 3) % types.length], i >= 8);
+            }
+            asm.literal("original", originals[i].peer);
+            byte[] code = asm.assemble();
+            stubs[i] = svcMemory.allocate(code.length, "JniMirror");
+            stubs[i].write(0, code, 0, code.length);
+        }
+    }
+
+    final void install() {
+        for (int i = 0; i < offsets.length; i++) {
+            impl.setPointer(offsets[i], stubs[i]);
+        }
+    }
+
+    final void uninstall() {
+        reset();
+        for (int i = 0; i < offsets.length; i++) {
+            impl.setPointer(offsets[i], originals[i]);
+        }
+    }
+
+    /**
+     * Called by the slow handlers once they served the object. The block of an entry resolved again with the same
+     * object is kept and refreshed in place, the Java side may have changed the array since.
+     */
+    final void mirror(int handle, DvmObject<?> object) {
+        int type = typeOf(object);
+        if (type == 0) {
+            return;
+        }
+        Entry entry = entries.get(handle);
+        if (entry == null) {
+            if ((entries.size() + 1) * 2 > capacity) {
+                allocateTable(capacity * 2);
+            }
+            entry = new Entry(findSlot(handle));
+            entries.put(handle, entry);
+        } else if (entry.object == object && (slot(entry).getInt(OFFSET_FLAGS) & FLAG_VALID) != 0) {
+            return;
+        }
+        entry.object = object;
+        entry.type = type;
+
+        UnidbgPointer slot = slot(entry);
+        slot.setInt(OFFSET_HANDLE, handle);
+        slot.setInt(OFFSET_TYPE, type);
+        if (type == TYPE_STRING) {
+            if (entry.block != null) {
+                entry.block.free();
+                entry.block = null;
+            }
+            String value = ((StringObject) object).getValue();
+            slot.setInt(OFFSET_LENGTH, value.length());
+            slot.setInt(OFFSET_UTF_LENGTH, value.getBytes(StandardCharsets.UTF_8).length);
+            slot.setLong(OFFSET_DATA, 0);
+            slot.setInt(OFFSET_SHIFT, 0);
+        } else {
+            Array<?> array = (Array<?>) object;
+            byte[] data = toBytes(object, type);
+            int size = Math.max(data.length, 1);
+            if (entry.block != null && entry.size != size) {
+                entry.block.free();
+                entry.block = null;
+            }
+            if (entry.block == null) {
+                entry.block = memory.malloc(size, true);
+                entry.size = size;
+            }
+            entry.block.getPointer().write(0, data, 0, data.length);
+            slot.setInt(OFFSET_LENGTH, array.length());
+            slot.setLong(OFFSET_DATA, entry.block.getPointer().peer);
+            slot.setInt(OFFSET_SHIFT, shiftOf(type));
+        }
+        slot.setInt(OFFSET_FLAGS, FLAG_VALID);
+    }
+
+    /**
+     * Called whenever the VM resolves a handle: copies back what the stubs wrote to the array and stops
+     * serving it from guest memory, since the caller may change it from Java. The block is kept for the next mirror.
+     */
+    final void touch(int handle, DvmObject<?> object) {
+        Entry entry = entries.get(handle);
+        if (entry == null || entry.object == null || (entry.object == object && entry.type == TYPE_STRING)) {
+            return;
+        }
+        UnidbgPointer slot = slot(entry);
+        sync(entry, slot);
+        slot.setInt(OFFSET_FLAGS, 0);
+        if (entry.object != object) {
+            entry.object = null;
+        }
+    }
+
+    /**
+     * Called when a mirroring handler resolves a handle: only copies back what the stubs wrote.
+     * The stubs serve every in-range access of a valid entry, so such a handler either throws or finds the entry invalid.
+     */
+    final void sync(int handle, DvmObject<?> object) {
+        Entry entry = entries.get(handle);
+        if (entry == null || entry.object == null) {
+            return;
+        }
+        if (entry.object != object) {
+            touch(handle, object);
+        } else {
+            sync(entry, slot(entry));
+        }
+    }
+
+    /**
+     * Called at the end of every JNI call, when the handles die.
+     */
+    final void reset() {
+        for (Entry entry : entries.values()) {
+            UnidbgPointer slot = slot(entry);
+            sync(entry, slot);
+            slot.setInt(OFFSET_HANDLE, 0);
+            slot.setInt(OFFSET_FLAGS, 0);
+            if (entry.block != null) {
+                entry.block.free();
+            }
+        }
+        entries.clear();
+    }
+
+    private void sync(Entry entry, UnidbgPointer slot) {
+        int flags = slot.getInt(OFFSET_FLAGS);
+        if (entry.object != null && (flags & (FLAG_VALID | FLAG_DIRTY)) == (FLAG_VALID | FLAG_DIRTY)) {
+            int length = ((Array<?>) entry.object).length() << shiftOf(entry.type);
+            fromBytes(entry.object, entry.type, entry.block.getPointer().getByteArray(0, length));
+            slot.setInt(OFFSET_FLAGS, flags & ~FLAG_DIRTY);
+        }
+    }
+
+    private UnidbgPointer slot(Entry entry) {
+        return table.getPointer().share((long) entry.slot * ENTRY_SIZE, ENTRY_SIZE);
+    }
+
+    private int findSlot(int handle) {
+        int mask = capacity - 1;
+        UnidbgPointer pointer = table.getPointer();
+        for (int slot = handle & mask; ; slot = (slot + 1) & mask) {
+            if (pointer.getInt((long) slot * ENTRY_SIZE + OFFSET_HANDLE) == 0) {
+                return slot;
+            }
+        }
+    }
+
+    /**
+     * Rehashes the live entries into a zeroed table of the new capacity and publishes it through the header.
+     */
+    private void allocateTable(int capacity) {
+        MemoryBlock old = table;
+        UnidbgPointer oldPointer = old == null ? null : old.getPointer();
+        table = memory.malloc(capacity * ENTRY_SIZE, true);
+        this.capacity = capacity;
+        table.getPointer().write(0, new byte[capacity * ENTRY_SIZE], 0, capacity * ENTRY_SIZE);
+
+        if (oldPointer != null) {
+            Map<Integer, Entry> moved = new HashMap<>(entries.size());
+            for (Map.Entry<Integer, Entry> e : entries.entrySet()) {
+                Entry entry = e.getValue();
+                byte[] data = oldPointer.getByteArray((long) entry.slot * ENTRY_SIZE, ENTRY_SIZE);
+                Entry copy = new Entry(findSlot(e.getKey()));
+                copy.object = entry.object;
+                copy.block = entry.block;
+                copy.size = entry.size;
+                copy.type = entry.type;
+                table.getPointer().write((long) copy.slot * ENTRY_SIZE, data, 0, ENTRY_SIZE);
+                moved.put(e.getKey(), copy);
+            }
+            entries.clear();
+            entries.putAll(moved);
+        }
+
+        UnidbgPointer pointer = header.getPointer();
+        pointer.setInt(0, capacity - 1);
+        pointer.setPointer(8, table.getPointer());
+        if (old != null) {
+            old.free();
+        }
+    }
+
+    private static int typeOf(DvmObject<?> object) {
+        if (object instanceof ByteArray) {
+            return TYPE_BYTE;
+        } else if (object instanceof ShortArray) {
+            return TYPE_SHORT;
+        } else if (object instanceof IntArray) {
+            return TYPE_INT;
+        } else if (object instanceof FloatArray) {
+            return TYPE_FLOAT;
+        } else if (object instanceof DoubleArray) {
+            return TYPE_DOUBLE;
+        } else if (object instanceof StringObject) {
+            return TYPE_STRING;
+        } else {
+            return 0;
+        }
+    }
+
+    private static int shiftOf(int type) {
+        switch (type) {
+            case TYPE_BYTE:
+                return 0;
+            case TYPE_SHORT:
+                return 1;
+            case TYPE_INT:
+            case TYPE_FLOAT:
+                return 2;
+            case TYPE_DOUBLE:
+                return 3;
+            default:
+                throw new IllegalStateException("type=" + type);
+        }
+    }
+
+    private static byte[] toBytes(DvmObject<?> object, int type) {
+        if (type == TYPE_BYTE) {
+            return ((ByteArray) object).getValue().clone();
+        }
+        ByteBuffer buffer = ByteBuffer.allocate(((Array<?>) object).length() << shiftOf(type));
+        buffer.order(ByteOrder.LITTLE_ENDIAN);
+        switch (type) {
+            case TYPE_SHORT:
+                buffer.asShortBuffer().put(((ShortArray) object).getValue());
+                break;
+            case TYPE_INT:
+                buffer.asIntBuffer().put(((IntArray) object).getValue());
+                break;
+            case TYPE_FLOAT:
+                buffer.asFloatBuffer().put(((FloatArray) object).getValue());
+                break;
+            case TYPE_DOUBLE:
+                buffer.asDoubleBuffer().put(((DoubleArray) object).getValue());
+                break;
+        }
+        return buffer.array();
+    }
+
+    private static void fromBytes(DvmObject<?> object, int type, byte[] data) {
+        ByteBuffer buffer = ByteBuffer.wrap(data);
+        buffer.order(ByteOrder.LITTLE_ENDIAN);
+        switch (type) {
+            case TYPE_BYTE:
+                ((ByteArray) object).setData(0, data);
+                break;
+            case TYPE_SHORT:
+                buffer.asShortBuffer().get(((ShortArray) object).getValue());
+                break;
+            case TYPE_INT:
+                buffer.asIntBuffer().get(((IntArray) object).getValue());
+                break;
+            case TYPE_FLOAT:
+                buffer.asFloatBuffer().get(((FloatArray) object).getValue());
+                break;
+            case TYPE_DOUBLE:
+                buffer.asDoubleBuffer().get(((DoubleArray) object).getValue());
+                break;
+        }
+    }
+
+    /**
+     * Probes the table for x1 with x9 = entries, w10 = mask and leaves the entry in x12, or branches to "slow".
+     */
+    private static Assembler assembleLookup(long header) {
+        Assembler asm = new Assembler();
+        asm.emit(0x58000009, "header", 19); // ldr x9, header
+        asm.emit(0xb940012a); // ldr w10, [x9]
+        asm.emit(0xf9400529); // ldr x9, [x9, #8]
+        asm.emit(0x0a0a002b); // and w11, w1, w10
+        asm.label("probe");
+        asm.emit(0x8b0b152c); // add x12, x9, x11, lsl #5
+        asm.emit(0xb940018d); // ldr w13, [x12]
+        asm.emit(0x3400000d, "slow", 19); // cbz w13, slow
+        asm.emit(0x6b0101bf); // cmp w13, w1
+        asm.emit(0x54000000, "found", 19); // b.eq found
+        asm.emit(0x1100056b); // add w11, w11, #1
+        asm.emit(0x0a0a016b); // and w11, w11, w10
+        asm.emit(0x14000000, "probe", 26); // b probe
+        asm.label("found");
+        asm.emit(0xb940158d); // ldr w13, [x12, #20]
+        asm.emit(0x3600000d, "slow", 14); // tbz w13, #0, slow
+        asm.emit(0xb9401d8e); // ldr w14, [x12, #28]
+        asm.literal("header", header);
+        return asm;
+    }
+
+    private static Assembler assembleGetLength(long header, boolean string, int offset) {
+        Assembler asm = assembleLookup(header);
+        asm.emit(0x710001df | (TYPE_STRING << 10)); // cmp w14, #TYPE_STRING
+        asm.emit(string ? 0x54000001 : 0x54000000, "slow", 19); // b.ne slow or b.eq slow
+        asm.emit(0xb9400180 | ((offset / 4) << 10)); // ldr w0, [x12, #offset]
+        asm.emit(0xd65f03c0); // ret
+        asm.slow();
+        return asm;
+    }
+
+    /**
+     * (env, array, jsize start, jsize len, buf)
+     */
+    private static Assembler assembleRegion(long header, int type, boolean set) {
+        Assembler asm = assembleLookup(header);
+        asm.emit(0x710001df | (type << 10)); // cmp w14, #type
+        asm.emit(0x54000001, "slow", 19); // b.ne slow
+        asm.emit(0xb940058e); // ldr w14, [x12, #4]
+        asm.emit(0x37f80002, "slow", 14); // tbnz w2, #31, slow
+        asm.emit(0x37f80003, "slow", 14); // tbnz w3, #31, slow
+        asm.emit(0x0b03004f); // add w15, w2, w3
+        asm.emit(0x6b0e01ff); // cmp w15, w14
+        asm.emit(0x54000008, "slow", 19); // b.hi slow
+        if (set) {
+            asm.emit(0xb940158e); // ldr w14, [x12, #20]
+            asm.emit(0x321f01ce); // orr w14, w14, #2
+            asm.emit(0xb900158e); // str w14, [x12, #20]
+        }
+        asm.emit(0xb940118e); // ldr w14, [x12, #16]
+        asm.emit(0x2a0203e2); // mov w2, w2
+        asm.emit(0x2a0303e3); // mov w3, w3
+        asm.emit(0x9ace2042); // lsl x2, x2, x14
+        asm.emit(0x9ace2063); // lsl x3, x3, x14
+        asm.emit(0xf940058f); // ldr x15, [x12, #8]
+        asm.emit(0x8b0201ef); // add x15, x15, x2
+        asm.label("words");
+        asm.emit(0xf100207f); // cmp x3, #8
+        asm.emit(0x54000003, "bytes", 19); // b.lo bytes
+        if (set) {
+            asm.emit(0xf840848e); // ldr x14, [x4], #8
+            asm.emit(0xf80085ee); // str x14, [x15], #8
+        } else {
+            asm.emit(0xf84085ee); // ldr x14, [x15], #8
+            asm.emit(0xf800848e); // str x14, [x4], #8
+        }
+        asm.emit(0xd1002063); // sub x3, x3, #8
+        asm.emit(0x14000000, "words", 26); // b words
+        asm.label("bytes");
+        asm.emit(0xb4000003, "done", 19); // cbz x3, done
+        if (set) {
+            asm.emit(0x3840148e); // ldrb w14, [x4], #1
+            asm.emit(0x380015ee); // strb w14, [x15], #1
+        } else {
+            asm.emit(0x384015ee); // ldrb w14, [x15], #1
+            asm.emit(0x3800148e); // strb w14, [x4], #1
+        }
+        asm.emit(0xd1000463); // sub x3, x3, #1
+        asm.emit(0x14000000, "bytes", 26); // b bytes
+        asm.label("done");
+        asm.emit(0xd65f03c0); // ret
+        asm.slow();
+        return asm;
+    }
+
+    private static class Assembler {
+        private final List<Integer> code = new ArrayList<>();
+        private final Map<String, Integer> labels = new HashMap<>();
+        private final List<int[]> fixups = new ArrayList<>(); // index, target, immediate bits
+        private final List<String> targets = new ArrayList<>();
+        private final List<Object[]> literals = new ArrayList<>(); // emitted behind the code
+
+        void emit(int instruction) {
+            code.add(instruction);
+        }
+
+        void emit(int instruction, String label, int bits) {
+            targets.add(label);
+            fixups.add(new int[]{code.size(), targets.size() - 1, bits});
+            code.add(instruction);
+        }
+
+        void label(String name) {
+            labels.put(name, code.size());
+        }
+
+        void literal(String name, long value) {
+            literals.add(new Object[]{name, value});
+        }
+
+        void slow() {
+            label("slow");
+            emit(0x58000010, "original", 19); // ldr x16, original
+            emit(0xd61f0200); // br x16
+        }
+
+        byte[] assemble() {
+            if (code.size() % 2 != 0) {
+                emit(0xd503201f); // nop, aligns the literals
+            }
+            for (Object[] literal : literals) {
+                long value = (Long) literal[1];
+                label((String) literal[0]);
+                emit((int) value);
+                emit((int) (value >>> 32));
+            }
+            for (int[] fixup : fixups) {
+                int index = fixup[0];
+                int bits = fixup[2];
+                int offset = labels.get(targets.get(fixup[1])) - index;
+                int imm = offset & ((1 << bits) - 1);
+                code.set(index, code.get(index) | (bits == 26 ? imm : imm << 5));
+            }
+            ByteBuffer buffer = ByteBuffer.allocate(code.size() * 4);
+            buffer.order(ByteOrder.LITTLE_ENDIAN);
+            for (int instruction : code) {
+                buffer.putInt(instruction);
+            }
+            return buffer.array();
+        }
+    }
+
+}
@@ -104,6 +104,14 @@ public interface VM {
     void setVerboseMethodOperation(boolean verboseMethodOperation);
     void setVerboseFieldOperation(boolean verboseFieldOperation);
 
+    /**
+     * Serve GetArrayLength, the string length functions and the byte, short, int, float and double
+     * Get/Set&lt;Type&gt;ArrayRegion functions from guest memory once an object was seen, without trapping into the VM.
+     * Those calls are no longer traced, and Java code changing an array behind the VM's back is only seen
+     * by native code from the next JNI call on. arm64 only.
+     */
+    void setJniMirror(boolean jniMirror);
+
     void setDvmClassFactory(DvmClassFactory factory);
 
     Emulator<?> getEmulator();
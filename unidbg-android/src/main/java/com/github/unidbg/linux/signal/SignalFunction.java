@@ -3,10 +3,10 @@ package com.github.unidbg.linux.signal;
 import com.github.unidbg.AbstractEmulator;
 import com.github.unidbg.Emulator;
 import com.github.unidbg.arm.backend.Backend;
+import com.github.unidbg.arm.context.EditableArm64RegisterContext;
 import com.github.unidbg.memory.MemoryBlock;
 import com.github.unidbg.pointer.UnidbgPointer;
 import com.github.unidbg.thread.MainTask;
-import unicorn.Arm64Const;
 import unicorn.ArmConst;
 
 public class SignalFunction extends MainTask {
@@ -52,11 +52,12 @@ public class SignalFunction extends MainTask {
             backend.reg_write(ArmConst.UC_ARM_REG_R2, 0); // void *ucontext
             backend.reg_write(ArmConst.UC_ARM_REG_LR, until);
         } else {
-            backend.reg_write(Arm64Const.UC_ARM64_REG_SP, stack.peer);
-            backend.reg_write(Arm64Const.UC_ARM64_REG_X0, signum);
-            backend.reg_write(Arm64Const.UC_ARM64_REG_X1, infoBlock == null ? 0 : infoBlock.getPointer().peer); // siginfo_t *info
-            backend.reg_write(Arm64Const.UC_ARM64_REG_X2, 0); // void *ucontext
-            backend.reg_write(Arm64Const.UC_ARM64_REG_LR, until);
+            EditableArm64RegisterContext context = emulator.getContext();
+            context.setStackPointer(stack);
+            context.setXLong(0, signum);
+            context.setXLong(1, infoBlock == null ? 0 : infoBlock.getPointer().peer); // siginfo_t *info
+            context.setXLong(2, 0); // void *ucontext
+            context.setLR(until);
         }
         return emulator.emulate(action.getSaHandler(), until);
     }
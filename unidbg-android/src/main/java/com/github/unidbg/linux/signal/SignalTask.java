@@ -3,6 +3,7 @@ package com.github.unidbg.linux.signal;
 import com.github.unidbg.AbstractEmulator;
 import com.github.unidbg.Emulator;
 import com.github.unidbg.arm.backend.Backend;
+import com.github.unidbg.arm.context.EditableArm64RegisterContext;
 import com.github.unidbg.memory.MemoryBlock;
 import com.github.unidbg.pointer.UnidbgPointer;
 import com.github.unidbg.signal.AbstractSignalTask;
@@ -10,7 +11,6 @@ import com.github.unidbg.signal.SigSet;
 import com.github.unidbg.signal.SignalOps;
 import com.github.unidbg.signal.UnixSigSet;
 import com.sun.jna.Pointer;
-import unicorn.Arm64Const;
 import unicorn.ArmConst;
 
 public class SignalTask extends AbstractSignalTask {
@@ -72,11 +72,12 @@ public class SignalTask extends AbstractSignalTask {
             backend.reg_write(ArmConst.UC_ARM_REG_R2, UnidbgPointer.nativeValue(ucontext.getPointer()));
             backend.reg_write(ArmConst.UC_ARM_REG_LR, emulator.getReturnAddress());
         } else {
-            backend.reg_write(Arm64Const.UC_ARM64_REG_SP, stack.peer);
-            backend.reg_write(Arm64Const.UC_ARM64_REG_X0, signum);
-            backend.reg_write(Arm64Const.UC_ARM64_REG_X1, UnidbgPointer.nativeValue(sig_info)); // siginfo_t *info
-            backend.reg_write(Arm64Const.UC_ARM64_REG_X2, UnidbgPointer.nativeValue(ucontext.getPointer()));
-            backend.reg_write(Arm64Const.UC_ARM64_REG_LR, emulator.getReturnAddress());
+            EditableArm64RegisterContext context = emulator.getContext();
+            context.setStackPointer(stack);
+            context.setXLong(0, signum);
+            context.setXLong(1, UnidbgPointer.nativeValue(sig_info)); // siginfo_t *info
+            context.setXLong(2, UnidbgPointer.nativeValue(ucontext.getPointer()));
+            context.setLR(emulator.getReturnAddress());
         }
         return emulator.emulate(action.getSaHandler(), emulator.getReturnAddress());
     }
@@ -3,7 +3,7 @@ package com.github.unidbg.linux.thread;
 import com.github.unidbg.Emulator;
 import com.github.unidbg.Svc;
 import com.github.unidbg.arm.Arm64Svc;
-import com.github.unidbg.arm.backend.Backend;
+import com.github.unidbg.arm.context.EditableArm64RegisterContext;
 import com.github.unidbg.arm.context.RegisterContext;
 import com.github.unidbg.memory.SvcMemory;
 import com.github.unidbg.pointer.UnidbgPointer;
@@ -45,7 +45,6 @@ class ClonePatcher64 extends Arm64Svc {
         Pointer arg = thread.getPointer(0x68);
         log.info("clone start_routine=" + start_routine + ", child_stack=" + child_stack + ", flags=0x" + Integer.toHexString(flags) + ", arg=" + arg + ", pthread_start=" + pthread_start);
 
-        Backend backend = emulator.getBackend();
         boolean join = visitor == null || visitor.canJoin(start_routine, ++threadId);
         UnidbgPointer pointer = UnidbgPointer.register(emulator, Arm64Const.UC_ARM64_REG_SP);
         try {
@@ -63,7 +62,7 @@ class ClonePatcher64 extends Arm64Svc {
             pointer = pointer.share(-8, 0); // can join
             pointer.setLong(0, join ? 1 : 0);
         } finally {
-            backend.reg_write(Arm64Const.UC_ARM64_REG_SP, pointer.peer);
+            emulator.<EditableArm64RegisterContext>getContext().setStackPointer(pointer);
         }
         return 0;
     }
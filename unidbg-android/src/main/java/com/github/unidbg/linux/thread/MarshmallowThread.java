@@ -3,6 +3,7 @@ package com.github.unidbg.linux.thread;
 import com.github.unidbg.AbstractEmulator;
 import com.github.unidbg.Emulator;
 import com.github.unidbg.arm.backend.Backend;
+import com.github.unidbg.arm.context.EditableArm64RegisterContext;
 import com.github.unidbg.pointer.UnidbgPointer;
 import com.github.unidbg.thread.ThreadTask;
 import com.sun.jna.Pointer;
@@ -61,10 +62,11 @@ public class MarshmallowThread extends ThreadTask {
         } else {
             Pointer tls = thread.share(0xb0);
             this.errno = tls.share(16);
-            backend.reg_write(Arm64Const.UC_ARM64_REG_X0, UnidbgPointer.nativeValue(thread));
-            backend.reg_write(Arm64Const.UC_ARM64_REG_SP, stack.peer);
+            EditableArm64RegisterContext context = emulator.getContext();
+            context.setXLong(0, UnidbgPointer.nativeValue(thread));
+            context.setStackPointer(stack);
             backend.reg_write(Arm64Const.UC_ARM64_REG_TPIDR_EL0, UnidbgPointer.nativeValue(tls));
-            backend.reg_write(Arm64Const.UC_ARM64_REG_LR, until);
+            context.setLR(until);
         }
         return emulator.emulate(this.fn.peer, until);
     }
@@ -0,0 +1,54 @@
+package com.github.unidbg.android;
+
+import com.alibaba.fastjson.util.IOUtils;
+import com.github.unidbg.AndroidEmulator;
+import com.github.unidbg.arm.backend.BackendFactory;
+import com.github.unidbg.linux.android.AndroidEmulatorBuilder;
+import com.github.unidbg.pointer.UnidbgPointer;
+import keystone.Keystone;
+import keystone.KeystoneArchitecture;
+import keystone.KeystoneEncoded;
+import keystone.KeystoneMode;
+import unicorn.UnicornConst;
+
+/**
+ * Times one call of an arm64 assembly loop on a fresh emulator, with the feature under test off or on.
+ */
+public abstract class Arm64LoopBenchmark {
+
+    private final String assembly;
+
+    protected Arm64LoopBenchmark(String assembly) {
+        this.assembly = assembly;
+    }
+
+    /**
+     * @param x0 the first argument of the loop
+     * @return elapsed nanoseconds
+     */
+    protected final long measure(BackendFactory factory, boolean enable, long x0) {
+        AndroidEmulator emulator = AndroidEmulatorBuilder.for64Bit()
+                .setProcessName("benchmark")
+                .addBackendFactory(factory)
+                .build();
+        try (Keystone keystone = new Keystone(KeystoneArchitecture.Arm64, KeystoneMode.LittleEndian)) {
+            KeystoneEncoded encoded = keystone.assemble(assembly);
+            byte[] code = encoded.getMachineCode();
+            UnidbgPointer pointer = emulator.getMemory().mmap(emulator.getPageAlign(), UnicornConst.UC_PROT_READ | UnicornConst.UC_PROT_EXEC);
+            pointer.write(0, code, 0, code.length);
+
+            if (enable) {
+                enable(emulator);
+            }
+
+            long start = System.nanoTime();
+            emulator.eFunc(pointer.peer, x0);
+            return System.nanoTime() - start;
+        } finally {
+            IOUtils.close(emulator);
+        }
+    }
+
+    protected abstract void enable(AndroidEmulator emulator);
+
+}
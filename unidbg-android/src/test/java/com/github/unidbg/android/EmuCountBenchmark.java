@@ -0,0 +1,43 @@
+package com.github.unidbg.android;
+
+import com.github.unidbg.AndroidEmulator;
+import com.github.unidbg.arm.backend.BackendFactory;
+import com.github.unidbg.arm.backend.DynarmicFactory;
+import com.github.unidbg.arm.backend.Unicorn2Factory;
+
+/**
+ * Measures the overhead of the instruction-count budget used by the thread dispatcher.
+ */
+public class EmuCountBenchmark extends Arm64LoopBenchmark {
+
+    private static final int LOOP = 50000000;
+    private static final long EMU_COUNT = 10000;
+
+    public static void main(String[] args) {
+        EmuCountBenchmark benchmark = new EmuCountBenchmark();
+        benchmark.run(new Unicorn2Factory(false), false);
+        benchmark.run(new Unicorn2Factory(false), true);
+        benchmark.run(new DynarmicFactory(false), false);
+        benchmark.run(new DynarmicFactory(false), true);
+    }
+
+    private EmuCountBenchmark() {
+        super("loop:\n" +
+                "add x1, x1, #1\n" +
+                "subs x0, x0, #1\n" +
+                "b.ne loop\n" +
+                "ret");
+    }
+
+    private void run(BackendFactory factory, boolean emuCount) {
+        long elapsed = measure(factory, emuCount, LOOP);
+        System.out.printf("%s emuCount=%s, %d iterations in %dms, %.0f insn/s%n", factory.getClass().getSimpleName(), emuCount, LOOP, elapsed / 1000000, LOOP * 3e9 / elapsed);
+    }
+
+    @Override
+    protected void enable(AndroidEmulator emulator) {
+        emulator.getBackend().registerEmuCountHook(EMU_COUNT);
+        emulator.getSyscallHandler().setEnableThreadDispatcher(true); // resumes the main task after every budget
+    }
+
+}
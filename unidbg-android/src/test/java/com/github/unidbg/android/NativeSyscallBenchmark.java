@@ -0,0 +1,45 @@
+package com.github.unidbg.android;
+
+import com.github.unidbg.AndroidEmulator;
+import com.github.unidbg.arm.backend.DynarmicFactory;
+
+/**
+ * Measures clock_gettime throughput with and without the native syscall table.
+ */
+public class NativeSyscallBenchmark extends Arm64LoopBenchmark {
+
+    private static final int LOOP = 1000000;
+
+    public static void main(String[] args) {
+        NativeSyscallBenchmark benchmark = new NativeSyscallBenchmark();
+        benchmark.run(false);
+        benchmark.run(true);
+    }
+
+    private NativeSyscallBenchmark() {
+        super("mov x9, x0\n" +
+                "sub sp, sp, #0x10\n" +
+                "loop:\n" +
+                "mov x0, #1\n" + // CLOCK_MONOTONIC
+                "mov x1, sp\n" +
+                "mov x8, #113\n" + // clock_gettime
+                "svc #0\n" +
+                "subs x9, x9, #1\n" +
+                "b.ne loop\n" +
+                "add sp, sp, #0x10\n" +
+                "ret");
+    }
+
+    private void run(boolean nativeSyscalls) {
+        long elapsed = measure(new DynarmicFactory(false), nativeSyscalls, LOOP);
+        System.out.printf("nativeSyscalls=%s, %d svc in %dms, %.0f svc/s%n", nativeSyscalls, LOOP, elapsed / 1000000, LOOP * 1e9 / elapsed);
+    }
+
+    @Override
+    protected void enable(AndroidEmulator emulator) {
+        if (!emulator.getSyscallHandler().registerNativeSyscalls(emulator)) {
+            throw new IllegalStateException("native syscalls not supported: " + emulator.getBackend());
+        }
+    }
+
+}
@@ -0,0 +1,70 @@
+package com.github.unidbg.linux;
+
+import com.github.unidbg.AndroidEmulator;
+import com.github.unidbg.Emulator;
+import com.github.unidbg.Module;
+import com.github.unidbg.arm.backend.DynarmicFactory;
+import com.github.unidbg.file.FileResult;
+import com.github.unidbg.file.IOResolver;
+import com.github.unidbg.file.linux.AndroidFileIO;
+import com.github.unidbg.linux.android.AndroidEmulatorBuilder;
+import com.github.unidbg.linux.android.AndroidResolver;
+import com.github.unidbg.linux.file.ByteArrayFileIO;
+import com.github.unidbg.memory.MemoryBlock;
+import com.github.unidbg.pointer.UnidbgPointer;
+import junit.framework.TestCase;
+
+import java.nio.charset.StandardCharsets;
+
+public class ForkTest extends TestCase {
+
+    private static final String DATA_PATH = "/data/local/tmp/fork";
+
+    public void testForkAndSyscall() throws Exception {
+        try (AndroidEmulator template = createEmulator("template")) {
+            Module libc = template.getMemory().dlopen("libc.so");
+            MemoryBlock block = template.getMemory().malloc(0x40, true);
+            UnidbgPointer pointer = block.getPointer();
+            pointer.setString(0, DATA_PATH);
+            assertEquals(DATA_PATH.length(), libc.callFunction(template, "strlen", pointer.peer).intValue());
+
+            try (AndroidEmulator clone = createEmulator("clone")) {
+                clone.forkFrom(template);
+                Module forked = clone.getMemory().findModule("libc.so");
+                assertNotNull(forked);
+                assertEquals(libc.base, forked.base);
+
+                // open and read go through the syscall handler and the file resolver of the clone
+                int fd = forked.callFunction(clone, "open", pointer.peer, 0).intValue();
+                assertTrue(fd > 0);
+                assertEquals(5, forked.callFunction(clone, "read", fd, pointer.peer, 0x20).intValue());
+                UnidbgPointer view = UnidbgPointer.pointer(clone, pointer.peer);
+                assertNotNull(view);
+                assertEquals("clone", new String(view.getByteArray(0, 5), StandardCharsets.UTF_8));
+            }
+
+            // the clone wrote its own copy of the page
+            assertEquals(DATA_PATH, pointer.getString(0));
+            assertEquals(DATA_PATH.length(), libc.callFunction(template, "strlen", pointer.peer).intValue());
+        }
+    }
+
+    private static AndroidEmulator createEmulator(final String content) {
+        AndroidEmulator emulator = AndroidEmulatorBuilder.for64Bit()
+                .setProcessName("fork")
+                .addBackendFactory(new DynarmicFactory(true))
+                .build();
+        emulator.getMemory().setLibraryResolver(new AndroidResolver(23));
+        emulator.getSyscallHandler().addIOResolver(new IOResolver<AndroidFileIO>() {
+            @Override
+            public FileResult<AndroidFileIO> resolve(Emulator<AndroidFileIO> emulator, String pathname, int oflags) {
+                if (DATA_PATH.equals(pathname)) {
+                    return FileResult.<AndroidFileIO>success(new ByteArrayFileIO(oflags, pathname, content.getBytes(StandardCharsets.UTF_8)));
+                }
+                return null;
+            }
+        });
+        return emulator;
+    }
+
+}
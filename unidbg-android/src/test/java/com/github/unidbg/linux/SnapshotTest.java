@@ -0,0 +1,89 @@
+package com.github.unidbg.linux;
+
+import com.github.unidbg.AndroidEmulator;
+import com.github.unidbg.Emulator;
+import com.github.unidbg.Module;
+import com.github.unidbg.file.FileIO;
+import com.github.unidbg.file.FileResult;
+import com.github.unidbg.file.IOResolver;
+import com.github.unidbg.file.linux.AndroidFileIO;
+import com.github.unidbg.linux.android.AndroidEmulatorBuilder;
+import com.github.unidbg.linux.android.AndroidResolver;
+import com.github.unidbg.linux.file.ByteArrayFileIO;
+import com.github.unidbg.memory.MemoryBlock;
+import junit.framework.TestCase;
+import unicorn.Arm64Const;
+
+import java.io.File;
+import java.nio.charset.StandardCharsets;
+
+public class SnapshotTest extends TestCase {
+
+    private static final String DATA_PATH = "/data/local/tmp/snapshot";
+
+    private File file;
+
+    @Override
+    protected void setUp() throws Exception {
+        super.setUp();
+        file = File.createTempFile("unidbg", ".snapshot");
+    }
+
+    @Override
+    protected void tearDown() throws Exception {
+        assertTrue(file.delete());
+        super.tearDown();
+    }
+
+    public void testRestoreAndCall() throws Exception {
+        long string;
+        int fd;
+        try (AndroidEmulator emulator = createEmulator()) {
+            Module libc = emulator.getMemory().dlopen("libc.so");
+            MemoryBlock block = emulator.getMemory().malloc(0x10, true);
+            string = block.getPointer().peer;
+            block.getPointer().setString(0, "unidbg");
+            assertEquals(6, libc.callFunction(emulator, "strlen", string).intValue());
+
+            fd = emulator.getSyscallHandler().open(emulator, DATA_PATH, 0);
+            assertTrue(fd > 0);
+            emulator.getSyscallHandler().getFileIO(fd).lseek(3, FileIO.SEEK_SET);
+            emulator.getBackend().reg_write(Arm64Const.UC_ARM64_REG_X19, 0x1234);
+            emulator.snapshot(file);
+
+            block.getPointer().setString(0, "x");
+            assertEquals(1, libc.callFunction(emulator, "strlen", string).intValue());
+            emulator.restore(file); // the modules are still loaded at their serialized base
+            assertEquals(6, libc.callFunction(emulator, "strlen", string).intValue());
+        }
+
+        try (AndroidEmulator emulator = createEmulator()) {
+            assertNull(emulator.getMemory().findModule("libc.so"));
+            emulator.restore(file);
+            assertEquals(0x1234, emulator.getBackend().reg_read(Arm64Const.UC_ARM64_REG_X19).intValue());
+            FileIO io = emulator.getSyscallHandler().getFileIO(fd);
+            assertNotNull(io);
+            assertEquals(3, io.lseek(0, FileIO.SEEK_CUR));
+
+            Module libc = emulator.getMemory().findModule("libc.so");
+            assertNotNull(libc);
+            assertEquals(6, libc.callFunction(emulator, "strlen", string).intValue());
+        }
+    }
+
+    private static AndroidEmulator createEmulator() {
+        AndroidEmulator emulator = AndroidEmulatorBuilder.for64Bit().setProcessName("snapshot").build();
+        emulator.getMemory().setLibraryResolver(new AndroidResolver(23));
+        emulator.getSyscallHandler().addIOResolver(new IOResolver<AndroidFileIO>() {
+            @Override
+            public FileResult<AndroidFileIO> resolve(Emulator<AndroidFileIO> emulator, String pathname, int oflags) {
+                if (DATA_PATH.equals(pathname)) {
+                    return FileResult.<AndroidFileIO>success(new ByteArrayFileIO(oflags, pathname, "snapshot".getBytes(StandardCharsets.UTF_8)));
+                }
+                return null;
+            }
+        });
+        return emulator;
+    }
+
+}
@@ -0,0 +1,117 @@
+package com.github.unidbg.linux.android.dvm;
+
+import com.github.unidbg.AndroidEmulator;
+import com.github.unidbg.Module;
+import com.github.unidbg.linux.android.AndroidEmulatorBuilder;
+import com.github.unidbg.linux.android.dvm.array.IntArray;
+import com.github.unidbg.linux.android.dvm.array.ShortArray;
+import com.github.unidbg.memory.MemoryBlock;
+import com.github.unidbg.pointer.UnidbgPointer;
+import junit.framework.TestCase;
+
+import java.util.Arrays;
+
+public class JniMirrorTest extends TestCase {
+
+    private static final int GetArrayLength = 0x558;
+    private static final int GetIntArrayRegion = 0x658;
+    private static final int SetShortArrayRegion = 0x690;
+    private static final int SetIntArrayRegion = 0x6a8;
+
+    private AndroidEmulator emulator;
+    private BaseVM vm;
+    private MemoryBlock buf;
+
+    @Override
+    protected void setUp() throws Exception {
+        super.setUp();
+        emulator = AndroidEmulatorBuilder.for64Bit().setProcessName("mirror").build();
+        vm = (BaseVM) emulator.createDalvikVM();
+        vm.setJniMirror(true);
+        buf = emulator.getMemory().malloc(0x100, true);
+    }
+
+    @Override
+    protected void tearDown() throws Exception {
+        buf.free();
+        emulator.close();
+        super.tearDown();
+    }
+
+    public void testHitAndMiss() {
+        IntArray array = new IntArray(vm, new int[]{1, 2, 3});
+        int handle = vm.addLocalObject(array);
+        assertTrue(Arrays.equals(new int[]{1, 2, 3}, getIntArrayRegion(handle, 0, 3))); // miss, mirrors the array
+
+        array.getValue()[0] = 9; // behind the back of the VM: only a miss sees it
+        assertTrue(Arrays.equals(new int[]{1, 2, 3}, getIntArrayRegion(handle, 0, 3)));
+        assertEquals(3, call(GetArrayLength, handle));
+
+        assertSame(array, vm.getObject(handle)); // resolving the handle drops the mirror
+        assertTrue(Arrays.equals(new int[]{9, 2, 3}, getIntArrayRegion(handle, 0, 3)));
+    }
+
+    public void testSetRegionWrittenBackAtDeleteLocalRefs() {
+        IntArray array = new IntArray(vm, new int[4]);
+        int handle = vm.addLocalObject(array);
+        getIntArrayRegion(handle, 0, 4);
+
+        buf.getPointer().write(0, new int[]{5, 6}, 0, 2);
+        call(SetIntArrayRegion, handle, 1, 2, buf.getPointer().peer);
+        assertTrue(Arrays.equals(new int[4], array.getValue())); // served by the stub
+        assertTrue(Arrays.equals(new int[]{0, 5, 6}, getIntArrayRegion(handle, 0, 3)));
+
+        vm.deleteLocalRefs();
+        assertTrue(Arrays.equals(new int[]{0, 5, 6, 0}, array.getValue()));
+    }
+
+    public void testSetShortRegionFallback() {
+        ShortArray array = new ShortArray(vm, new short[3]);
+        int handle = vm.addLocalObject(array);
+        buf.getPointer().write(0, new short[]{7, 8}, 0, 2);
+        call(SetShortArrayRegion, handle, 1, 2, buf.getPointer().peer);
+        assertTrue(Arrays.equals(new short[]{0, 7, 8}, array.getValue()));
+    }
+
+    public void testOutOfRangeFallsBack() {
+        IntArray array = new IntArray(vm, new int[]{1, 2, 3});
+        int handle = vm.addLocalObject(array);
+        getIntArrayRegion(handle, 0, 3);
+
+        array.getValue()[2] = 7;
+        assertEquals(3, getIntArrayRegion(handle, 2, 1)[0]); // in range: the mirror
+        assertEquals(7, getIntArrayRegion(handle, 2, 2)[0]); // past the end: the Java handler
+    }
+
+    public void testTableGrowth() {
+        int count = 200;
+        IntArray[] arrays = new IntArray[count];
+        int[] handles = new int[count];
+        for (int i = 0; i < count; i++) {
+            arrays[i] = new IntArray(vm, new int[]{i});
+            handles[i] = vm.addLocalObject(arrays[i]);
+            getIntArrayRegion(handles[i], 0, 1);
+        }
+        for (int i = 0; i < count; i++) {
+            arrays[i].getValue()[0] = -1;
+            assertEquals(i, getIntArrayRegion(handles[i], 0, 1)[0]);
+        }
+    }
+
+    private int[] getIntArrayRegion(int handle, int start, int length) {
+        UnidbgPointer pointer = buf.getPointer();
+        pointer.write(0, new byte[0x100], 0, 0x100);
+        call(GetIntArrayRegion, handle, start, length, pointer.peer);
+        return pointer.getIntArray(0, Math.min(length, 0x40));
+    }
+
+    private int call(int offset, Object... args) {
+        UnidbgPointer env = (UnidbgPointer) vm.getJNIEnv();
+        UnidbgPointer function = env.getPointer(0).getPointer(offset);
+        Object[] arguments = new Object[args.length + 1];
+        arguments[0] = env.peer;
+        System.arraycopy(args, 0, arguments, 1, args.length);
+        return Module.emulateFunction(emulator, function.peer, arguments).intValue();
+    }
+
+}
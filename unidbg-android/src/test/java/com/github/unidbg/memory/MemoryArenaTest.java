@@ -0,0 +1,114 @@
+package com.github.unidbg.memory;
+
+import com.github.unidbg.AndroidEmulator;
+import com.github.unidbg.linux.android.AndroidEmulatorBuilder;
+import com.github.unidbg.pointer.UnidbgPointer;
+import junit.framework.TestCase;
+
+import java.util.Arrays;
+
+public class MemoryArenaTest extends TestCase {
+
+    private AndroidEmulator emulator;
+    private Memory memory;
+    private MemoryArena arena;
+
+    @Override
+    protected void setUp() throws Exception {
+        super.setUp();
+        emulator = AndroidEmulatorBuilder.for64Bit().setProcessName("arena").build();
+        memory = emulator.getMemory();
+        arena = new MemoryArena(memory);
+    }
+
+    @Override
+    protected void tearDown() throws Exception {
+        emulator.close();
+        super.tearDown();
+    }
+
+    public void testSizeClasses() {
+        assertEquals(0x10, arena.alloc(0).getPointer().getSize());
+        assertEquals(0x10, arena.alloc(1).getPointer().getSize());
+        assertEquals(0x10, arena.alloc(0x10).getPointer().getSize());
+        assertEquals(0x20, arena.alloc(0x11).getPointer().getSize());
+        assertEquals(0x10000, arena.alloc(0x10000).getPointer().getSize());
+        assertEquals(0, arena.alloc(0x30).getPointer().peer & 0xf);
+    }
+
+    public void testReuse() {
+        MemoryBlock block = arena.alloc(100);
+        long address = block.getPointer().peer;
+        block.free();
+        assertEquals(address, arena.alloc(120).getPointer().peer); // same class of 128 bytes
+        assertTrue(address != arena.alloc(120).getPointer().peer);
+    }
+
+    public void testZeroing() {
+        MemoryBlock block = arena.alloc(0x40);
+        byte[] data = new byte[0x40];
+        Arrays.fill(data, (byte) 0xcc);
+        block.getPointer().write(0, data, 0, data.length);
+        block.free();
+
+        UnidbgPointer pointer = arena.alloc(0x40).getPointer();
+        assertEquals(block.getPointer().peer, pointer.peer);
+        assertTrue(Arrays.equals(new byte[0x40], pointer.getByteArray(0, 0x40)));
+    }
+
+    public void testDoubleFree() {
+        MemoryBlock block = arena.alloc(8);
+        block.free();
+        try {
+            block.free();
+            fail();
+        } catch (IllegalStateException ignored) {
+        }
+        arena.alloc(8);
+        assertTrue(block.getPointer().peer != arena.alloc(8).getPointer().peer); // freed once, handed out once
+    }
+
+    public void testLargeBlockFallback() {
+        int maps = memory.getMemoryMap().size();
+        MemoryBlock block = arena.alloc(0x10001);
+        assertEquals(maps + 1, memory.getMemoryMap().size()); // a mapping of its own
+        assertEquals(0, block.getPointer().peer & 0xfff);
+        block.free();
+        assertEquals(maps, memory.getMemoryMap().size());
+    }
+
+    public void testChunkTailReleased() {
+        long base = arena.alloc(0x10).getPointer().peer;
+        for (int i = 0; i < 15; i++) {
+            arena.alloc(0x10000);
+        }
+        arena.alloc(0x10000); // 0xfff0 bytes left, a new chunk is mapped
+        assertEquals(base + 0xf0010, arena.alloc(0x8000).getPointer().peer);
+        assertEquals(base + 0xf8010, arena.alloc(0x4000).getPointer().peer);
+        assertEquals(base + 0xffff0, arena.alloc(0x10).getPointer().peer);
+    }
+
+    public void testEmptyChunkUnmapped() {
+        MemoryBlock[] blocks = new MemoryBlock[16];
+        for (int i = 0; i < blocks.length; i++) {
+            blocks[i] = arena.alloc(0x10000); // fills the first chunk
+        }
+        arena.alloc(0x10);
+        int maps = memory.getMemoryMap().size();
+        for (MemoryBlock block : blocks) {
+            block.free();
+        }
+        assertEquals(maps - 1, memory.getMemoryMap().size());
+        assertTrue(arena.alloc(0x10000).getPointer().peer != blocks[0].getPointer().peer);
+    }
+
+    public void testReset() {
+        MemoryBlock block = arena.alloc(0x10);
+        int maps = memory.getMemoryMap().size();
+        arena.reset();
+        block.free(); // stale, ignored
+        arena.alloc(0x10);
+        assertEquals(maps + 1, memory.getMemoryMap().size()); // the old chunk is not handed out again
+    }
+
+}
@@ -19,6 +19,7 @@ import com.github.unidbg.listener.TraceReadListener;
 import com.github.unidbg.listener.TraceSystemMemoryWriteListener;
 import com.github.unidbg.listener.TraceWriteListener;
 import com.github.unidbg.memory.Memory;
+import com.github.unidbg.memory.MemoryMap;
 import com.github.unidbg.memory.SvcMemory;
 import com.github.unidbg.pointer.MemoryWriteListener;
 import com.github.unidbg.pointer.UnidbgPointer;
@@ -38,10 +39,16 @@ import org.slf4j.LoggerFactory;
 import unicorn.Arm64Const;
 import unicorn.ArmConst;
 
+import java.io.ByteArrayInputStream;
+import java.io.ByteArrayOutputStream;
+import java.io.DataInput;
+import java.io.DataInputStream;
 import java.io.DataOutput;
+import java.io.DataOutputStream;
 import java.io.File;
 import java.io.IOException;
 import java.io.PrintWriter;
+import java.io.RandomAccessFile;
 import java.io.StringWriter;
 import java.lang.management.ManagementFactory;
 import java.text.DateFormat;
@@ -487,8 +494,141 @@ public abstract class AbstractEmulator<T extends NewFileIO> implements Emulator<
         out.writeUTF(getClass().getName());
         getMemory().serialize(out);
         getSvcMemory().serialize(out);
-        getSyscallHandler().serialize(out);
+        getSyscallHandler().serialize(this, out);
         getDlfcn().serialize(out);
+        serializeRegisters(out);
+    }
+
+    /**
+     * Only restores the bookkeeping and the registers, the memory contents are mapped by {@link #restore(File)}.
+     */
+    @Override
+    public final void deserialize(DataInput in) throws IOException {
+        String className = in.readUTF();
+        if (!getClass().getName().equals(className)) {
+            throw new IllegalStateException("Snapshot of " + className + " cannot be restored into " + getClass().getName());
+        }
+        getMemory().deserialize(in);
+        getSvcMemory().deserialize(in);
+        getSyscallHandler().deserialize(this, in);
+        getDlfcn().deserialize(in);
+        deserializeRegisters(in);
+    }
+
+    private static final int[] ARM_SNAPSHOT_REGS = new int[] {
+            ArmConst.UC_ARM_REG_R0, ArmConst.UC_ARM_REG_R1, ArmConst.UC_ARM_REG_R2, ArmConst.UC_ARM_REG_R3,
+            ArmConst.UC_ARM_REG_R4, ArmConst.UC_ARM_REG_R5, ArmConst.UC_ARM_REG_R6, ArmConst.UC_ARM_REG_R7,
+            ArmConst.UC_ARM_REG_R8, ArmConst.UC_ARM_REG_R9, ArmConst.UC_ARM_REG_R10, ArmConst.UC_ARM_REG_R11,
+            ArmConst.UC_ARM_REG_R12, ArmConst.UC_ARM_REG_SP, ArmConst.UC_ARM_REG_LR, ArmConst.UC_ARM_REG_PC,
+            ArmConst.UC_ARM_REG_CPSR, ArmConst.UC_ARM_REG_C13_C0_3,
+    };
+
+    private static final int[] ARM64_SNAPSHOT_REGS = new int[] {
+            Arm64Const.UC_ARM64_REG_X0, Arm64Const.UC_ARM64_REG_X1, Arm64Const.UC_ARM64_REG_X2, Arm64Const.UC_ARM64_REG_X3,
+            Arm64Const.UC_ARM64_REG_X4, Arm64Const.UC_ARM64_REG_X5, Arm64Const.UC_ARM64_REG_X6, Arm64Const.UC_ARM64_REG_X7,
+            Arm64Const.UC_ARM64_REG_X8, Arm64Const.UC_ARM64_REG_X9, Arm64Const.UC_ARM64_REG_X10, Arm64Const.UC_ARM64_REG_X11,
+            Arm64Const.UC_ARM64_REG_X12, Arm64Const.UC_ARM64_REG_X13, Arm64Const.UC_ARM64_REG_X14, Arm64Const.UC_ARM64_REG_X15,
+            Arm64Const.UC_ARM64_REG_X16, Arm64Const.UC_ARM64_REG_X17, Arm64Const.UC_ARM64_REG_X18, Arm64Const.UC_ARM64_REG_X19,
+            Arm64Const.UC_ARM64_REG_X20, Arm64Const.UC_ARM64_REG_X21, Arm64Const.UC_ARM64_REG_X22, Arm64Const.UC_ARM64_REG_X23,
+            Arm64Const.UC_ARM64_REG_X24, Arm64Const.UC_ARM64_REG_X25, Arm64Const.UC_ARM64_REG_X26, Arm64Const.UC_ARM64_REG_X27,
+            Arm64Const.UC_ARM64_REG_X28, Arm64Const.UC_ARM64_REG_X29, Arm64Const.UC_ARM64_REG_LR, Arm64Const.UC_ARM64_REG_SP,
+            Arm64Const.UC_ARM64_REG_PC, Arm64Const.UC_ARM64_REG_NZCV, Arm64Const.UC_ARM64_REG_TPIDR_EL0,
+    };
+
+    private static final int ARM64_VECTOR_REGS = 32;
+
+    private void serializeRegisters(DataOutput out) throws IOException {
+        int[] regIds = is64Bit() ? ARM64_SNAPSHOT_REGS : ARM_SNAPSHOT_REGS;
+        for (int regId : regIds) {
+            out.writeLong(backend.reg_read(regId).longValue());
+        }
+        if (is64Bit()) {
+            for (int i = 0; i < ARM64_VECTOR_REGS; i++) {
+                out.write(backend.reg_read_vector(Arm64Const.UC_ARM64_REG_Q0 + i));
+            }
+        }
+    }
+
+    private void deserializeRegisters(DataInput in) throws IOException {
+        int[] regIds = is64Bit() ? ARM64_SNAPSHOT_REGS : ARM_SNAPSHOT_REGS;
+        for (int regId : regIds) {
+            backend.reg_write(regId, in.readLong());
+        }
+        if (is64Bit()) {
+            for (int i = 0; i < ARM64_VECTOR_REGS; i++) {
+                byte[] vector = new byte[16];
+                in.readFully(vector);
+                backend.reg_write_vector(Arm64Const.UC_ARM64_REG_Q0 + i, vector);
+            }
+        }
+    }
+
+    private static final int SNAPSHOT_MAGIC = 0x756e6462; // unidbg
+    private static final long SNAPSHOT_ALIGNMENT = 0x10000; // file offsets of the pages must be aligned for mmap on every host
+    private static final int SNAPSHOT_CHUNK_SIZE = 0x100000;
+
+    @Override
+    public final void snapshot(File file) throws IOException {
+        ByteArrayOutputStream baos = new ByteArrayOutputStream();
+        serialize(new DataOutputStream(baos));
+        try (RandomAccessFile raf = new RandomAccessFile(file, "rw")) {
+            raf.setLength(0);
+            raf.writeInt(SNAPSHOT_MAGIC);
+            raf.writeInt(baos.size());
+            raf.write(baos.toByteArray());
+            long offset = alignSnapshot(raf.getFilePointer());
+            for (MemoryMap map : getMemory().getMemoryMap()) {
+                raf.seek(offset);
+                for (long off = 0; off < map.size; off += SNAPSHOT_CHUNK_SIZE) {
+                    raf.write(backend.mem_read(map.base + off, Math.min(SNAPSHOT_CHUNK_SIZE, map.size - off)));
+                }
+                offset = alignSnapshot(offset + map.size);
+            }
+            raf.seek(offset);
+            raf.write(backend.mem_read(svcMemory.getBase(), svcMemory.getSize()));
+        }
+    }
+
+    @Override
+    public final void restore(File file) throws IOException {
+        try (RandomAccessFile raf = new RandomAccessFile(file, "r")) {
+            if (raf.readInt() != SNAPSHOT_MAGIC) {
+                throw new IOException("Invalid snapshot: " + file);
+            }
+            byte[] state = new byte[raf.readInt()];
+            raf.readFully(state);
+            deserialize(new DataInputStream(new ByteArrayInputStream(state)));
+
+            long offset = alignSnapshot(raf.getFilePointer());
+            for (MemoryMap map : getMemory().getMemoryMap()) {
+                backend.mem_map_file(map.base, map.size, map.prot, file, offset);
+                offset = alignSnapshot(offset + map.size);
+            }
+            byte[] svc = new byte[svcMemory.getSize()];
+            raf.seek(offset);
+            raf.readFully(svc);
+            backend.mem_write(svcMemory.getBase(), svc);
+        }
+    }
+
+    @Override
+    public final void forkFrom(Emulator<?> template) throws IOException {
+        if (template == this) {
+            throw new IllegalArgumentException("fork from itself");
+        }
+        ByteArrayOutputStream baos = new ByteArrayOutputStream();
+        template.serialize(new DataOutputStream(baos));
+        deserialize(new DataInputStream(new ByteArrayInputStream(baos.toByteArray())));
+
+        Backend source = template.getBackend();
+        for (MemoryMap map : getMemory().getMemoryMap()) {
+            backend.mem_map_fork(map.base, map.size, map.prot, source);
+        }
+        backend.mem_write(svcMemory.getBase(), source.mem_read(svcMemory.getBase(), svcMemory.getSize()));
+    }
+
+    private static long alignSnapshot(long offset) {
+        return (offset + SNAPSHOT_ALIGNMENT - 1) & -SNAPSHOT_ALIGNMENT;
     }
 
     private static class Context {
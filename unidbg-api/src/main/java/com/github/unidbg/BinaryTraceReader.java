@@ -0,0 +1,117 @@
+package com.github.unidbg;
+
+import com.github.unidbg.arm.backend.TraceBufferHook;
+
+import java.io.Closeable;
+import java.io.File;
+import java.io.FileInputStream;
+import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.channels.FileChannel;
+
+/**
+ * Iterates the records of a file written by {@link BinaryTraceWriter}:
+ * <pre>
+ * while (reader.next()) {
+ *     if (reader.getType() == TraceBufferHook.TRACE_CODE) ...
+ * }
+ * </pre>
+ */
+public class BinaryTraceReader implements Closeable {
+
+    private static final int BATCH_RECORDS = 0x10000;
+
+    private final FileChannel channel;
+    private final ByteBuffer buffer;
+
+    public BinaryTraceReader(File file) throws IOException {
+        this.channel = new FileInputStream(file).getChannel();
+        try {
+            this.buffer = ByteBuffer.allocateDirect(BATCH_RECORDS * TraceBufferHook.RECORD_SIZE).order(readHeader(file));
+            this.buffer.limit(0);
+        } catch (IOException e) {
+            channel.close();
+            throw e;
+        }
+    }
+
+    /**
+     * @return byte order of the records
+     */
+    private ByteOrder readHeader(File file) throws IOException {
+        ByteBuffer header = ByteBuffer.allocate(BinaryTraceWriter.HEADER_SIZE);
+        readFully(header);
+        if (header.hasRemaining()) {
+            throw new IOException("Truncated trace header: " + file);
+        }
+        int magic = header.getInt(0);
+        if (magic == Integer.reverseBytes(BinaryTraceWriter.MAGIC)) {
+            header.order(ByteOrder.LITTLE_ENDIAN);
+        } else if (magic != BinaryTraceWriter.MAGIC) {
+            throw new IOException("Not a trace file: " + file);
+        }
+        int version = header.getInt(4);
+        int recordSize = header.getInt(8);
+        if (version != BinaryTraceWriter.VERSION || recordSize != TraceBufferHook.RECORD_SIZE) {
+            throw new IOException("Unsupported trace file: version=" + version + ", recordSize=" + recordSize);
+        }
+        return header.order();
+    }
+
+    private void readFully(ByteBuffer dst) throws IOException {
+        while (dst.hasRemaining() && channel.read(dst) != -1) {
+        }
+    }
+
+    private int record = -TraceBufferHook.RECORD_SIZE;
+
+    /**
+     * Advances to the next record.
+     * @return <code>false</code> at the end of the trace
+     */
+    public boolean next() throws IOException {
+        record += TraceBufferHook.RECORD_SIZE;
+        if (record + TraceBufferHook.RECORD_SIZE > buffer.limit()) {
+            buffer.clear();
+            readFully(buffer);
+            buffer.flip();
+            record = 0;
+        }
+        return record + TraceBufferHook.RECORD_SIZE <= buffer.limit();
+    }
+
+    /**
+     * @return pc for code records, accessed address otherwise
+     */
+    public long getAddress() {
+        return buffer.getLong(record);
+    }
+
+    /**
+     * @return value read or written, 0 for code records
+     */
+    public long getValue() {
+        return buffer.getLong(record + 8);
+    }
+
+    /**
+     * @return instruction size or access size
+     */
+    public int getSize() {
+        return buffer.getInt(record + 16);
+    }
+
+    /**
+     * @return one of {@link TraceBufferHook#TRACE_CODE}, {@link TraceBufferHook#TRACE_READ} and {@link TraceBufferHook#TRACE_WRITE}
+     */
+    public int getType() {
+        return buffer.getInt(record + 20);
+    }
+
+    @Override
+    public void close() throws IOException {
+        channel.close();
+    }
+
+}
@@ -0,0 +1,83 @@
+package com.github.unidbg;
+
+import com.github.unidbg.arm.backend.Backend;
+import com.github.unidbg.arm.backend.TraceBufferHook;
+import com.github.unidbg.arm.backend.UnHook;
+
+import java.io.Closeable;
+import java.io.File;
+import java.io.FileOutputStream;
+import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.channels.FileChannel;
+
+/**
+ * Writes a native trace to a file read by {@link BinaryTraceReader}: a header of magic, version and record size
+ * followed by the records as the backend buffered them, all in the byte order of the host.
+ */
+public class BinaryTraceWriter implements TraceBufferHook, Closeable {
+
+    static final int MAGIC = 0x55545243; // UTRC
+    static final int VERSION = 1;
+    static final int HEADER_SIZE = 12;
+
+    private final FileChannel channel;
+
+    public BinaryTraceWriter(File file) throws IOException {
+        this.channel = new FileOutputStream(file).getChannel();
+
+        ByteBuffer header = ByteBuffer.allocate(HEADER_SIZE).order(ByteOrder.nativeOrder());
+        header.putInt(MAGIC);
+        header.putInt(VERSION);
+        header.putInt(RECORD_SIZE);
+        header.flip();
+        write(header);
+    }
+
+    private UnHook unHook;
+
+    @Override
+    public void onAttach(UnHook unHook) {
+        if (this.unHook != null) {
+            throw new IllegalStateException();
+        }
+        this.unHook = unHook;
+    }
+
+    @Override
+    public void detach() {
+        if (unHook != null) {
+            unHook.unhook();
+            unHook = null;
+        }
+    }
+
+    @Override
+    public void onTrace(Backend backend, ByteBuffer records, int count, Object user) {
+        ByteBuffer buffer = records.duplicate();
+        buffer.position(0);
+        buffer.limit(count * RECORD_SIZE);
+        try {
+            write(buffer);
+        } catch (IOException e) {
+            throw new IllegalStateException(e);
+        }
+    }
+
+    private void write(ByteBuffer buffer) throws IOException {
+        while (buffer.hasRemaining()) {
+            channel.write(buffer);
+        }
+    }
+
+    /**
+     * Stops the trace, which hands over the pending records, and closes the file.
+     */
+    @Override
+    public void close() throws IOException {
+        detach();
+        channel.close();
+    }
+
+}
@@ -22,6 +22,7 @@ import com.github.unidbg.unwind.Unwinder;
 
 import java.io.Closeable;
 import java.io.File;
+import java.io.IOException;
 import java.net.URL;
 
 /**
@@ -133,4 +134,23 @@ public interface Emulator<T extends NewFileIO> extends Closeable, ArmDisassemble
     void set(String key, Object value);
     <V> V get(String key);
 
+    /**
+     * Writes the guest memory and the emulator state to <code>file</code>, see {@link #restore(File)}.
+     */
+    void snapshot(File file) throws IOException;
+
+    /**
+     * Resets a freshly created emulator to the state saved by {@link #snapshot(File)}: the loaded modules are rebuilt
+     * through the library resolver, the open files are reopened by path and the registers are restored.
+     * Page contents are mapped copy-on-write from <code>file</code> when the backend supports it, the file must outlive the emulator.
+     */
+    void restore(File file) throws IOException;
+
+    /**
+     * Resets a freshly created emulator to the current state of <code>template</code>, like {@link #restore(File)} without
+     * the file: a warmed template is stamped out without loading and initializing its modules again. The guest pages are
+     * shared copy-on-write when both emulators run on the dynarmic backend and copied otherwise.
+     */
+    void forkFrom(Emulator<?> template) throws IOException;
+
 }
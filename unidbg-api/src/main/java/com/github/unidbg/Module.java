@@ -88,6 +88,10 @@ public abstract class Module {
         return --referenceCount;
     }
 
+    public int getReferenceCount() {
+        return referenceCount;
+    }
+
     private boolean forceCallInit;
 
     public boolean isForceCallInit() {
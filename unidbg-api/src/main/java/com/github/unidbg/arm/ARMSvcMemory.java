@@ -12,7 +12,9 @@ import org.apache.commons.logging.Log;
 import org.apache.commons.logging.LogFactory;
 import unicorn.UnicornConst;
 
+import java.io.DataInput;
 import java.io.DataOutput;
+import java.io.IOException;
 import java.nio.charset.StandardCharsets;
 import java.util.ArrayList;
 import java.util.Arrays;
@@ -41,8 +43,59 @@ public class ARMSvcMemory implements SvcMemory {
     }
 
     @Override
-    public void serialize(DataOutput out) {
-        throw new UnsupportedOperationException();
+    public void serialize(DataOutput out) throws IOException {
+        out.writeLong(baseAddr);
+        out.writeInt(size);
+        out.writeLong(base.peer);
+        out.writeInt(thumbSvcNumber);
+        out.writeInt(armSvcNumber);
+        out.writeInt(memRegions.size());
+        for (MemRegion region : memRegions) {
+            out.writeLong(region.begin);
+            out.writeLong(region.end);
+            out.writeUTF(region.getName());
+        }
+        out.writeInt(symbolMap.size());
+        for (Map.Entry<String, UnidbgPointer> entry : symbolMap.entrySet()) {
+            out.writeUTF(entry.getKey());
+            out.writeLong(entry.getValue().peer);
+        }
+    }
+
+    /**
+     * The svc handlers are java objects: the restoring emulator must have registered the same ones in the same order.
+     */
+    @Override
+    public void deserialize(DataInput in) throws IOException {
+        long baseAddr = in.readLong();
+        int size = in.readInt();
+        if (baseAddr != this.baseAddr || size != this.size) {
+            throw new IllegalStateException("svc memory mismatch: base=0x" + Long.toHexString(baseAddr) + ", size=0x" + Integer.toHexString(size));
+        }
+        long peer = in.readLong();
+        int thumbSvcNumber = in.readInt();
+        int armSvcNumber = in.readInt();
+        if (thumbSvcNumber != this.thumbSvcNumber || armSvcNumber != this.armSvcNumber) {
+            throw new IllegalStateException("svc registration mismatch: thumbSvcNumber=" + thumbSvcNumber + ", armSvcNumber=" + armSvcNumber);
+        }
+        UnidbgPointer pointer = UnidbgPointer.pointer(emulator, baseAddr);
+        assert pointer != null;
+        pointer.setSize(size);
+        base = (UnidbgPointer) pointer.share(peer - baseAddr);
+
+        memRegions.clear();
+        int count = in.readInt();
+        for (int i = 0; i < count; i++) {
+            long begin = in.readLong();
+            long end = in.readLong();
+            addMemRegion(begin, end, in.readUTF());
+        }
+        symbolMap.clear();
+        count = in.readInt();
+        for (int i = 0; i < count; i++) {
+            String name = in.readUTF();
+            symbolMap.put(name, UnidbgPointer.pointer(emulator, in.readLong()));
+        }
     }
 
     private final long baseAddr;
@@ -80,13 +133,17 @@ public class ARMSvcMemory implements SvcMemory {
         if (log.isDebugEnabled()) {
             log.debug("allocate size=" + size + ", label=" + label + ", base=" + base);
         }
-        memRegions.add(new MemRegion(pointer.peer, pointer.peer, pointer.peer + size, UnicornConst.UC_PROT_READ | UnicornConst.UC_PROT_EXEC, null, 0) {
+        addMemRegion(pointer.peer, pointer.peer + size, label);
+        return pointer;
+    }
+
+    private void addMemRegion(long begin, long end, final String label) {
+        memRegions.add(new MemRegion(begin, begin, end, UnicornConst.UC_PROT_READ | UnicornConst.UC_PROT_EXEC, null, 0) {
             @Override
             public String getName() {
                 return label;
             }
         });
-        return pointer;
     }
 
     private final Map<String, UnidbgPointer> symbolMap = new HashMap<>();
@@ -2,7 +2,7 @@ package com.github.unidbg.arm;
 
 import com.github.unidbg.Emulator;
 import com.github.unidbg.Svc;
-import com.github.unidbg.arm.backend.Backend;
+import com.github.unidbg.arm.context.EditableArm64RegisterContext;
 import com.github.unidbg.memory.SvcMemory;
 import com.github.unidbg.pointer.UnidbgPointer;
 import keystone.Keystone;
@@ -90,7 +90,6 @@ public abstract class Arm64Hook extends Arm64Svc {
 
     @Override
     public final long handle(Emulator<?> emulator) {
-        Backend backend = emulator.getBackend();
         if (enablePostCall) {
             regContext = RegContext.backupContext(emulator, Arm64Const.UC_ARM64_REG_X29,
                     Arm64Const.UC_ARM64_REG_X30);
@@ -108,7 +107,7 @@ public abstract class Arm64Hook extends Arm64Svc {
 
             return status.returnValue;
         } finally {
-            backend.reg_write(Arm64Const.UC_ARM64_REG_SP, sp.peer);
+            emulator.<EditableArm64RegisterContext>getContext().setStackPointer(sp);
         }
     }
 
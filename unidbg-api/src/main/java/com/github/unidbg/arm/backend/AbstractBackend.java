@@ -1,5 +1,13 @@
 package com.github.unidbg.arm.backend;
 
+import java.io.ByteArrayOutputStream;
+import java.io.File;
+import java.io.IOException;
+import java.io.RandomAccessFile;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.util.Arrays;
+
 public abstract class AbstractBackend implements Backend {
 
     @Override
@@ -16,7 +24,111 @@ public abstract class AbstractBackend implements Backend {
         throw new UnsupportedOperationException();
     }
 
+    @Override
+    public void reg_read_batch(int[] regIds, long[] values) throws BackendException {
+        for (int i = 0; i < regIds.length; i++) {
+            Number number = reg_read(regIds[i]);
+            values[i] = number instanceof Integer ? number.intValue() & 0xffffffffL : number.longValue();
+        }
+    }
+
+    @Override
+    public void reg_write_batch(int[] regIds, long[] values) throws BackendException {
+        for (int i = 0; i < regIds.length; i++) {
+            reg_write(regIds[i], values[i]);
+        }
+    }
+
+    @Override
+    public byte[] mem_read_cstring(long address, int max) throws BackendException {
+        ByteArrayOutputStream baos = new ByteArrayOutputStream(0x40);
+        while (baos.size() < max) {
+            byte[] data = mem_read(address + baos.size(), Math.min(0x10, max - baos.size()));
+            for (int i = 0; i < data.length; i++) {
+                if (data[i] == 0) {
+                    baos.write(data, 0, i);
+                    return baos.toByteArray();
+                }
+            }
+            baos.write(data, 0, data.length);
+        }
+        return baos.toByteArray();
+    }
+
+    @Override
+    public int mem_read_u32(long address) throws BackendException {
+        return ByteBuffer.wrap(mem_read(address, 4)).order(ByteOrder.LITTLE_ENDIAN).getInt();
+    }
+
+    @Override
+    public long mem_read_u64(long address) throws BackendException {
+        return ByteBuffer.wrap(mem_read(address, 8)).order(ByteOrder.LITTLE_ENDIAN).getLong();
+    }
+
+    @Override
+    public void mem_write_u32(long address, int value) throws BackendException {
+        mem_write(address, ByteBuffer.allocate(4).order(ByteOrder.LITTLE_ENDIAN).putInt(value).array());
+    }
+
+    @Override
+    public void mem_write_u64(long address, long value) throws BackendException {
+        mem_write(address, ByteBuffer.allocate(8).order(ByteOrder.LITTLE_ENDIAN).putLong(value).array());
+    }
+
+    @Override
+    public void mem_read(long address, ByteBuffer dst) throws BackendException {
+        byte[] data = mem_read(address, dst.remaining());
+        ByteBuffer buffer = dst.duplicate();
+        buffer.put(data);
+    }
+
+    @Override
+    public void mem_write(long address, ByteBuffer src) throws BackendException {
+        byte[] data = new byte[src.remaining()];
+        src.duplicate().get(data);
+        mem_write(address, data);
+    }
+
+    @Override
+    public ByteBuffer mem_view(long address, int size) throws BackendException {
+        return null;
+    }
+
+    @Override
+    public void mem_map_file(long address, long size, int perms, File file, long offset) throws BackendException {
+        mem_map(address, size, perms);
+        try (RandomAccessFile raf = new RandomAccessFile(file, "r")) {
+            raf.seek(offset);
+            byte[] data = new byte[(int) Math.min(size, 0x100000)];
+            for (long off = 0; off < size; off += data.length) {
+                int length = (int) Math.min(data.length, size - off);
+                raf.readFully(data, 0, length);
+                mem_write(address + off, length == data.length ? data : Arrays.copyOf(data, length));
+            }
+        } catch (IOException e) {
+            throw new BackendException(e);
+        }
+    }
+
+    @Override
+    public void mem_map_fork(long address, long size, int perms, Backend template) throws BackendException {
+        mem_map(address, size, perms);
+        for (long off = 0; off < size; off += 0x100000) {
+            mem_write(address + off, template.mem_read(address + off, Math.min(0x100000, size - off)));
+        }
+    }
+
+    @Override
+    public void trace_add(TraceBufferHook callback, long begin, long end, int types, int capacity, Object user_data) throws BackendException {
+        throw new UnsupportedOperationException();
+    }
+
     @Override
     public void removeJitCodeCache(long begin, long end) throws BackendException {
     }
+
+    @Override
+    public boolean registerNativeSyscall(int NR, NativeSyscall syscall) throws BackendException {
+        return false;
+    }
 }
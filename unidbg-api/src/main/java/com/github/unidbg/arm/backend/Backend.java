@@ -3,6 +3,9 @@ package com.github.unidbg.arm.backend;
 import com.github.unidbg.debugger.BreakPoint;
 import com.github.unidbg.debugger.BreakPointCallback;
 
+import java.io.File;
+import java.nio.ByteBuffer;
+
 public interface Backend {
 
     void onInitialize();
@@ -17,12 +20,65 @@ public interface Backend {
 
     void reg_write(int regId, Number value) throws BackendException;
 
+    /**
+     * Reads the registers of <code>regIds</code> into <code>values</code> in one call, 32-bit registers are zero-extended.
+     */
+    void reg_read_batch(int[] regIds, long[] values) throws BackendException;
+
+    /**
+     * Writes <code>values</code> to the registers of <code>regIds</code> in one call.
+     */
+    void reg_write_batch(int[] regIds, long[] values) throws BackendException;
+
     byte[] mem_read(long address, long size) throws BackendException;
 
     void mem_write(long address, byte[] bytes) throws BackendException;
 
+    /**
+     * Reads the NUL terminated string at <code>address</code> in one call, without its terminator.
+     * @return <code>max</code> bytes if none of them is the terminator.
+     */
+    byte[] mem_read_cstring(long address, int max) throws BackendException;
+
+    /**
+     * Little-endian primitive accessors which do not allocate.
+     */
+    int mem_read_u32(long address) throws BackendException;
+    long mem_read_u64(long address) throws BackendException;
+    void mem_write_u32(long address, int value) throws BackendException;
+    void mem_write_u64(long address, long value) throws BackendException;
+
+    /**
+     * Reads into <code>dst</code> from its position to its limit without allocating, the position is not changed.
+     */
+    void mem_read(long address, ByteBuffer dst) throws BackendException;
+
+    /**
+     * Writes <code>src</code> from its position to its limit without allocating, the position is not changed.
+     */
+    void mem_write(long address, ByteBuffer src) throws BackendException;
+
+    /**
+     * Buffer over the host memory backing the guest range, writes go straight to the guest.
+     * It must not be used after the range is unmapped.
+     * @return <code>null</code> if the range is not inside one host mapping, or the backend cannot expose its memory.
+     */
+    ByteBuffer mem_view(long address, int size) throws BackendException;
+
     void mem_map(long address, long size, int perms) throws BackendException;
 
+    /**
+     * Maps <code>size</code> bytes of <code>file</code> at <code>offset</code> privately: guest writes never reach the file.
+     * Backends that cannot map host files copy the contents instead.
+     */
+    void mem_map_file(long address, long size, int perms, File file, long offset) throws BackendException;
+
+    /**
+     * Maps the same range of <code>template</code> with its current contents, the pages are shared copy-on-write
+     * when both backends support it and copied otherwise.
+     */
+    void mem_map_fork(long address, long size, int perms, Backend template) throws BackendException;
+
     void mem_protect(long address, long size, int perms) throws BackendException;
 
     void mem_unmap(long address, long size) throws BackendException;
@@ -48,6 +104,13 @@ public interface Backend {
 
     void hook_add_new(BlockHook callback, long begin, long end, Object user_data) throws BackendException;
 
+    /**
+     * Records every instruction (pc in [begin, end]) and memory access (address in [begin, end]) selected by <code>types</code>
+     * natively, <code>callback</code> receives them when <code>capacity</code> records are buffered and when emulation stops.
+     * @param types combination of {@link TraceBufferHook#TRACE_CODE}, {@link TraceBufferHook#TRACE_READ} and {@link TraceBufferHook#TRACE_WRITE}
+     */
+    void trace_add(TraceBufferHook callback, long begin, long end, int types, int capacity, Object user_data) throws BackendException;
+
     void emu_start(long begin, long until, long timeout, long count) throws BackendException;
 
     void emu_stop() throws BackendException;
@@ -61,6 +124,17 @@ public interface Backend {
 
     int getPageSize();
 
+    /**
+     * Switches threads after about <code>emu_count</code> instructions. The budget may be counted per block, from the
+     * block size in 4 byte units, 2 byte units for Thumb, so it is never exceeded by more than the block crossing it.
+     */
     void registerEmuCountHook(long emu_count);
 
+    /**
+     * Answer the syscall inside the backend without calling the interrupt hook.
+     * @param syscall <code>null</code> to unregister
+     * @return <code>false</code> if the backend does not support native syscalls
+     */
+    boolean registerNativeSyscall(int NR, NativeSyscall syscall) throws BackendException;
+
 }
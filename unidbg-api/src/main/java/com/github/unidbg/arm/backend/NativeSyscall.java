@@ -0,0 +1,46 @@
+package com.github.unidbg.arm.backend;
+
+/**
+ * Syscall answered by the backend itself, see {@link Backend#registerNativeSyscall(int, NativeSyscall)}
+ */
+public class NativeSyscall {
+
+    public static final int TYPE_CONSTANT = 0;
+    public static final int TYPE_CLOCK_GETTIME = 1;
+    public static final int TYPE_GETTIMEOFDAY = 2;
+
+    /**
+     * Always returns <code>value</code>
+     */
+    public static NativeSyscall constant(long value) {
+        return new NativeSyscall(TYPE_CONSTANT, value, 0);
+    }
+
+    /**
+     * The clocks advance with the host clocks from the emulated values at registration.
+     * @param realtimeNanos emulated CLOCK_REALTIME now
+     * @param monotonicNanos emulated CLOCK_MONOTONIC now
+     */
+    public static NativeSyscall clock_gettime(long realtimeNanos, long monotonicNanos) {
+        return new NativeSyscall(TYPE_CLOCK_GETTIME, realtimeNanos, monotonicNanos);
+    }
+
+    /**
+     * Calls with a non-null timezone still go through the interrupt hook.
+     * @param realtimeNanos emulated realtime now
+     */
+    public static NativeSyscall gettimeofday(long realtimeNanos) {
+        return new NativeSyscall(TYPE_GETTIMEOFDAY, realtimeNanos, 0);
+    }
+
+    public final int type;
+    public final long arg0;
+    public final long arg1;
+
+    private NativeSyscall(int type, long arg0, long arg1) {
+        this.type = type;
+        this.arg0 = arg0;
+        this.arg1 = arg1;
+    }
+
+}
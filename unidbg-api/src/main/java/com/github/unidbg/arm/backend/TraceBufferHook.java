@@ -0,0 +1,22 @@
+package com.github.unidbg.arm.backend;
+
+import java.nio.ByteBuffer;
+
+/**
+ * Receives the records of a native trace in batches, see {@link Backend#trace_add(TraceBufferHook, long, long, int, int, Object)}.
+ * A record is <code>RECORD_SIZE</code> bytes in native byte order: long address, long value, int size, int type.
+ */
+public interface TraceBufferHook extends Detachable {
+
+    int TRACE_CODE = 1;
+    int TRACE_READ = 2;
+    int TRACE_WRITE = 4;
+
+    int RECORD_SIZE = 24;
+
+    /**
+     * @param records <code>count</code> records from index 0, the buffer is reused after the call returns
+     */
+    void onTrace(Backend backend, ByteBuffer records, int count, Object user);
+
+}
@@ -8,21 +8,114 @@ import unicorn.Arm64Const;
 
 public class BackendArm64RegisterContext extends BaseRegisterContext implements EditableArm64RegisterContext {
 
+    /**
+     * x0-x7, sp and lr: the arguments, stack and return address a syscall or svc handler reads.
+     */
+    public static final int SYSCALL_REG_COUNT = 10;
+
+    private static final int SYSCALL_SP = 8;
+    private static final int SYSCALL_LR = 9;
+
     private final Backend backend;
 
+    private final long[] syscallRegs = new long[SYSCALL_REG_COUNT];
+    private boolean inSyscall;
+
     public BackendArm64RegisterContext(Backend backend, Emulator<?> emulator) {
         super(emulator, Arm64Const.UC_ARM64_REG_X0, 8);
         this.backend = backend;
     }
 
+    /**
+     * @return x0-x7, sp and lr followed by <code>regIds</code>, for {@link #enterSyscall(int[])}
+     */
+    public static int[] syscallRegs(int... regIds) {
+        int[] ids = new int[SYSCALL_REG_COUNT + regIds.length];
+        for (int i = 0; i < 8; i++) {
+            ids[i] = Arm64Const.UC_ARM64_REG_X0 + i;
+        }
+        ids[SYSCALL_SP] = Arm64Const.UC_ARM64_REG_SP;
+        ids[SYSCALL_LR] = Arm64Const.UC_ARM64_REG_LR;
+        System.arraycopy(regIds, 0, ids, SYSCALL_REG_COUNT, regIds.length);
+        return ids;
+    }
+
+    /**
+     * Reads <code>regIds</code> built by {@link #syscallRegs(int...)} with one backend call. Until {@link #leaveSyscall()}
+     * this context serves x0-x7, sp and lr from that read and its setters keep them up to date: a handler must not
+     * write them through the backend and read them back through this context, unidbg itself writes them through the context.
+     * A nested syscall leaves it for the outer one.
+     * @return the values of <code>regIds</code>
+     */
+    public long[] enterSyscall(int[] regIds) {
+        long[] values = new long[regIds.length];
+        backend.reg_read_batch(regIds, values);
+        System.arraycopy(values, 0, syscallRegs, 0, SYSCALL_REG_COUNT);
+        inSyscall = true;
+        return values;
+    }
+
+    public void leaveSyscall() {
+        inSyscall = false;
+    }
+
     private long reg(int regId) {
+        if (inSyscall) {
+            int index = syscallIndex(regId);
+            if (index != -1) {
+                return syscallRegs[index];
+            }
+        }
         return backend.reg_read(regId).longValue();
     }
 
+    private void writeReg(int regId, long value) {
+        backend.reg_write(regId, value);
+        if (inSyscall) {
+            int index = syscallIndex(regId);
+            if (index != -1) {
+                syscallRegs[index] = value;
+            }
+        }
+    }
+
+    private static int syscallIndex(int regId) {
+        if (regId >= Arm64Const.UC_ARM64_REG_X0 && regId <= Arm64Const.UC_ARM64_REG_X7) {
+            return regId - Arm64Const.UC_ARM64_REG_X0;
+        }
+        switch (regId) {
+            case Arm64Const.UC_ARM64_REG_SP:
+                return SYSCALL_SP;
+            case Arm64Const.UC_ARM64_REG_LR:
+                return SYSCALL_LR;
+            default:
+                return -1;
+        }
+    }
+
+    @Override
+    public UnidbgPointer getPointerArg(int index) {
+        if (index < 8) {
+            return getXPointer(index);
+        }
+        UnidbgPointer sp = getStackPointer();
+        return sp.getPointer((long) (index - 8) * emulator.getPointerSize());
+    }
+
+    @Override
+    public int getIntByReg(int regId) {
+        return (int) reg(regId);
+    }
+
+    @Override
+    public long getLongByReg(int regId) {
+        return reg(regId);
+    }
+
     @Override
     public void setXLong(int index, long value) {
         if (index >= 0 && index <= 28) {
-            backend.reg_write(Arm64Const.UC_ARM64_REG_X0 + index, value);
+            writeReg(Arm64Const.UC_ARM64_REG_X0 + index, value);
             return;
         }
         throw new IllegalArgumentException("invalid index: " + index);
@@ -73,11 +166,16 @@ public class BackendArm64RegisterContext extends BaseRegisterContext implements
 
     @Override
     public UnidbgPointer getStackPointer() {
-        return UnidbgPointer.register(emulator, Arm64Const.UC_ARM64_REG_SP);
+        return UnidbgPointer.pointer(emulator, reg(Arm64Const.UC_ARM64_REG_SP));
     }
 
     @Override
     public void setStackPointer(Pointer sp) {
-        backend.reg_write(Arm64Const.UC_ARM64_REG_SP, ((UnidbgPointer) sp).peer);
+        writeReg(Arm64Const.UC_ARM64_REG_SP, ((UnidbgPointer) sp).peer);
+    }
+
+    @Override
+    public void setLR(long value) {
+        writeReg(Arm64Const.UC_ARM64_REG_LR, value);
     }
 }
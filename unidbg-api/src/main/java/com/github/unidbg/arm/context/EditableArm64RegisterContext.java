@@ -8,4 +8,6 @@ public interface EditableArm64RegisterContext extends Arm64RegisterContext {
 
     void setStackPointer(Pointer sp);
 
+    void setLR(long value);
+
 }
@@ -25,6 +25,11 @@ class Arm64HookContext extends HookContext implements EditableArm64RegisterConte
         registerContext.setStackPointer(sp);
     }
 
+    @Override
+    public void setLR(long value) {
+        registerContext.setLR(value);
+    }
+
     @Override
     public long getXLong(int index) {
         return registerContext.getXLong(index);
@@ -65,6 +65,11 @@ public class HookZzArm64RegisterContextImpl extends HookZzRegisterContext implem
         throw new UnsupportedOperationException();
     }
 
+    @Override
+    public void setLR(long value) {
+        reg_ctx.setLong(30 * 8, value);
+    }
+
     @Override
     public UnidbgPointer getFpPointer() {
         return UnidbgPointer.pointer(emulator, getFp());
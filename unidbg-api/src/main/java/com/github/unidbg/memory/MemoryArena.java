@@ -0,0 +1,187 @@
+package com.github.unidbg.memory;
+
+import com.github.unidbg.pointer.UnidbgPointer;
+import com.sun.jna.Pointer;
+import unicorn.UnicornConst;
+
+import java.util.Arrays;
+import java.util.TreeMap;
+
+/**
+ * Size-classed allocator for the runtime memory blocks, carved out of large guest mappings,
+ * so that a short-lived block costs no backend <code>mem_map</code>/<code>mem_unmap</code>.
+ * Freed blocks go back to the free list of their class and are zeroed when handed out again,
+ * a chunk whose blocks are all freed is unmapped.
+ */
+public class MemoryArena {
+
+    private static final int MIN_CLASS_BITS = 4; // 16 bytes, the alignment of every block
+    private static final int MAX_CLASS_BITS = 16; // larger blocks get a mapping of their own
+    private static final int CHUNK_SIZE = 0x100000;
+
+    private final Memory memory;
+    private final long[][] freeLists = new long[MAX_CLASS_BITS - MIN_CLASS_BITS + 1][];
+    private final int[] freeCounts = new int[MAX_CLASS_BITS - MIN_CLASS_BITS + 1];
+    private final byte[][] zeros = new byte[MAX_CLASS_BITS - MIN_CLASS_BITS + 1][];
+
+    private final TreeMap<Long, Chunk> chunks = new TreeMap<>();
+    private Chunk current;
+    private long chunk;
+    private long chunkEnd;
+    private int generation;
+
+    public MemoryArena(Memory memory) {
+        this.memory = memory;
+    }
+
+    public MemoryBlock alloc(int length) {
+        if (length > 1 << MAX_CLASS_BITS) {
+            return MemoryBlockImpl.alloc(memory, length);
+        }
+
+        int index = sizeClass(length);
+        int size = 1 << (index + MIN_CLASS_BITS);
+        long address;
+        Chunk owner;
+        if (freeCounts[index] > 0) {
+            address = freeLists[index][--freeCounts[index]];
+            owner = chunks.floorEntry(address).getValue();
+            if (zeros[index] == null) {
+                zeros[index] = new byte[size];
+            }
+            memory.pointer(address).write(0, zeros[index], 0, size);
+        } else {
+            if (chunkEnd - chunk < size) {
+                if (current != null && current.live == 0) {
+                    forget(current); // nothing handed out, start over from the base
+                    chunk = current.base;
+                } else {
+                    releaseTail();
+                    UnidbgPointer pointer = memory.mmap(CHUNK_SIZE, UnicornConst.UC_PROT_READ | UnicornConst.UC_PROT_WRITE);
+                    current = new Chunk(pointer.peer);
+                    chunks.put(current.base, current);
+                    chunk = current.base;
+                    chunkEnd = chunk + CHUNK_SIZE;
+                }
+            }
+            address = chunk;
+            owner = current;
+            chunk += size;
+        }
+        owner.live += size;
+        return new ArenaBlock(memory.pointer(address).setSize(size), index, owner);
+    }
+
+    /**
+     * Forgets every chunk without unmapping it, for a restore that has already replaced the guest memory.
+     * Blocks handed out before are stale, freeing them is ignored.
+     */
+    public void reset() {
+        generation++;
+        chunks.clear();
+        current = null;
+        chunk = chunkEnd = 0;
+        Arrays.fill(freeCounts, 0);
+    }
+
+    private static int sizeClass(int length) {
+        int bits = length <= 1 ? 0 : 32 - Integer.numberOfLeadingZeros(length - 1);
+        return Math.max(bits, MIN_CLASS_BITS) - MIN_CLASS_BITS;
+    }
+
+    /**
+     * Hands the rest of the current chunk to the free lists, biggest classes first, before it is abandoned.
+     */
+    private void releaseTail() {
+        while (chunkEnd - chunk >= 1 << MIN_CLASS_BITS) {
+            int index = Math.min(63 - Long.numberOfLeadingZeros(chunkEnd - chunk), MAX_CLASS_BITS) - MIN_CLASS_BITS;
+            release(chunk, index);
+            chunk += 1 << (index + MIN_CLASS_BITS);
+        }
+    }
+
+    private void release(long address, int index) {
+        long[] list = freeLists[index];
+        if (list == null) {
+            list = freeLists[index] = new long[16];
+        } else if (freeCounts[index] == list.length) {
+            long[] grown = new long[list.length * 2];
+            System.arraycopy(list, 0, grown, 0, list.length);
+            list = freeLists[index] = grown;
+        }
+        list[freeCounts[index]++] = address;
+    }
+
+    private void free(long address, int index, Chunk owner) {
+        owner.live -= 1 << (index + MIN_CLASS_BITS);
+        if (owner.live == 0 && owner != current) {
+            forget(owner);
+            chunks.remove(owner.base);
+            memory.munmap(owner.base, CHUNK_SIZE);
+        } else {
+            release(address, index);
+        }
+    }
+
+    /**
+     * Drops the free list entries inside <code>owner</code>.
+     */
+    private void forget(Chunk owner) {
+        for (int index = 0; index < freeCounts.length; index++) {
+            long[] list = freeLists[index];
+            int count = 0;
+            for (int i = 0; i < freeCounts[index]; i++) {
+                if (list[i] < owner.base || list[i] >= owner.base + CHUNK_SIZE) {
+                    list[count++] = list[i];
+                }
+            }
+            freeCounts[index] = count;
+        }
+    }
+
+    private static class Chunk {
+        final long base;
+        int live; // bytes handed out and not freed yet
+
+        Chunk(long base) {
+            this.base = base;
+        }
+    }
+
+    private class ArenaBlock implements MemoryBlock {
+        private final UnidbgPointer pointer;
+        private final int index;
+        private final Chunk owner;
+        private final int generation;
+        private boolean freed;
+
+        ArenaBlock(UnidbgPointer pointer, int index, Chunk owner) {
+            this.pointer = pointer;
+            this.index = index;
+            this.owner = owner;
+            this.generation = MemoryArena.this.generation;
+        }
+
+        @Override
+        public UnidbgPointer getPointer() {
+            return pointer;
+        }
+
+        @Override
+        public boolean isSame(Pointer pointer) {
+            return this.pointer.equals(pointer);
+        }
+
+        @Override
+        public void free() {
+            if (freed) {
+                throw new IllegalStateException("double free: " + pointer);
+            }
+            freed = true;
+            if (generation == MemoryArena.this.generation) {
+                MemoryArena.this.free(pointer.peer, index, owner);
+            }
+        }
+    }
+
+}
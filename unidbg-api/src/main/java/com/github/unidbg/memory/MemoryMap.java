@@ -1,11 +1,10 @@
 package com.github.unidbg.memory;
 
-import com.github.unidbg.serialize.Serializable;
-
+import java.io.DataInput;
 import java.io.DataOutput;
 import java.io.IOException;
 
-public class MemoryMap implements Serializable {
+public class MemoryMap {
 
     public final long base;
     public final long size;
@@ -17,13 +16,19 @@ public class MemoryMap implements Serializable {
         this.prot = prot;
     }
 
-    @Override
     public void serialize(DataOutput out) throws IOException {
         out.writeLong(base);
         out.writeLong(size);
         out.writeInt(prot);
     }
 
+    public static MemoryMap deserialize(DataInput in) throws IOException {
+        long base = in.readLong();
+        long size = in.readLong();
+        int prot = in.readInt();
+        return new MemoryMap(base, size, prot);
+    }
+
     @Override
     public String toString() {
         return "MemoryMap{" +
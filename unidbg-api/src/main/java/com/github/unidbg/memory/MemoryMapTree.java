@@ -0,0 +1,174 @@
+package com.github.unidbg.memory;
+
+import java.util.Collection;
+import java.util.Collections;
+import java.util.Map;
+import java.util.TreeMap;
+import java.util.TreeSet;
+
+/**
+ * Memory maps by base address, which also indexes the gaps between neighbouring maps by size,
+ * so that placing a new mapping and finding the map of an address are O(log n).
+ */
+public class MemoryMapTree {
+
+    private final TreeMap<Long, MemoryMap> maps = new TreeMap<>();
+
+    /**
+     * base of the map in front of a gap -&gt; gap size
+     */
+    private final Map<Long, Long> gaps = new TreeMap<>();
+
+    /**
+     * gap size -&gt; bases of the maps in front of the gaps of that size
+     */
+    private final TreeMap<Long, TreeSet<Long>> gapsBySize = new TreeMap<>();
+
+    /**
+     * @return the map replaced at <code>base</code>, or <code>null</code>
+     */
+    public MemoryMap put(long base, MemoryMap map) {
+        MemoryMap old = maps.put(base, map);
+        updateGap(base);
+        Long lower = maps.lowerKey(base);
+        if (lower != null) {
+            updateGap(lower);
+        }
+        return old;
+    }
+
+    /**
+     * @return the map removed at <code>base</code>, or <code>null</code>
+     */
+    public MemoryMap remove(long base) {
+        MemoryMap removed = maps.remove(base);
+        if (removed != null) {
+            removeGap(base);
+            Long lower = maps.lowerKey(base);
+            if (lower != null) {
+                updateGap(lower);
+            }
+        }
+        return removed;
+    }
+
+    public void clear() {
+        maps.clear();
+        gaps.clear();
+        gapsBySize.clear();
+    }
+
+    /**
+     * @return the map at <code>base</code>, or <code>null</code>
+     */
+    public MemoryMap get(long base) {
+        return maps.get(base);
+    }
+
+    /**
+     * @return the map with the highest base, or <code>null</code>
+     */
+    public MemoryMap last() {
+        Map.Entry<Long, MemoryMap> entry = maps.lastEntry();
+        return entry == null ? null : entry.getValue();
+    }
+
+    public int size() {
+        return maps.size();
+    }
+
+    public boolean isEmpty() {
+        return maps.isEmpty();
+    }
+
+    /**
+     * @return a read-only view of the maps by base address
+     */
+    public Collection<MemoryMap> values() {
+        return Collections.unmodifiableCollection(maps.values());
+    }
+
+    /**
+     * @return the map containing the address, or <code>null</code>
+     */
+    public MemoryMap findContaining(long address) {
+        Map.Entry<Long, MemoryMap> entry = maps.floorEntry(address);
+        if (entry == null) {
+            return null;
+        }
+        MemoryMap map = entry.getValue();
+        return address < map.base + map.size ? map : null;
+    }
+
+    /**
+     * @return <code>true</code> if a map intersects or touches <code>[start, end]</code>
+     */
+    public boolean overlaps(long start, long end) {
+        Map.Entry<Long, MemoryMap> entry = maps.floorEntry(end);
+        if (entry == null) {
+            return false;
+        }
+        MemoryMap map = entry.getValue();
+        return map.base + map.size >= start;
+    }
+
+    /**
+     * Best fit among the gaps between two maps: the smallest gap with more than <code>length</code> bytes
+     * behind its first address matching <code>mask</code>. Aligning skips at most <code>mask</code> bytes, so only the
+     * gaps up to <code>length + mask</code> bytes are checked one by one, the next bigger gap always fits.
+     * @return the address, or <code>-1</code> when no gap fits
+     */
+    public long findGap(long length, long mask) {
+        for (Map.Entry<Long, TreeSet<Long>> entry : gapsBySize.subMap(length, false, length + mask, true).entrySet()) {
+            long size = entry.getKey();
+            for (Long key : entry.getValue()) {
+                long start = gapStart(key);
+                long address = (start + mask) & ~mask;
+                if (address + length < start + size) {
+                    return address;
+                }
+            }
+        }
+        Map.Entry<Long, TreeSet<Long>> entry = gapsBySize.higherEntry(length + mask);
+        if (entry == null) {
+            return -1;
+        }
+        return (gapStart(entry.getValue().first()) + mask) & ~mask;
+    }
+
+    private long gapStart(long key) {
+        MemoryMap map = maps.get(key);
+        return map.base + map.size;
+    }
+
+    private void updateGap(long key) {
+        removeGap(key);
+        MemoryMap map = maps.get(key);
+        Map.Entry<Long, MemoryMap> next = maps.higherEntry(key);
+        if (map == null || next == null) {
+            return;
+        }
+        long size = next.getKey() - (map.base + map.size);
+        if (size > 0) {
+            gaps.put(key, size);
+            TreeSet<Long> keys = gapsBySize.get(size);
+            if (keys == null) {
+                keys = new TreeSet<>();
+                gapsBySize.put(size, keys);
+            }
+            keys.add(key);
+        }
+    }
+
+    private void removeGap(long key) {
+        Long size = gaps.remove(key);
+        if (size != null) {
+            TreeSet<Long> keys = gapsBySize.get(size);
+            keys.remove(key);
+            if (keys.isEmpty()) {
+                gapsBySize.remove(size);
+            }
+        }
+    }
+
+}
@@ -7,11 +7,16 @@ import com.github.unidbg.arm.backend.CodeHook;
 import com.github.unidbg.arm.backend.DebugHook;
 import com.github.unidbg.arm.backend.EventMemHook;
 import com.github.unidbg.arm.backend.InterruptHook;
+import com.github.unidbg.arm.backend.NativeSyscall;
 import com.github.unidbg.arm.backend.ReadHook;
+import com.github.unidbg.arm.backend.TraceBufferHook;
 import com.github.unidbg.arm.backend.WriteHook;
 import com.github.unidbg.debugger.BreakPoint;
 import com.github.unidbg.debugger.BreakPointCallback;
 
+import java.io.File;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
 import java.util.Arrays;
 
 class ByteArrayBackend implements Backend {
@@ -57,6 +62,16 @@ class ByteArrayBackend implements Backend {
         throw new UnsupportedOperationException();
     }
 
+    @Override
+    public void reg_read_batch(int[] regIds, long[] values) throws BackendException {
+        throw new UnsupportedOperationException();
+    }
+
+    @Override
+    public void reg_write_batch(int[] regIds, long[] values) throws BackendException {
+        throw new UnsupportedOperationException();
+    }
+
     @Override
     public byte[] mem_read(long address, long size) throws BackendException {
         return Arrays.copyOfRange(data, (int) address, (int) (address + size));
@@ -67,11 +82,71 @@ class ByteArrayBackend implements Backend {
         System.arraycopy(bytes, 0, data, (int) address, bytes.length);
     }
 
+    @Override
+    public byte[] mem_read_cstring(long address, int max) throws BackendException {
+        int end = (int) address;
+        while (end < data.length && end - address < max && data[end] != 0) {
+            end++;
+        }
+        return Arrays.copyOfRange(data, (int) address, end);
+    }
+
+    @Override
+    public int mem_read_u32(long address) throws BackendException {
+        return ByteBuffer.wrap(data).order(ByteOrder.LITTLE_ENDIAN).getInt((int) address);
+    }
+
+    @Override
+    public long mem_read_u64(long address) throws BackendException {
+        return ByteBuffer.wrap(data).order(ByteOrder.LITTLE_ENDIAN).getLong((int) address);
+    }
+
+    @Override
+    public void mem_write_u32(long address, int value) throws BackendException {
+        ByteBuffer.wrap(data).order(ByteOrder.LITTLE_ENDIAN).putInt((int) address, value);
+    }
+
+    @Override
+    public void mem_write_u64(long address, long value) throws BackendException {
+        ByteBuffer.wrap(data).order(ByteOrder.LITTLE_ENDIAN).putLong((int) address, value);
+    }
+
+    @Override
+    public void mem_read(long address, ByteBuffer dst) throws BackendException {
+        int position = dst.position();
+        for (int i = 0; i < dst.remaining(); i++) {
+            dst.put(position + i, data[(int) address + i]);
+        }
+    }
+
+    @Override
+    public void mem_write(long address, ByteBuffer src) throws BackendException {
+        int position = src.position();
+        for (int i = 0; i < src.remaining(); i++) {
+            data[(int) address + i] = src.get(position + i);
+        }
+    }
+
+    @Override
+    public ByteBuffer mem_view(long address, int size) throws BackendException {
+        return ByteBuffer.wrap(data, (int) address, size).slice().order(ByteOrder.LITTLE_ENDIAN);
+    }
+
     @Override
     public void mem_map(long address, long size, int perms) throws BackendException {
         throw new UnsupportedOperationException();
     }
 
+    @Override
+    public void mem_map_file(long address, long size, int perms, File file, long offset) throws BackendException {
+        throw new UnsupportedOperationException();
+    }
+
+    @Override
+    public void mem_map_fork(long address, long size, int perms, Backend template) throws BackendException {
+        throw new UnsupportedOperationException();
+    }
+
     @Override
     public void mem_protect(long address, long size, int perms) throws BackendException {
         throw new UnsupportedOperationException();
@@ -142,6 +217,11 @@ class ByteArrayBackend implements Backend {
         throw new UnsupportedOperationException();
     }
 
+    @Override
+    public void trace_add(TraceBufferHook callback, long begin, long end, int types, int capacity, Object user_data) throws BackendException {
+        throw new UnsupportedOperationException();
+    }
+
     @Override
     public void emu_start(long begin, long until, long timeout, long count) throws BackendException {
         throw new UnsupportedOperationException();
@@ -186,4 +266,9 @@ class ByteArrayBackend implements Backend {
     public void registerEmuCountHook(long emu_count) {
         throw new UnsupportedOperationException();
     }
+
+    @Override
+    public boolean registerNativeSyscall(int NR, NativeSyscall syscall) {
+        throw new UnsupportedOperationException();
+    }
 }
@@ -14,7 +14,6 @@ import org.apache.commons.logging.Log;
 import org.apache.commons.logging.LogFactory;
 import unicorn.UnicornConst;
 
-import java.io.ByteArrayOutputStream;
 import java.io.UnsupportedEncodingException;
 import java.nio.ByteBuffer;
 import java.nio.ByteOrder;
@@ -228,29 +227,85 @@ public class UnidbgPointer extends Pointer implements PointerArg {
         throw new AbstractMethodError();
     }
 
+    private static final ThreadLocal<ByteBuffer> PRIMITIVE_BUFFER = new ThreadLocal<ByteBuffer>() {
+        @Override
+        protected ByteBuffer initialValue() {
+            return ByteBuffer.allocateDirect(8).order(ByteOrder.LITTLE_ENDIAN);
+        }
+    };
+
+    /**
+     * The primitive accessors go through a reused direct buffer, so they do not allocate a java array per access.
+     */
+    private static ByteBuffer primitiveBuffer(int length) {
+        ByteBuffer buffer = PRIMITIVE_BUFFER.get();
+        buffer.clear();
+        buffer.limit(length);
+        return buffer;
+    }
+
+    private void checkRead(long offset, int length) {
+        if (size > 0 && offset + length > size) {
+            throw new InvalidMemoryAccessException();
+        }
+    }
+
+    private void checkWrite(long offset, int length) {
+        if (size > 0) {
+            if (offset < 0) {
+                throw new IllegalArgumentException();
+            }
+
+            if (size - offset < length) {
+                throw new InvalidMemoryAccessException();
+            }
+        }
+    }
+
+    private ByteBuffer readPrimitive(long offset, int length) {
+        checkRead(offset, length);
+        ByteBuffer buffer = primitiveBuffer(length);
+        backend.mem_read(peer + offset, buffer);
+        return buffer;
+    }
+
+    private void writePrimitive(long offset, ByteBuffer buffer) {
+        checkWrite(offset, buffer.remaining());
+
+        long address = peer + offset;
+        backend.mem_write(address, buffer);
+        if (listener != null) {
+            byte[] data = new byte[buffer.remaining()];
+            buffer.get(data);
+            listener.onSystemWrite(address, data);
+        }
+    }
+
     @Override
     public byte getByte(long offset) {
-        return getByteArray(offset, 1)[0];
+        return readPrimitive(offset, 1).get(0);
     }
 
     @Override
     public char getChar(long offset) {
-        return getByteBuffer(offset, 2).getChar();
+        return readPrimitive(offset, 2).getChar(0);
     }
 
     @Override
     public short getShort(long offset) {
-        return getByteBuffer(offset, 2).getShort();
+        return readPrimitive(offset, 2).getShort(0);
     }
 
     @Override
     public int getInt(long offset) {
-        return getByteBuffer(offset, 4).getInt();
+        checkRead(offset, 4);
+        return backend.mem_read_u32(peer + offset);
     }
 
     @Override
     public long getLong(long offset) {
-        return getByteBuffer(offset, 8).getLong();
+        checkRead(offset, 8);
+        return backend.mem_read_u64(peer + offset);
     }
 
     @Override
@@ -260,12 +315,12 @@ public class UnidbgPointer extends Pointer implements PointerArg {
 
     @Override
     public float getFloat(long offset) {
-        return getByteBuffer(offset, 4).getFloat();
+        return readPrimitive(offset, 4).getFloat(0);
     }
 
     @Override
     public double getDouble(long offset) {
-        return getByteBuffer(offset, 8).getDouble();
+        return readPrimitive(offset, 8).getDouble(0);
     }
 
     @Override
@@ -315,47 +370,30 @@ public class UnidbgPointer extends Pointer implements PointerArg {
 
     @Override
     public String getString(long offset, String encoding) {
-        long addr = peer + offset;
-
-        ByteArrayOutputStream baos = new ByteArrayOutputStream(0x40);
-        while (true) {
-            byte[] data = backend.mem_read(addr, 0x10);
-            int length = data.length;
-            for (int i = 0; i < data.length; i++) {
-                if (data[i] == 0) {
-                    length = i;
-                    break;
-                }
-            }
-            baos.write(data, 0, length);
-            addr += length;
-
-            if (length < data.length) { // reach zero
-                break;
-            }
-
-            if (baos.size() > 0x40000) { // 256k
-                throw new IllegalStateException("buffer overflow");
-            }
-
-            if (size > 0 && offset + baos.size() > size) {
-                throw new InvalidMemoryAccessException();
+        long max = 0x40000; // 256k
+        if (size > 0) {
+            if (offset >= size) {
+                throw new InvalidMemoryAccessException("offset=" + offset + ", size=" + size + ", peer=0x" + Long.toHexString(peer));
             }
+            max = Math.min(size - offset, max); // a string without its nul inside the pointer reads one byte past it
+        }
+        byte[] data = backend.mem_read_cstring(peer + offset, (int) max + 1);
+        if (data.length > 0x40000) {
+            throw new IllegalStateException("buffer overflow");
+        }
+        if (size > 0 && offset + data.length > size) {
+            throw new InvalidMemoryAccessException();
         }
 
         try {
-            String ret = baos.toString(encoding);
-            log.debug("getString pointer=" + this + ", size=" + baos.size() + ", encoding=" + encoding + ", ret=" + ret);
+            String ret = new String(data, encoding);
+            log.debug("getString pointer=" + this + ", size=" + data.length + ", encoding=" + encoding + ", ret=" + ret);
             return ret;
         } catch (UnsupportedEncodingException e) {
             throw new IllegalStateException(e);
         }
     }
 
-    private ByteBuffer allocateBuffer(int size) {
-        return ByteBuffer.allocate(size).order(ByteOrder.LITTLE_ENDIAN);
-    }
-
     @Override
     public void setMemory(long offset, long length, byte value) {
         byte[] data = new byte[(int) length];
@@ -365,27 +403,37 @@ public class UnidbgPointer extends Pointer implements PointerArg {
 
     @Override
     public void setByte(long offset, byte value) {
-        write(offset, new byte[] { value }, 0, 1);
+        writePrimitive(offset, primitiveBuffer(1).put(0, value));
     }
 
     @Override
     public void setShort(long offset, short value) {
-        write(offset, allocateBuffer(2).putShort(value).array(), 0, 2);
+        writePrimitive(offset, primitiveBuffer(2).putShort(0, value));
     }
 
     @Override
     public void setChar(long offset, char value) {
-        write(offset, allocateBuffer(2).putChar(value).array(), 0, 2);
+        writePrimitive(offset, primitiveBuffer(2).putChar(0, value));
     }
 
     @Override
     public void setInt(long offset, int value) {
-        write(offset, allocateBuffer(4).putInt(value).array(), 0, 4);
+        if (listener != null) {
+            writePrimitive(offset, primitiveBuffer(4).putInt(0, value));
+            return;
+        }
+        checkWrite(offset, 4);
+        backend.mem_write_u32(peer + offset, value);
     }
 
     @Override
     public void setLong(long offset, long value) {
-        write(offset, allocateBuffer(8).putLong(value).array(), 0, 8);
+        if (listener != null) {
+            writePrimitive(offset, primitiveBuffer(8).putLong(0, value));
+            return;
+        }
+        checkWrite(offset, 8);
+        backend.mem_write_u64(peer + offset, value);
     }
 
     @Override
@@ -395,12 +443,12 @@ public class UnidbgPointer extends Pointer implements PointerArg {
 
     @Override
     public void setFloat(long offset, float value) {
-        write(offset, allocateBuffer(4).putFloat(value).array(), 0, 4);
+        writePrimitive(offset, primitiveBuffer(4).putFloat(0, value));
     }
 
     @Override
     public void setDouble(long offset, double value) {
-        write(offset, allocateBuffer(8).putDouble(value).array(), 0, 8);
+        writePrimitive(offset, primitiveBuffer(8).putDouble(0, value));
     }
 
     @Override
@@ -1,5 +1,6 @@
 package com.github.unidbg.serialize;
 
+import java.io.DataInput;
 import java.io.DataOutput;
 import java.io.IOException;
 
@@ -7,4 +8,9 @@ public interface Serializable {
 
     void serialize(DataOutput out) throws IOException;
 
+    /**
+     * Restores the state written by {@link #serialize(DataOutput)} into a freshly created instance.
+     */
+    void deserialize(DataInput in) throws IOException;
+
 }
@@ -8,20 +8,23 @@ import com.github.unidbg.ModuleListener;
 import com.github.unidbg.arm.ARM;
 import com.github.unidbg.arm.ARMEmulator;
 import com.github.unidbg.arm.backend.Backend;
+import com.github.unidbg.arm.context.EditableArm64RegisterContext;
 import com.github.unidbg.file.NewFileIO;
 import com.github.unidbg.hook.HookListener;
 import com.github.unidbg.memory.MMapListener;
 import com.github.unidbg.memory.Memory;
+import com.github.unidbg.memory.MemoryArena;
 import com.github.unidbg.memory.MemoryMap;
+import com.github.unidbg.memory.MemoryMapTree;
 import com.github.unidbg.pointer.UnidbgPointer;
 import com.github.unidbg.unix.UnixEmulator;
 import com.github.unidbg.unix.UnixSyscallHandler;
 import com.sun.jna.Pointer;
 import org.apache.commons.logging.Log;
 import org.apache.commons.logging.LogFactory;
-import unicorn.Arm64Const;
 import unicorn.ArmConst;
 
+import java.io.DataInput;
 import java.io.DataOutput;
 import java.io.File;
 import java.io.IOException;
@@ -31,9 +34,9 @@ import java.nio.file.Files;
 import java.util.ArrayList;
 import java.util.Arrays;
 import java.util.Collection;
+import java.util.Collections;
 import java.util.List;
 import java.util.Map;
-import java.util.TreeMap;
 
 public abstract class AbstractLoader<T extends NewFileIO> implements Memory, Loader {
 
@@ -45,7 +48,12 @@ public abstract class AbstractLoader<T extends NewFileIO> implements Memory, Loa
 
     protected long sp;
     protected long mmapBaseAddress;
-    protected final Map<Long, MemoryMap> memoryMap = new TreeMap<>();
+    protected final MemoryMapTree memoryMap = new MemoryMapTree();
+
+    /**
+     * Backs the runtime {@link #malloc(int, boolean)} blocks.
+     */
+    protected final MemoryArena runtimeArena = new MemoryArena(this);
 
     protected MMapListener mMapListener;
 
@@ -91,22 +99,12 @@ public abstract class AbstractLoader<T extends NewFileIO> implements Memory, Loa
 //    private static final int MAP_ANONYMOUS =	0x20;		/* don't use a file */
 
     protected final long allocateMapAddress(long mask, long length) {
-        Map.Entry<Long, MemoryMap> lastEntry = null;
-        for (Map.Entry<Long, MemoryMap> entry : memoryMap.entrySet()) {
-            if (lastEntry == null) {
-                lastEntry = entry;
-            } else {
-                MemoryMap map = lastEntry.getValue();
-                long mmapAddress = map.base + map.size;
-                if (mmapAddress + length < entry.getKey() && (mmapAddress & mask) == 0) {
-                    return mmapAddress;
-                } else {
-                    lastEntry = entry;
-                }
-            }
+        long gap = memoryMap.findGap(length, mask);
+        if (gap != -1) {
+            return gap;
         }
-        if (lastEntry != null) {
-            MemoryMap map = lastEntry.getValue();
+        MemoryMap map = memoryMap.last();
+        if (map != null) {
             long mmapAddress = map.base + map.size;
             if (mmapAddress < mmapBaseAddress) {
                 log.debug("allocateMapAddress mmapBaseAddress=0x" + Long.toHexString(mmapBaseAddress) + ", mmapAddress=0x" + Long.toHexString(mmapAddress));
@@ -132,14 +130,7 @@ public abstract class AbstractLoader<T extends NewFileIO> implements Memory, Loa
         MemoryMap removed = memoryMap.remove(start);
 
         if (removed == null) {
-            MemoryMap segment = null;
-            for (Map.Entry<Long, MemoryMap> entry : memoryMap.entrySet()) {
-                MemoryMap map = entry.getValue();
-                if (start > entry.getKey() && start < map.base + map.size) {
-                    segment = entry.getValue();
-                    break;
-                }
-            }
+            MemoryMap segment = memoryMap.findContaining(start);
             if (segment == null || segment.size < aligned) {
                 throw new IllegalStateException("munmap aligned=0x" + Long.toHexString(aligned) + ", start=0x" + Long.toHexString(start));
             }
@@ -317,7 +308,7 @@ public abstract class AbstractLoader<T extends NewFileIO> implements Memory, Loa
         if (emulator.is32Bit()) {
             backend.reg_write(ArmConst.UC_ARM_REG_SP, sp);
         } else {
-            backend.reg_write(Arm64Const.UC_ARM64_REG_SP, sp);
+            emulator.<EditableArm64RegisterContext>getContext().setStackPointer(UnidbgPointer.pointer(emulator, sp));
         }
     }
 
@@ -407,15 +398,128 @@ public abstract class AbstractLoader<T extends NewFileIO> implements Memory, Loa
         out.writeLong(mmapBaseAddress);
         out.writeLong(stackBase);
         out.writeLong(stackSize);
+        Collection<Module> modules = getLoadedModules();
+        out.writeInt(modules.size());
+        for (Module module : modules) {
+            out.writeUTF(module.name);
+            out.writeLong(module.base);
+            out.writeLong(module.size);
+            out.writeInt(module.getReferenceCount());
+            out.writeBoolean(module.isVirtual());
+        }
         out.writeInt(memoryMap.size());
-        for (Map.Entry<Long, MemoryMap> entry : memoryMap.entrySet()) {
-            MemoryMap map = entry.getValue();
-            out.writeLong(entry.getKey());
+        for (MemoryMap map : memoryMap.values()) {
+            out.writeLong(map.base);
             map.serialize(out);
-            UnidbgPointer pointer = UnidbgPointer.pointer(emulator, map.base);
-            assert pointer != null;
-            byte[] data = pointer.getByteArray(0, (int) map.size);
-            out.write(data);
+        }
+    }
+
+    /**
+     * Replaces the memory layout with the serialized one, the page contents are mapped by {@link com.github.unidbg.Emulator#restore(File)}.
+     * Modules missing from this loader are loaded again at their serialized base through the library resolver, without
+     * calling their init functions. Modules already loaded and virtual modules must sit at their serialized base.
+     */
+    @Override
+    public void deserialize(DataInput in) throws IOException {
+        long sp = in.readLong();
+        long mmapBaseAddress = in.readLong();
+        long stackBase = in.readLong();
+        long stackSize = in.readLong();
+
+        int count = in.readInt();
+        List<ModuleRecord> records = new ArrayList<>(count);
+        for (int i = 0; i < count; i++) {
+            records.add(new ModuleRecord(in.readUTF(), in.readLong(), in.readLong(), in.readInt(), in.readBoolean()));
+        }
+        for (Module module : getLoadedModules()) {
+            if (!records.contains(new ModuleRecord(module.name, module.base, module.size, 0, false))) {
+                throw new IllegalStateException("Restore module mismatch: " + module.name + " is not in the snapshot");
+            }
+        }
+
+        unmapExcept(getLoadedModules());
+        for (ModuleRecord record : records) {
+            Module module = findModule(record.name);
+            if (module == null && !record.virtual) {
+                LibraryFile libraryFile = libraryResolver == null ? null : libraryResolver.resolveLibrary(emulator, record.name);
+                if (libraryFile == null) {
+                    throw new IllegalStateException("Restore cannot resolve module " + record.name + ", load it or register a library resolver first");
+                }
+                setMMapBaseAddress(record.base);
+                module = restoreModule(libraryFile);
+            }
+            if (module == null || !record.equals(new ModuleRecord(module.name, module.base, module.size, 0, false))) {
+                throw new IllegalStateException("Restore module mismatch: name=" + record.name + ", base=0x" + Long.toHexString(record.base) + ", module=" + module);
+            }
+            while (module.getReferenceCount() < record.referenceCount) {
+                module.addReferenceCount();
+            }
+        }
+        unmapExcept(Collections.<Module>emptyList());
+        runtimeArena.reset();
+
+        this.sp = sp;
+        this.mmapBaseAddress = mmapBaseAddress;
+        this.stackBase = stackBase;
+        this.stackSize = (int) stackSize;
+        count = in.readInt();
+        for (int i = 0; i < count; i++) {
+            long key = in.readLong();
+            memoryMap.put(key, MemoryMap.deserialize(in));
+        }
+    }
+
+    /**
+     * Loads <code>libraryFile</code> at the mmap base address for {@link #deserialize(DataInput)}: the symbols are
+     * resolved, the init functions are not called, the snapshot holds the initialized memory.
+     */
+    protected Module restoreModule(LibraryFile libraryFile) throws IOException {
+        throw new UnsupportedOperationException("restoreModule " + libraryFile.getName());
+    }
+
+    private static class ModuleRecord {
+        final String name;
+        final long base;
+        final long size;
+        final int referenceCount;
+        final boolean virtual;
+        ModuleRecord(String name, long base, long size, int referenceCount, boolean virtual) {
+            this.name = name;
+            this.base = base;
+            this.size = size;
+            this.referenceCount = referenceCount;
+            this.virtual = virtual;
+        }
+        /**
+         * Records of the same module at the same place.
+         */
+        @Override
+        public boolean equals(Object o) {
+            if (!(o instanceof ModuleRecord)) {
+                return false;
+            }
+            ModuleRecord that = (ModuleRecord) o;
+            return name.equals(that.name) && base == that.base && size == that.size;
+        }
+        @Override
+        public int hashCode() {
+            return name.hashCode();
+        }
+    }
+
+    private void unmapExcept(Collection<Module> modules) {
+        for (MemoryMap map : new ArrayList<>(memoryMap.values())) {
+            boolean keep = false;
+            for (Module module : modules) {
+                if (map.base >= module.base && map.base < module.base + module.size) {
+                    keep = true;
+                    break;
+                }
+            }
+            if (!keep) {
+                backend.mem_unmap(map.base, map.size);
+                memoryMap.remove(map.base);
+            }
         }
     }
 
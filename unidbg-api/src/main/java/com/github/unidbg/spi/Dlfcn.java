@@ -10,7 +10,9 @@ import com.github.unidbg.serialize.Serializable;
 import org.apache.commons.logging.Log;
 import org.apache.commons.logging.LogFactory;
 
+import java.io.DataInput;
 import java.io.DataOutput;
+import java.io.IOException;
 
 public abstract class Dlfcn implements HookListener, Serializable {
 
@@ -35,8 +37,22 @@ public abstract class Dlfcn implements HookListener, Serializable {
         return symbol.getAddress();
     }
 
+    /**
+     * The dlfcn trampolines and the contents of the error buffer live in the svc memory, which is serialized with its contents.
+     */
     @Override
-    public void serialize(DataOutput out) {
-        throw new UnsupportedOperationException();
+    public void serialize(DataOutput out) throws IOException {
+        out.writeLong(error.peer);
+    }
+
+    /**
+     * The error buffer is allocated by the constructor: the restoring emulator must have created its svc memory in the same order.
+     */
+    @Override
+    public void deserialize(DataInput in) throws IOException {
+        long peer = in.readLong();
+        if (peer != error.peer) {
+            throw new IllegalStateException("dlfcn error buffer mismatch: peer=0x" + Long.toHexString(peer) + ", error=" + error);
+        }
     }
 }
@@ -10,6 +10,10 @@ import com.github.unidbg.serialize.Serializable;
 import com.github.unidbg.thread.MainTask;
 import com.github.unidbg.unix.FileListener;
 
+import java.io.DataInput;
+import java.io.DataOutput;
+import java.io.IOException;
+
 /**
  * syscall handler
  * Created by zhkl0228 on 2017/5/9.
@@ -44,4 +48,21 @@ public interface SyscallHandler<T extends NewFileIO> extends InterruptHook, Seri
 
     void destroy();
 
+    /**
+     * Let the backend answer hot syscalls such as getpid and clock_gettime without calling back into java,
+     * they are no longer visible to verbose logging or syscall hooks.
+     * @return <code>false</code> if the backend does not support native syscalls
+     */
+    boolean registerNativeSyscalls(Emulator<?> emulator);
+
+    /**
+     * Writes the descriptor, path, flags and offset of every open file.
+     */
+    void serialize(Emulator<T> emulator, DataOutput out) throws IOException;
+
+    /**
+     * Opens the files written by {@link #serialize(Emulator, DataOutput)} again.
+     */
+    void deserialize(Emulator<T> emulator, DataInput in) throws IOException;
+
 }
@@ -2,11 +2,10 @@ package com.github.unidbg.thread;
 
 import com.github.unidbg.AbstractEmulator;
 import com.github.unidbg.arm.ARM;
-import com.github.unidbg.arm.backend.Backend;
+import com.github.unidbg.arm.context.EditableArm64RegisterContext;
 import com.github.unidbg.memory.Memory;
 import org.apache.commons.logging.Log;
 import org.apache.commons.logging.LogFactory;
-import unicorn.Arm64Const;
 
 import java.util.Arrays;
 
@@ -27,7 +26,6 @@ public class Function64 extends MainTask {
 
     @Override
     protected Number run(AbstractEmulator<?> emulator) {
-        Backend backend = emulator.getBackend();
         Memory memory = emulator.getMemory();
         ARM.initArgs(emulator, paddingArgument, arguments);
 
@@ -35,7 +33,7 @@ public class Function64 extends MainTask {
         if (sp % 16 != 0) {
             log.info("SP NOT 16 bytes aligned", new Exception(emulator.getStackPointer().toString()));
         }
-        backend.reg_write(Arm64Const.UC_ARM64_REG_LR, until);
+        emulator.<EditableArm64RegisterContext>getContext().setLR(until);
         return emulator.emulate(address, until);
     }
 
@@ -20,6 +20,7 @@ import com.sun.jna.Pointer;
 import org.apache.commons.logging.Log;
 import org.apache.commons.logging.LogFactory;
 
+import java.io.DataInput;
 import java.io.DataOutput;
 import java.io.IOException;
 import java.util.ArrayList;
@@ -599,7 +600,65 @@ public abstract class UnixSyscallHandler<T extends NewFileIO> implements Syscall
 
     @Override
     public void serialize(DataOutput out) {
-        throw new UnsupportedOperationException();
+        throw new UnsupportedOperationException("serialize(Emulator, DataOutput)");
+    }
+
+    @Override
+    public void deserialize(DataInput in) {
+        throw new UnsupportedOperationException("deserialize(Emulator, DataInput)");
+    }
+
+    @Override
+    public void serialize(Emulator<T> emulator, DataOutput out) throws IOException {
+        out.writeInt(fdMap.size());
+        for (Map.Entry<Integer, T> entry : fdMap.entrySet()) {
+            T io = entry.getValue();
+            String path = io.getPath();
+            out.writeInt(entry.getKey());
+            out.writeUTF(path == null ? "" : path);
+            out.writeInt(io.fcntl(emulator, F_GETFL, 0));
+            out.writeInt(tell(io));
+        }
+    }
+
+    /**
+     * Open files are host objects: descriptors missing from this handler are opened again by path and seeked to
+     * their serialized offset, those which cannot be resolved any more are reported.
+     */
+    @Override
+    public void deserialize(Emulator<T> emulator, DataInput in) throws IOException {
+        int count = in.readInt();
+        for (int i = 0; i < count; i++) {
+            int fd = in.readInt();
+            String path = in.readUTF();
+            int oflags = in.readInt();
+            int offset = in.readInt();
+            if (fdMap.containsKey(fd)) {
+                continue;
+            }
+            FileResult<T> result = path.isEmpty() ? null : resolve(emulator, path, oflags);
+            if (result == null || !result.isSuccess()) {
+                log.warn("deserialize fd=" + fd + " cannot be reopened, path=" + path);
+                continue;
+            }
+            if (offset > 0) {
+                result.io.lseek(offset, FileIO.SEEK_SET);
+            }
+            fdMap.put(fd, result.io);
+        }
+    }
+
+    private static final int F_GETFL = 3; /* get file status flags */
+
+    /**
+     * @return the offset of <code>io</code>, or <code>-1</code> if it is not seekable
+     */
+    private static int tell(FileIO io) {
+        try {
+            return io.lseek(0, FileIO.SEEK_CUR);
+        } catch (AbstractMethodError | UnsupportedOperationException e) {
+            return -1;
+        }
     }
 
     @Override
@@ -618,6 +677,11 @@ public abstract class UnixSyscallHandler<T extends NewFileIO> implements Syscall
         }
     }
 
+    @Override
+    public boolean registerNativeSyscalls(Emulator<?> emulator) {
+        return false;
+    }
+
     protected boolean threadDispatcherEnabled;
 
     @Override
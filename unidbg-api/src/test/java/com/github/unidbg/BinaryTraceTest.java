@@ -0,0 +1,93 @@
+package com.github.unidbg;
+
+import com.github.unidbg.arm.backend.TraceBufferHook;
+import junit.framework.TestCase;
+
+import java.io.File;
+import java.io.FileOutputStream;
+import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+
+public class BinaryTraceTest extends TestCase {
+
+    private File file;
+
+    @Override
+    protected void setUp() throws Exception {
+        super.setUp();
+        file = File.createTempFile("unidbg", ".trace");
+    }
+
+    @Override
+    protected void tearDown() throws Exception {
+        assertTrue(file.delete());
+        super.tearDown();
+    }
+
+    public void testRoundTrip() throws IOException {
+        ByteBuffer records = ByteBuffer.allocateDirect(4 * TraceBufferHook.RECORD_SIZE).order(ByteOrder.nativeOrder());
+        try (BinaryTraceWriter writer = new BinaryTraceWriter(file)) {
+            putRecord(records, 0x1000, 0, 4, TraceBufferHook.TRACE_CODE);
+            putRecord(records, 0x2000, 0x1122334455667788L, 8, TraceBufferHook.TRACE_READ);
+            putRecord(records, 0xdead, 0xff, 1, TraceBufferHook.TRACE_WRITE); // not handed over
+            writer.onTrace(null, records, 2, null);
+
+            records.clear();
+            putRecord(records, 0x1004, 0, 2, TraceBufferHook.TRACE_CODE);
+            writer.onTrace(null, records, 1, null);
+        }
+
+        try (BinaryTraceReader reader = new BinaryTraceReader(file)) {
+            assertRecord(reader, 0x1000, 0, 4, TraceBufferHook.TRACE_CODE);
+            assertRecord(reader, 0x2000, 0x1122334455667788L, 8, TraceBufferHook.TRACE_READ);
+            assertRecord(reader, 0x1004, 0, 2, TraceBufferHook.TRACE_CODE);
+            assertFalse(reader.next());
+        }
+    }
+
+    public void testEmptyTrace() throws IOException {
+        new BinaryTraceWriter(file).close();
+        try (BinaryTraceReader reader = new BinaryTraceReader(file)) {
+            assertFalse(reader.next());
+        }
+    }
+
+    public void testInvalidHeader() throws IOException {
+        try (FileOutputStream outputStream = new FileOutputStream(file)) {
+            outputStream.write(new byte[BinaryTraceWriter.HEADER_SIZE]);
+        }
+        try {
+            new BinaryTraceReader(file).close();
+            fail();
+        } catch (IOException e) {
+            assertTrue(e.getMessage().startsWith("Not a trace file"));
+        }
+
+        try (FileOutputStream outputStream = new FileOutputStream(file)) {
+            outputStream.write(new byte[BinaryTraceWriter.HEADER_SIZE - 1]);
+        }
+        try {
+            new BinaryTraceReader(file).close();
+            fail();
+        } catch (IOException e) {
+            assertTrue(e.getMessage().startsWith("Truncated trace header"));
+        }
+    }
+
+    private static void putRecord(ByteBuffer records, long address, long value, int size, int type) {
+        records.putLong(address);
+        records.putLong(value);
+        records.putInt(size);
+        records.putInt(type);
+    }
+
+    private static void assertRecord(BinaryTraceReader reader, long address, long value, int size, int type) throws IOException {
+        assertTrue(reader.next());
+        assertEquals(address, reader.getAddress());
+        assertEquals(value, reader.getValue());
+        assertEquals(size, reader.getSize());
+        assertEquals(type, reader.getType());
+    }
+
+}
@@ -0,0 +1,97 @@
+package com.github.unidbg.memory;
+
+import junit.framework.TestCase;
+
+public class MemoryMapTreeTest extends TestCase {
+
+    private static final int PAGE = 0x1000;
+    private static final int PROT = 3;
+
+    private MemoryMapTree tree;
+
+    @Override
+    protected void setUp() throws Exception {
+        super.setUp();
+        tree = new MemoryMapTree();
+    }
+
+    public void testSplit() {
+        map(0x10000, 4 * PAGE);
+        map(0x20000, PAGE);
+        assertEquals(0x14000, tree.findGap(PAGE, 0));
+
+        // munmap of the second page: the map is split in two around a one page gap
+        tree.put(0x10000, new MemoryMap(0x10000, PAGE, PROT));
+        map(0x12000, 2 * PAGE);
+        assertEquals(3, tree.size());
+        assertEquals(0x11000, tree.findGap(PAGE - 1, 0));
+        assertEquals(0x14000, tree.findGap(PAGE, 0)); // a gap must be bigger than the length
+        assertEquals(0x14000, tree.findGap(0xc000 - 1, 0));
+        assertEquals(-1, tree.findGap(0xc000, 0));
+    }
+
+    public void testMerge() {
+        map(0x10000, PAGE);
+        map(0x12000, PAGE);
+        map(0x14000, PAGE);
+        assertEquals(0x11000, tree.findGap(PAGE - 1, 0));
+        assertEquals(-1, tree.findGap(PAGE, 0));
+
+        // the gaps on both sides of the removed map become one
+        assertNotNull(tree.remove(0x12000));
+        assertNull(tree.remove(0x12000));
+        assertEquals(0x11000, tree.findGap(2 * PAGE, 0));
+        assertEquals(-1, tree.findGap(3 * PAGE, 0));
+
+        tree.clear();
+        assertTrue(tree.isEmpty());
+        assertNull(tree.last());
+        assertEquals(-1, tree.findGap(1, 0));
+    }
+
+    public void testAlignedPlacement() {
+        long mask = 0xffff;
+        map(0x10000, PAGE);
+        map(0x18000, PAGE); // gap of 0x7000 at 0x11000, no 64K boundary in it
+        map(0x30000, PAGE); // gap of 0x17000 at 0x19000, 64K aligned at 0x20000
+        map(0x60000, PAGE); // gap of 0x2f000 at 0x31000, 64K aligned at 0x40000
+
+        assertEquals(0x11000, tree.findGap(PAGE, 0)); // best fit without alignment
+        assertEquals(0x20000, tree.findGap(PAGE, mask)); // the smallest gap does not fit once aligned
+        assertEquals(0x40000, tree.findGap(0x10000, mask)); // the only gap bigger than length + mask
+        assertEquals(-1, tree.findGap(0x20000, mask));
+    }
+
+    public void testContainment() {
+        map(0x10000, 2 * PAGE);
+        map(0x20000, PAGE);
+
+        assertNull(tree.findContaining(0xffff));
+        assertSame(tree.get(0x10000), tree.findContaining(0x10000));
+        assertSame(tree.get(0x10000), tree.findContaining(0x11fff));
+        assertNull(tree.findContaining(0x12000));
+        assertSame(tree.get(0x20000), tree.findContaining(0x20fff));
+        assertNull(tree.findContaining(0x21000));
+
+        assertTrue(tree.overlaps(0x11000, 0x11fff));
+        assertTrue(tree.overlaps(0x12000, 0x12fff)); // touches the end of the first map
+        assertFalse(tree.overlaps(0x13000, 0x1ffff));
+        assertTrue(tree.overlaps(0x13000, 0x20000));
+        assertSame(tree.get(0x20000), tree.last());
+    }
+
+    public void testValuesAreReadOnly() {
+        map(0x10000, PAGE);
+        try {
+            tree.values().clear();
+            fail();
+        } catch (UnsupportedOperationException ignored) {
+        }
+        assertEquals(1, tree.size());
+    }
+
+    private void map(long base, int size) {
+        assertNull(tree.put(base, new MemoryMap(base, size, PROT)));
+    }
+
+}
@@ -12,6 +12,7 @@ import com.github.unidbg.arm.Cpsr;
 import com.github.unidbg.arm.backend.Backend;
 import com.github.unidbg.arm.backend.BackendException;
 import com.github.unidbg.arm.context.Arm64RegisterContext;
+import com.github.unidbg.arm.context.BackendArm64RegisterContext;
 import com.github.unidbg.arm.context.EditableArm64RegisterContext;
 import com.github.unidbg.arm.context.RegisterContext;
 import com.github.unidbg.file.FileIO;
@@ -127,6 +128,21 @@ public class ARM64SyscallHandler extends DarwinSyscallHandler {
 
     private static final Log log = LogFactory.getLog(ARM64SyscallHandler.class);
 
+    /**
+     * Registers every svc needs, read with one backend call: the arguments, stack and return address served by the
+     * register context, then pc, syscall number, callback marker and callback svc number.
+     */
+    private static final int[] SVC_REGS = BackendArm64RegisterContext.syscallRegs(
+            Arm64Const.UC_ARM64_REG_PC,
+            Arm64Const.UC_ARM64_REG_X16,
+            Arm64Const.UC_ARM64_REG_X8,
+            Arm64Const.UC_ARM64_REG_X12);
+
+    private static final int SVC_PC = BackendArm64RegisterContext.SYSCALL_REG_COUNT;
+    private static final int SVC_NR = SVC_PC + 1;
+    private static final int SVC_MARKER = SVC_PC + 2;
+    private static final int SVC_NUMBER = SVC_PC + 3;
+
     private final SvcMemory svcMemory;
 
     protected ARM64SyscallHandler(SvcMemory svcMemory) {
@@ -139,7 +155,24 @@ public class ARM64SyscallHandler extends DarwinSyscallHandler {
     @Override
     public void hook(Backend backend, int intno, int swi, Object user) {
         Emulator<DarwinFileIO> emulator = (Emulator<DarwinFileIO>) user;
-        UnidbgPointer pc = UnidbgPointer.register(emulator, Arm64Const.UC_ARM64_REG_PC);
+        RegisterContext registerContext = emulator.getContext();
+        if (!(registerContext instanceof BackendArm64RegisterContext)) { // no cache to fill, the handlers read every register from the backend
+            long[] regs = new long[SVC_REGS.length];
+            backend.reg_read_batch(SVC_REGS, regs);
+            hook(backend, intno, swi, emulator, regs);
+            return;
+        }
+        BackendArm64RegisterContext context = (BackendArm64RegisterContext) registerContext;
+        long[] regs = context.enterSyscall(SVC_REGS);
+        try {
+            hook(backend, intno, swi, emulator, regs);
+        } finally {
+            context.leaveSyscall();
+        }
+    }
+
+    private void hook(Backend backend, int intno, int swi, Emulator<DarwinFileIO> emulator, long[] regs) {
+        UnidbgPointer pc = UnidbgPointer.pointer(emulator, regs[SVC_PC]);
 
         if (intno == ARMEmulator.EXCP_BKPT) { // brk
             createBreaker(emulator).brk(pc, pc == null ? swi : (pc.getInt(0) >> 5) & 0xffff);
@@ -154,12 +187,12 @@ public class ARM64SyscallHandler extends DarwinSyscallHandler {
             throw new BackendException("intno=" + intno);
         }
 
-        int NR = backend.reg_read(Arm64Const.UC_ARM64_REG_X16).intValue();
+        int NR = (int) regs[SVC_NR];
         String syscall = null;
         Throwable exception = null;
         try {
-            if (swi == 0 && NR == Svc.POST_CALLBACK_SYSCALL_NUMBER && backend.reg_read(Arm64Const.UC_ARM64_REG_X8).intValue() == 0) { // postCallback
-                int number = backend.reg_read(Arm64Const.UC_ARM64_REG_X12).intValue();
+            if (swi == 0 && NR == Svc.POST_CALLBACK_SYSCALL_NUMBER && (int) regs[SVC_MARKER] == 0) { // postCallback
+                int number = (int) regs[SVC_NUMBER];
                 Svc svc = svcMemory.getSvc(number);
                 if (svc != null) {
                     svc.handlePostCallback(emulator);
@@ -168,8 +201,8 @@ public class ARM64SyscallHandler extends DarwinSyscallHandler {
                 backend.emu_stop();
                 throw new IllegalStateException("svc number: " + swi);
             }
-            if (swi == 0 && NR == Svc.PRE_CALLBACK_SYSCALL_NUMBER && backend.reg_read(Arm64Const.UC_ARM64_REG_X8).intValue() == 0) { // preCallback
-                int number = backend.reg_read(Arm64Const.UC_ARM64_REG_X12).intValue();
+            if (swi == 0 && NR == Svc.PRE_CALLBACK_SYSCALL_NUMBER && (int) regs[SVC_MARKER] == 0) { // preCallback
+                int number = (int) regs[SVC_NUMBER];
                 Svc svc = svcMemory.getSvc(number);
                 if (svc != null) {
                     svc.handlePreCallback(emulator);
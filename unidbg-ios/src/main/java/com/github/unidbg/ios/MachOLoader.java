@@ -32,7 +32,6 @@ import com.github.unidbg.memory.MemRegion;
 import com.github.unidbg.memory.Memory;
 import com.github.unidbg.memory.MemoryAllocBlock;
 import com.github.unidbg.memory.MemoryBlock;
-import com.github.unidbg.memory.MemoryBlockImpl;
 import com.github.unidbg.memory.MemoryMap;
 import com.github.unidbg.pointer.UnidbgPointer;
 import com.github.unidbg.pointer.UnidbgStructure;
@@ -1889,7 +1888,7 @@ public class MachOLoader extends AbstractLoader<DarwinFileIO> implements Memory,
     @Override
     public MemoryBlock malloc(int length, boolean runtime) {
         if (runtime) {
-            return MemoryBlockImpl.alloc(this, length);
+            return runtimeArena.alloc(length);
         } else {
             return MemoryAllocBlock.malloc(emulator, malloc, free, length);
         }
@@ -2190,14 +2189,8 @@ public class MachOLoader extends AbstractLoader<DarwinFileIO> implements Memory,
     }
 
     final void remap(VmRemapRequest args) {
-        MemoryMap memoryMap = null;
-        for (MemoryMap map : emulator.getMemory().getMemoryMap()) {
-            if (args.target_address >= map.base && args.target_address + args.size <= map.base + map.size) {
-                memoryMap = map;
-                break;
-            }
-        }
-        if (memoryMap != null) {
+        MemoryMap memoryMap = this.memoryMap.findContaining(args.target_address);
+        if (memoryMap != null && args.target_address + args.size <= memoryMap.base + memoryMap.size) {
             munmap(args.target_address, (int) args.size);
         }
         int prot = UnicornConst.UC_PROT_ALL;
@@ -2224,11 +2217,9 @@ public class MachOLoader extends AbstractLoader<DarwinFileIO> implements Memory,
                 log.debug("mmap2 MAP_FIXED start=0x" + Long.toHexString(start) + ", length=" + length + ", prot=" + prot);
             }
 
-            MemoryMap mapped = null;
-            for (MemoryMap map : memoryMap.values()) {
-                if (start >= map.base && start + aligned <= map.base + map.size) {
-                    mapped = map;
-                }
+            MemoryMap mapped = memoryMap.findContaining(start);
+            if (mapped != null && start + aligned > mapped.base + mapped.size) {
+                mapped = null;
             }
 
             if (mapped != null) {
@@ -2282,11 +2273,9 @@ public class MachOLoader extends AbstractLoader<DarwinFileIO> implements Memory,
                     log.debug("mmap2 MAP_FIXED start=0x" + Long.toHexString(start) + ", length=" + length + ", prot=" + prot + ", fd=" + fd + ", offset=0x" + Long.toHexString(offset));
                 }
 
-                MemoryMap mapped = null;
-                for (MemoryMap map : memoryMap.values()) {
-                    if (start >= map.base && start + aligned <= map.base + map.size) {
-                        mapped = map;
-                    }
+                MemoryMap mapped = memoryMap.findContaining(start);
+                if (mapped != null && start + aligned > mapped.base + mapped.size) {
+                    mapped = null;
                 }
 
                 if (mapped != null) {
@@ -2311,11 +2300,9 @@ public class MachOLoader extends AbstractLoader<DarwinFileIO> implements Memory,
                     log.debug("mmap2 NOT VM_FLAGS_ANYWHERE start=0x" + Long.toHexString(start) + ", length=" + length + ", prot=" + prot + ", fd=" + fd + ", offset=0x" + Long.toHexString(offset));
                 }
 
-                MemoryMap mapped = null;
-                for (MemoryMap map : memoryMap.values()) {
-                    if (start >= map.base && start + aligned <= map.base + map.size) {
-                        mapped = map;
-                    }
+                MemoryMap mapped = memoryMap.findContaining(start);
+                if (mapped != null && start + aligned > mapped.base + mapped.size) {
+                    mapped = null;
                 }
 
                 if (mapped != null) {